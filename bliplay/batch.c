@@ -0,0 +1,463 @@
+/*
+ * Copyright (c) 2012-2016 Simon Schoenenberger
+ * http://blipkit.audio
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "bliplay.h"
+
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct batch_job
+{
+	BKString input;
+	BKString output;
+	BKInt    status;
+	double   secs;
+};
+
+struct batch
+{
+	BKArray                jobs;
+	BKUSize                nextJob;
+	BKInt                  numFailed;
+	struct bliplay const * app;
+#if BK_USE_THREADS
+	pthread_mutex_t        mutex;
+#endif
+};
+
+static void batch_lock (struct batch * batch)
+{
+#if BK_USE_THREADS
+	pthread_mutex_lock (&batch -> mutex);
+#endif
+}
+
+static void batch_unlock (struct batch * batch)
+{
+#if BK_USE_THREADS
+	pthread_mutex_unlock (&batch -> mutex);
+#endif
+}
+
+/**
+ * Dispose jobs including partially added ones
+ */
+static void batch_dispose (struct batch * batch)
+{
+	struct batch_job * job;
+
+	for (BKUSize i = 0; i < batch -> jobs.len; i ++) {
+		job = BKArrayItemAt (&batch -> jobs, i);
+
+		BKStringDispose (&job -> input);
+		BKStringDispose (&job -> output);
+	}
+
+	BKArrayDispose (&batch -> jobs);
+}
+
+/**
+ * Add job to batch
+ *
+ * If `output` is NULL, the output path is the input path with a `.wav`
+ * extension instead of `.blip`.
+ */
+static BKInt batch_add_job (struct batch * batch, char const * input, BKUSize inputLen, char const * output, BKUSize outputLen)
+{
+	struct batch_job * job;
+
+	if ((job = BKArrayPush (&batch -> jobs)) == NULL) {
+		return -1;
+	}
+
+	*job = (struct batch_job) {BK_STRING_INIT, BK_STRING_INIT, -1, 0.0};
+
+	if (BKStringAppendLen (&job -> input, input, inputLen) != 0) {
+		return -1;
+	}
+
+	if (output) {
+		if (BKStringAppendLen (&job -> output, output, outputLen) != 0) {
+			return -1;
+		}
+	}
+	else {
+		if (string_ends_with (input, ".blip")) {
+			inputLen -= strlen (".blip");
+		}
+
+		if (BKStringAppendLen (&job -> output, input, inputLen) != 0) {
+			return -1;
+		}
+
+		if (BKStringAppend (&job -> output, ".wav") != 0) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Add all `.blip` files in directory
+ */
+static BKInt batch_read_dir (struct batch * batch, char const * dirname)
+{
+	DIR * dir;
+	struct dirent * entry;
+	BKInt res = 0;
+	BKString path = BK_STRING_INIT;
+
+	if ((dir = opendir (dirname)) == NULL) {
+		print_error ("Could not open directory: %s\n", dirname);
+		return -1;
+	}
+
+	while ((entry = readdir (dir)) != NULL) {
+		if (entry -> d_name [0] == '.' || !string_ends_with (entry -> d_name, ".blip")) {
+			continue;
+		}
+
+		BKStringEmpty (&path);
+
+		if (BKStringAppendFormat (&path, "%s/%s", dirname, entry -> d_name) != 0) {
+			res = -1;
+			break;
+		}
+
+		if (batch_add_job (batch, (char *) path.str, path.len, NULL, 0) != 0) {
+			res = -1;
+			break;
+		}
+	}
+
+	BKStringDispose (&path);
+	closedir (dir);
+
+	return res;
+}
+
+/**
+ * Read manifest file
+ *
+ * Each line contains an input path and an optional output path separated by
+ * whitespace. Empty lines and lines beginning with `#` are ignored.
+ */
+static BKInt batch_read_manifest (struct batch * batch, FILE * file)
+{
+	char line [4096];
+	char * input, * output;
+	BKUSize inputLen, outputLen;
+
+	while (fgets (line, sizeof (line), file)) {
+		if (!strchr (line, '\n') && !feof (file)) {
+			print_error ("Manifest line too long: %.64s...\n", line);
+			return -1;
+		}
+
+		input = line + strspn (line, " \t");
+		inputLen = strcspn (input, " \t\r\n");
+
+		if (inputLen == 0 || input [0] == '#') {
+			continue;
+		}
+
+		output = input + inputLen;
+		output += strspn (output, " \t");
+		outputLen = strcspn (output, " \t\r\n");
+
+		input [inputLen] = '\0';
+
+		if (batch_add_job (batch, input, inputLen, outputLen ? output : NULL, outputLen) != 0) {
+			print_error ("Allocation error\n");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static BKInt batch_write_output (struct bliplay const * app, BKTKContext * ctx, struct batch_job const * job)
+{
+	BKInt res = 0;
+	BKInt done = 0;
+	BKInt numFrames;
+	BKTime time;
+	BKTime jobEndTime = (BKTime) {0};
+	BKTime const * jobEndTimePtr = NULL;
+	BKInt numChannels = ctx -> renderContext -> numChannels;
+	struct output output;
+	BKFrame * frames;
+
+	memset (&output, 0, sizeof (output));
+	output.type = output_type_for_name ((char *) job -> output.str);
+
+	// time units depend on the file's speed
+	if (app -> flags & FLAG_HAS_END_TIME) {
+		if (parse_seek_time (ctx -> renderContext, app -> endTimeString, &jobEndTime, ctx -> info.stepTicks) != 0) {
+			return -1;
+		}
+
+		jobEndTimePtr = &jobEndTime;
+	}
+
+	if (app -> flags & FLAG_HAS_SEEK_TIME) {
+		if (parse_seek_time (ctx -> renderContext, app -> seekTimeString, &time, ctx -> info.stepTicks) != 0) {
+			return -1;
+		}
+
+		jobEndTime = skip_time (jobEndTime, seek_context (ctx, time));
+	}
+
+	if ((frames = malloc (RENDER_CHUNK_FRAMES * numChannels * sizeof (BKFrame))) == NULL) {
+		return -1;
+	}
+
+	if ((output.file = fopen ((char *) job -> output.str, "wb+")) == NULL) {
+		print_error ("Could not open output file: %s\n", job -> output.str);
+		free (frames);
+		return -1;
+	}
+
+	if (output.type == OUTPUT_TYPE_WAVE) {
+		if ((res = BKWaveFileWriterInit (&output.writer, output.file, numChannels, ctx -> renderContext -> sampleRate, 0)) != 0) {
+			print_error ("Could not initialize WAVE writer: %s\n", BKStatusGetName (res));
+			fclose (output.file);
+			free (frames);
+			return -1;
+		}
+	}
+
+	while (!done) {
+		numFrames = render_frames (ctx, frames, RENDER_CHUNK_FRAMES, jobEndTimePtr, app -> flags, &done);
+
+		if (numFrames) {
+			write_frames (&output, frames, numFrames * numChannels);
+		}
+	}
+
+	if (output.type == OUTPUT_TYPE_WAVE) {
+		BKWaveFileWriterTerminate (&output.writer);
+		BKDispose (&output.writer);
+	}
+
+	fclose (output.file);
+	free (frames);
+
+	return res;
+}
+
+static BKInt batch_render (struct bliplay const * app, struct loader * loader, struct batch_job const * job)
+{
+	BKInt res;
+	struct stat st;
+	FILE * file;
+	BKTKContext context;
+	BKContext renderContext;
+	BKString loadPath = BK_STRING_INIT;
+	void * data = NULL;
+	size_t size = 0;
+
+	if (output_type_for_name ((char *) job -> output.str) == OUTPUT_TYPE_NONE) {
+		print_error ("Only .wav and .raw is supported for output: %s\n", job -> output.str);
+		return -1;
+	}
+
+	if (!(app -> flags & FLAG_YES) && stat ((char *) job -> output.str, &st) == 0) {
+		print_error ("Output file already exists: %s\n", job -> output.str);
+		return -1;
+	}
+
+	if ((file = fopen ((char *) job -> input.str, "rb")) == NULL) {
+		print_error ("No such file: %s\n", job -> input.str);
+		return -1;
+	}
+
+	if (BKStringDirname (&job -> input, &loadPath) != 0) {
+		fclose (file);
+		return -1;
+	}
+
+	if ((res = BKTKContextInit (&context, 0)) != 0) {
+		BKStringDispose (&loadPath);
+		fclose (file);
+		return res;
+	}
+
+	if ((res = BKContextInit (&renderContext, app -> numChannels, app -> sampleRate)) != 0) {
+		BKDispose (&context);
+		BKStringDispose (&loadPath);
+		fclose (file);
+		return res;
+	}
+
+	if ((res = map_program (file, &data, &size)) > 0) {
+		res = make_program_context (&context, &renderContext, data, size, 0, 1);
+	}
+	else if (res == 0) {
+		res = make_context (loader, &context, &renderContext, file, &loadPath, 0, 1);
+	}
+
+	fclose (file);
+
+	if (res == 0) {
+		res = batch_write_output (app, &context, job);
+	}
+
+	BKDispose (&context);
+	BKDispose (&renderContext);
+	BKStringDispose (&loadPath);
+
+	if (data) {
+		munmap (data, size);
+	}
+
+	return res;
+}
+
+static void * batch_run (void * info)
+{
+	double start;
+	struct batch * batch = info;
+	struct loader loader;
+	struct batch_job * job;
+
+	if (loader_init (&loader, batch -> app -> flags) != 0) {
+		return NULL;
+	}
+
+	for (;;) {
+		batch_lock (batch);
+		job = batch -> nextJob < batch -> jobs.len ? BKArrayItemAt (&batch -> jobs, batch -> nextJob ++) : NULL;
+		batch_unlock (batch);
+
+		if (job == NULL) {
+			break;
+		}
+
+		start = time_secs ();
+		job -> status = batch_render (batch -> app, &loader, job);
+		job -> secs = time_secs () - start;
+
+		batch_lock (batch);
+
+		if (job -> status == 0) {
+			print_message ("%s -> %s (%.3fs)\n", job -> input.str, job -> output.str, job -> secs);
+		}
+		else {
+			print_error ("Failed to render %s (%.3fs)\n", job -> input.str, job -> secs);
+			batch -> numFailed ++;
+		}
+
+		batch_unlock (batch);
+	}
+
+	loader_dispose (&loader);
+
+	return NULL;
+}
+
+/**
+ * Render files listed in manifest or contained in directory
+ *
+ * Files are rendered by `numJobs` workers, each reusing its tokenizer, parser
+ * and compiler. Failing files are reported and do not stop the batch.
+ */
+BKInt run_batch (struct bliplay const * app, char const * path)
+{
+	double start;
+	BKInt res;
+	BKInt numWorkers = 0;
+	BKInt numRendered = 0;
+	BKInt numJobsTotal;
+	struct stat st;
+	struct batch batch;
+	struct batch_job * job;
+	FILE * file;
+
+	memset (&batch, 0, sizeof (batch));
+	batch.jobs = BK_ARRAY_INIT (sizeof (struct batch_job));
+	batch.app = app;
+
+	if (strcmp (path, "-") == 0) {
+		res = batch_read_manifest (&batch, stdin);
+	}
+	else if (stat (path, &st) == 0 && S_ISDIR (st.st_mode)) {
+		res = batch_read_dir (&batch, path);
+	}
+	else if ((file = fopen (path, "r")) != NULL) {
+		res = batch_read_manifest (&batch, file);
+		fclose (file);
+	}
+	else {
+		print_error ("No such file: %s\n", path);
+		res = -1;
+	}
+
+	if (res != 0) {
+		batch_dispose (&batch);
+		return -1;
+	}
+
+	start = time_secs ();
+
+#if BK_USE_THREADS
+	pthread_t threads [MAX_JOBS];
+
+	pthread_mutex_init (&batch.mutex, NULL);
+
+	for (BKInt i = 1; i < BKMin (app -> numJobs, (BKInt) batch.jobs.len); i ++) {
+		if (pthread_create (&threads [numWorkers], NULL, batch_run, &batch) != 0) {
+			break;
+		}
+
+		numWorkers ++;
+	}
+#endif
+
+	batch_run (&batch);
+
+#if BK_USE_THREADS
+	for (BKInt i = 0; i < numWorkers; i ++) {
+		pthread_join (threads [i], NULL);
+	}
+
+	pthread_mutex_destroy (&batch.mutex);
+#endif
+
+	for (BKUSize i = 0; i < batch.jobs.len; i ++) {
+		job = BKArrayItemAt (&batch.jobs, i);
+
+		if (job -> status == 0) {
+			numRendered ++;
+		}
+	}
+
+	numJobsTotal = (BKInt) batch.jobs.len;
+	print_message ("Rendered %d of %d files with %d workers in %.3fs\n", numRendered, numJobsTotal, numWorkers + 1, time_secs () - start);
+
+	batch_dispose (&batch);
+
+	return numRendered == numJobsTotal ? 0 : -1;
+}
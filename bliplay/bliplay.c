@@ -21,149 +21,56 @@
  * IN THE SOFTWARE.
  */
 
-#define __USE_POSIX
-
-#ifdef HAVE_CONFIG_H
-#include "config.h"
-#endif
-
-#ifndef BK_USE_SDL
-#define BK_USE_SDL 1
-#endif
+#include "bliplay.h"
 
+#include <errno.h>
 #include <getopt.h>
-#include <math.h>
 #include <stdarg.h>
-#include <stdio.h>
-#include <sys/select.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
-#include <sys/types.h>
-#include <termios.h>
+#include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
-#if defined(BK_USE_SDL) && defined(BK_SDL_VERSION)
-#include "SDL.h"
-#endif
-
-#include "BKTK.h"
-#include "BlipKit.h"
-
-#define BK_BLIPLAY_VERSION "3.2.4"
-
-#ifndef FD_COPY
-#define FD_COPY(src, dest) memcpy ((dest), (src), sizeof (*(dest)))
-#endif
-
-#ifndef PROGRAM_NAME
-#define PROGRAM_NAME "bliplay"
-#endif
-
-enum OUTPUT_TYPE
-{
-	OUTPUT_TYPE_NONE,
-	OUTPUT_TYPE_RAW,
-	OUTPUT_TYPE_WAVE,
-};
-
-enum FLAG
+/**
+ * Terminal colors
+ *
+ * Set once before any thread is started.
+ */
+static struct colors
 {
-	FLAG_HAS_SEEK_TIME     = 1 << 0,
-	FLAG_HAS_END_TIME      = 1 << 1,
-	FLAG_PRINT_NO_TIME     = 1 << 2,
-	FLAG_NO_SOUND          = 1 << 3,
-	FLAG_INFO              = 1 << 4,
-	FLAG_INFO_EXPLICITE    = 1 << 5,
-	FLAG_YES               = 1 << 6,
-	FLAG_FROM_STDIN        = 1 << 7,
-	FLAG_TIMING_UNIT_SHIFT = 16,
-	FLAG_TIMING_UNIT_SECS  = 1 << 16,
-	FLAG_TIMING_UNIT_TICKS = 2 << 16,
-	FLAG_TIMING_UNIT_MASK  = 3 << 16, // next flag is at 18
-};
-
-static BKInt            istty;
-static BKInt            flags;
-static BKTKContext      ctx;
-static BKContext        renderCtx;
-static BKTKTokenizer    tok;
-static BKTKParser       parser;
-static BKTKCompiler     compiler;
-static BKUInt           sampleRate = 44100;
-static BKTime           seekTime, endTime;
-static BKInt            numChannels = 2;
-static char const     * filename;
-static char const     * outputFilename;
-static FILE           * outputFile;
-static FILE           * timingFile;
-static BKEnum           outputType = OUTPUT_TYPE_NONE;
-static BKWaveFileWriter waveWriter;
-static char             seekTimeString [64];
-static char             endTimeString [64];
-
-#if BK_USE_SDL
-static int              updateUSecs = 91200;
-#endif
-
-static char const * colorNormal = "";
-static char const * colorYellow = "";
-static char const * colorRed    = "";
-static char const * colorGreen  = "";
+	BKInt        enabled;
+	char const * normal;
+	char const * yellow;
+	char const * red;
+	char const * green;
+} colors = {0, "", "", "", ""};
 
 struct option const options [] =
 {
+	{"compile-only", required_argument, NULL, 'c'},
 	{"load-dir",     required_argument, NULL, 'd'},
+	{"daemon",       required_argument, NULL, 'D'},
 	{"fast-forward", required_argument, NULL, 'f'},
 	{"help",         no_argument,       NULL, 'h'},
+	{"batch",        no_argument,       NULL, 'b'},
+	{"buffer-size",  required_argument, NULL, 'B'},
 	{"info",         required_argument, NULL, 'i'},
+	{"jobs",         required_argument, NULL, 'j'},
 	{"end-time",     required_argument, NULL, 'l'},
 	{"no-time",      no_argument,       NULL, 'n'},
+	{"optimize",     no_argument,       NULL, 'O'},
 	{"output",       required_argument, NULL, 'o'},
+	{"play",         no_argument,       NULL, 'p'},
+	{"realtime",     no_argument,       NULL, 'R'},
 	{"samplerate",   required_argument, NULL, 'r'},
+	{"stats",        no_argument,       NULL, 'S'},
 	{"timing-data",  required_argument, NULL, 't'},
 	{"version",      no_argument,       NULL, 'v'},
 	{"yes",          no_argument,       NULL, 'y'},
 	{NULL,           0,                 NULL, 0},
 };
 
-#if BK_USE_SDL
-static int set_noecho (int nocanon)
-{
-	struct termios oldtc, newtc;
-
-	tcgetattr (STDIN_FILENO, & oldtc);
-
-	newtc = oldtc;
-
-	if (nocanon) {
-		newtc.c_lflag &= ~(ICANON | ECHO);
-	}
-	else {
-		newtc.c_lflag |= (ICANON | ECHO);
-	}
-
-	tcsetattr (STDIN_FILENO, TCSANOW, & newtc);
-
-	return 0;
-}
-
-static int getchar_nocanon (unsigned tcflags)
-{
-	int c;
-	struct termios oldtc, newtc;
-
-	tcgetattr (STDIN_FILENO, & oldtc);
-
-	newtc = oldtc;
-	newtc.c_lflag &= ~(ICANON | ECHO | tcflags);
-
-	tcsetattr (STDIN_FILENO, TCSANOW, & newtc);
-	c = getchar ();
-	tcsetattr (STDIN_FILENO, TCSANOW, & oldtc);
-
-	return c;
-}
-#endif /* BK_USE_SDL */
-
 static int string_begins_with (char const * str, char const * head)
 {
 	char const * sc, * hc;
@@ -192,7 +99,7 @@ static int string_begins_with (char const * str, char const * head)
 	return 1;
 }
 
-static int string_ends_with (char const * str, char const * tail)
+int string_ends_with (char const * str, char const * tail)
 {
 	char const * sc, * tc;
 	BKSize sl, tl;
@@ -232,6 +139,22 @@ static void print_help (void)
 		"  sound player and renderer\n"
 		"  more info for file syntax: " PACKAGE_URL "\n"
 		"usage: %1$s [options] file\n"
+		"  %2$s-b, --batch%3$s\n"
+		"      Render multiple files; input is a manifest file or directory\n"
+		"      Manifest lines contain an input and an optional output file\n"
+		"      Files in a directory are rendered to [name].wav\n"
+		"      Use %2$s-j%3$s to set the number of worker threads\n"
+		"  %2$s-B, --buffer-size frames|auto%3$s\n"
+		"      Set audio buffer size in frames (default: 512)\n"
+		"      Range: 128 - 8192; rounded up to a power of 2\n"
+		"      auto: adjust size to callback duration and underruns\n"
+		"  %2$s-c, --compile-only file.blipc%3$s\n"
+		"      Write compiled program to file and exit\n"
+		"      Compiled programs can be used as input file\n"
+		"  %2$s-D, --daemon socket%3$s\n"
+		"      Accept render jobs on a Unix domain socket\n"
+		"      Compiled files are cached for repeated jobs\n"
+		"      Use %2$s-j%3$s to set the number of worker threads\n"
 		"  %2$s-d, --load-dir path%3$s\n"
 		"      Sets the path for loading resources\n"
 		"      If not set, the input file's directory is used\n"
@@ -244,25 +167,39 @@ static void print_help (void)
 		"      Print this screen and exit\n"
 		"  %2$s-i, --info%3$s\n"
 		"      Validate and print info about input file then exit\n"
+		"  %2$s-j, --jobs count%3$s\n"
+		"      Number of threads used to render tracks when writing to file\n"
+		"      or number of workers in batch mode\n"
+		"      (default: 1)\n"
 		"  %2$s-l, --end-time time%3$s\n"
 		"      Maximum end time to export\n"
 		"      Time format is the same as of %2$s-f%3$s\n"
 		"  %2$s-n, --no-time%3$s\n"
 		"      Do not print play time\n"
+		"  %2$s-O, --optimize%3$s\n"
+		"      Inline small groups and remove redundant instructions when compiling\n"
 		"  %2$s-o, --output file.[wav|raw]%3$s\n"
 		"      Write audio data to file\n"
 		"      WAVE format: PCM 16 bit, stereo\n"
 		"      RAW format: headerless native signed 16 bit, stereo\n"
+		"  %2$s-p, --play%3$s\n"
+		"      Play audio while writing to file with %2$s-o%3$s\n"
+		"  %2$s-R, --realtime%3$s\n"
+		"      Write output at playback pace and report timing jitter\n"
+		"      Output may also be a FIFO or stdout\n"
 		"  %2$s-r, --samplerate value%3$s\n"
 		"      Set output sample rate (default: 44100)\n"
 		"      Range: 16000 - 96000\n"
+		"  %2$s-S, --stats%3$s\n"
+		"      Print audio callback statistics after playing\n"
+		"      Press [s] to print them while playing\n"
 		"  %2$s-t, --timing-data [s|t]%3$s\n"
 		"      Write timing data to [output file].txt\n"
 		"      Units: s: seconds, t: ticks\n"
 		"      Ignored when not used with %2$s-o%3$s\n"
 		"  %2$s-y, --yes%3$s\n"
 		"      Overwrite output file without asking\n",
-		PROGRAM_NAME, colorYellow, colorNormal
+		PROGRAM_NAME, colors.yellow, colors.normal
 	);
 }
 
@@ -270,22 +207,26 @@ static void set_color (FILE * stream, int level)
 {
 	char const * color;
 
-	if (!istty) {
+	if (!colors.enabled) {
 		return;
 	}
 
 	switch (level) {
 		default:
 		case 0: {
-			color = colorNormal;
+			color = colors.normal;
 			break;
 		}
 		case 1: {
-			color = colorYellow;
+			color = colors.yellow;
 			break;
 		}
 		case 2: {
-			color = colorRed;
+			color = colors.red;
+			break;
+		}
+		case 3: {
+			color = colors.green;
 			break;
 		}
 	}
@@ -304,13 +245,27 @@ static void print_color_string (char const * format, va_list args, int level)
 		}
 	}
 
+	// batch workers print concurrently
+	flockfile (stream);
 	set_color (stream, level);
 	vfprintf (stream, format, args);
 	set_color (stream, 0);
 	fflush (stream);
+	funlockfile (stream);
+}
+
+static void init_colors (BKInt istty)
+{
+	if (istty) {
+		colors.enabled = 1;
+		colors.red     = "\033[31m";
+		colors.yellow  = "\033[33m";
+		colors.green   = "\033[32m";
+		colors.normal  = "\033[0m";
+	}
 }
 
-static void print_message (char const * format, ...)
+void print_message (char const * format, ...)
 {
 	va_list args;
 
@@ -319,7 +274,7 @@ static void print_message (char const * format, ...)
 	va_end (args);
 }
 
-static void print_notice (char const * format, ...)
+void print_notice (char const * format, ...)
 {
 	va_list args;
 
@@ -329,7 +284,7 @@ static void print_notice (char const * format, ...)
 
 }
 
-static void print_error (char const * format, ...)
+void print_error (char const * format, ...)
 {
 	va_list args;
 
@@ -338,65 +293,197 @@ static void print_error (char const * format, ...)
 	va_end (args);
 }
 
-static void output_chunk (BKFrame const frames [], BKInt numFrames)
+void print_status (char const * format, ...)
 {
-	switch (outputType) {
+	va_list args;
+
+	va_start (args, format);
+	print_color_string (format, args, 3);
+	va_end (args);
+}
+
+BKEnum output_type_for_name (char const * name)
+{
+	if (string_ends_with (name, ".wav")) {
+		return OUTPUT_TYPE_WAVE;
+	}
+	else if (string_ends_with (name, ".raw")) {
+		return OUTPUT_TYPE_RAW;
+	}
+
+	return OUTPUT_TYPE_NONE;
+}
+
+void make_wave_header (uint8_t header [WAVE_HEADER_SIZE], BKInt numChannels, BKInt sampleRate, uint32_t dataSize)
+{
+	uint32_t const values [] = {
+		36 + dataSize, 16, 1 | (numChannels << 16), sampleRate,
+		sampleRate * numChannels * 2, (numChannels * 2) | (16 << 16), dataSize,
+	};
+	BKInt const offsets [] = {4, 16, 20, 24, 28, 32, 40};
+
+	memcpy (&header [0], "RIFF", 4);
+	memcpy (&header [8], "WAVEfmt ", 8);
+	memcpy (&header [36], "data", 4);
+
+	// little endian
+	for (BKInt i = 0; i < 7; i ++) {
+		for (BKInt j = 0; j < 4; j ++) {
+			header [offsets [i] + j] = (values [i] >> (j * 8)) & 0xFF;
+		}
+	}
+}
+
+/**
+ * Write WAVE header with maximum data size
+ *
+ * Used when the sizes cannot be patched after writing the frames, e.g., for
+ * pipes. Readers stop at the end of the stream.
+ */
+static BKInt write_wave_stream_header (FILE * file, BKInt numChannels, BKInt sampleRate)
+{
+	uint8_t header [WAVE_HEADER_SIZE];
+
+	make_wave_header (header, numChannels, sampleRate, WAVE_STREAM_DATA_SIZE);
+
+	return fwrite (header, 1, sizeof (header), file) == sizeof (header) ? 0 : -1;
+}
+
+/**
+ * Convert frames to little endian samples
+ */
+void frames_to_le (uint8_t data [], BKFrame const frames [], BKInt numFrames)
+{
+	for (BKInt i = 0; i < numFrames; i ++) {
+		data [i * 2 + 0] = (uint16_t) frames [i] & 0xFF;
+		data [i * 2 + 1] = (uint16_t) frames [i] >> 8;
+	}
+}
+
+/**
+ * Write frames as little endian samples
+ */
+static void write_frames_le (FILE * file, BKFrame const frames [], BKInt numFrames)
+{
+	uint8_t data [1024];
+	BKInt size;
+
+	while (numFrames) {
+		size = BKMin (numFrames, (BKInt) sizeof (data) / 2);
+		frames_to_le (data, frames, size);
+		fwrite (data, 2, size, file);
+		frames += size;
+		numFrames -= size;
+	}
+}
+
+void write_frames (struct output * output, BKFrame const frames [], BKInt numFrames)
+{
+	switch (output -> type) {
 		case OUTPUT_TYPE_RAW: {
-			fwrite (frames, numFrames, sizeof (BKFrame), outputFile);
+			fwrite (frames, numFrames, sizeof (BKFrame), output -> file);
 			break;
 		}
 		case OUTPUT_TYPE_WAVE: {
-			BKWaveFileWriterAppendFrames (& waveWriter, frames, numFrames);
+			BKWaveFileWriterAppendFrames (&output -> writer, frames, numFrames);
+			break;
+		}
+		case OUTPUT_TYPE_WAVE_STREAM: {
+			write_frames_le (output -> file, frames, numFrames);
 			break;
 		}
 	}
 }
 
-#if BK_USE_SDL
-static void fill_audio (BKTKContext * ctx, Uint8 * stream, int len)
+int64_t monotonic_nsecs (void)
 {
-	BKUInt numChannels = ctx -> renderContext -> numChannels;
-	BKUInt numFrames   = len / sizeof (BKFrame) / numChannels;
+	struct timespec time;
+
+	clock_gettime (CLOCK_MONOTONIC, &time);
 
-	BKContextGenerate (ctx -> renderContext, (BKFrame *) stream, numFrames);
-	output_chunk ((BKFrame *) stream, numFrames * numChannels);
+	return (int64_t) time.tv_sec * 1000000000 + time.tv_nsec;
 }
-#endif /* BK_USE_SDL */
 
-static BKInt push_frames (BKFrame inFrames [], BKUInt size, void * info)
+BKInt push_frames (BKFrame inFrames [], BKUInt size, void * info)
 {
 	return 0;
 }
 
-static void seek_context (BKTKContext * ctx, BKTime time)
+/**
+ * Fast forward to time
+ *
+ * The interpreters are advanced silently up to `prerollSecs` before `time`.
+ * The remaining frames are rendered to let envelopes and effects settle.
+ * Seeks from the last keyframe if `keyframes` is not NULL. Returns the time
+ * skipped without advancing the render context.
+ */
+BKTime seek_context_preroll (BKTKContext * ctx, BKTKKeyframes const * keyframes, BKTime time, double prerollSecs)
+{
+	BKInt res;
+	BKTime skipTime = (BKTime) {0};
+	BKTime preroll = BKTimeFromSeconds (ctx -> renderContext, prerollSecs);
+
+	if (BKTimeIsGreater (time, preroll)) {
+		if (keyframes) {
+			res = BKTKContextSeekKeyframe (ctx, keyframes, BKTimeSub (time, preroll), &skipTime);
+		}
+		else {
+			res = BKTKContextSeek (ctx, BKTimeSub (time, preroll), &skipTime);
+		}
+
+		if (res != 0) {
+			skipTime = (BKTime) {0};
+		}
+	}
+	else if (keyframes) {
+		BKTKContextSeekKeyframe (ctx, keyframes, (BKTime) {0}, &skipTime);
+	}
+
+	BKContextGenerateToTime (ctx -> renderContext, BKTimeSub (time, skipTime), push_frames, NULL);
+
+	return skipTime;
+}
+
+BKTime seek_context (BKTKContext * ctx, BKTime time)
 {
-	BKContextGenerateToTime (ctx -> renderContext, time, push_frames, NULL);
+	return seek_context_preroll (ctx, NULL, time, SEEK_PREROLL_SECS);
 }
 
-#if BK_USE_SDL
-static BKInt init_sdl (BKTKContext * ctx, char const ** error)
+/**
+ * Make time relative to render context after skipping `skipTime`
+ */
+BKTime skip_time (BKTime time, BKTime skipTime)
 {
-	SDL_Init (SDL_INIT_AUDIO);
+	if (BKTimeIsGreater (time, skipTime)) {
+		return BKTimeSub (time, skipTime);
+	}
+
+	return (BKTime) {0};
+}
 
-	SDL_AudioSpec wanted;
+/**
+ * Build keyframes with a snapshot every `KEYFRAME_INTERVAL_BEATS`
+ *
+ * Only the first `KEYFRAME_MAX_SECS` are indexed.
+ */
+BKInt make_keyframes (BKTKContext * ctx, BKTKKeyframes * keyframes)
+{
+	BKInt interval = KEYFRAME_INTERVAL_BEATS * ctx -> info.stepTicks;
+	BKTime maxTime = BKTimeFromSeconds (ctx -> renderContext, KEYFRAME_MAX_SECS);
 
-	wanted.freq     = ctx -> renderContext -> sampleRate;
-	wanted.format   = AUDIO_S16SYS;
-	wanted.channels = ctx -> renderContext -> numChannels;
-	wanted.samples  = 512;
-	wanted.callback = (void *) fill_audio;
-	wanted.userdata = ctx;
+	if (BKTKKeyframesInit (keyframes) != 0) {
+		return -1;
+	}
 
-	if (SDL_OpenAudio (& wanted, NULL) < 0) {
-		* error = SDL_GetError ();
+	if (BKTKContextBuildKeyframes (ctx, keyframes, interval, &maxTime) != 0) {
+		BKDispose (keyframes);
 		return -1;
 	}
 
 	return 0;
 }
-#endif /* BK_USE_SDL */
 
-static BKInt check_tracks_running (BKTKContext const * ctx)
+BKInt check_tracks_running (BKTKContext const * ctx, BKInt flags)
 {
 	BKTKTrack * track;
 	BKSize numActive = 0;
@@ -423,7 +510,7 @@ static BKInt check_tracks_running (BKTKContext const * ctx)
 	return numActive > 0;
 }
 
-static BKInt parse_seek_time (char const * string, BKTime * outTime, BKInt speed)
+BKInt parse_seek_time (BKContext * renderContext, char const * string, BKTime * outTime, BKInt speed)
 {
 	double value;
 	char   type;
@@ -452,15 +539,15 @@ static BKInt parse_seek_time (char const * string, BKTime * outTime, BKInt speed
 			break;
 		}
 		case 'b': {
-			time = BKTimeFromSeconds (ctx.renderContext, (1.0 / 240) * speed * value);
+			time = BKTimeFromSeconds (renderContext, (1.0 / 240) * speed * value);
 			break;
 		}
 		case 't': {
-			time = BKTimeFromSeconds (ctx.renderContext, (1.0 / 240) * value);
+			time = BKTimeFromSeconds (renderContext, (1.0 / 240) * value);
 			break;
 		}
 		case 's': {
-			time = BKTimeFromSeconds (ctx.renderContext, value);
+			time = BKTimeFromSeconds (renderContext, value);
 			break;
 		}
 		default: {
@@ -474,22 +561,7 @@ static BKInt parse_seek_time (char const * string, BKTime * outTime, BKInt speed
 	return 0;
 }
 
-#if BK_USE_SDL
-static void print_time (BKTKContext const * ctx)
-{
-	int frames = BKTimeGetTime (ctx -> renderContext -> currentTime) * 100 / ctx -> renderContext -> sampleRate;
-	int frac   = frames % 100;
-	int hsecs  = frames / 100;
-
-	int secs = hsecs % 60;
-	int mins = hsecs / 60;
-
-	printf ("\r%s%4d:%02d.%02d%s", colorGreen, mins, secs, frac, colorNormal);
-	fflush (stdout);
-}
-#endif /* BK_USE_SDL */
-
-static BKInt count_slots (BKArray const * array)
+BKInt count_slots (BKArray const * array)
 {
 	BKInt count = 0;
 	BKTKObject const * object;
@@ -639,18 +711,18 @@ static BKInt should_overwrite_output (char const * filename)
 	return 0;
 }
 
-static BKInt put_token (BKTKToken const * token, BKTKParser * parser)
+static BKInt put_tokens (BKTKToken const * tokens, BKUSize count, BKTKParser * parser)
 {
 	BKInt res;
 
-	if ((res = BKTKParserPutTokens (parser, token, 1)) != 0) {
+	if ((res = BKTKParserPutTokens (parser, tokens, count)) != 0) {
 		return res;
 	}
 
 	return 0;
 }
 
-static BKInt context_init (BKTKContext * ctx, BKInt numChannels, BKInt sampleRate, BKUInt flags)
+static BKInt context_init (BKTKContext * ctx, BKContext * renderCtx, BKInt numChannels, BKInt sampleRate, BKUInt flags)
 {
 	BKInt res = 0;
 
@@ -658,7 +730,7 @@ static BKInt context_init (BKTKContext * ctx, BKInt numChannels, BKInt sampleRat
 		return res;
 	}
 
-	if ((res = BKContextInit (&renderCtx, numChannels, sampleRate)) != 0) {
+	if ((res = BKContextInit (renderCtx, numChannels, sampleRate)) != 0) {
 		print_error ("Context init failed (%s)\n", BKStatusGetName (res));
 		return res;
 	}
@@ -666,78 +738,211 @@ static BKInt context_init (BKTKContext * ctx, BKInt numChannels, BKInt sampleRat
 	return res;
 }
 
-static BKInt make_context (BKTKContext * ctx, FILE * file, BKString * const loadPath)
+BKInt loader_init (struct loader * loader, BKInt flags)
 {
 	BKInt res = 0;
-	BKTKParserNode * nodeTree;
 
-	if ((res = BKTKParserInit (&parser)) != 0) {
+	if ((res = BKTKTokenizerInit (&loader -> tok)) != 0) {
+		print_error ("BKTKTokenizerInit failed (%s)\n", BKStatusGetName (res));
+		return res;
+	}
+
+	// embedded sample data is not copied by the parser
+	loader -> tok.object.flags |= BKTKTokenizerFlagKeepData;
+
+	if ((res = BKTKParserInit (&loader -> parser)) != 0) {
 		print_error ("BKTKParserInit failed (%s)\n", BKStatusGetName (res));
+		BKDispose (&loader -> tok);
 		return res;
 	}
 
-	if ((res = BKTKTokenizerInit (&tok)) != 0) {
-		print_error ("BKTKTokenizerInit failed (%s)\n", BKStatusGetName (res));
+	if ((res = BKTKCompilerInit (&loader -> compiler)) != 0) {
+		print_error ("BKTKCompilerInit failed (%s)\n", BKStatusGetName (res));
+		BKDispose (&loader -> parser);
+		BKDispose (&loader -> tok);
 		return res;
 	}
 
+	if (flags & FLAG_OPTIMIZE) {
+		loader -> compiler.object.flags |= BKTKCompilerFlagOptimize | BKTKCompilerFlagInline;
+	}
+
+	loader -> numJobs = 1;
+	loader -> flags = flags;
+
+	return 0;
+}
+
+void loader_dispose (struct loader * loader)
+{
+	BKDispose (&loader -> compiler);
+	BKDispose (&loader -> parser);
+	BKDispose (&loader -> tok);
+}
+
+/**
+ * Tokenize whole file at once if it can be mapped
+ *
+ * Large files are tokenized by `numJobs` threads. Falls back to reading
+ * chunks, e.g., from stdin.
+ */
+static void tokenize_file (BKTKTokenizer * tok, BKTKParser * parser, FILE * file, BKInt numJobs)
+{
+	struct stat st;
+	void * data;
+	int fd = fileno (file);
+	BKTKToken tokens [TOKEN_BATCH_SIZE];
+
+	if (fd >= 0 && fstat (fd, &st) == 0 && S_ISREG (st.st_mode) && st.st_size > 0 && ftello (file) == 0) {
+		data = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (data != MAP_FAILED) {
+			madvise (data, st.st_size, MADV_SEQUENTIAL);
+
+			// tokens may reference the mapping until parsed
+			if (numJobs > 1 && st.st_size >= SPLIT_TOKENIZE_MIN_SIZE) {
+				BKTKTokenizerPutResidentCharsSplit (tok, data, st.st_size, SPLIT_SEGMENT_SIZE, numJobs, tokens, TOKEN_BATCH_SIZE, (BKTKPutTokensFunc) put_tokens, parser);
+			}
+			else {
+				BKTKTokenizerPutResidentChars (tok, data, st.st_size, tokens, TOKEN_BATCH_SIZE, (BKTKPutTokensFunc) put_tokens, parser);
+			}
+
+			munmap (data, st.st_size);
+
+			return;
+		}
+	}
+
 	do {
 		size_t size;
-		uint8_t buffer [1024];
+		uint8_t buffer [READ_CHUNK_SIZE];
 
 		size = fread (buffer, sizeof (uint8_t), sizeof (buffer), file);
 
 		// will also be called with `chunkSize` = 0 to terminate tokenizer
-		if (BKTKTokenizerPutChars (&tok, buffer, size, (BKTKPutTokenFunc) put_token, &parser) != 0) {
+		if (BKTKTokenizerPutCharsBatch (tok, buffer, size, tokens, TOKEN_BATCH_SIZE, (BKTKPutTokensFunc) put_tokens, parser) != 0) {
 			break;
 		}
 	}
-	while (!BKTKTokenizerIsFinished (&tok));
+	while (!BKTKTokenizerIsFinished (tok));
+}
 
-	if (BKTKTokenizerHasError (&tok)) {
-		print_error ("%s\n", tok.buffer);
-		res = -1;
+BKInt make_context (struct loader * loader, BKTKContext * ctx, BKContext * renderCtx, FILE * file, BKString const * loadPath, BKInt shardIndex, BKInt numShards)
+{
+	BKInt res = 0;
+	BKTKTree tree;
+	BKTKTokenizer * tok = &loader -> tok;
+	BKTKParser * parser = &loader -> parser;
+	BKTKCompiler * compiler = &loader -> compiler;
+
+	if ((res = BKTKTreeInit (&tree, NULL)) != 0) {
+		print_error ("Allocation error\n");
+		return res;
 	}
 
-	if (BKTKParserHasError (&parser)) {
-		print_error ("%s\n", parser.buffer);
+	BKTKTokenizerReset (tok);
+	BKTKParserReset (parser);
+	// parse into flat tree to compile it without copying
+	BKTKParserSetTree (parser, &tree);
+
+	tokenize_file (tok, parser, file, loader -> numJobs);
+
+	if (BKTKTokenizerHasError (tok)) {
+		print_error ("%s\n", tok -> buffer);
 		res = -1;
 	}
 
-	if (res) {
-		return res;
+	if (BKTKParserHasError (parser)) {
+		print_error ("%s\n", parser -> buffer);
+		res = -1;
 	}
 
-	BKDispose (&tok);
+	if (res == 0 && (res = BKTKCompilerCompileTree (compiler, &tree)) != 0) {
+		print_error ("%s", (char *) compiler -> error.str);
+		BKTKCompilerReset (compiler);
+	}
 
-	nodeTree = BKTKParserGetNodeTree (&parser);
+	BKTKParserReset (parser);
+	BKDispose (&tree);
 
-	if ((res = BKTKCompilerInit (&compiler)) != 0) {
-		print_error ("BKTKCompilerInit failed (%s)\n", BKStatusGetName (res));
+	if (res) {
 		return res;
 	}
 
-	if ((res = BKTKCompilerCompile (&compiler, nodeTree)) != 0) {
-		print_error ((char *) compiler.error.str);
-		return res;
+	if ((loader -> flags & FLAG_OPTIMIZE) && (loader -> flags & FLAG_STATS)) {
+		print_message ("Optimizer inlined %zu calls and removed %zu instructions\n", (size_t) compiler -> numInlinedCalls, (size_t) compiler -> numRemovedInstrs);
 	}
 
-	BKDispose (&parser);
+	// free data literals kept for the node tree
+	BKTKTokenizerReset (tok);
 
 	if ((res = BKStringReplaceInRange (&ctx -> loadPath, loadPath, 0, ctx -> loadPath.len)) != 0) {
 		print_error ("Allocation error\n");
+		BKTKCompilerReset (compiler);
 		return res;
 	}
 
-	if ((res = BKTKContextCreate (ctx, &compiler)) != 0) {
+	// also resets compiler
+	if ((res = BKTKContextCreate (ctx, compiler)) != 0) {
 		print_error ("Creating context failed (%s)\n", BKStatusGetName (res));
-		print_error ((char *) ctx -> error.str);
+		print_error ("%s", (char *) ctx -> error.str);
+		BKTKCompilerReset (compiler);
+		return res;
+	}
+
+	if ((res = BKTKContextAttachShard (ctx, renderCtx, shardIndex, numShards)) != 0) {
+		print_error ("Attaching context failed (%s)\n", BKStatusGetName (res));
 		return res;
 	}
 
-	BKDispose (&compiler);
+	return 0;
+}
+
+/**
+ * Map file if it contains a compiled program
+ *
+ * Returns 1 if the program was mapped, 0 if the file is not a compiled program
+ * or cannot be mapped, e.g., stdin, and -1 on error.
+ */
+BKInt map_program (FILE * file, void ** outData, size_t * outSize)
+{
+	struct stat st;
+	char magic [4];
+	void * data;
+	int fd = fileno (file);
+
+	if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode) || st.st_size < (off_t) sizeof (magic)) {
+		return 0;
+	}
+
+	if (pread (fd, magic, sizeof (magic), 0) != sizeof (magic) || memcmp (magic, BK_TK_PROGRAM_MAGIC, sizeof (magic)) != 0) {
+		return 0;
+	}
+
+	data = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if (data == MAP_FAILED) {
+		print_error ("Failed to map compiled program (%s)\n", strerror (errno));
+		return -1;
+	}
 
-	if ((res = BKTKContextAttach (ctx, &renderCtx)) != 0) {
+	*outData = data;
+	*outSize = st.st_size;
+
+	return 1;
+}
+
+BKInt make_program_context (BKTKContext * ctx, BKContext * renderCtx, void const * data, size_t size, BKInt shardIndex, BKInt numShards)
+{
+	BKInt res;
+
+	if ((res = BKTKContextLoadProgram (ctx, data, size)) != 0) {
+		print_error ("Loading compiled program failed (%s)\n", BKStatusGetName (res));
+		print_error ("%s", (char *) ctx -> error.str);
+		return res;
+	}
+
+	if ((res = BKTKContextAttachShard (ctx, renderCtx, shardIndex, numShards)) != 0) {
 		print_error ("Attaching context failed (%s)\n", BKStatusGetName (res));
 		return res;
 	}
@@ -745,7 +950,171 @@ static BKInt make_context (BKTKContext * ctx, FILE * file, BKString * const load
 	return 0;
 }
 
-static BKInt handle_options (BKTKContext * ctx, int argc, char * argv [])
+static BKInt write_program_data (FILE * file, uint8_t const * data, BKUSize size)
+{
+	return fwrite (data, sizeof (uint8_t), size, file) == size ? 0 : BK_FILE_ERROR;
+}
+
+static BKInt write_program (BKTKContext const * ctx, char const * filename)
+{
+	BKInt res;
+	FILE * file = fopen (filename, "wb");
+
+	if (file == NULL) {
+		print_error ("Could not open output file: %s\n", filename);
+		return -1;
+	}
+
+	res = BKTKContextWriteProgram (ctx, (BKTKWriterWriteFunc) write_program_data, file);
+
+	if (fclose (file) != 0 && res == 0) {
+		res = BK_FILE_ERROR;
+	}
+
+	if (res != 0) {
+		print_error ("Failed to write compiled program: %s (%s)\n", filename, BKStatusGetName (res));
+		unlink (filename);
+		return res;
+	}
+
+	return 0;
+}
+
+#if BK_USE_THREADS
+static BKInt append_program_data (BKByteBuffer * buffer, uint8_t const * data, BKUSize size)
+{
+	return BKByteBufferAppendBytes (buffer, data, size);
+}
+
+/**
+ * Compile main context into a program image shared by worker contexts
+ *
+ * Workers then load the image instead of parsing the input file again.
+ * Nothing is done if the input file already is a compiled program. Workers
+ * fall back to parsing if the image cannot be written.
+ */
+static void share_program (struct bliplay * app)
+{
+	if (app -> programData) {
+		return;
+	}
+
+	if (BKTKContextWriteProgram (&app -> ctx, (BKTKWriterWriteFunc) append_program_data, &app -> programImage) != 0 ||
+		BKByteBufferMakeContinuous (&app -> programImage) != 0) {
+		BKByteBufferDispose (&app -> programImage);
+		return;
+	}
+
+	app -> programData = app -> programImage.first -> data;
+	app -> programSize = BKByteBufferSize (&app -> programImage);
+}
+
+/**
+ * Keep input paths and share program for worker contexts
+ */
+BKInt share_source (struct bliplay * app, BKString const * path, BKString const * loadPath)
+{
+	if (BKStringAppendString (&app -> sourcePath, path) != 0) {
+		return -1;
+	}
+
+	if (BKStringAppendString (&app -> sourceLoadPath, loadPath) != 0) {
+		return -1;
+	}
+
+	share_program (app);
+
+	return 0;
+}
+
+/**
+ * Load input file again into new contexts
+ *
+ * Used by threads which need their own contexts. The contexts are disposed
+ * on failure.
+ */
+BKInt load_source_context (struct bliplay const * app, BKTKContext * ctx, BKContext * renderCtx, BKInt shardIndex, BKInt numShards)
+{
+	BKInt res;
+	FILE * file;
+	struct loader loader;
+
+	if (BKTKContextInit (ctx, 0) != 0) {
+		return -1;
+	}
+
+	if (BKContextInit (renderCtx, app -> numChannels, app -> sampleRate) != 0) {
+		BKDispose (ctx);
+		return -1;
+	}
+
+	// share mapped program of the main context
+	if (app -> programData) {
+		res = make_program_context (ctx, renderCtx, app -> programData, app -> programSize, shardIndex, numShards);
+	}
+	else if ((file = fopen ((char *) app -> sourcePath.str, "rb")) == NULL) {
+		print_error ("No such file: %s\n", app -> sourcePath.str);
+		res = -1;
+	}
+	else {
+		if ((res = loader_init (&loader, app -> flags)) == 0) {
+			res = make_context (&loader, ctx, renderCtx, file, &app -> sourceLoadPath, shardIndex, numShards);
+			loader_dispose (&loader);
+		}
+
+		fclose (file);
+	}
+
+	if (res != 0) {
+		BKDispose (ctx);
+		BKDispose (renderCtx);
+		return -1;
+	}
+
+	return 0;
+}
+#endif /* BK_USE_THREADS */
+
+BKTime const * end_time (struct bliplay const * app)
+{
+	return (app -> flags & FLAG_HAS_END_TIME) ? &app -> endTime : NULL;
+}
+
+/**
+ * Render frames in chunks until `maxFrames` is reached
+ *
+ * Sets `outDone` to 1 if the tracks have finished or `endTime` was reached.
+ * `endTime` may be NULL. With `FLAG_NO_SOUND` in `flags`, repeated tracks
+ * count as finished. Returns the number of frames rendered.
+ */
+BKInt render_frames (BKTKContext * ctx, BKFrame frames [], BKInt maxFrames, BKTime const * endTime, BKInt flags, BKInt * outDone)
+{
+	BKInt numFrames = 0;
+	BKInt numChannels = ctx -> renderContext -> numChannels;
+
+	*outDone = 0;
+
+	while (numFrames < maxFrames) {
+		if (!check_tracks_running (ctx, flags)) {
+			*outDone = 1;
+			break;
+		}
+
+		BKContextGenerate (ctx -> renderContext, &frames [numFrames * numChannels], RENDER_CHUNK_FRAMES);
+		numFrames += RENDER_CHUNK_FRAMES;
+
+		if (endTime) {
+			if (BKTimeIsGreaterEqual (ctx -> renderContext -> currentTime, *endTime)) {
+				*outDone = 1;
+				break;
+			}
+		}
+	}
+
+	return numFrames;
+}
+
+static BKInt handle_options (struct bliplay * app, int argc, char * argv [])
 {
 	int    opt;
 	int    longoptind = 1;
@@ -755,15 +1124,48 @@ static BKInt handle_options (BKTKContext * ctx, int argc, char * argv [])
 	BKString path = BK_STRING_INIT;
 	BKString loadPath = BK_STRING_INIT;
 	BKEnum opts = 0;
+	BKInt res;
+	struct loader loader;
+	BKTKContext * ctx = &app -> ctx;
 
 	opterr = 0;
 
 #if BK_USE_SDL
-	flags = FLAG_INFO;
+	app -> flags = FLAG_INFO;
 #endif
 
-	while ((opt = getopt_long (argc, (void *) argv, "d:f:hil:no:pr:t:vy", options, &longoptind)) != -1) {
+	while ((opt = getopt_long (argc, (void *) argv, "bB:c:d:D:f:hij:l:nOo:pRr:St:vy", options, &longoptind)) != -1) {
 		switch (opt) {
+			case 'b': {
+				app -> flags |= FLAG_BATCH | FLAG_NO_SOUND;
+				break;
+			}
+			case 'B': {
+#if BK_USE_SDL
+				if (strcmp (optarg, "auto") == 0) {
+					app -> flags |= FLAG_ADAPTIVE_BUFFER;
+				}
+				else {
+					char * end;
+					long frames = strtol (optarg, &end, 10);
+
+					if (end == optarg || *end != '\0' || frames < AUDIO_BUFFER_MIN || frames > AUDIO_BUFFER_MAX) {
+						print_error ("--buffer-size: expected 'auto' or %d - %d frames; got '%s'\n", AUDIO_BUFFER_MIN, AUDIO_BUFFER_MAX, optarg);
+						return -1;
+					}
+
+					for (app -> audio.bufferFrames = AUDIO_BUFFER_MIN; app -> audio.bufferFrames < frames; app -> audio.bufferFrames <<= 1) {
+						;
+					}
+				}
+#endif
+				break;
+			}
+			case 'c': {
+				app -> compileFilename = optarg;
+				app -> flags |= FLAG_COMPILE_ONLY | FLAG_NO_SOUND;
+				break;
+			}
 			case 'd': {
 				BKStringEmpty (&loadPath);
 
@@ -773,10 +1175,15 @@ static BKInt handle_options (BKTKContext * ctx, int argc, char * argv [])
 				}
 				break;
 			}
+			case 'D': {
+				app -> flags |= FLAG_DAEMON | FLAG_NO_SOUND;
+				app -> daemonPath = optarg;
+				break;
+			}
 			case 'f': {
-				flags |= FLAG_HAS_SEEK_TIME;
-				strncpy (seekTimeString, optarg, sizeof(seekTimeString) - 1);
-				seekTimeString[sizeof(seekTimeString) - 1] = '\0';
+				app -> flags |= FLAG_HAS_SEEK_TIME;
+				strncpy (app -> seekTimeString, optarg, sizeof(app -> seekTimeString) - 1);
+				app -> seekTimeString[sizeof(app -> seekTimeString) - 1] = '\0';
 				break;
 			}
 			case 'h':
@@ -786,34 +1193,54 @@ static BKInt handle_options (BKTKContext * ctx, int argc, char * argv [])
 				break;
 			}
 			case 'i': {
-				flags |= FLAG_INFO_EXPLICITE;
+				app -> flags |= FLAG_INFO_EXPLICITE;
+				break;
+			}
+			case 'j': {
+				app -> numJobs = BKClamp (atoi (optarg), 1, MAX_JOBS);
 				break;
 			}
 			case 'l': {
-				flags |= FLAG_HAS_END_TIME;
-				strncpy (endTimeString, optarg, sizeof(endTimeString) - 1);
-				endTimeString[sizeof(endTimeString) - 1] = '\0';
+				app -> flags |= FLAG_HAS_END_TIME;
+				strncpy (app -> endTimeString, optarg, sizeof(app -> endTimeString) - 1);
+				app -> endTimeString[sizeof(app -> endTimeString) - 1] = '\0';
 				break;
 			}
 			case 'n': {
-				flags |= FLAG_PRINT_NO_TIME;
+				app -> flags |= FLAG_PRINT_NO_TIME;
+				break;
+			}
+			case 'O': {
+				app -> flags |= FLAG_OPTIMIZE;
 				break;
 			}
 			case 'o': {
-				outputFilename = optarg;
-				flags |= FLAG_INFO | FLAG_NO_SOUND;
+				app -> outputFilename = optarg;
+				app -> flags |= FLAG_INFO | FLAG_NO_SOUND;
+				break;
+			}
+			case 'p': {
+				app -> flags |= FLAG_PLAY;
+				break;
+			}
+			case 'R': {
+				app -> flags |= FLAG_REALTIME;
 				break;
 			}
 			case 'r': {
-				sampleRate = atoi (optarg);
+				app -> sampleRate = atoi (optarg);
+				break;
+			}
+			case 'S': {
+				app -> flags |= FLAG_STATS;
 				break;
 			}
 			case 't': {
 				if (strcmp (optarg, "s") == 0) {
-					flags |= FLAG_TIMING_UNIT_SECS;
+					app -> flags |= FLAG_TIMING_UNIT_SECS;
 				}
 				else if (strcmp (optarg, "t") == 0) {
-					flags |= FLAG_TIMING_UNIT_TICKS;
+					app -> flags |= FLAG_TIMING_UNIT_TICKS;
 				}
 				else {
 					print_error ("Unknown timing unit '%s'; use 's' or 't'\n", optarg);
@@ -823,7 +1250,7 @@ static BKInt handle_options (BKTKContext * ctx, int argc, char * argv [])
 				break;
 			}
 			case 'y': {
-				flags |= FLAG_YES;
+				app -> flags |= FLAG_YES;
 				break;
 			}
 			default: {
@@ -842,44 +1269,65 @@ static BKInt handle_options (BKTKContext * ctx, int argc, char * argv [])
 		}
 	}
 
-	if (flags & FLAG_INFO_EXPLICITE) {
-		flags |= FLAG_INFO;
+	if (app -> flags & FLAG_INFO_EXPLICITE) {
+		app -> flags |= FLAG_INFO;
+	}
+
+	// paced output is rendered by the main context only
+	if (app -> flags & (FLAG_REALTIME | FLAG_COMPILE_ONLY)) {
+		app -> numJobs = 1;
+	}
+
+#if BK_USE_SDL
+	// play while writing to file
+	if ((app -> flags & FLAG_PLAY) && app -> outputFilename && !string_begins_with (app -> outputFilename, "-")) {
+		app -> flags &= ~FLAG_NO_SOUND;
+	}
+#endif
+
+	if (app -> flags & FLAG_DAEMON) {
+		// load resources relative to load path or working directory
+		return BKStringAppend (&app -> sourceLoadPath, loadPath.len ? (char *) loadPath.str : ".");
 	}
 
 	if (optind <= argc) {
-		filename = argv [optind];
+		app -> filename = argv [optind];
 	}
 	else {
 		print_help ();
 		return -1;
 	}
 
-	if (filename == NULL) {
+	if (app -> filename == NULL) {
 		print_help ();
 		print_error ("No input file given\n");
 		return -1;
 	}
 
+	if (app -> flags & FLAG_BATCH) {
+		return 0;
+	}
+
 #if !BK_USE_SDL
-	if (!outputFilename) {
-		if ((flags & FLAG_INFO) == 0) {
-			print_error ("SDL support disabled. Output file must be given\n");
+	if (!app -> outputFilename) {
+		if ((app -> flags & (FLAG_INFO | FLAG_REALTIME | FLAG_COMPILE_ONLY)) == 0) {
+			print_error ("SDL support disabled. Output file or --realtime must be given\n");
 			return -1;
 		}
 	}
 #endif
 
-	if (outputFilename) {
-		opts = ((flags & FLAG_TIMING_UNIT_MASK) >> FLAG_TIMING_UNIT_SHIFT) << BKTKContextOptionTimingShift;
+	if (app -> outputFilename) {
+		opts = ((app -> flags & FLAG_TIMING_UNIT_MASK) >> FLAG_TIMING_UNIT_SHIFT) << BKTKContextOptionTimingShift;
 	}
 
-	if (context_init (ctx, numChannels, sampleRate, opts) != 0) {
+	if (context_init (ctx, &app -> renderCtx, app -> numChannels, app -> sampleRate, opts) != 0) {
 		return 1;
 	}
 
 	BKStringEmpty (&path);
 
-	if (BKStringAppend (&path, filename) != 0) {
+	if (BKStringAppend (&path, app -> filename) != 0) {
 		return -1;
 	}
 
@@ -908,48 +1356,56 @@ static BKInt handle_options (BKTKContext * ctx, int argc, char * argv [])
 		}
 	}
 
-	if (outputFilename) {
+	if (app -> outputFilename) {
 		// output file already exists
-		if (stat (outputFilename, &st) == 0) {
-			if (!S_ISREG (st.st_mode)) {
-				print_error ("Output file already exists and is not a file: %s\n", outputFilename);
+		if (stat (app -> outputFilename, &st) == 0) {
+			if (S_ISFIFO (st.st_mode) && (app -> flags & FLAG_REALTIME)) {
+				// write to FIFO
+			}
+			else if (!S_ISREG (st.st_mode)) {
+				print_error ("Output file already exists and is not a file: %s\n", app -> outputFilename);
 				return -1;
 			}
-
 			// ask if file should be overwritten
-			if (!(flags & FLAG_YES)) {
-				if (!should_overwrite_output (outputFilename)) {
+			else if (!(app -> flags & FLAG_YES)) {
+				if (!should_overwrite_output (app -> outputFilename)) {
 					print_error ("Not overwriting\n");
 					return -1;
 				}
 			}
 		}
 
-		if (string_ends_with (outputFilename, ".wav")) {
-			outputType = OUTPUT_TYPE_WAVE;
-		}
-		else if (string_ends_with (outputFilename, ".raw")) {
-			outputType = OUTPUT_TYPE_RAW;
-		}
-		else {
+		app -> output.type = output_type_for_name (app -> outputFilename);
+
+		if (app -> output.type == OUTPUT_TYPE_NONE) {
 			print_error ("Only .wav and .raw is supported for output\n");
 			return -1;
 		}
 
-		if (string_begins_with (outputFilename, "-")) {
-			outputFile = stdout;
+		if (string_begins_with (app -> outputFilename, "-")) {
+			app -> output.file = stdout;
 		}
 		else {
-			outputFile = fopen (outputFilename, "wb+");
+			app -> output.file = fopen (app -> outputFilename, "wb+");
 
-			if (outputFile == NULL) {
-				print_error ("Could not open output file: %s\n", outputFilename);
+			if (app -> output.file == NULL) {
+				print_error ("Could not open output file: %s\n", app -> outputFilename);
 				return -1;
 			}
 		}
 
-		if (outputType == OUTPUT_TYPE_WAVE) {
-			int res = BKWaveFileWriterInit (&waveWriter, outputFile, numChannels, sampleRate, 0);
+		// the WAVE writer seeks back to write the sizes when terminating
+		if (app -> output.type == OUTPUT_TYPE_WAVE && (fstat (fileno (app -> output.file), &st) != 0 || !S_ISREG (st.st_mode))) {
+			app -> output.type = OUTPUT_TYPE_WAVE_STREAM;
+
+			if (write_wave_stream_header (app -> output.file, app -> numChannels, app -> sampleRate) != 0) {
+				print_error ("Could not write WAVE header\n");
+				return -1;
+			}
+		}
+
+		if (app -> output.type == OUTPUT_TYPE_WAVE) {
+			int res = BKWaveFileWriterInit (&app -> output.writer, app -> output.file, app -> numChannels, app -> sampleRate, 0);
 
 			if (res != 0) {
 				print_error ("Could not initialize WAVE writer: %s\n", BKStatusGetName (res));
@@ -983,10 +1439,10 @@ static BKInt handle_options (BKTKContext * ctx, int argc, char * argv [])
 		}
 	}
 
-	if ((flags & FLAG_TIMING_UNIT_MASK) && outputFilename) {
+	if ((app -> flags & FLAG_TIMING_UNIT_MASK) && app -> outputFilename) {
 		BKString path = BK_STRING_INIT;
 
-		if (BKStringAppend (&path, outputFilename) != 0) {
+		if (BKStringAppend (&path, app -> outputFilename) != 0) {
 			print_error ("Allocation error\n");
 			return -1;
 		}
@@ -996,22 +1452,41 @@ static BKInt handle_options (BKTKContext * ctx, int argc, char * argv [])
 			return -1;
 		}
 
-		timingFile = fopen ((char *) path.str, "w");
+		app -> timingFile = fopen ((char *) path.str, "w");
 
 		BKStringDispose (&path);
 	}
 
-	if (make_context (ctx, inputFile, &loadPath) != 0) {
-		print_error ("Failed to load file: %s\n", filename);
+	if ((res = map_program (inputFile, &app -> programData, &app -> programSize)) > 0) {
+		res = make_program_context (ctx, &app -> renderCtx, app -> programData, app -> programSize, 0, 1);
+	}
+	else if (res == 0) {
+		if (loader_init (&loader, app -> flags) != 0) {
+			return -1;
+		}
+
+		loader.numJobs = app -> numJobs;
+		res = make_context (&loader, ctx, &app -> renderCtx, inputFile, &loadPath, 0, 1);
+		loader_dispose (&loader);
+	}
+
+	if (res != 0) {
+		print_error ("Failed to load file: %s\n", app -> filename);
 		fclose (inputFile);
 		return 1;
 	}
 
+	if (app -> numJobs > 1) {
+		if (prepare_shards (app, inputFile, &path, &loadPath) != 0) {
+			return -1;
+		}
+	}
+
 #if BK_USE_SDL
-	if ((flags & FLAG_NO_SOUND) == 0) {
+	if ((app -> flags & FLAG_NO_SOUND) == 0) {
 		char const * error = NULL;
 
-		if (init_sdl (ctx, &error) < 0) {
+		if (init_sdl (app, &error) < 0) {
 			print_error ("Could not initialize SDL: %s\n", error);
 			return -1;
 		}
@@ -1019,24 +1494,24 @@ static BKInt handle_options (BKTKContext * ctx, int argc, char * argv [])
 #endif
 
 	if (inputFile == stdin) {
-		flags |= FLAG_FROM_STDIN;
+		app -> flags |= FLAG_FROM_STDIN;
 	}
 	else {
 		fclose (inputFile);
 	}
 
-	if (flags & FLAG_HAS_SEEK_TIME) {
+	if (app -> flags & FLAG_HAS_SEEK_TIME) {
 		speed = ctx -> info.stepTicks;
 
-		if (parse_seek_time (seekTimeString, &seekTime, speed) != 0) {
+		if (parse_seek_time (ctx -> renderContext, app -> seekTimeString, &app -> seekTime, speed) != 0) {
 			return -1;
 		}
 	}
 
-	if (flags & FLAG_HAS_END_TIME) {
+	if (app -> flags & FLAG_HAS_END_TIME) {
 		speed = ctx -> info.stepTicks;
 
-		if (parse_seek_time (endTimeString, &endTime, speed) != 0) {
+		if (parse_seek_time (ctx -> renderContext, app -> endTimeString, &app -> endTime, speed) != 0) {
 			return -1;
 		}
 	}
@@ -1044,27 +1519,27 @@ static BKInt handle_options (BKTKContext * ctx, int argc, char * argv [])
 	return 0;
 }
 
-static void write_timing_data (void)
+static void write_timing_data (struct bliplay * app)
 {
 	BKEnum waveform;
 	BKTKTrack * track;
 	BKByteBufferSegment * seg;
 
-	if (timingFile) {
+	if (app -> timingFile) {
 		char name [64];
 		BKSize size;
 		char const * unit = "";
 
-		if (flags & FLAG_TIMING_UNIT_SECS) {
+		if (app -> flags & FLAG_TIMING_UNIT_SECS) {
 			unit = "seconds";
 		}
 
-		if (flags & FLAG_TIMING_UNIT_TICKS) {
+		if (app -> flags & FLAG_TIMING_UNIT_TICKS) {
 			unit = "ticks";
 		}
 
 		fprintf (
-			timingFile,
+			app -> timingFile,
 			"%% Timing data for tracks contained in '%s'\n"
 			"%%\n"
 			"%% [track:{waveformtype}:{tracknumber}\n"
@@ -1076,11 +1551,11 @@ static void write_timing_data (void)
 			"%%\n"
 			"%% Using unit '%s'\n"
 			"\n",
-			outputFilename, unit
+			app -> outputFilename, unit
 		);
 
-		for (BKUSize i = 0; i < ctx.tracks.len; i ++) {
-			track = *(BKTKTrack **) BKArrayItemAt (&ctx.tracks, i);
+		for (BKUSize i = 0; i < app -> ctx.tracks.len; i ++) {
+			track = *(BKTKTrack **) BKArrayItemAt (&app -> ctx.tracks, i);
 
 			if (!track) {
 				continue;
@@ -1089,70 +1564,90 @@ static void write_timing_data (void)
 			waveform = track -> waveform;
 
 			if (i > 0) {
-				fprintf (timingFile, "\n");
+				fprintf (app -> timingFile, "\n");
 			}
 
 			waveform_get_name (track, name, sizeof (name), waveform, NULL);
-			fprintf (timingFile, "[track:%s:%d\n", name, track -> object.index);
+			fprintf (app -> timingFile, "[track:%s:%d\n", name, track -> object.index);
 
 			for (seg = track -> timingData.first; seg != track -> timingData.cur; seg = seg -> next) {
-				fwrite (seg -> data, sizeof (char), seg -> size, timingFile);
+				fwrite (seg -> data, sizeof (char), seg -> size, app -> timingFile);
 			}
 
 			seg = track -> timingData.cur;
 
 			if (seg) {
 				size = track -> timingData.ptr - seg -> data;
-				fwrite (seg -> data, sizeof (char), size, timingFile);
+				fwrite (seg -> data, sizeof (char), size, app -> timingFile);
 			}
 
-			fprintf (timingFile, "]\n");
+			fprintf (app -> timingFile, "]\n");
 		}
 
-		fclose (timingFile);
+		fclose (app -> timingFile);
 	}
 }
 
-static void cleanup (void)
+static void cleanup (struct bliplay * app)
 {
 #if BK_USE_SDL
-	if ((flags & FLAG_NO_SOUND) == 0) {
+	if ((app -> flags & FLAG_NO_SOUND) == 0) {
 		SDL_CloseAudio ();
 	}
 #endif
 
-	if (outputFile) {
-		if (outputType == OUTPUT_TYPE_WAVE) {
-			BKWaveFileWriterTerminate (&waveWriter);
-			BKDispose (&waveWriter);
+	if (app -> output.file) {
+		if (app -> output.type == OUTPUT_TYPE_WAVE) {
+			BKWaveFileWriterTerminate (&app -> output.writer);
+			BKDispose (&app -> output.writer);
 		}
 
-		if (outputFile != stdout) {
-			fclose (outputFile);
+		if (app -> output.file != stdout) {
+			fclose (app -> output.file);
 		}
 	}
 
-	BKDispose (&ctx);
+	BKDispose (&app -> ctx);
+	BKStringDispose (&app -> sourcePath);
+	BKStringDispose (&app -> sourceLoadPath);
+
+	if (app -> programImage.first) {
+		BKByteBufferDispose (&app -> programImage);
+	}
+	else if (app -> programData) {
+		munmap (app -> programData, app -> programSize);
+	}
 }
 
-static BKInt write_output (BKTKContext * ctx)
+static BKInt write_output (struct bliplay * app)
 {
-	BKInt numFrames = 512;
+	BKInt done = 0;
+	BKInt numFrames;
+	BKTKContext * ctx = &app -> ctx;
 	BKInt numChannels = ctx -> renderContext -> numChannels;
-	BKFrame * frames = malloc (numFrames * numChannels * sizeof (BKFrame));
+	BKFrame * frames;
+
+	if (app -> flags & FLAG_REALTIME) {
+		return write_output_paced (app);
+	}
+
+#if BK_USE_THREADS
+	if (app -> numJobs > 1) {
+		return write_output_threaded (app);
+	}
+#endif
+
+	frames = malloc (RENDER_CHUNK_FRAMES * numChannels * sizeof (BKFrame));
 
 	if (frames == NULL) {
 		return -1;
 	}
 
-	while (check_tracks_running (ctx)) {
-		BKContextGenerate (ctx -> renderContext, frames, numFrames);
-		output_chunk (frames, numFrames * numChannels);
+	while (!done) {
+		numFrames = render_frames (ctx, frames, RENDER_CHUNK_FRAMES, end_time (app), app -> flags, &done);
 
-		if (flags & FLAG_HAS_END_TIME) {
-			if (BKTimeIsGreaterEqual (ctx -> renderContext -> currentTime, endTime)) {
-				break;
-			}
+		if (numFrames) {
+			write_frames (&app -> output, frames, numFrames * numChannels);
 		}
 	}
 
@@ -1161,83 +1656,37 @@ static BKInt write_output (BKTKContext * ctx)
 	return 0;
 }
 
-static BKInt runloop (BKTKContext * ctx)
+double time_secs (void)
 {
-#if BK_USE_SDL
-	int c;
-	int res;
-	int nfds = 0;
-	int flag = 1;
-	fd_set fds, fdsc;
-	struct timeval timeout;
-
-	FD_ZERO (&fds);
-
-	if (!(flags & FLAG_FROM_STDIN)) {
-		if (istty) {
-			FD_SET (STDIN_FILENO, &fds);
-			nfds = STDIN_FILENO + 1;
-		}
-
-		print_notice ("Press [q] to quit\n");
-	}
-
-	set_noecho (1);
-
-	SDL_PauseAudio (0);
-
-	do {
-		FD_COPY (&fds, &fdsc);
-		timeout.tv_sec  = 0;
-		timeout.tv_usec = updateUSecs;
-
-		res = select (nfds, &fdsc, NULL, NULL, &timeout);
+	struct timeval tv;
 
-		if (res < 0) {
-			return -1;
-		}
-		else if (res > 0) {
-			c = getchar_nocanon (0);
-
-			switch (c) {
-				case 'q': {
-					flag = 0;
-					break;
-				}
-			}
-		}
-
-		if (!(flags & FLAG_PRINT_NO_TIME)) {
-			print_time (ctx);
-		}
-
-		if (check_tracks_running (ctx) == 0) {
-			break;
-		}
-	}
-	while (flag);
+	gettimeofday (&tv, NULL);
 
-	set_noecho (0);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
 
-	if (!(flags & FLAG_PRINT_NO_TIME)) {
-		printf ("\n");
-	}
+/**
+ * Set default options
+ */
+static void bliplay_init (struct bliplay * app)
+{
+	memset (app, 0, sizeof (*app));
 
-	SDL_PauseAudio (1);
-#else
-	do {
-		if (check_tracks_running (ctx) == 0) {
-			break;
-		}
-	}
-	while (1);
-#endif /* BK_USE_SDL */
+	app -> istty          = isatty (STDOUT_FILENO);
+	app -> sampleRate     = 44100;
+	app -> numChannels    = 2;
+	app -> numJobs        = 1;
+	app -> output.type    = OUTPUT_TYPE_NONE;
+	app -> sourcePath     = BK_STRING_INIT;
+	app -> sourceLoadPath = BK_STRING_INIT;
+	app -> programImage   = BK_BYTE_BUFFER_INIT;
 
-	return 0;
+#if BK_USE_SDL
+	app -> audio.updateUSecs  = 91200;
+	app -> audio.bufferFrames = AUDIO_BUFFER_FRAMES;
+#endif
 }
 
-#include <sys/mman.h>
-
 // undef SDL main
 #ifdef main
 #undef main
@@ -1245,24 +1694,36 @@ static BKInt runloop (BKTKContext * ctx)
 
 int main (int argc, char * argv [])
 {
-	istty = isatty (STDOUT_FILENO);
+	BKInt res;
+	struct bliplay app;
 
-	if (istty) {
-		colorRed    = "\033[31m";
-		colorYellow = "\033[33m";
-		colorGreen  = "\033[32m";
-		colorNormal = "\033[0m";
-	}
+	bliplay_init (&app);
+	init_colors (app.istty);
 
-	if (handle_options (&ctx, argc, argv) != 0) {
+	if (handle_options (&app, argc, argv) != 0) {
 		return 1;
 	}
 
-	if (flags & FLAG_INFO && outputFile != stdout) {
-		print_info (&ctx);
+	if (app.flags & FLAG_BATCH) {
+		return run_batch (&app, app.filename) != 0 ? 2 : 0;
+	}
+
+	if (app.flags & FLAG_DAEMON) {
+		return run_daemon (&app, app.daemonPath) != 0 ? 2 : 0;
+	}
+
+	if (app.flags & FLAG_INFO && app.output.file != stdout) {
+		print_info (&app.ctx);
 		printf ("\n");
 	}
 
+	if (app.flags & FLAG_COMPILE_ONLY) {
+		res = write_program (&app.ctx, app.compileFilename);
+		cleanup (&app);
+
+		return res != 0 ? 2 : 0;
+	}
+
 
 
 	/*for (int i = 0; i < ctx.tracks.len; i++) {
@@ -1287,33 +1748,35 @@ int main (int argc, char * argv [])
 
 
 
-	if (flags & FLAG_INFO_EXPLICITE) {
+	if (app.flags & FLAG_INFO_EXPLICITE) {
 		return 0;
 	}
 
-	if (flags & FLAG_HAS_SEEK_TIME) {
-		print_notice ("Fast forward to %s\n", seekTimeString);
-		seek_context (&ctx, seekTime);
+	if (app.flags & FLAG_HAS_SEEK_TIME) {
+		print_notice ("Fast forward to %s\n", app.seekTimeString);
+
+		app.skipTime = seek_context (&app.ctx, app.seekTime);
+		app.endTime = skip_time (app.endTime, app.skipTime);
 	}
 
-	if (!istty) {
-		flags |= FLAG_PRINT_NO_TIME;
+	if (!app.istty) {
+		app.flags |= FLAG_PRINT_NO_TIME;
 	}
 
-	if (flags & FLAG_NO_SOUND) {
-		if (write_output (&ctx) < 0) {
+	if (app.flags & FLAG_NO_SOUND) {
+		if (write_output (&app) < 0) {
 			return 2;
 		}
 	}
 	else {
-		if (runloop (&ctx) < 0) {
+		if (runloop (&app) < 0) {
 			return 3;
 		}
 	}
 
-	write_timing_data ();
+	write_timing_data (&app);
 
-	cleanup ();
+	cleanup (&app);
 
 	return 0;
 }
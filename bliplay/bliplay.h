@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2012-2016 Simon Schoenenberger
+ * http://blipkit.audio
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef _BLIPLAY_H_
+#define _BLIPLAY_H_
+
+#define __USE_POSIX
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifndef BK_USE_SDL
+#define BK_USE_SDL 1
+#endif
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#ifdef HAVE_PTHREAD_H
+#define BK_USE_THREADS 1
+#include <pthread.h>
+#else
+#define BK_USE_THREADS 0
+#endif
+
+#if defined(BK_USE_SDL) && defined(BK_SDL_VERSION)
+#include "SDL.h"
+#endif
+
+#include "BKTK.h"
+#include "BKRingBuffer.h"
+#include "BlipKit.h"
+
+#define BK_BLIPLAY_VERSION "3.2.4"
+
+#ifndef PROGRAM_NAME
+#define PROGRAM_NAME "bliplay"
+#endif
+
+#define RENDER_CHUNK_FRAMES 512
+#define RENDER_POOL_CHUNKS 16
+#define MAX_JOBS 64
+#define SEEK_PREROLL_SECS 1.0
+#define KEYFRAME_INTERVAL_BEATS 16
+#define KEYFRAME_MAX_SECS 3600.0
+#define SCRUB_SECS 5.0
+#define SCRUB_PREROLL_SECS 0.05
+#define AUDIO_BUFFER_FRAMES 512
+#define AUDIO_BUFFER_MIN 128
+#define AUDIO_BUFFER_MAX 8192
+#define ADAPT_CALM_UPDATES 20
+#define STATS_BUCKET_USECS 10
+#define STATS_NUM_BUCKETS 2000
+#define PLAYER_BUFFER_PERIODS 2
+#define PLAYER_SLEEP_USECS 1000
+#define RECORD_BUFFER_SECS 4
+#define DAEMON_CACHE_SIZE 16
+#define DAEMON_BACKLOG 16
+#define DAEMON_MAX_SOURCE_SIZE (64 << 20)
+#define DAEMON_TIMEOUT_SECS 10
+#define DAEMON_READ_SIZE (16 * 1024)
+#define READ_CHUNK_SIZE (16 * 1024)
+#define TOKEN_BATCH_SIZE 256
+#define SPLIT_TOKENIZE_MIN_SIZE (1 << 20)
+#define SPLIT_SEGMENT_SIZE (64 * 1024)
+#define WAVE_HEADER_SIZE 44
+#define WAVE_STREAM_DATA_SIZE (0xFFFFFFFF - 36)
+
+enum OUTPUT_TYPE
+{
+	OUTPUT_TYPE_NONE,
+	OUTPUT_TYPE_RAW,
+	OUTPUT_TYPE_WAVE,
+	OUTPUT_TYPE_WAVE_STREAM, // header written up front; output is not seekable
+};
+
+enum FLAG
+{
+	FLAG_HAS_SEEK_TIME     = 1 << 0,
+	FLAG_HAS_END_TIME      = 1 << 1,
+	FLAG_PRINT_NO_TIME     = 1 << 2,
+	FLAG_NO_SOUND          = 1 << 3,
+	FLAG_INFO              = 1 << 4,
+	FLAG_INFO_EXPLICITE    = 1 << 5,
+	FLAG_YES               = 1 << 6,
+	FLAG_FROM_STDIN        = 1 << 7,
+	FLAG_BATCH             = 1 << 8,
+	FLAG_PLAY              = 1 << 10,
+	FLAG_ADAPTIVE_BUFFER   = 1 << 11,
+	FLAG_STATS             = 1 << 12,
+	FLAG_REALTIME          = 1 << 13,
+	FLAG_DAEMON            = 1 << 14,
+	FLAG_COMPILE_ONLY      = 1 << 15,
+	FLAG_TIMING_UNIT_SHIFT = 16,
+	FLAG_TIMING_UNIT_SECS  = 1 << 16,
+	FLAG_TIMING_UNIT_TICKS = 2 << 16,
+	FLAG_TIMING_UNIT_MASK  = 3 << 16,
+	FLAG_OPTIMIZE          = 1 << 18,
+};
+
+struct loader
+{
+	BKTKTokenizer tok;
+	BKTKParser    parser;
+	BKTKCompiler  compiler;
+	BKInt         numJobs; // number of threads tokenizing large files
+	BKInt         flags;
+};
+
+/**
+ * Audio output file
+ */
+struct output
+{
+	BKEnum           type;
+	FILE           * file;
+	BKWaveFileWriter writer;
+};
+
+#if BK_USE_SDL
+/**
+ * Audio callback statistics
+ *
+ * Written by the audio callback and read by the main thread.
+ */
+struct callback_stats
+{
+	atomic_uint count;
+	atomic_uint late;          // callbacks exceeding the buffer duration
+	atomic_uint underruns;     // callbacks with not enough rendered frames
+	atomic_uint maxUsecs;
+	atomic_uint windowMaxUsecs; // reset by adaptive buffer size
+	atomic_uint deadlineUsecs;  // buffer duration
+	atomic_uint renderWindowMaxUsecs; // render thread; reset by adaptive buffer size
+	atomic_uint renderDeadlineUsecs;  // render chunk duration
+	atomic_uint buckets [STATS_NUM_BUCKETS];
+};
+
+#if BK_USE_THREADS
+/**
+ * Renders ahead of the audio callback
+ *
+ * The render thread fills `frames`, which the audio callback only copies
+ * from. When writing to a file, the rendered frames are also pushed to
+ * `record`, which is drained by the writer thread.
+ */
+struct player
+{
+	BKRingBuffer    frames;
+	BKRingBuffer    record;
+	BKFrame       * renderChunk;
+	BKFrame       * writeChunk;
+	BKUSize         chunkSize;
+	atomic_size_t   targetSize; // number of bytes to render ahead
+	BKInt           running;
+	BKInt           recording;
+	pthread_t       renderThread;
+	pthread_t       writerThread;
+	pthread_mutex_t mutex; // locks render context
+	atomic_int      quit;
+	atomic_int      done;
+	atomic_int      ended; // render thread has reached the end
+	atomic_int      flush;
+};
+#endif /* BK_USE_THREADS */
+
+/**
+ * Audio device and playback state
+ */
+struct audio
+{
+	int                   updateUSecs;
+	BKInt                 bufferFrames;
+	unsigned              lastMisses;  // misses at last buffer size adaption
+	BKInt                 calmUpdates; // updates without misses
+	BKTKKeyframes         keyframes;   // built when seeking while playing
+	BKInt                 hasKeyframes;
+	struct callback_stats stats;
+#if BK_USE_THREADS
+	struct player         player;
+#endif
+};
+#endif /* BK_USE_SDL */
+
+/**
+ * Options and main context
+ *
+ * Threads rendering with their own contexts only read from it.
+ */
+struct bliplay
+{
+	BKInt          istty;
+	BKInt          flags;
+	BKTKContext    ctx;
+	BKContext      renderCtx;
+	BKUInt         sampleRate;
+	BKInt          numChannels;
+	BKTime         seekTime, endTime;
+	BKTime         skipTime;
+	char const   * filename;
+	char const   * outputFilename;
+	struct output  output;
+	FILE         * timingFile;
+	char           seekTimeString [64];
+	char           endTimeString [64];
+	BKInt          numJobs;
+	BKString       sourcePath;
+	BKString       sourceLoadPath;
+	char const   * daemonPath;
+	char const   * compileFilename;
+	void         * programData; // mapped compiled program
+	size_t         programSize;
+	BKByteBuffer   programImage; // main context compiled for workers
+#if BK_USE_SDL
+	struct audio   audio;
+#endif
+};
+
+/**
+ * Print to stdout or to stderr for errors
+ *
+ * Lines of concurrent threads are not mixed.
+ */
+extern void print_message (char const * format, ...);
+extern void print_notice (char const * format, ...);
+extern void print_error (char const * format, ...);
+
+/**
+ * Print to stdout highlighted as status
+ */
+extern void print_status (char const * format, ...);
+
+extern int string_ends_with (char const * str, char const * tail);
+
+extern BKEnum output_type_for_name (char const * name);
+extern void make_wave_header (uint8_t header [WAVE_HEADER_SIZE], BKInt numChannels, BKInt sampleRate, uint32_t dataSize);
+extern void frames_to_le (uint8_t data [], BKFrame const frames [], BKInt numFrames);
+extern void write_frames (struct output * output, BKFrame const frames [], BKInt numFrames);
+
+extern int64_t monotonic_nsecs (void);
+extern double time_secs (void);
+
+extern BKInt loader_init (struct loader * loader, BKInt flags);
+extern void loader_dispose (struct loader * loader);
+extern BKInt make_context (struct loader * loader, BKTKContext * ctx, BKContext * renderCtx, FILE * file, BKString const * loadPath, BKInt shardIndex, BKInt numShards);
+extern BKInt map_program (FILE * file, void ** outData, size_t * outSize);
+extern BKInt make_program_context (BKTKContext * ctx, BKContext * renderCtx, void const * data, size_t size, BKInt shardIndex, BKInt numShards);
+
+#if BK_USE_THREADS
+extern BKInt load_source_context (struct bliplay const * app, BKTKContext * ctx, BKContext * renderCtx, BKInt shardIndex, BKInt numShards);
+
+extern BKInt share_source (struct bliplay * app, BKString const * path, BKString const * loadPath);
+#endif
+
+extern BKInt parse_seek_time (BKContext * renderContext, char const * string, BKTime * outTime, BKInt speed);
+extern BKInt push_frames (BKFrame inFrames [], BKUInt size, void * info);
+extern BKTime seek_context_preroll (BKTKContext * ctx, BKTKKeyframes const * keyframes, BKTime time, double prerollSecs);
+extern BKTime seek_context (BKTKContext * ctx, BKTime time);
+extern BKTime skip_time (BKTime time, BKTime skipTime);
+extern BKInt make_keyframes (BKTKContext * ctx, BKTKKeyframes * keyframes);
+
+extern BKInt count_slots (BKArray const * array);
+extern BKInt check_tracks_running (BKTKContext const * ctx, BKInt flags);
+extern BKTime const * end_time (struct bliplay const * app);
+extern BKInt render_frames (BKTKContext * ctx, BKFrame frames [], BKInt maxFrames, BKTime const * endTime, BKInt flags, BKInt * outDone);
+
+/**
+ * Render tracks distributed over multiple shards
+ */
+extern BKInt prepare_shards (struct bliplay * app, FILE * inputFile, BKString const * path, BKString const * loadPath);
+
+#if BK_USE_THREADS
+extern BKInt write_output_threaded (struct bliplay * app);
+#endif
+
+/**
+ * Write output at playback pace
+ */
+extern BKInt write_output_paced (struct bliplay * app);
+
+#if BK_USE_SDL
+/**
+ * Play with SDL
+ */
+extern BKInt init_sdl (struct bliplay * app, char const ** error);
+#endif
+
+/**
+ * Play until tracks have stopped or user quits
+ */
+extern BKInt runloop (struct bliplay * app);
+
+/**
+ * Render files listed in manifest or contained in directory
+ */
+extern BKInt run_batch (struct bliplay const * app, char const * path);
+
+/**
+ * Accept render jobs on a Unix domain socket
+ */
+extern BKInt run_daemon (struct bliplay const * app, char const * path);
+
+#endif /* ! _BLIPLAY_H_ */
@@ -0,0 +1,837 @@
+/*
+ * Copyright (c) 2012-2016 Simon Schoenenberger
+ * http://blipkit.audio
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "bliplay.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * Render job received by daemon
+ *
+ * Request: header line `rate format start end length` followed by `length`
+ * bytes of source text. `format` is `raw` or `wav`; `start` and `end` are
+ * times as for `-f` and `-l` or `-` if not set.
+ *
+ * Response: `OK` line followed by the audio data or `ERROR message` line.
+ * WAVE data is streamed with the maximum data size in the header.
+ */
+struct daemon_job
+{
+	BKInt  sampleRate;
+	BKEnum type;
+	char   startTime [64];
+	char   endTime [64];
+	char * source;
+	BKUSize sourceSize;
+};
+
+/**
+ * Client connection with buffered reading
+ *
+ * Reading fails when the request is not received until `deadline`.
+ */
+struct daemon_conn
+{
+	int     fd;
+	int64_t deadline;
+	BKUSize pos;
+	BKUSize len;
+	char    buffer [DAEMON_READ_SIZE];
+};
+
+/**
+ * Compiled program kept in the daemon's cache
+ *
+ * Entries in use by a worker are not evicted. The render lock serializes
+ * workers rendering the same program.
+ */
+struct daemon_entry
+{
+	BKInt           used;
+	BKInt           users;
+	BKUInt          lastUse;
+	uint64_t        hash;
+	BKInt           sampleRate;
+	char          * source;
+	BKUSize         sourceSize;
+	BKTKContext     ctx;
+	BKContext       renderCtx;
+	BKTKKeyframes   keyframes;
+#if BK_USE_THREADS
+	pthread_mutex_t mutex;
+#endif
+};
+
+/**
+ * Accepted connections are queued for the workers
+ */
+struct daemon
+{
+	int                    socket;
+	BKUInt                 useCount;
+	struct daemon_entry    entries [DAEMON_CACHE_SIZE];
+	struct bliplay const * app;
+#if BK_USE_THREADS
+	BKInt                  quit;
+	int                    queue [DAEMON_BACKLOG];
+	BKInt                  queueHead;
+	BKInt                  queueLen;
+	pthread_mutex_t        mutex; // locks cache and queue
+	pthread_cond_t         cond;
+#endif
+};
+
+// only state a signal handler may set
+static volatile sig_atomic_t daemonQuit;
+
+static void daemon_signal (int signal)
+{
+	daemonQuit = 1;
+}
+
+static void daemon_lock (struct daemon * daemon)
+{
+#if BK_USE_THREADS
+	pthread_mutex_lock (&daemon -> mutex);
+#endif
+}
+
+static void daemon_unlock (struct daemon * daemon)
+{
+#if BK_USE_THREADS
+	pthread_mutex_unlock (&daemon -> mutex);
+#endif
+}
+
+/**
+ * FNV-1a hash of source text
+ */
+static uint64_t hash_source (char const * source, BKUSize size)
+{
+	uint64_t hash = 0xcbf29ce484222325;
+
+	for (BKUSize i = 0; i < size; i ++) {
+		hash = (hash ^ (uint8_t) source [i]) * 0x100000001b3;
+	}
+
+	return hash;
+}
+
+/**
+ * Write all data; fails after `DAEMON_TIMEOUT_SECS` of no progress
+ */
+static BKInt send_all (int fd, void const * data, BKUSize size)
+{
+	ssize_t res;
+	char const * ptr = data;
+
+	while (size) {
+		res = write (fd, ptr, size);
+
+		if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return -1;
+		}
+
+		ptr += res;
+		size -= res;
+	}
+
+	return 0;
+}
+
+/**
+ * Wait until connection is readable or deadline has passed
+ */
+static BKInt conn_wait (struct daemon_conn * conn)
+{
+	int res;
+	int64_t msecs;
+	struct pollfd pfd;
+
+	pfd.fd = conn -> fd;
+	pfd.events = POLLIN;
+
+	do {
+		msecs = (conn -> deadline - monotonic_nsecs ()) / 1000000;
+
+		if (msecs <= 0) {
+			return -1;
+		}
+
+		res = poll (&pfd, 1, (int) BKMin (msecs, INT_MAX));
+	}
+	while (res < 0 && errno == EINTR);
+
+	return res > 0 ? 0 : -1;
+}
+
+/**
+ * Read into connection buffer
+ */
+static BKInt conn_fill (struct daemon_conn * conn)
+{
+	ssize_t res;
+
+	if (conn -> pos == conn -> len) {
+		conn -> pos = conn -> len = 0;
+	}
+
+	do {
+		if (conn_wait (conn) != 0) {
+			return -1;
+		}
+
+		res = read (conn -> fd, &conn -> buffer [conn -> len], sizeof (conn -> buffer) - conn -> len);
+	}
+	while (res < 0 && errno == EINTR);
+
+	if (res <= 0) {
+		return -1;
+	}
+
+	conn -> len += res;
+
+	return 0;
+}
+
+/**
+ * Read line including newline into `line`
+ */
+static BKInt conn_read_line (struct daemon_conn * conn, char line [], BKUSize size)
+{
+	char * end;
+	BKUSize length;
+
+	for (;;) {
+		end = memchr (&conn -> buffer [conn -> pos], '\n', conn -> len - conn -> pos);
+
+		if (end) {
+			length = end - &conn -> buffer [conn -> pos] + 1;
+
+			if (length >= size) {
+				return -1;
+			}
+
+			memcpy (line, &conn -> buffer [conn -> pos], length);
+			line [length] = '\0';
+			conn -> pos += length;
+
+			return 0;
+		}
+
+		if (conn -> len - conn -> pos >= size - 1) {
+			return -1;
+		}
+
+		// keep partial line at start of buffer
+		memmove (conn -> buffer, &conn -> buffer [conn -> pos], conn -> len - conn -> pos);
+		conn -> len -= conn -> pos;
+		conn -> pos = 0;
+
+		if (conn_fill (conn) != 0) {
+			return -1;
+		}
+	}
+}
+
+/**
+ * Read `size` bytes starting with the buffered ones
+ */
+static BKInt conn_read (struct daemon_conn * conn, void * data, BKUSize size)
+{
+	ssize_t res;
+	char * ptr = data;
+	BKUSize length = BKMin (size, conn -> len - conn -> pos);
+
+	memcpy (ptr, &conn -> buffer [conn -> pos], length);
+	conn -> pos += length;
+	ptr += length;
+	size -= length;
+
+	while (size) {
+		if (conn_wait (conn) != 0) {
+			return -1;
+		}
+
+		res = read (conn -> fd, ptr, size);
+
+		if (res < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (res <= 0) {
+			return -1;
+		}
+
+		ptr += res;
+		size -= res;
+	}
+
+	return 0;
+}
+
+static void send_error (int fd, char const * message)
+{
+	char line [256];
+
+	snprintf (line, sizeof (line), "ERROR %s\n", message);
+	send_all (fd, line, strlen (line));
+}
+
+static BKInt daemon_read_job (struct daemon_conn * conn, struct daemon_job * job)
+{
+	char line [256];
+	char format [8];
+	unsigned long size;
+	int fd = conn -> fd;
+
+	if (conn_read_line (conn, line, sizeof (line)) != 0) {
+		return -1;
+	}
+
+	if (sscanf (line, "%d %7s %63s %63s %lu", &job -> sampleRate, format, job -> startTime, job -> endTime, &size) != 5) {
+		send_error (fd, "Invalid header");
+		return -1;
+	}
+
+	if (job -> sampleRate < 16000 || job -> sampleRate > 96000) {
+		send_error (fd, "Invalid sample rate");
+		return -1;
+	}
+
+	job -> type = output_type_for_name (strcmp (format, "wav") == 0 ? ".wav" : strcmp (format, "raw") == 0 ? ".raw" : "");
+
+	if (job -> type == OUTPUT_TYPE_NONE) {
+		send_error (fd, "Unknown format");
+		return -1;
+	}
+
+	if (size == 0 || size > DAEMON_MAX_SOURCE_SIZE) {
+		send_error (fd, "Invalid source size");
+		return -1;
+	}
+
+	if ((job -> source = malloc (size)) == NULL) {
+		send_error (fd, "Allocation error");
+		return -1;
+	}
+
+	job -> sourceSize = size;
+
+	if (conn_read (conn, job -> source, size) != 0) {
+		free (job -> source);
+		job -> source = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void daemon_entry_dispose (struct daemon_entry * entry)
+{
+	if (entry -> used) {
+		BKDispose (&entry -> keyframes);
+		BKDispose (&entry -> ctx);
+		BKDispose (&entry -> renderCtx);
+		free (entry -> source);
+	}
+
+	entry -> used = 0;
+	entry -> source = NULL;
+	entry -> sourceSize = 0;
+	entry -> hash = 0;
+}
+
+static BKInt daemon_entry_load (struct daemon const * daemon, struct loader * loader, struct daemon_entry * entry, struct daemon_job const * job)
+{
+	BKInt res;
+	FILE * file;
+
+	if (BKTKContextInit (&entry -> ctx, 0) != 0) {
+		return -1;
+	}
+
+	if (BKContextInit (&entry -> renderCtx, daemon -> app -> numChannels, job -> sampleRate) != 0) {
+		BKDispose (&entry -> ctx);
+		return -1;
+	}
+
+	if ((file = fmemopen (job -> source, job -> sourceSize, "rb")) == NULL) {
+		res = -1;
+	}
+	else {
+		res = make_context (loader, &entry -> ctx, &entry -> renderCtx, file, &daemon -> app -> sourceLoadPath, 0, 1);
+		fclose (file);
+	}
+
+	// keyframes are used to rewind and to seek to start time
+	if (res == 0) {
+		res = make_keyframes (&entry -> ctx, &entry -> keyframes);
+	}
+
+	if (res != 0) {
+		BKDispose (&entry -> ctx);
+		BKDispose (&entry -> renderCtx);
+		return -1;
+	}
+
+	entry -> source = job -> source;
+	entry -> sourceSize = job -> sourceSize;
+	entry -> sampleRate = job -> sampleRate;
+
+	return 0;
+}
+
+/**
+ * Get cached program or compile source into least recently used entry
+ *
+ * The entry is reserved until released with `daemon_release`. Takes ownership
+ * of the job's source if a new entry is created. Compiling is done without
+ * holding the cache lock.
+ *
+ * Returns 0 on success, 1 if all entries are being rendered or -1 if the
+ * source could not be compiled.
+ */
+static BKInt daemon_lookup (struct daemon * daemon, struct loader * loader, struct daemon_job * job, struct daemon_entry ** outEntry, BKInt * outCached)
+{
+	BKInt res;
+	uint64_t hash = hash_source (job -> source, job -> sourceSize);
+	struct daemon_entry * entry, * lruEntry = NULL;
+
+	daemon_lock (daemon);
+
+	for (BKInt i = 0; i < DAEMON_CACHE_SIZE; i ++) {
+		entry = &daemon -> entries [i];
+
+		if (entry -> used && entry -> hash == hash && entry -> sampleRate == job -> sampleRate
+			&& entry -> sourceSize == job -> sourceSize && memcmp (entry -> source, job -> source, job -> sourceSize) == 0) {
+			entry -> users ++;
+			entry -> lastUse = ++ daemon -> useCount;
+			daemon_unlock (daemon);
+			*outEntry = entry;
+			*outCached = 1;
+
+			return 0;
+		}
+
+		if (entry -> users) {
+			continue;
+		}
+
+		if (!lruEntry || (lruEntry -> used && (!entry -> used || entry -> lastUse < lruEntry -> lastUse))) {
+			lruEntry = entry;
+		}
+	}
+
+	// all entries are being rendered
+	if (!lruEntry) {
+		daemon_unlock (daemon);
+		return 1;
+	}
+
+	entry = lruEntry;
+	daemon_entry_dispose (entry);
+	entry -> users = 1;
+	daemon_unlock (daemon);
+
+	res = daemon_entry_load (daemon, loader, entry, job);
+
+	daemon_lock (daemon);
+
+	if (res != 0) {
+		entry -> users = 0;
+		daemon_unlock (daemon);
+		return -1;
+	}
+
+	job -> source = NULL;
+	entry -> used = 1;
+	entry -> hash = hash;
+	entry -> lastUse = ++ daemon -> useCount;
+	daemon_unlock (daemon);
+	*outEntry = entry;
+	*outCached = 0;
+
+	return 0;
+}
+
+static void daemon_release (struct daemon * daemon, struct daemon_entry * entry)
+{
+	daemon_lock (daemon);
+	entry -> users --;
+	daemon_unlock (daemon);
+}
+
+/**
+ * Render job and send frames to client as they are rendered
+ */
+static BKInt daemon_render (struct daemon_entry * entry, struct daemon_job const * job, int fd)
+{
+	BKInt res = 0;
+	BKInt done = 0;
+	BKInt numFrames;
+	BKTime startTime = (BKTime) {0}, endTime = (BKTime) {0};
+	BKTime skipTime, preroll;
+	BKTime const * endTimePtr = NULL;
+	BKTKContext * ctx = &entry -> ctx;
+	BKContext * renderContext = &entry -> renderCtx;
+	BKInt numChannels = renderContext -> numChannels;
+	BKUSize frameSize = numChannels * sizeof (BKFrame);
+	BKFrame * frames;
+	uint8_t * data;
+	uint8_t header [WAVE_HEADER_SIZE];
+
+	if (strcmp (job -> startTime, "-") != 0) {
+		if (parse_seek_time (renderContext, job -> startTime, &startTime, ctx -> info.stepTicks) != 0) {
+			send_error (fd, "Invalid start time");
+			return -1;
+		}
+	}
+
+	if (strcmp (job -> endTime, "-") != 0) {
+		if (parse_seek_time (renderContext, job -> endTime, &endTime, ctx -> info.stepTicks) != 0) {
+			send_error (fd, "Invalid end time");
+			return -1;
+		}
+
+		endTimePtr = &endTime;
+	}
+
+	frames = malloc (RENDER_CHUNK_FRAMES * frameSize);
+	data = malloc (RENDER_CHUNK_FRAMES * frameSize);
+
+	if (frames == NULL || data == NULL) {
+		send_error (fd, "Allocation error");
+		free (frames);
+		free (data);
+		return -1;
+	}
+
+	// rewind
+	preroll = BKTimeFromSeconds (renderContext, SEEK_PREROLL_SECS);
+	BKContextReset (renderContext);
+	BKTKContextSeekKeyframe (ctx, &entry -> keyframes, skip_time (startTime, preroll), &skipTime);
+	BKContextGenerateToTime (renderContext, BKTimeSub (startTime, skipTime), push_frames, NULL);
+	endTime = skip_time (endTime, skipTime);
+
+	res = send_all (fd, "OK\n", 3);
+
+	if (res == 0 && job -> type == OUTPUT_TYPE_WAVE) {
+		make_wave_header (header, numChannels, job -> sampleRate, WAVE_STREAM_DATA_SIZE);
+		res = send_all (fd, header, sizeof (header));
+	}
+
+	while (!done && res == 0) {
+		numFrames = render_frames (ctx, frames, RENDER_CHUNK_FRAMES, endTimePtr, FLAG_NO_SOUND, &done);
+
+		if (job -> type == OUTPUT_TYPE_RAW) {
+			res = send_all (fd, frames, numFrames * frameSize);
+		}
+		else {
+			frames_to_le (data, frames, numFrames * numChannels);
+			res = send_all (fd, data, numFrames * frameSize);
+		}
+	}
+
+	free (frames);
+	free (data);
+
+	return res;
+}
+
+static void daemon_handle (struct daemon * daemon, struct loader * loader, int fd)
+{
+	BKInt res;
+	BKInt cached = 0;
+	double start = time_secs ();
+	struct daemon_job job;
+	struct daemon_conn * conn;
+	struct daemon_entry * entry;
+
+	memset (&job, 0, sizeof (job));
+
+	if ((conn = malloc (sizeof (*conn))) == NULL) {
+		return;
+	}
+
+	conn -> fd = fd;
+	conn -> pos = conn -> len = 0;
+	conn -> deadline = monotonic_nsecs () + (int64_t) DAEMON_TIMEOUT_SECS * 1000000000;
+
+	res = daemon_read_job (conn, &job);
+	free (conn);
+
+	if (res != 0) {
+		return;
+	}
+
+	if ((res = daemon_lookup (daemon, loader, &job, &entry, &cached)) != 0) {
+		send_error (fd, res > 0 ? "Server busy" : "Failed to compile source");
+		free (job.source);
+		return;
+	}
+
+#if BK_USE_THREADS
+	pthread_mutex_lock (&entry -> mutex);
+#endif
+
+	res = daemon_render (entry, &job, fd);
+
+#if BK_USE_THREADS
+	pthread_mutex_unlock (&entry -> mutex);
+#endif
+
+	daemon_release (daemon, entry);
+	free (job.source);
+
+	print_message ("%s %lu bytes, %s, %.3fs\n", res == 0 ? "Rendered" : "Failed to render", (unsigned long) job.sourceSize, cached ? "cached" : "compiled", time_secs () - start);
+}
+
+/**
+ * Limit blocking writes to clients not reading
+ */
+static void set_send_timeout (int fd)
+{
+	struct timeval timeout;
+
+	timeout.tv_sec = DAEMON_TIMEOUT_SECS;
+	timeout.tv_usec = 0;
+
+	setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+}
+
+#if BK_USE_THREADS
+/**
+ * Take connections from queue until daemon quits
+ */
+static void * daemon_run (void * info)
+{
+	int fd;
+	struct daemon * daemon = info;
+	struct loader loader;
+
+	if (loader_init (&loader, daemon -> app -> flags) != 0) {
+		return NULL;
+	}
+
+	for (;;) {
+		pthread_mutex_lock (&daemon -> mutex);
+
+		while (!daemon -> queueLen && !daemon -> quit) {
+			pthread_cond_wait (&daemon -> cond, &daemon -> mutex);
+		}
+
+		// handle queued connections before quitting
+		if (!daemon -> queueLen) {
+			pthread_mutex_unlock (&daemon -> mutex);
+			break;
+		}
+
+		fd = daemon -> queue [daemon -> queueHead];
+		daemon -> queueHead = (daemon -> queueHead + 1) % DAEMON_BACKLOG;
+		daemon -> queueLen --;
+		pthread_cond_broadcast (&daemon -> cond);
+		pthread_mutex_unlock (&daemon -> mutex);
+
+		daemon_handle (daemon, &loader, fd);
+		close (fd);
+	}
+
+	loader_dispose (&loader);
+
+	return NULL;
+}
+
+/**
+ * Queue connection; waits while queue is full
+ */
+static void daemon_push (struct daemon * daemon, int fd)
+{
+	pthread_mutex_lock (&daemon -> mutex);
+
+	while (daemon -> queueLen == DAEMON_BACKLOG) {
+		pthread_cond_wait (&daemon -> cond, &daemon -> mutex);
+	}
+
+	daemon -> queue [(daemon -> queueHead + daemon -> queueLen) % DAEMON_BACKLOG] = fd;
+	daemon -> queueLen ++;
+	pthread_cond_broadcast (&daemon -> cond);
+	pthread_mutex_unlock (&daemon -> mutex);
+}
+#endif /* BK_USE_THREADS */
+
+/**
+ * Accept render jobs on Unix domain socket until interrupted
+ *
+ * Connections are handled by `numJobs` workers. Requests not received within
+ * `DAEMON_TIMEOUT_SECS` are dropped.
+ */
+BKInt run_daemon (struct bliplay const * app, char const * path)
+{
+	int fd;
+	BKInt numWorkers = 0;
+	struct sockaddr_un addr;
+	struct sigaction action;
+	struct daemon daemon;
+	struct loader loader;
+
+	memset (&addr, 0, sizeof (addr));
+	addr.sun_family = AF_UNIX;
+
+	if (strlen (path) >= sizeof (addr.sun_path)) {
+		print_error ("Socket path too long: %s\n", path);
+		return -1;
+	}
+
+	strcpy (addr.sun_path, path);
+
+	memset (&daemon, 0, sizeof (daemon));
+	daemon.app = app;
+
+	if ((daemon.socket = socket (AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		print_error ("Could not create socket: %s\n", strerror (errno));
+		return -1;
+	}
+
+	unlink (path);
+
+	if (bind (daemon.socket, (struct sockaddr *) &addr, sizeof (addr)) != 0 || listen (daemon.socket, DAEMON_BACKLOG) != 0) {
+		print_error ("Could not listen on socket %s: %s\n", path, strerror (errno));
+		close (daemon.socket);
+		return -1;
+	}
+
+	// interrupt `accept` to quit
+	memset (&action, 0, sizeof (action));
+	action.sa_handler = daemon_signal;
+	sigaction (SIGINT, &action, NULL);
+	sigaction (SIGTERM, &action, NULL);
+
+	// clients may close connection while sending
+	signal (SIGPIPE, SIG_IGN);
+
+#if BK_USE_THREADS
+	pthread_t threads [MAX_JOBS];
+	sigset_t signals, oldSignals;
+
+	pthread_mutex_init (&daemon.mutex, NULL);
+	pthread_cond_init (&daemon.cond, NULL);
+
+	for (BKInt i = 0; i < DAEMON_CACHE_SIZE; i ++) {
+		pthread_mutex_init (&daemon.entries [i].mutex, NULL);
+	}
+
+	// workers inherit the blocked signals, so only this thread is
+	// interrupted to quit
+	sigemptyset (&signals);
+	sigaddset (&signals, SIGINT);
+	sigaddset (&signals, SIGTERM);
+	pthread_sigmask (SIG_BLOCK, &signals, &oldSignals);
+
+	for (BKInt i = 0; i < app -> numJobs; i ++) {
+		if (pthread_create (&threads [numWorkers], NULL, daemon_run, &daemon) != 0) {
+			break;
+		}
+
+		numWorkers ++;
+	}
+
+	pthread_sigmask (SIG_SETMASK, &oldSignals, NULL);
+#endif
+
+	// handle connections in this thread if there are no workers
+	if (!numWorkers && loader_init (&loader, app -> flags) != 0) {
+		close (daemon.socket);
+		unlink (path);
+		return -1;
+	}
+
+	print_notice ("Listening on %s\n", path);
+
+	while (!daemonQuit) {
+		if ((fd = accept (daemon.socket, NULL, NULL)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			print_error ("Could not accept connection: %s\n", strerror (errno));
+			break;
+		}
+
+		set_send_timeout (fd);
+
+#if BK_USE_THREADS
+		if (numWorkers) {
+			daemon_push (&daemon, fd);
+			continue;
+		}
+#endif
+
+		daemon_handle (&daemon, &loader, fd);
+		close (fd);
+	}
+
+	close (daemon.socket);
+	unlink (path);
+
+#if BK_USE_THREADS
+	// let workers finish queued connections
+	pthread_mutex_lock (&daemon.mutex);
+	daemon.quit = 1;
+	pthread_cond_broadcast (&daemon.cond);
+	pthread_mutex_unlock (&daemon.mutex);
+
+	for (BKInt i = 0; i < numWorkers; i ++) {
+		pthread_join (threads [i], NULL);
+	}
+#endif
+
+	if (!numWorkers) {
+		loader_dispose (&loader);
+	}
+
+	for (BKInt i = 0; i < DAEMON_CACHE_SIZE; i ++) {
+		daemon_entry_dispose (&daemon.entries [i]);
+#if BK_USE_THREADS
+		pthread_mutex_destroy (&daemon.entries [i].mutex);
+#endif
+	}
+
+#if BK_USE_THREADS
+	pthread_cond_destroy (&daemon.cond);
+	pthread_mutex_destroy (&daemon.mutex);
+#endif
+
+	return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2012-2016 Simon Schoenenberger
+ * http://blipkit.audio
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "bliplay.h"
+
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+/**
+ * Timing deviation of paced output from wall-clock schedule
+ */
+struct jitter_stats
+{
+	BKInt   count;
+	BKInt   overruns; // chunks not rendered before their deadline
+	double  sum;
+	double  sumSquares;
+	int64_t maxNsecs;
+};
+
+static void sleep_until_nsecs (int64_t nsecs)
+{
+	struct timespec time;
+
+#ifdef HAVE_CLOCK_NANOSLEEP
+	time.tv_sec  = nsecs / 1000000000;
+	time.tv_nsec = nsecs % 1000000000;
+
+	while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &time, NULL) == EINTR) {
+		;
+	}
+#else
+	nsecs -= monotonic_nsecs ();
+
+	if (nsecs > 0) {
+		time.tv_sec  = nsecs / 1000000000;
+		time.tv_nsec = nsecs % 1000000000;
+
+		nanosleep (&time, NULL);
+	}
+#endif
+}
+
+static void jitter_add (struct jitter_stats * jitter, int64_t nsecs)
+{
+	jitter -> count ++;
+	jitter -> sum += nsecs;
+	jitter -> sumSquares += (double) nsecs * nsecs;
+	jitter -> maxNsecs = BKMax (jitter -> maxNsecs, nsecs);
+}
+
+static void print_jitter (struct jitter_stats const * jitter, FILE * outputFile)
+{
+	double mean = 0, deviation = 0;
+	// don't mix report with audio data
+	FILE * stream = outputFile == stdout ? stderr : stdout;
+
+	if (jitter -> count) {
+		mean = jitter -> sum / jitter -> count;
+		deviation = sqrt (BKMax (jitter -> sumSquares / jitter -> count - mean * mean, 0));
+	}
+
+	fprintf (stream, "     chunks: %d, overruns: %d\n", jitter -> count, jitter -> overruns);
+	fprintf (stream, "     jitter: mean %.3f ms, stddev %.3f ms, max %.3f ms\n", mean / 1e6, deviation / 1e6, jitter -> maxNsecs / 1e6);
+}
+
+/**
+ * Render and write chunks at wall-clock pace
+ *
+ * Each chunk is due when the previously written frames would have been
+ * played. The deadlines are derived from the start time, so delays don't
+ * accumulate. The lateness of each wake-up is reported as jitter.
+ */
+BKInt write_output_paced (struct bliplay * app)
+{
+	BKInt done = 0;
+	BKInt numFrames;
+	int64_t totalFrames = 0;
+	int64_t start, deadline, now;
+	BKTKContext * ctx = &app -> ctx;
+	BKInt numChannels = ctx -> renderContext -> numChannels;
+	BKInt sampleRate = ctx -> renderContext -> sampleRate;
+	struct jitter_stats jitter;
+	BKFrame * frames;
+
+	memset (&jitter, 0, sizeof (jitter));
+	frames = malloc (RENDER_CHUNK_FRAMES * numChannels * sizeof (BKFrame));
+
+	if (frames == NULL) {
+		return -1;
+	}
+
+	start = monotonic_nsecs ();
+
+	while (!done) {
+		numFrames = render_frames (ctx, frames, RENDER_CHUNK_FRAMES, end_time (app), app -> flags, &done);
+
+		// nothing is due after the last frames
+		if (!numFrames) {
+			break;
+		}
+
+		write_frames (&app -> output, frames, numFrames * numChannels);
+
+		// pass frames to readers of FIFOs and pipes immediately
+		if (app -> output.file) {
+			fflush (app -> output.file);
+		}
+
+		totalFrames += numFrames;
+		deadline = start + totalFrames * 1000000000 / sampleRate;
+		now = monotonic_nsecs ();
+
+		if (now < deadline) {
+			sleep_until_nsecs (deadline);
+			now = monotonic_nsecs ();
+		}
+		else {
+			jitter.overruns ++;
+		}
+
+		jitter_add (&jitter, now - deadline);
+	}
+
+	free (frames);
+	print_jitter (&jitter, app -> output.file);
+
+	return 0;
+}
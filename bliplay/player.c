@@ -0,0 +1,714 @@
+/*
+ * Copyright (c) 2012-2016 Simon Schoenenberger
+ * http://blipkit.audio
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "bliplay.h"
+
+#if BK_USE_SDL
+
+#include <errno.h>
+#include <math.h>
+#include <sys/select.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef FD_COPY
+#define FD_COPY(src, dest) memcpy ((dest), (src), sizeof (*(dest)))
+#endif
+
+static int set_noecho (int nocanon)
+{
+	struct termios oldtc, newtc;
+
+	tcgetattr (STDIN_FILENO, & oldtc);
+
+	newtc = oldtc;
+
+	if (nocanon) {
+		newtc.c_lflag &= ~(ICANON | ECHO);
+	}
+	else {
+		newtc.c_lflag |= (ICANON | ECHO);
+	}
+
+	tcsetattr (STDIN_FILENO, TCSANOW, & newtc);
+
+	return 0;
+}
+
+static int getchar_nocanon (unsigned tcflags)
+{
+	int c;
+	struct termios oldtc, newtc;
+
+	tcgetattr (STDIN_FILENO, & oldtc);
+
+	newtc = oldtc;
+	newtc.c_lflag &= ~(ICANON | ECHO | tcflags);
+
+	tcsetattr (STDIN_FILENO, TCSANOW, & newtc);
+	c = getchar ();
+	tcsetattr (STDIN_FILENO, TCSANOW, & oldtc);
+
+	return c;
+}
+
+static unsigned time_usecs (void)
+{
+	return (unsigned) (monotonic_nsecs () / 1000);
+}
+
+static void atomic_max (atomic_uint * value, unsigned newValue)
+{
+	unsigned oldValue = atomic_load (value);
+
+	while (oldValue < newValue && !atomic_compare_exchange_weak (value, &oldValue, newValue)) {
+		;
+	}
+}
+
+static void stats_add_callback (struct callback_stats * stats, unsigned usecs)
+{
+	BKInt bucket = BKMin (usecs / STATS_BUCKET_USECS, STATS_NUM_BUCKETS - 1);
+
+	atomic_fetch_add (&stats -> count, 1);
+	atomic_fetch_add (&stats -> buckets [bucket], 1);
+	atomic_max (&stats -> maxUsecs, usecs);
+	atomic_max (&stats -> windowMaxUsecs, usecs);
+
+	if (usecs > atomic_load (&stats -> deadlineUsecs)) {
+		atomic_fetch_add (&stats -> late, 1);
+	}
+}
+
+/**
+ * Get callback duration below which `percent` of all callbacks are
+ */
+static double stats_percentile (struct callback_stats * stats, double percent)
+{
+	unsigned count = atomic_load (&stats -> count);
+	unsigned sum = 0;
+
+	for (BKInt i = 0; i < STATS_NUM_BUCKETS; i ++) {
+		sum += atomic_load (&stats -> buckets [i]);
+
+		if (sum && sum >= count * percent / 100.0) {
+			return (i + 1) * STATS_BUCKET_USECS / 1000.0;
+		}
+	}
+
+	return atomic_load (&stats -> maxUsecs) / 1000.0;
+}
+
+static void print_stats (struct bliplay * app)
+{
+	struct callback_stats * stats = &app -> audio.stats;
+
+	print_message ("     buffer: %d frames (%.2f ms)%s\n", app -> audio.bufferFrames, atomic_load (&stats -> deadlineUsecs) / 1000.0, (app -> flags & FLAG_ADAPTIVE_BUFFER) ? ", adaptive" : "");
+	print_message ("  callbacks: %u, late: %u, underruns: %u\n", atomic_load (&stats -> count), atomic_load (&stats -> late), atomic_load (&stats -> underruns));
+	print_message ("   duration: p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+		stats_percentile (stats, 50), stats_percentile (stats, 95), stats_percentile (stats, 99), atomic_load (&stats -> maxUsecs) / 1000.0);
+}
+
+#if BK_USE_THREADS
+static void sleep_usecs (BKInt usecs)
+{
+	struct timespec time;
+
+	time.tv_sec  = usecs / 1000000;
+	time.tv_nsec = (usecs % 1000000) * 1000;
+
+	nanosleep (&time, NULL);
+}
+
+static void * player_render_run (void * info)
+{
+	unsigned start;
+	struct bliplay * app = info;
+	struct player * player = &app -> audio.player;
+	BKContext * renderContext = app -> ctx.renderContext;
+	BKTime const * endTime = end_time (app);
+
+	while (!atomic_load (&player -> quit)) {
+		if (BKRingBufferReadable (&player -> frames) + player -> chunkSize > atomic_load (&player -> targetSize)) {
+			sleep_usecs (PLAYER_SLEEP_USECS);
+			continue;
+		}
+
+		// wait for writer instead of dropping frames
+		if (player -> recording && BKRingBufferWritable (&player -> record) < player -> chunkSize) {
+			sleep_usecs (PLAYER_SLEEP_USECS);
+			continue;
+		}
+
+		start = time_usecs ();
+		// write while locked so seeking cannot flush before the chunk is written
+		pthread_mutex_lock (&player -> mutex);
+
+		// stop at the same frame as the offline render; the remaining
+		// frames are played and written by the other threads
+		if (!check_tracks_running (&app -> ctx, app -> flags) || (endTime && BKTimeIsGreaterEqual (renderContext -> currentTime, *endTime))) {
+			atomic_store (&player -> ended, 1);
+			pthread_mutex_unlock (&player -> mutex);
+			break;
+		}
+
+		BKContextGenerate (renderContext, player -> renderChunk, RENDER_CHUNK_FRAMES);
+		BKRingBufferWrite (&player -> frames, player -> renderChunk, player -> chunkSize);
+
+		if (player -> recording) {
+			BKRingBufferWrite (&player -> record, player -> renderChunk, player -> chunkSize);
+		}
+
+		pthread_mutex_unlock (&player -> mutex);
+		atomic_max (&app -> audio.stats.renderWindowMaxUsecs, time_usecs () - start);
+	}
+
+	return NULL;
+}
+
+static void * player_write_run (void * info)
+{
+	BKInt done;
+	BKUSize size;
+	struct bliplay * app = info;
+	struct player * player = &app -> audio.player;
+
+	do {
+		// check before draining to not miss the last frames
+		done = atomic_load (&player -> done);
+
+		while ((size = BKRingBufferRead (&player -> record, player -> writeChunk, player -> chunkSize))) {
+			write_frames (&app -> output, player -> writeChunk, size / sizeof (BKFrame));
+		}
+
+		if (!done) {
+			sleep_usecs (PLAYER_SLEEP_USECS);
+		}
+	}
+	while (!done);
+
+	return NULL;
+}
+
+/**
+ * Copy rendered frames in audio callback
+ */
+static void player_fill (struct audio * audio, Uint8 * stream, BKUSize len)
+{
+	BKUSize size;
+	struct player * player = &audio -> player;
+
+	// discard frames rendered before seeking
+	if (atomic_exchange (&player -> flush, 0)) {
+		BKRingBufferSkip (&player -> frames, BKRingBufferReadable (&player -> frames));
+	}
+
+	size = BKRingBufferRead (&player -> frames, stream, len);
+
+	if (size < len) {
+		memset (&stream [size], 0, len - size);
+		atomic_fetch_add (&audio -> stats.underruns, 1);
+	}
+}
+
+/**
+ * Render `PLAYER_BUFFER_PERIODS` audio buffers ahead
+ */
+static void player_set_buffer_size (struct player * player, BKInt frames)
+{
+	BKUSize size = PLAYER_BUFFER_PERIODS * frames * (player -> chunkSize / RENDER_CHUNK_FRAMES);
+
+	atomic_store (&player -> targetSize, BKMax (size, 2 * player -> chunkSize));
+}
+
+static void player_dispose (struct player * player)
+{
+	BKRingBufferDispose (&player -> frames);
+	BKRingBufferDispose (&player -> record);
+	free (player -> renderChunk);
+	free (player -> writeChunk);
+	pthread_mutex_destroy (&player -> mutex);
+}
+
+/**
+ * Start render thread and writer thread if writing to a file
+ *
+ * Returns when the buffer is filled or the tracks have ended.
+ */
+static BKInt player_start (struct bliplay * app)
+{
+	BKInt res = 0;
+	struct player * player = &app -> audio.player;
+	BKContext * renderContext = app -> ctx.renderContext;
+	BKUSize frameSize = renderContext -> numChannels * sizeof (BKFrame);
+
+	memset (player, 0, sizeof (*player));
+	pthread_mutex_init (&player -> mutex, NULL);
+	atomic_init (&player -> quit, 0);
+	atomic_init (&player -> done, 0);
+	atomic_init (&player -> ended, 0);
+	atomic_init (&player -> flush, 0);
+	atomic_init (&player -> targetSize, 0);
+	atomic_store (&app -> audio.stats.renderDeadlineUsecs, (unsigned) (RENDER_CHUNK_FRAMES * 1000000.0 / renderContext -> sampleRate));
+
+	player -> chunkSize = RENDER_CHUNK_FRAMES * frameSize;
+	player -> recording = app -> output.file != NULL;
+	player -> renderChunk = malloc (player -> chunkSize);
+	player -> writeChunk = malloc (player -> chunkSize);
+
+	if (!player -> renderChunk || !player -> writeChunk) {
+		res = -1;
+	}
+	else if (BKRingBufferInit (&player -> frames, PLAYER_BUFFER_PERIODS * AUDIO_BUFFER_MAX * frameSize) != 0) {
+		res = -1;
+	}
+	else if (player -> recording && BKRingBufferInit (&player -> record, RECORD_BUFFER_SECS * renderContext -> sampleRate * frameSize) != 0) {
+		res = -1;
+	}
+
+	if (res != 0) {
+		player_dispose (player);
+		return res;
+	}
+
+	if (pthread_create (&player -> renderThread, NULL, player_render_run, app) != 0) {
+		player_dispose (player);
+		return -1;
+	}
+
+	if (player -> recording) {
+		if (pthread_create (&player -> writerThread, NULL, player_write_run, app) != 0) {
+			atomic_store (&player -> quit, 1);
+			pthread_join (player -> renderThread, NULL);
+			player_dispose (player);
+			return -1;
+		}
+	}
+
+	player -> running = 1;
+	player_set_buffer_size (player, app -> audio.bufferFrames);
+
+	while (BKRingBufferReadable (&player -> frames) + player -> chunkSize <= atomic_load (&player -> targetSize) && !atomic_load (&player -> ended)) {
+		sleep_usecs (PLAYER_SLEEP_USECS);
+	}
+
+	return 0;
+}
+
+/**
+ * Stop rendering and wait until the buffered frames are played
+ */
+static void player_drain (struct player * player)
+{
+	if (!player -> running) {
+		return;
+	}
+
+	atomic_store (&player -> quit, 1);
+	pthread_join (player -> renderThread, NULL);
+
+	while (BKRingBufferReadable (&player -> frames)) {
+		sleep_usecs (PLAYER_SLEEP_USECS);
+	}
+}
+
+/**
+ * Stop threads after pausing audio
+ */
+static void player_stop (struct player * player)
+{
+	if (!player -> running) {
+		return;
+	}
+
+	if (!atomic_exchange (&player -> quit, 1)) {
+		pthread_join (player -> renderThread, NULL);
+	}
+
+	if (player -> recording) {
+		atomic_store (&player -> done, 1);
+		pthread_join (player -> writerThread, NULL);
+	}
+
+	player -> running = 0;
+	player_dispose (player);
+}
+#endif /* BK_USE_THREADS */
+
+static void fill_audio (struct bliplay * app, Uint8 * stream, int len)
+{
+	BKContext * renderContext = app -> ctx.renderContext;
+	BKUInt numChannels = renderContext -> numChannels;
+	BKUInt numFrames   = len / sizeof (BKFrame) / numChannels;
+	unsigned start     = time_usecs ();
+
+#if BK_USE_THREADS
+	if (app -> audio.player.running) {
+		player_fill (&app -> audio, stream, len);
+		stats_add_callback (&app -> audio.stats, time_usecs () - start);
+		return;
+	}
+#endif
+
+	BKContextGenerate (renderContext, (BKFrame *) stream, numFrames);
+	write_frames (&app -> output, (BKFrame *) stream, numFrames * numChannels);
+
+	stats_add_callback (&app -> audio.stats, time_usecs () - start);
+}
+
+/**
+ * Lock render context against the thread rendering audio
+ */
+static void lock_render (struct audio * audio)
+{
+#if BK_USE_THREADS
+	if (audio -> player.running) {
+		pthread_mutex_lock (&audio -> player.mutex);
+		return;
+	}
+#endif
+
+	SDL_LockAudio ();
+}
+
+static void unlock_render (struct audio * audio)
+{
+#if BK_USE_THREADS
+	if (audio -> player.running) {
+		pthread_mutex_unlock (&audio -> player.mutex);
+		return;
+	}
+#endif
+
+	SDL_UnlockAudio ();
+}
+
+/**
+ * Seek relative to current play time while playing
+ *
+ * Keyframes are built when seeking the first time. This rewinds the
+ * interpreters, so the render context is locked while building.
+ */
+static void scrub_context (struct bliplay * app, double secs)
+{
+	BKTime time, delta;
+	BKTKContext * ctx = &app -> ctx;
+	BKContext * renderContext = ctx -> renderContext;
+	struct audio * audio = &app -> audio;
+
+	lock_render (audio);
+
+	time = BKTimeAdd (renderContext -> currentTime, app -> skipTime);
+	delta = BKTimeFromSeconds (renderContext, fabs (secs));
+	time = secs < 0 ? skip_time (time, delta) : BKTimeAdd (time, delta);
+
+	if (!audio -> hasKeyframes) {
+		if (make_keyframes (ctx, &audio -> keyframes) != 0) {
+			print_error ("\nCould not build keyframes for seeking\n");
+			unlock_render (audio);
+			return;
+		}
+
+		audio -> hasKeyframes = 1;
+	}
+
+	// the render tracks are reset before applying the recorded state
+	BKContextReset (renderContext);
+	// keep the audio locked only briefly
+	app -> skipTime = seek_context_preroll (ctx, &audio -> keyframes, time, SCRUB_PREROLL_SECS);
+
+#if BK_USE_THREADS
+	atomic_store (&audio -> player.flush, 1);
+#endif
+
+	unlock_render (audio);
+}
+
+BKInt init_sdl (struct bliplay * app, char const ** error)
+{
+	SDL_Init (SDL_INIT_AUDIO);
+
+	SDL_AudioSpec wanted;
+
+	wanted.freq     = app -> ctx.renderContext -> sampleRate;
+	wanted.format   = AUDIO_S16SYS;
+	wanted.channels = app -> ctx.renderContext -> numChannels;
+	wanted.samples  = app -> audio.bufferFrames;
+	wanted.callback = (void *) fill_audio;
+	wanted.userdata = app;
+
+	if (SDL_OpenAudio (& wanted, NULL) < 0) {
+		* error = SDL_GetError ();
+		return -1;
+	}
+
+	atomic_store (&app -> audio.stats.deadlineUsecs, (unsigned) (app -> audio.bufferFrames * 1000000.0 / wanted.freq));
+
+	return 0;
+}
+
+/**
+ * Reopen audio device with new buffer size while playing
+ */
+static BKInt resize_audio_buffer (struct bliplay * app, BKInt frames)
+{
+	char const * error = NULL;
+
+	SDL_CloseAudio ();
+	app -> audio.bufferFrames = frames;
+
+#if BK_USE_THREADS
+	if (app -> audio.player.running) {
+		player_set_buffer_size (&app -> audio.player, frames);
+	}
+#endif
+
+	if (init_sdl (app, &error) < 0) {
+		print_error ("Could not initialize SDL: %s\n", error);
+		return -1;
+	}
+
+	SDL_PauseAudio (0);
+
+	return 0;
+}
+
+/**
+ * Grow buffer on underruns or slow callbacks and shrink it when calm
+ *
+ * With a render thread, the callback only copies frames, so the render time
+ * per chunk and the ring buffer underruns are used instead.
+ *
+ * Called after each update interval of the run loop.
+ */
+static BKInt adapt_buffer_size (struct bliplay * app)
+{
+	struct audio * audio = &app -> audio;
+	struct callback_stats * stats = &audio -> stats;
+	BKInt frames = audio -> bufferFrames;
+	unsigned misses = atomic_load (&stats -> late) + atomic_load (&stats -> underruns);
+	unsigned maxUsecs = atomic_exchange (&stats -> windowMaxUsecs, 0);
+	unsigned deadlineUsecs = atomic_load (&stats -> deadlineUsecs);
+
+#if BK_USE_THREADS
+	if (audio -> player.running) {
+		misses = atomic_load (&stats -> underruns);
+		maxUsecs = atomic_exchange (&stats -> renderWindowMaxUsecs, 0);
+		deadlineUsecs = atomic_load (&stats -> renderDeadlineUsecs);
+	}
+#endif
+
+	if (misses != audio -> lastMisses || maxUsecs > deadlineUsecs * 3 / 4) {
+		frames *= 2;
+		audio -> calmUpdates = 0;
+	}
+	else if (maxUsecs < deadlineUsecs / 4) {
+		if (++ audio -> calmUpdates >= ADAPT_CALM_UPDATES) {
+			frames /= 2;
+			audio -> calmUpdates = 0;
+		}
+	}
+	else {
+		audio -> calmUpdates = 0;
+	}
+
+	audio -> lastMisses = misses;
+	frames = BKClamp (frames, AUDIO_BUFFER_MIN, AUDIO_BUFFER_MAX);
+
+	if (frames == audio -> bufferFrames) {
+		return 0;
+	}
+
+	return resize_audio_buffer (app, frames);
+}
+
+/**
+ * Get play time in frames
+ *
+ * The render context must be locked.
+ */
+static BKInt play_frames (struct bliplay const * app)
+{
+	return BKTimeGetTime (app -> ctx.renderContext -> currentTime) + BKTimeGetTime (app -> skipTime);
+}
+
+static void print_time (BKTKContext const * ctx, BKInt playFrames)
+{
+	int frames = playFrames * 100 / ctx -> renderContext -> sampleRate;
+	int frac   = frames % 100;
+	int hsecs  = frames / 100;
+
+	int secs = hsecs % 60;
+	int mins = hsecs / 60;
+
+	print_status ("\r%4d:%02d.%02d", mins, secs, frac);
+}
+
+BKInt runloop (struct bliplay * app)
+{
+	BKInt status = 0;
+	int c;
+	int res;
+	BKInt running;
+	BKInt playFrames;
+	int nfds = 0;
+	int flag = 1;
+	fd_set fds, fdsc;
+	struct timeval timeout;
+	BKTKContext * ctx = &app -> ctx;
+	struct audio * audio = &app -> audio;
+
+	FD_ZERO (&fds);
+
+	if (!(app -> flags & FLAG_FROM_STDIN)) {
+		if (app -> istty) {
+			FD_SET (STDIN_FILENO, &fds);
+			nfds = STDIN_FILENO + 1;
+		}
+
+		print_notice ("Press [q] to quit, [,] and [.] to seek\n");
+	}
+
+	set_noecho (1);
+
+#if BK_USE_THREADS
+	if (player_start (app) != 0) {
+		print_notice ("Could not start render thread; rendering in audio callback\n");
+	}
+#endif
+
+	SDL_PauseAudio (0);
+
+	do {
+		FD_COPY (&fds, &fdsc);
+		timeout.tv_sec  = 0;
+		timeout.tv_usec = audio -> updateUSecs;
+
+		res = select (nfds, &fdsc, NULL, NULL, &timeout);
+
+		if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			status = -1;
+			break;
+		}
+		else if (res > 0) {
+			c = getchar_nocanon (0);
+
+			switch (c) {
+				case 'q': {
+					flag = 0;
+					break;
+				}
+				case ',': {
+					scrub_context (app, -SCRUB_SECS);
+					break;
+				}
+				case '.': {
+					scrub_context (app, SCRUB_SECS);
+					break;
+				}
+				case 's': {
+					if (app -> flags & FLAG_STATS) {
+						printf ("\n");
+						print_stats (app);
+					}
+					break;
+				}
+			}
+		}
+
+		// audio device is closed on failure; tear down normally
+		if (app -> flags & FLAG_ADAPTIVE_BUFFER) {
+			if (adapt_buffer_size (app) != 0) {
+				status = -1;
+				break;
+			}
+		}
+
+		// the render thread or audio callback advances the context
+		lock_render (audio);
+		playFrames = play_frames (app);
+		running = check_tracks_running (ctx, app -> flags);
+
+#if BK_USE_THREADS
+		// the render thread also stops at the end time
+		if (audio -> player.running && atomic_load (&audio -> player.ended)) {
+			running = 0;
+		}
+#endif
+
+		unlock_render (audio);
+
+		if (!(app -> flags & FLAG_PRINT_NO_TIME)) {
+			print_time (ctx, playFrames);
+		}
+
+		if (!running) {
+			break;
+		}
+	}
+	while (flag);
+
+	set_noecho (0);
+
+	if (!(app -> flags & FLAG_PRINT_NO_TIME)) {
+		printf ("\n");
+	}
+
+#if BK_USE_THREADS
+	// play remaining frames if not quit
+	if (flag && status == 0) {
+		player_drain (&audio -> player);
+	}
+#endif
+
+	SDL_PauseAudio (1);
+
+#if BK_USE_THREADS
+	player_stop (&audio -> player);
+#endif
+
+	if (app -> flags & FLAG_STATS) {
+		print_stats (app);
+	}
+
+	if (audio -> hasKeyframes) {
+		BKDispose (&audio -> keyframes);
+		audio -> hasKeyframes = 0;
+	}
+
+	return status;
+}
+
+#else /* !BK_USE_SDL */
+
+BKInt runloop (struct bliplay * app)
+{
+	return write_output_paced (app) != 0 ? -1 : 0;
+}
+
+#endif /* BK_USE_SDL */
@@ -0,0 +1,381 @@
+/*
+ * Copyright (c) 2012-2016 Simon Schoenenberger
+ * http://blipkit.audio
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "bliplay.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if BK_USE_THREADS
+
+struct render_pool;
+
+struct render_shard
+{
+	BKTKContext          ctx;
+	BKContext            renderCtx;
+	BKInt                index;
+	BKInt                hasContext;
+	BKInt                error;
+	BKInt                numFrames;
+	BKInt                done;
+	BKFrame            * frames;
+	pthread_t            thread;
+	struct render_pool * pool;
+};
+
+struct render_pool
+{
+	pthread_mutex_t        mutex;
+	pthread_cond_t         startCond;
+	pthread_cond_t         doneCond;
+	BKInt                  round;
+	BKInt                  pending;
+	BKInt                  quit;
+	BKInt                  maxFrames;
+	struct render_shard  * shards;
+	struct bliplay const * app;
+};
+
+/**
+ * Convert `source` to wide samples
+ */
+static void widen_frames (int32_t mix [], BKFrame const source [], BKInt numSamples)
+{
+	for (BKInt i = 0; i < numSamples; i ++) {
+		mix [i] = source [i];
+	}
+}
+
+/**
+ * Add `source` to wide samples without clipping
+ */
+static void add_frames (int32_t mix [], BKFrame const source [], BKInt numSamples)
+{
+	BKInt i = 0;
+
+#ifdef __SSE2__
+	for (; i + 8 <= numSamples; i += 8) {
+		__m128i b = _mm_loadu_si128 ((__m128i const *) &source [i]);
+		// sign extend by shifting high half of interleaved words
+		__m128i lo = _mm_srai_epi32 (_mm_unpacklo_epi16 (b, b), 16);
+		__m128i hi = _mm_srai_epi32 (_mm_unpackhi_epi16 (b, b), 16);
+
+		_mm_storeu_si128 ((__m128i *) &mix [i], _mm_add_epi32 (_mm_loadu_si128 ((__m128i const *) &mix [i]), lo));
+		_mm_storeu_si128 ((__m128i *) &mix [i + 4], _mm_add_epi32 (_mm_loadu_si128 ((__m128i const *) &mix [i + 4]), hi));
+	}
+#endif
+
+	for (; i < numSamples; i ++) {
+		mix [i] += source [i];
+	}
+}
+
+/**
+ * Clip mixed wide samples to the frame range
+ */
+static void clip_frames (BKFrame frames [], int32_t const mix [], BKInt numSamples)
+{
+	BKInt i = 0;
+
+#ifdef __SSE2__
+	for (; i + 8 <= numSamples; i += 8) {
+		__m128i lo = _mm_loadu_si128 ((__m128i const *) &mix [i]);
+		__m128i hi = _mm_loadu_si128 ((__m128i const *) &mix [i + 4]);
+
+		_mm_storeu_si128 ((__m128i *) &frames [i], _mm_packs_epi32 (lo, hi));
+	}
+#endif
+
+	for (; i < numSamples; i ++) {
+		frames [i] = BKClamp (mix [i], INT16_MIN, INT16_MAX);
+	}
+}
+
+/**
+ * Load and seek a shard context in the shard's thread
+ */
+static BKInt render_shard_load (struct render_shard * shard)
+{
+	struct bliplay const * app = shard -> pool -> app;
+
+	if (load_source_context (app, &shard -> ctx, &shard -> renderCtx, shard -> index, app -> numJobs) != 0) {
+		return -1;
+	}
+
+	shard -> hasContext = 1;
+
+	if (app -> flags & FLAG_HAS_SEEK_TIME) {
+		seek_context (&shard -> ctx, app -> seekTime);
+	}
+
+	return 0;
+}
+
+static void render_shard_signal_done (struct render_pool * pool)
+{
+	pthread_mutex_lock (&pool -> mutex);
+
+	if (-- pool -> pending == 0) {
+		pthread_cond_signal (&pool -> doneCond);
+	}
+
+	pthread_mutex_unlock (&pool -> mutex);
+}
+
+static void * render_shard_run (void * info)
+{
+	struct render_shard * shard = info;
+	struct render_pool * pool = shard -> pool;
+	BKInt round = 0;
+	BKInt quit;
+
+	shard -> error = render_shard_load (shard);
+	render_shard_signal_done (pool);
+
+	if (shard -> error) {
+		return NULL;
+	}
+
+	for (;;) {
+		pthread_mutex_lock (&pool -> mutex);
+
+		while (pool -> round == round && !pool -> quit) {
+			pthread_cond_wait (&pool -> startCond, &pool -> mutex);
+		}
+
+		round = pool -> round;
+		quit = pool -> quit;
+
+		pthread_mutex_unlock (&pool -> mutex);
+
+		if (quit) {
+			break;
+		}
+
+		shard -> numFrames = render_frames (&shard -> ctx, shard -> frames, pool -> maxFrames, end_time (pool -> app), pool -> app -> flags, &shard -> done);
+		render_shard_signal_done (pool);
+	}
+
+	return NULL;
+}
+
+/**
+ * Render tracks distributed over `numJobs` contexts
+ *
+ * Each shard renders its own subset of tracks. Shard 0 is the main context
+ * and runs the interpreters of all tracks, so it decides when rendering ends.
+ * The other shards run in threads and are mixed into the main output after
+ * each round.
+ *
+ * BlipKit rounds and clips the output of each shard, so the mix differs from
+ * a single-threaded render by up to two units per shard, or more if a shard
+ * is clipped. Summing in wide samples avoids clipping the mix again.
+ */
+BKInt write_output_threaded (struct bliplay * app)
+{
+	BKInt res = 0;
+	BKInt done = 0;
+	BKInt numFrames;
+	BKInt numThreads = 0;
+	BKInt numJobs = app -> numJobs;
+	BKTKContext * ctx = &app -> ctx;
+	BKInt numChannels = ctx -> renderContext -> numChannels;
+	BKInt maxFrames = RENDER_CHUNK_FRAMES * RENDER_POOL_CHUNKS;
+	BKSize framesSize = maxFrames * numChannels * sizeof (BKFrame);
+	struct render_pool pool;
+	struct render_shard * shards;
+	BKFrame * frames;
+	int32_t * mix;
+
+	memset (&pool, 0, sizeof (pool));
+	pool.maxFrames = maxFrames;
+	pool.app = app;
+
+	shards = calloc (numJobs, sizeof (*shards));
+	frames = malloc (framesSize);
+	mix = malloc (maxFrames * numChannels * sizeof (*mix));
+
+	if (shards == NULL || frames == NULL || mix == NULL) {
+		free (shards);
+		free (frames);
+		free (mix);
+		return -1;
+	}
+
+	pool.shards = shards;
+	pthread_mutex_init (&pool.mutex, NULL);
+	pthread_cond_init (&pool.startCond, NULL);
+	pthread_cond_init (&pool.doneCond, NULL);
+
+	pthread_mutex_lock (&pool.mutex);
+
+	for (BKInt i = 1; i < numJobs; i ++) {
+		struct render_shard * shard = &shards [i];
+
+		shard -> index = i;
+		shard -> pool = &pool;
+		shard -> frames = malloc (framesSize);
+
+		if (shard -> frames == NULL) {
+			res = -1;
+			break;
+		}
+
+		if (pthread_create (&shard -> thread, NULL, render_shard_run, shard) != 0) {
+			print_error ("Could not create render thread\n");
+			res = -1;
+			break;
+		}
+
+		numThreads ++;
+		pool.pending ++;
+	}
+
+	// wait for shards to be loaded
+	while (pool.pending) {
+		pthread_cond_wait (&pool.doneCond, &pool.mutex);
+	}
+
+	pthread_mutex_unlock (&pool.mutex);
+
+	for (BKInt i = 1; i <= numThreads; i ++) {
+		if (shards [i].error) {
+			res = -1;
+		}
+	}
+
+	while (res == 0 && !done) {
+		pthread_mutex_lock (&pool.mutex);
+		pool.pending = numThreads;
+		pool.round ++;
+		pthread_cond_broadcast (&pool.startCond);
+		pthread_mutex_unlock (&pool.mutex);
+
+		numFrames = render_frames (ctx, frames, maxFrames, end_time (app), app -> flags, &done);
+
+		pthread_mutex_lock (&pool.mutex);
+
+		while (pool.pending) {
+			pthread_cond_wait (&pool.doneCond, &pool.mutex);
+		}
+
+		pthread_mutex_unlock (&pool.mutex);
+
+		// the other shards don't run all interpreters and don't stop by
+		// themselves; only the frames of the main context are used
+		if (numThreads) {
+			widen_frames (mix, frames, numFrames * numChannels);
+
+			for (BKInt i = 1; i <= numThreads; i ++) {
+				add_frames (mix, shards [i].frames, BKMin (numFrames, shards [i].numFrames) * numChannels);
+			}
+
+			clip_frames (frames, mix, numFrames * numChannels);
+		}
+
+		if (numFrames) {
+			write_frames (&app -> output, frames, numFrames * numChannels);
+		}
+	}
+
+	pthread_mutex_lock (&pool.mutex);
+	pool.quit = 1;
+	pthread_cond_broadcast (&pool.startCond);
+	pthread_mutex_unlock (&pool.mutex);
+
+	for (BKInt i = 1; i <= numThreads; i ++) {
+		pthread_join (shards [i].thread, NULL);
+	}
+
+	for (BKInt i = 1; i < numJobs; i ++) {
+		if (shards [i].hasContext) {
+			BKDispose (&shards [i].ctx);
+			BKDispose (&shards [i].renderCtx);
+		}
+
+		free (shards [i].frames);
+	}
+
+	pthread_cond_destroy (&pool.doneCond);
+	pthread_cond_destroy (&pool.startCond);
+	pthread_mutex_destroy (&pool.mutex);
+
+	free (shards);
+	free (frames);
+	free (mix);
+
+	return res;
+}
+
+#endif /* BK_USE_THREADS */
+
+/**
+ * Distribute tracks of the main context over `numJobs` shards
+ *
+ * The input is only parsed once. The main context keeps shard 0 and the
+ * other shards load its compiled program when rendering begins. The shards
+ * render disjoint sets of tracks.
+ */
+BKInt prepare_shards (struct bliplay * app, FILE * inputFile, BKString const * path, BKString const * loadPath)
+{
+#if BK_USE_THREADS
+	BKInt numTracks;
+	BKTKContext * ctx = &app -> ctx;
+
+	if ((app -> flags & FLAG_NO_SOUND) == 0 || (app -> flags & FLAG_INFO_EXPLICITE)) {
+		app -> numJobs = 1;
+		return 0;
+	}
+
+	if (inputFile == stdin) {
+		print_notice ("Cannot render with multiple jobs when reading from stdin\n");
+		app -> numJobs = 1;
+		return 0;
+	}
+
+	numTracks = count_slots (&ctx -> tracks);
+	app -> numJobs = BKClamp (app -> numJobs, 1, BKMax (numTracks, 1));
+
+	if (app -> numJobs <= 1) {
+		return 0;
+	}
+
+	if (share_source (app, path, loadPath) != 0) {
+		return -1;
+	}
+
+	BKTKContextDetach (ctx);
+
+	if (BKTKContextAttachShard (ctx, &app -> renderCtx, 0, app -> numJobs) != 0) {
+		print_error ("Failed to attach context\n");
+		return -1;
+	}
+#else
+	print_notice ("Multiple jobs are not supported in this build\n");
+	app -> numJobs = 1;
+#endif
+
+	return 0;
+}
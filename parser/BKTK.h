@@ -31,9 +31,11 @@ extern "C" {
 #include "BKTKBase.h"
 #include "BKTKCompiler.h"
 #include "BKTKContext.h"
+#include "BKTKDocument.h"
 #include "BKTKInterpreter.h"
 #include "BKTKParser.h"
 #include "BKTKTokenizer.h"
+#include "BKTKTree.h"
 #include "BKTKWriter.h"
 
 #ifdef __cplusplus
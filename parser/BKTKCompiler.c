@@ -26,47 +26,38 @@
 #include "BKTKCompiler.h"
 #include "BKTKTokenizer.h"
 #include "BKTKContext.h"
+#include "BKTKCompilerNames.h"
 
 #define MAX_TRACKS     256
 #define MAX_GROUPS     256
 #define MAX_SEQ_LENGTH 256
 #define OCTAVE_SIZE_MIN 3
 #define OCTAVE_SIZE_MAX 100
+#define MAX_MERGED_STEPS (1 << 16)
+#define MAX_CALL_OFFSET (1 << 25)
+#define INLINE_MAX_SIZE 16    // maximum words of groups called more than once
+#define INLINE_MAX_GROWTH 100 // maximum code growth in percent
+#define MAX_ENCODED_SIZE (1 + (6 + BK_MAX_ARPEGGIO) * BK_INTR_MAX_VARINT_SIZE)
 
 #define VOLUME_UNIT (BK_MAX_VOLUME / 255)
 
-enum BKCompilerEnvelopeType
-{
-	BKTKEnvelopeTypeVolumeSeq,
-	BKTKEnvelopeTypePitchSeq,
-	BKTKEnvelopeTypePanningSeq,
-	BKTKEnvelopeTypeDutyCycleSeq,
-	BKTKEnvelopeTypeADSR,
-	BKTKEnvelopeTypeVolumeEnv,
-	BKTKEnvelopeTypePitchEnv,
-	BKTKEnvelopeTypePanningEnv,
-	BKTKEnvelopeTypeDutyCycleEnv,
-};
-
-enum BKCompilerMiscCmds
+/**
+ * Lookup tables of node names
+ */
+enum BKTKSymbolTable
 {
-	BKTKMiscLoad,
-	BKTKMiscData,
-	BKTKMiscPitch,
-	BKTKMiscSampleRange,
-	BKTKMiscSampleRepeat,
-	BKTKMiscSampleSustainRange,
-	BKTKMiscSequence,
+	BKTKSymbolTableCmd,
+	BKTKSymbolTableEnvelope,
+	BKTKSymbolTableMisc,
+	BKTKSymbolTableCount,
 };
 
 /**
- * Used for lookup tables to assign a string to a value
+ * Entries of a tree symbol in each lookup table or NULL
  */
-struct keyval
+struct symbol
 {
-	char const * name;
-	BKInt value;
-	BKInt flags;
+	struct keyval const * items [BKTKSymbolTableCount];
 };
 
 /**
@@ -81,162 +72,9 @@ struct noteidx
 
 extern BKClass const BKTKCompilerClass;
 
-/**
- * Note lookup table
- */
-static struct keyval const noteNames [] =
-{
-	{"a",  9},
-	{"a#", 10},
-	{"b",  11},
-	{"c",  0},
-	{"c#", 1},
-	{"d",  2},
-	{"d#", 3},
-	{"e",  4},
-	{"f",  5},
-	{"f#", 6},
-	{"g",  7},
-	{"g#", 8},
-	{"h",  11},
-};
-
-/**
- * Command lookup table
- */
-static struct keyval const cmdNames [] =
-{
-	{"a",           BKIntrAttack},
-	{"as",          BKIntrArpeggioSpeed},
-	{"at",          BKIntrAttackTicks},
-	{"d",           BKIntrSample},
-	{"dc",          BKIntrDutyCycle},
-	{"dn",          BKIntrSampleRange},
-	{"dr",          BKIntrSampleRepeat},
-	{"ds",          BKIntrSampleSustainRange},
-	{"e",           BKIntrEffect},
-	{"g",           BKIntrGroupJump},
-	{"grp",         BKIntrGroupDef, BKTKParserFlagIsGroup},
-	{"i",           BKIntrInstrument},
-	{"instr",       BKIntrInstrumentDef, BKTKParserFlagIsGroup},
-	{"m",           BKIntrMute},
-	{"mt",          BKIntrMuteTicks},
-	{"octave",      BKIntrOctaveDef},
-	{"p",           BKIntrPanning},
-	{"pk",          BKIntrPulseKernel},
-	{"pt",          BKIntrPitch},
-	{"pulsekernel", BKIntrPulseKernel},
-	{"pw",          BKIntrPhaseWrap},
-	{"r",           BKIntrRelease},
-	{"rt",          BKIntrReleaseTicks},
-	{"s",           BKIntrStep},
-	{"samp",        BKIntrSampleDef, BKTKParserFlagIsGroup},
-	{"sample",      BKIntrSampleDef, BKTKParserFlagIsGroup},
-	{"st",          BKIntrStepTicks},
-	{"stepticks",   BKIntrStepTicks},
-	{"stt",         BKIntrStepTicksTrack},
-	{"t",           BKIntrTicks},
-	{"tickrate",    BKIntrTickRate},
-	{"tr",          BKIntrTickRate},
-	{"track",       BKIntrTrackDef, BKTKParserFlagIsGroup},
-	{"tstepticks",  BKIntrStepTicksTrack},
-	{"v",           BKIntrVolume},
-	{"vm",          BKIntrMasterVolume},
-	{"w",           BKIntrWaveform},
-	{"wave",        BKIntrWaveformDef, BKTKParserFlagIsGroup},
-	{"x",           BKIntrRepeat},
-	{"xb",          BKIntrRepeatStart},
-	{"z",           BKIntrEnd},
-};
-
-/**
- * Effect lookup table
- */
-static struct keyval const effectNames [] =
-{
-	{"pr", BK_EFFECT_PORTAMENTO},
-	{"ps", BK_EFFECT_PANNING_SLIDE},
-	{"tr", BK_EFFECT_TREMOLO},
-	{"vb", BK_EFFECT_VIBRATO},
-	{"vs", BK_EFFECT_VOLUME_SLIDE},
-};
-
-/**
- * Waveform lookup table
- */
-static struct keyval const waveformNames [] =
-{
-	{"noi",      BK_NOISE},
-	{"noise",    BK_NOISE},
-	{"sample",   BK_SAMPLE},
-	{"saw",      BK_SAWTOOTH},
-	{"sawtooth", BK_SAWTOOTH},
-	{"sin",      BK_SINE},
-	{"sine",     BK_SINE},
-	{"smp",      BK_SAMPLE},
-	{"sqr",      BK_SQUARE},
-	{"square",   BK_SQUARE},
-	{"tri",      BK_TRIANGLE},
-	{"triangle", BK_TRIANGLE},
-};
-
-/**
- * Envelope lookup table
- */
-static struct keyval const envelopeNames [] =
-{
-	{"a",    BKTKEnvelopeTypePitchSeq},
-	{"adsr", BKTKEnvelopeTypeADSR},
-	{"anv",  BKTKEnvelopeTypePitchEnv},
-	{"dc",   BKTKEnvelopeTypeDutyCycleSeq},
-	{"dcnv", BKTKEnvelopeTypeDutyCycleEnv},
-	{"p",    BKTKEnvelopeTypePanningSeq},
-	{"pnv",  BKTKEnvelopeTypePanningEnv},
-	{"v",    BKTKEnvelopeTypeVolumeSeq},
-	{"vnv",  BKTKEnvelopeTypeVolumeEnv},
-};
-
-/**
- * Miscellaneous lookup table
- */
-static struct keyval const miscNames [] =
-{
-	{"data", BKTKMiscData},
-	{"dn",   BKTKMiscSampleRange},
-	{"dr",   BKTKMiscSampleRepeat},
-	{"ds",   BKTKMiscSampleSustainRange},
-	{"load", BKTKMiscLoad},
-	{"pt",   BKTKMiscPitch},
-	{"s",    BKTKMiscSequence},
-};
-
-/**
- * Repeat modes lookup table
- */
-static struct keyval const repeatNames [] =
-{
-	{"no",  BK_NO_REPEAT},
-	{"pal", BK_PALINDROME},
-	{"rep", BK_REPEAT},
-};
-
-/**
- * Pulse kernels
- */
-static struct keyval const pulseNames [] =
-{
-	{"harm", BK_PULSE_KERNEL_HARM},
-	{"sinc", BK_PULSE_KERNEL_SINC},
-};
+#include "BKTKCompilerNameTables.h"
 
-#define NUM_WAVEFORM_NAMES (sizeof (waveformNames) / sizeof (struct keyval))
-#define NUM_CMD_NAMES (sizeof (cmdNames) / sizeof (struct keyval))
-#define NUM_EFFECT_NAMES (sizeof (effectNames) / sizeof (struct keyval))
 #define NUM_NOTE_NAMES (sizeof (noteNames) / sizeof (struct keyval))
-#define NUM_ENVELOPE_NAMES (sizeof (envelopeNames) / sizeof (struct keyval))
-#define NUM_MISC_NAMES (sizeof (miscNames) / sizeof (struct keyval))
-#define NUM_REPEAT_NAMES (sizeof (repeatNames) / sizeof (struct keyval))
-#define NUM_PULSE_NAMES (sizeof (pulseNames) / sizeof (struct keyval))
 
 /**
  * Convert string to signed integer like `atoi`
@@ -252,32 +90,77 @@ static int strtolx (uint8_t const * str, int alt)
 }
 
 /**
- * Compare name of command with string
+ * Compare name with note index item,
  * Used as callback for `bsearch`
  */
-static int keyvalcmp (BKString const * name, struct keyval const * item)
+static int noteidxcmp (BKString const * name, struct noteidx const * item)
 {
 	return strcmp ((void *) name -> str, item -> name);
 }
 
 /**
- * Compare name with note index item,
- * Used as callback for `bsearch`
+ * Find item with `name` in hash table
+ *
+ * Returns NULL if name is not contained in table
  */
-static int noteidxcmp (BKString const * name, struct noteidx const * item)
+static struct keyval const * keyvalFind (struct keyhash const * table, BKString const * name)
 {
-	return strcmp ((void *) name -> str, item -> name);
+	if (name == NULL) {
+		return NULL;
+	}
+
+	return BKTKNameFind (table, (char const *) name -> str);
 }
 
-static BKInt keyvalLookup (struct keyval const table [], BKSize size, BKString const * name, BKInt * outValue, BKUInt * outFlags)
+static BKInt keyvalLookup (struct keyhash const * table, BKString const * name, BKInt * outValue, BKUInt * outFlags)
 {
-	struct keyval * item;
+	struct keyval const * item = keyvalFind (table, name);
 
-	if (name == NULL) {
+	if (item == NULL) {
 		return 0;
 	}
 
-	item = bsearch (name, table, size, sizeof (struct keyval), (void *) keyvalcmp);
+	*outValue = item -> value;
+
+	if (outFlags) {
+		*outFlags = item -> flags;
+	}
+
+	return 1;
+}
+
+/**
+ * Lookup all symbols of tree once
+ */
+static BKInt symbolsResolve (BKArray * symbols, BKTKTree const * tree)
+{
+	BKInt res;
+
+	if ((res = BKArrayResize (symbols, tree -> numSymbols)) != 0) {
+		return res;
+	}
+
+	for (BKUSize i = 0; i < tree -> numSymbols; i ++) {
+		struct symbol * symbol = BKArrayItemAt (symbols, i);
+		BKString const * name = tree -> symbols [i];
+
+		symbol -> items [BKTKSymbolTableCmd] = keyvalFind (&cmdNamesHash, name);
+		symbol -> items [BKTKSymbolTableEnvelope] = keyvalFind (&envelopeNamesHash, name);
+		symbol -> items [BKTKSymbolTableMisc] = keyvalFind (&miscNamesHash, name);
+	}
+
+	return 0;
+}
+
+/**
+ * Get value of node name from resolved symbol
+ *
+ * Returns 0 if name is not contained in `table`
+ */
+static BKInt nodeLookup (BKTKCompiler const * compiler, BKTKTreeNode const * node, enum BKTKSymbolTable table, BKInt * outValue, BKUInt * outFlags)
+{
+	struct symbol const * symbol = BKArrayItemAt (&compiler -> symbols, node -> symbol);
+	struct keyval const * item = symbol -> items [table];
 
 	if (item == NULL) {
 		return 0;
@@ -346,16 +229,16 @@ BK_INLINE BKInstrMask BKReadIntrMask (void ** opcode)
 /**
  * TODO: should this be an error?
  */
-static void printErrorUnexpectedCommand (BKTKCompiler * compiler, BKTKParserNode const * node)
+static void printErrorUnexpectedCommand (BKTKCompiler * compiler, BKTKTreeNode const * node)
 {
 	char const * type = (node -> flags & BKTKParserFlagIsGroup) ? "group" : "command";
 
 	BKStringAppendFormat (&compiler -> error, "Warning: unexpected %s '%s' on line %u:%u\n",
-		type, BKTKCompilerEscapeString (compiler, &node -> name),
+		type, BKTKCompilerEscapeString (compiler, node -> name),
 		node -> offset.lineno, node -> offset.colno);
 }
 
-static void printError (BKTKCompiler * compiler, BKTKParserNode const * node, char const * format, ...)
+static void printError (BKTKCompiler * compiler, BKTKTreeNode const * node, char const * format, ...)
 {
 	va_list args;
 
@@ -395,16 +278,26 @@ static BKInt parseNote (BKTKCompiler const* compiler, BKString const * string, B
 		return -1;
 	}
 
-	struct noteidx const* note = BKArraySearch (&compiler -> notesTable, &noteName, (int (*)(const void *, const void *)) noteidxcmp);
+	// default notes have no pitch
+	if (!compiler -> notesDefined) {
+		if (!keyvalLookup (&noteNamesHash, &noteName, &value, NULL)) {
+			return -1;
+		}
+	}
+	else {
+		struct noteidx const* note = BKArraySearch (&compiler -> notesTable, &noteName, (int (*)(const void *, const void *)) noteidxcmp);
+
+		if (!note) {
+			return -1;
+		}
 
-	if (!note) {
-		return -1;
+		value = note -> idx;
+		pitch += note -> pitch;
 	}
 
-	value = note -> idx;
 	value += octave * compiler -> octaveSize;
 	*outNote = BKClamp (value, BK_MIN_NOTE, BK_MAX_NOTE);
-	*outPitch = pitch + note -> pitch;
+	*outPitch = pitch;
 
 	return 0;
 }
@@ -485,7 +378,7 @@ static BKInt parseDataParams (BKString const * arg)
  *
  * Returns empty string if no argument exists at given offset
  */
-static BKString const * nodeArgString (BKTKParserNode const * node, BKUSize offset)
+static BKString const * nodeArgString (BKTKTreeNode const * node, BKUSize offset)
 {
 	// BK_STRING_INIT not working with 'static' in GCC
 	static BKString empty = {(uint8_t *) "", 0, 0};
@@ -494,7 +387,7 @@ static BKString const * nodeArgString (BKTKParserNode const * node, BKUSize offs
 		return &empty;
 	}
 
-	return &node -> argStrings [offset];
+	return &node -> name [offset + 1];
 }
 
 BK_INLINE BKInt value2Volume (BKInt value)
@@ -512,7 +405,7 @@ BK_INLINE BKInt value2Pitch (BKInt value)
  *
  * Returns `alt` if no argument exists at given offset
  */
-static BKInt nodeArgInt (BKTKParserNode const * node, BKUSize offset, BKInt alt)
+static BKInt nodeArgInt (BKTKTreeNode const * node, BKUSize offset, BKInt alt)
 {
 	return strtolx ((uint8_t *) nodeArgString (node, offset) -> str, alt);
 }
@@ -636,6 +529,8 @@ BKInt BKTKCompilerInit (BKTKCompiler * compiler)
 	compiler -> auxString   = BK_STRING_INIT;
 	compiler -> error       = BK_STRING_INIT;
 	compiler -> notesTable  = BK_ARRAY_INIT (sizeof (struct noteidx));
+	compiler -> symbols     = BK_ARRAY_INIT (sizeof (struct symbol));
+	compiler -> program     = BK_BYTE_BUFFER_INIT;
 
 	if ((res = BKTKCompilerReset (compiler)) != 0) {
 		return res;
@@ -644,7 +539,7 @@ BKInt BKTKCompilerInit (BKTKCompiler * compiler)
 	return 0;
 }
 
-static BKInt BKTKCompilerCompileCommand (BKTKCompiler * compiler, BKTKParserNode const * node, BKByteBuffer * byteCode, BKInt cmd, BKInt level)
+static BKInt BKTKCompilerCompileCommand (BKTKCompiler * compiler, BKTKTreeNode const * node, BKByteBuffer * byteCode, BKInt cmd, BKInt level)
 {
 	BKInt arg;
 	BKInt args [8];
@@ -746,7 +641,7 @@ static BKInt BKTKCompilerCompileCommand (BKTKCompiler * compiler, BKTKParserNode
 		case BKIntrSampleRepeat: {
 			name = nodeArgString (node, 0);
 
-			if (!keyvalLookup (repeatNames, NUM_REPEAT_NAMES, name, &arg, NULL)) {
+			if (!keyvalLookup (&repeatNamesHash, name, &arg, NULL)) {
 				printError (compiler, node, "Error: expected repeat mode: 'no', 'rep', 'pal'");
 				goto error;
 			}
@@ -757,7 +652,7 @@ static BKInt BKTKCompilerCompileCommand (BKTKCompiler * compiler, BKTKParserNode
 		case BKIntrEffect: {
 			name = nodeArgString (node, 0);
 
-			if (!keyvalLookup (effectNames, NUM_EFFECT_NAMES, name, &args [0], NULL)) {
+			if (!keyvalLookup (&effectNamesHash, name, &args [0], NULL)) {
 				printError (compiler, node, "Error: expected effect name: 'pr', 'ps', 'tr', 'vb', 'vs'");
 				goto error;
 			}
@@ -816,7 +711,7 @@ static BKInt BKTKCompilerCompileCommand (BKTKCompiler * compiler, BKTKParserNode
 		case BKIntrPulseKernel: {
 			name = nodeArgString (node, 0);
 
-			if (!keyvalLookup (pulseNames, NUM_PULSE_NAMES, name, &args [0], NULL)) {
+			if (!keyvalLookup (&pulseNamesHash, name, &args [0], NULL)) {
 				printError (compiler, node, "Error: expected pulse kernel name: 'harm', 'sinc'");
 				goto error;
 			}
@@ -899,7 +794,7 @@ static BKInt BKTKCompilerCompileCommand (BKTKCompiler * compiler, BKTKParserNode
 			name = nodeArgString (node, 0);
 
 			if (!BKHashTableLookup (&compiler -> waveforms, (char *) name -> str, (void **) &waveform)) {
-				keyvalLookup (waveformNames, NUM_WAVEFORM_NAMES, name, &value, NULL);
+				keyvalLookup (&waveformNamesHash, name, &value, NULL);
 			}
 
 			if (waveform) {
@@ -958,6 +853,7 @@ static BKInt BKTKCompilerCompileCommand (BKTKCompiler * compiler, BKTKParserNode
 
 			BKArraySort (&compiler -> notesTable, (int (*)(const void *, const void *)) sortNoteIdx);
 			compiler -> octaveSize = node -> argCount;
+			compiler -> notesDefined = 1;
 			break;
 		}
 		default: {
@@ -978,7 +874,7 @@ static BKInt BKTKCompilerCompileCommand (BKTKCompiler * compiler, BKTKParserNode
 	}
 }
 
-static BKInt BKTKCompilerParseSequence (BKTKParserNode const * node, BKInt sequence [], BKInt * outLength, BKInt * outRepeatBegin, BKInt * outRepeatLength, BKInt multiplier, BKInt divider)
+static BKInt BKTKCompilerParseSequence (BKTKTreeNode const * node, BKInt sequence [], BKInt * outLength, BKInt * outRepeatBegin, BKInt * outRepeatLength, BKInt multiplier, BKInt divider)
 {
 	BKInt value;
 	BKInt length = 0;
@@ -1020,7 +916,7 @@ static BKInt BKTKCompilerParseSequence (BKTKParserNode const * node, BKInt seque
 	return 0;
 }
 
-static BKInt BKTKCompilerParseEnvelope (BKTKParserNode const * node, BKSequencePhase phases [], BKInt * outLength, BKInt * outRepeatBegin, BKInt * outRepeatLength, BKInt multiplier, BKInt divider)
+static BKInt BKTKCompilerParseEnvelope (BKTKTreeNode const * node, BKSequencePhase phases [], BKInt * outLength, BKInt * outRepeatBegin, BKInt * outRepeatLength, BKInt multiplier, BKInt divider)
 {
 	BKInt value;
 	BKInt length = 0;
@@ -1070,11 +966,11 @@ static BKInt BKTKCompilerParseEnvelope (BKTKParserNode const * node, BKSequenceP
 	return 0;
 }
 
-static BKInt BKTKCompilerCompileInstrument (BKTKCompiler * compiler, BKTKParserNode const * tree)
+static BKInt BKTKCompilerCompileInstrument (BKTKCompiler * compiler, BKTKTreeNode const * tree)
 {
 	BKInt res = 0;
 	BKUInt flags;
-	BKTKParserNode const * node;
+	BKTKTreeNode const * node;
 	BKTKInstrument ** instrument;
 	BKString const * name;
 	BKString auxString = BK_STRING_INIT;
@@ -1124,7 +1020,7 @@ static BKInt BKTKCompilerCompileInstrument (BKTKCompiler * compiler, BKTKParserN
 	(*instrument) -> object.offset = tree -> offset;
 	BKStringAppendString (&(*instrument) -> name, &auxString);
 
-	for (node = tree -> subNode; node; node = node -> nextNode) {
+	for (node = BKTKTreeNodeSub (tree); node; node = BKTKTreeNodeNext (node)) {
 		if (node -> type == BKTKTypeComment) {
 			continue;
 		}
@@ -1134,7 +1030,7 @@ static BKInt BKTKCompilerCompileInstrument (BKTKCompiler * compiler, BKTKParserN
 			continue;
 		}
 
-		if (!keyvalLookup (envelopeNames, NUM_ENVELOPE_NAMES, &node -> name, &seqType, &flags)) {
+		if (!nodeLookup (compiler, node, BKTKSymbolTableEnvelope, &seqType, &flags)) {
 			printErrorUnexpectedCommand (compiler, node);
 			continue;
 		}
@@ -1157,7 +1053,7 @@ static BKInt BKTKCompilerCompileInstrument (BKTKCompiler * compiler, BKTKParserN
 				adsr [2] = nodeArgInt (node, 2, 0) * VOLUME_UNIT;
 				adsr [3] = nodeArgInt (node, 3, 0);
 
-				res = BKInstrumentSetEnvelopeADSR (&(*instrument) -> instr, adsr [0], adsr [1], adsr [2], adsr [3]);
+				res = BKTKInstrumentSetEnvelopeADSR (*instrument, adsr [0], adsr [1], adsr [2], adsr [3]);
 				break;
 			}
 			case BKTKEnvelopeTypePitchEnv: {
@@ -1207,21 +1103,21 @@ static BKInt BKTKCompilerCompileInstrument (BKTKCompiler * compiler, BKTKParserN
 
 		if (res < 0) {
 			printError (compiler, node, "Error: invalid sequence '%s' (%s)",
-				BKTKCompilerEscapeString (compiler, &node -> name), BKStatusGetName (res));
+				BKTKCompilerEscapeString (compiler, node -> name), BKStatusGetName (res));
 		}
 
 		if (type >= 0) {
 			if (isEnv) {
-				res = BKInstrumentSetEnvelope (&(*instrument) -> instr, type, sequence, length, repeatBegin, repeatLength);
+				res = BKTKInstrumentSetEnvelope (*instrument, type, sequence, length, repeatBegin, repeatLength);
 			}
 			else {
-				res = BKInstrumentSetSequence (&(*instrument) -> instr, type, (BKInt *) sequence, length, repeatBegin, repeatLength);
+				res = BKTKInstrumentSetSequence (*instrument, type, (BKInt *) sequence, length, repeatBegin, repeatLength);
 			}
 		}
 
 		if (res < 0) {
 			printError (compiler, node, "Error: malformed sequence '%s'; possibly invalid sustain range (%s)",
-				BKTKCompilerEscapeString (compiler, &node -> name), BKStatusGetName (res));
+				BKTKCompilerEscapeString (compiler, node -> name), BKStatusGetName (res));
 
 		}
 	}
@@ -1233,12 +1129,12 @@ static BKInt BKTKCompilerCompileInstrument (BKTKCompiler * compiler, BKTKParserN
 	}
 }
 
-static BKInt BKTKCompilerCompileWaveform (BKTKCompiler * compiler, BKTKParserNode const * tree)
+static BKInt BKTKCompilerCompileWaveform (BKTKCompiler * compiler, BKTKTreeNode const * tree)
 {
 	BKInt res = 0;
 	BKInt value;
 	BKUInt flags;
-	BKTKParserNode const * node;
+	BKTKTreeNode const * node;
 	BKTKWaveform ** waveform;
 	BKString const * name;
 	BKString auxString = BK_STRING_INIT;
@@ -1254,7 +1150,7 @@ static BKInt BKTKCompilerCompileWaveform (BKTKCompiler * compiler, BKTKParserNod
 		autoindex = 1;
 	}
 
-	if (keyvalLookup (waveformNames, NUM_WAVEFORM_NAMES, name, &value, NULL)) {
+	if (keyvalLookup (&waveformNamesHash, name, &value, NULL)) {
 		printError (compiler, tree, "Error: waveform '%s' overwrites default waveform",
 			BKTKCompilerEscapeString (compiler, name));
 		res = -1;
@@ -1292,7 +1188,7 @@ static BKInt BKTKCompilerCompileWaveform (BKTKCompiler * compiler, BKTKParserNod
 	(*waveform) -> object.offset = tree -> offset;
 	BKStringAppendString (&(*waveform) -> name, &auxString);
 
-	for (node = tree -> subNode; node; node = node -> nextNode) {
+	for (node = BKTKTreeNodeSub (tree); node; node = BKTKTreeNodeNext (node)) {
 		BKInt arg;
 		BKInt length = 0;
 		BKFrame sequence [MAX_SEQ_LENGTH];
@@ -1301,7 +1197,7 @@ static BKInt BKTKCompilerCompileWaveform (BKTKCompiler * compiler, BKTKParserNod
 			continue;
 		}
 
-		if (!keyvalLookup (miscNames, NUM_MISC_NAMES, &node -> name, &value, &flags)) {
+		if (!nodeLookup (compiler, node, BKTKSymbolTableMisc, &value, &flags)) {
 			printErrorUnexpectedCommand (compiler, node);
 			continue;
 		}
@@ -1346,12 +1242,12 @@ static BKInt BKTKCompilerCompileWaveform (BKTKCompiler * compiler, BKTKParserNod
 	}
 }
 
-static BKInt BKTKCompilerCompileSample (BKTKCompiler * compiler, BKTKParserNode const * tree)
+static BKInt BKTKCompilerCompileSample (BKTKCompiler * compiler, BKTKTreeNode const * tree)
 {
 	BKInt res = 0;
 	BKInt value;
 	BKUInt flags;
-	BKTKParserNode const * node;
+	BKTKTreeNode const * node;
 	BKTKSample ** sample;
 	BKString const * name;
 	BKString auxString = BK_STRING_INIT;
@@ -1398,7 +1294,7 @@ static BKInt BKTKCompilerCompileSample (BKTKCompiler * compiler, BKTKParserNode
 	(*sample) -> path = BK_STRING_INIT;
 	BKStringAppendString (&(*sample) -> name, &auxString);
 
-	for (node = tree -> subNode; node; node = node -> nextNode) {
+	for (node = BKTKTreeNodeSub (tree); node; node = BKTKTreeNodeNext (node)) {
 		BKInt arg1, arg2;
 		BKString const * str;
 		BKString const * data;
@@ -1407,7 +1303,7 @@ static BKInt BKTKCompilerCompileSample (BKTKCompiler * compiler, BKTKParserNode
 			continue;
 		}
 
-		if (!keyvalLookup (miscNames, NUM_MISC_NAMES, &node -> name, &value, &flags)) {
+		if (!nodeLookup (compiler, node, BKTKSymbolTableMisc, &value, &flags)) {
 			printErrorUnexpectedCommand (compiler, node);
 			continue;
 		}
@@ -1464,7 +1360,7 @@ static BKInt BKTKCompilerCompileSample (BKTKCompiler * compiler, BKTKParserNode
 			case BKTKMiscSampleRepeat: {
 				name = nodeArgString (node, 0);
 
-				if (!keyvalLookup (repeatNames, NUM_REPEAT_NAMES, name, &arg1, NULL)) {
+				if (!keyvalLookup (&repeatNamesHash, name, &arg1, NULL)) {
 					printError (compiler, node, "Error: expected repeat mode: 'no', 'rep', 'pal'");
 					res = -1;
 					goto cleanup;
@@ -1494,12 +1390,12 @@ static BKInt BKTKCompilerCompileSample (BKTKCompiler * compiler, BKTKParserNode
 	}
 }
 
-static BKInt BKTKCompilerCompileGroup (BKTKCompiler * compiler, BKTKParserNode const * tree, BKTKTrack * track, BKInt level)
+static BKInt BKTKCompilerCompileGroup (BKTKCompiler * compiler, BKTKTreeNode const * tree, BKTKTrack * track, BKInt level)
 {
 	BKInt res;
 	BKInt value;
 	BKUInt flags;
-	BKTKParserNode const * node;
+	BKTKTreeNode const * node;
 	BKTKGroup * group;
 	BKInt offset;
 	uint32_t cmd;
@@ -1542,12 +1438,12 @@ static BKInt BKTKCompilerCompileGroup (BKTKCompiler * compiler, BKTKParserNode c
 	group -> object.index  = offset;
 	group -> object.offset = tree -> offset;
 
-	for (node = tree -> subNode; node; node = node -> nextNode) {
+	for (node = BKTKTreeNodeSub (tree); node; node = BKTKTreeNodeNext (node)) {
 		if (node -> type == BKTKTypeComment) {
 			continue;
 		}
 
-		if (!keyvalLookup (cmdNames, NUM_CMD_NAMES, &node -> name, &value, &flags)) {
+		if (!nodeLookup (compiler, node, BKTKSymbolTableCmd, &value, &flags)) {
 			printErrorUnexpectedCommand (compiler, node);
 			continue;
 		}
@@ -1572,12 +1468,12 @@ static BKInt BKTKCompilerCompileGroup (BKTKCompiler * compiler, BKTKParserNode c
 	return 0;
 }
 
-static BKInt BKTKCompilerCompileTrack (BKTKCompiler * compiler, BKTKParserNode const * tree, BKInt level)
+static BKInt BKTKCompilerCompileTrack (BKTKCompiler * compiler, BKTKTreeNode const * tree, BKInt level)
 {
 	BKInt res;
 	BKInt value = -1;
 	BKUInt flags;
-	BKTKParserNode const * node;
+	BKTKTreeNode const * node;
 	BKTKTrack * track;
 	BKString const * wavename;
 	BKInt offset;
@@ -1589,7 +1485,7 @@ static BKInt BKTKCompilerCompileTrack (BKTKCompiler * compiler, BKTKParserNode c
 	wavename = nodeArgString (tree, 0);
 
 	if (!BKHashTableLookup (&compiler -> waveforms, (char *) wavename -> str, (void **) &waveform)) {
-		keyvalLookup (waveformNames, NUM_WAVEFORM_NAMES, wavename, &value, NULL);
+		keyvalLookup (&waveformNamesHash, wavename, &value, NULL);
 	}
 
 	if (waveform) {
@@ -1658,12 +1554,12 @@ static BKInt BKTKCompilerCompileTrack (BKTKCompiler * compiler, BKTKParserNode c
 		return -1;
 	}
 
-	for (node = tree -> subNode; node; node = node -> nextNode) {
+	for (node = BKTKTreeNodeSub (tree); node; node = BKTKTreeNodeNext (node)) {
 		if (node -> type == BKTKTypeComment) {
 			continue;
 		}
 
-		if (keyvalLookup (cmdNames, NUM_CMD_NAMES, &node -> name, &value, &flags)) {
+		if (nodeLookup (compiler, node, BKTKSymbolTableCmd, &value, &flags)) {
 			switch (value) {
 				case BKIntrGroupDef: {
 					if ((res = BKTKCompilerCompileGroup (compiler, node, track, level)) != 0) {
@@ -1698,150 +1594,1116 @@ static BKInt BKTKCompilerCompileTrack (BKTKCompiler * compiler, BKTKParserNode c
 	return 0;
 }
 
-static BKInt BKTKCompilerLinkByteCode (BKTKCompiler * compiler, BKByteBuffer * byteCode, BKTKTrack * track)
+/**
+ * Get track containing the group called by instruction
+ */
+static BKTKTrack * BKTKCompilerCallTrack (BKTKCompiler * compiler, BKInstrMask mask, BKTKTrack * track)
 {
-	void * opcode;
-	void * opcodeEnd;
-	BKInstrMask mask;
-	BKTKOffset offset;
-	BKInt index, index2;
-	BKTKGroup * group;
-	BKTKTrack * groupTrack;
+	BKTKTrack * groupTrack = NULL;
 
-	// make continous byte array for interpreter
-	if (BKByteBufferMakeContinuous (byteCode) != 0) {
-		return -1;
+	switch (mask.grp.type) {
+		case BKGroupIndexTypeLocal: {
+			groupTrack = track;
+			break;
+		}
+		case BKGroupIndexTypeGlobal: {
+			groupTrack = BKTKCompilerTrackAtOffset (compiler, 0, 0);
+			break;
+		}
+		case BKGroupIndexTypeTrack: {
+			groupTrack = BKTKCompilerTrackAtOffset (compiler, mask.grp.idx2, 0);
+			break;
+		}
 	}
 
-	opcode = byteCode -> first->data;
-	opcodeEnd = opcode + BKByteBufferSize (byteCode);
+	return groupTrack;
+}
 
-	while (opcode < opcodeEnd) {
-		mask = BKReadIntrMask (&opcode);
+/**
+ * Get group called by instruction
+ *
+ * Returns NULL if group is not defined
+ */
+static BKTKGroup * BKTKCompilerCallTarget (BKTKCompiler * compiler, BKInstrMask mask, BKTKTrack * track)
+{
+	BKTKTrack * groupTrack = BKTKCompilerCallTrack (compiler, mask, track);
+	BKTKGroup * group = NULL;
 
-		if (mask.arg1.cmd == BKIntrCall) {
-			offset.lineno = BKReadIntrMask (&opcode).arg1.arg1;
-			offset.colno = BKReadIntrMask (&opcode).arg1.arg1;
-			index = mask.grp.idx1;
-			index2 = mask.grp.idx2;
+	if (groupTrack && (groupTrack -> object.object.flags & BKTKFlagUsed)) {
+		group = BKTKCompilerTrackGroupAtOffset (groupTrack, mask.grp.idx1, 0);
+	}
 
-			switch (mask.grp.type) {
-				case BKGroupIndexTypeLocal: {
-					group = BKTKCompilerTrackGroupAtOffset (track, index, 0);
+	if (!group || !(group -> object.object.flags & BKTKFlagUsed) || !group -> byteCode.first) {
+		return NULL;
+	}
 
-					if (!group || !(group -> object.object.flags & BKTKFlagUsed)) {
-						BKStringAppendFormat (&compiler -> error, "Local group '%d' not defined on line %d:%d\n", index, offset.lineno, offset.colno);
-						return -1;
-					}
-					break;
-				}
-				case BKGroupIndexTypeGlobal: {
-					groupTrack = BKTKCompilerTrackAtOffset (compiler, 0, 0);
-					group = BKTKCompilerTrackGroupAtOffset (groupTrack, index, 0);
+	return group;
+}
 
-					if (!group || !(group -> object.object.flags & BKTKFlagUsed)) {
-						BKStringAppendFormat (&compiler -> error, "Global group '%d' not defined on line %d:%d\n", index, offset.lineno, offset.colno);
-						return -1;
-					}
-					break;
-				}
-				case BKGroupIndexTypeTrack: {
-					groupTrack = BKTKCompilerTrackAtOffset (compiler, index2, 0);
+/**
+ * Get number of words of group without the final return
+ *
+ * Only groups which don't call other groups and don't contain repeat marks
+ * can be inlined. Groups larger than `maxSize` are not checked.
+ *
+ * Returns -1 if group cannot be inlined
+ */
+static BKInt groupInlineSize (BKTKGroup const * group, BKInt maxSize)
+{
+	BKInstrMask mask;
+	BKUSize size;
+	uint32_t const * code = (void *) group -> byteCode.first -> data;
+	BKInt numWords = (BKInt) (BKByteBufferSize (&group -> byteCode) / sizeof (uint32_t));
 
-					if (!groupTrack|| !(groupTrack -> object.object.flags & BKTKFlagUsed)) {
-						BKStringAppendFormat (&compiler -> error, "Track '%d' not defined on line %d:%d\n", index2 - 1, offset.lineno, offset.colno);
-						return -1;
-					}
+	if (numWords - 1 > maxSize) {
+		return -1;
+	}
 
-					group = BKTKCompilerTrackGroupAtOffset (groupTrack, index, 0);
+	for (BKInt i = 0; i < numWords; i += size) {
+		mask.value = code [i];
+		size = BKInstrMaskSize (mask);
 
-					if (!group|| !(group -> object.object.flags & BKTKFlagUsed)) {
-						BKStringAppendFormat (&compiler -> error, "Group '%d' of track '%d' not defined on line %d:%d\n", index, index2 - 1, offset.lineno, offset.colno);
-						return -1;
-					}
-					break;
+		switch (mask.arg1.cmd) {
+			case BKIntrCall:
+			case BKIntrEnd:
+			case BKIntrJump:
+			case BKIntrRepeatStart: {
+				return -1;
+			}
+			case BKIntrReturn: {
+				if (i != numWords - 1) {
+					return -1;
 				}
+				break;
 			}
 		}
 	}
 
-	return 0;
+	if (numWords < 1 || ((BKInstrMask) {.value = code [numWords - 1]}).arg1.cmd != BKIntrReturn) {
+		return -1;
+	}
+
+	return numWords - 1;
 }
 
-static BKInt BKTKCompilerGroupLink (BKTKCompiler * compiler, BKTKGroup * group, BKTKTrack * track)
+/**
+ * Count calls of all groups
+ */
+static void BKTKCompilerCountCalls (BKTKCompiler * compiler)
 {
-	return BKTKCompilerLinkByteCode (compiler, &group -> byteCode, track);
+	BKTKTrack * track;
+	BKTKGroup * group;
+
+	for (BKUSize i = 0; i < compiler -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&compiler -> tracks, i);
+
+		for (BKUSize j = 0; track && j < track -> groups.len; j ++) {
+			group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, j);
+
+			if (group) {
+				group -> numCalls = 0;
+			}
+		}
+	}
+
+	for (BKUSize i = 0; i < compiler -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&compiler -> tracks, i);
+
+		if (!track) {
+			continue;
+		}
+
+		for (BKInt j = -1; j < (BKInt) track -> groups.len; j ++) {
+			BKByteBuffer const * byteCode = &track -> byteCode;
+			BKInstrMask mask;
+			BKUSize numWords;
+			uint32_t const * code;
+
+			if (j >= 0) {
+				group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, j);
+
+				if (!group) {
+					continue;
+				}
+
+				byteCode = &group -> byteCode;
+			}
+
+			if (!byteCode -> first) {
+				continue;
+			}
+
+			code = (void *) byteCode -> first -> data;
+			numWords = BKByteBufferSize (byteCode) / sizeof (uint32_t);
+
+			for (BKUSize k = 0; k < numWords; k += BKInstrMaskSize (mask)) {
+				mask.value = code [k];
+
+				if (mask.arg1.cmd == BKIntrCall) {
+					if ((group = BKTKCompilerCallTarget (compiler, mask, track))) {
+						group -> numCalls ++;
+					}
+				}
+			}
+		}
+	}
 }
 
-static BKInt BKTKCompilerTrackLink (BKTKCompiler * compiler, BKTKTrack * track)
+/**
+ * Get maximum number of nested calls of byte code
+ *
+ * The result is limited to BK_INTR_STACK_SIZE + 1. Recursive calls are
+ * counted as overflowing the stack.
+ */
+static BKInt BKTKCompilerCallDepth (BKTKCompiler * compiler, BKByteBuffer const * byteCode, BKTKTrack * track)
 {
+	BKInstrMask mask;
 	BKTKGroup * group;
+	BKUSize numWords;
+	uint32_t const * code;
+	BKInt depth = 0;
 
-	if (BKTKCompilerLinkByteCode (compiler, &track -> byteCode, track) != 0) {
-		return -1;
+	if (!byteCode -> first) {
+		return 0;
 	}
 
-	for (BKUSize i = 0; i < track -> groups.len; i ++) {
-		group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, i);
+	code = (void *) byteCode -> first -> data;
+	numWords = BKByteBufferSize (byteCode) / sizeof (uint32_t);
 
-		if (group) {
-			if (BKTKCompilerGroupLink (compiler, group, track) != 0) {
-				return -1;
-			}
+	for (BKUSize i = 0; i < numWords; i += BKInstrMaskSize (mask)) {
+		mask.value = code [i];
+
+		if (mask.arg1.cmd != BKIntrCall || !(group = BKTKCompilerCallTarget (compiler, mask, track))) {
+			continue;
+		}
+
+		if (group -> callDepth < 0) {
+			// recursive calls will reach this value
+			group -> callDepth = BK_INTR_STACK_SIZE + 1;
+			group -> callDepth = BKTKCompilerCallDepth (compiler, &group -> byteCode, BKTKCompilerCallTrack (compiler, mask, track));
 		}
+
+		depth = BKMax (depth, BKMin (group -> callDepth + 1, BK_INTR_STACK_SIZE + 1));
 	}
 
-	return 0;
+	return depth;
 }
 
-static BKInt BKTKCompilerLink (BKTKCompiler * compiler)
+/**
+ * Check if calls of any track are nested deeper than the interpreter stack
+ *
+ * Calls which would overflow the stack are ignored by the interpreter, but
+ * would be executed when inlined.
+ */
+static BKInt BKTKCompilerStackOverflows (BKTKCompiler * compiler)
 {
 	BKTKTrack * track;
+	BKTKGroup * group;
 
 	for (BKUSize i = 0; i < compiler -> tracks.len; i ++) {
 		track = *(BKTKTrack **) BKArrayItemAt (&compiler -> tracks, i);
 
-		if (track) {
-			if (BKTKCompilerTrackLink (compiler, track) != 0) {
-				return -1;
+		for (BKUSize j = 0; track && j < track -> groups.len; j ++) {
+			group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, j);
+
+			if (group) {
+				group -> callDepth = -1;
 			}
 		}
 	}
 
+	for (BKUSize i = 0; i < compiler -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&compiler -> tracks, i);
+
+		if (track && BKTKCompilerCallDepth (compiler, &track -> byteCode, track) > BK_INTR_STACK_SIZE) {
+			return 1;
+		}
+	}
+
 	return 0;
 }
 
-BKInt BKTKCompilerCompile (BKTKCompiler * compiler, BKTKParserNode const * tree)
+/**
+ * Replace calls in byte code with the body of the called group
+ *
+ * Groups which are called only once are always inlined, other groups only
+ * if they are not larger than INLINE_MAX_SIZE. `budget` is the number of
+ * words the byte code may still grow.
+ *
+ * Returns the number of inlined calls or -1 on error
+ */
+static BKInt BKTKCompilerInlineByteCode (BKTKCompiler * compiler, BKByteBuffer * byteCode, BKTKTrack * track, BKSize * budget)
 {
-	BKInt res = 0;
-	BKInt value;
-	BKUInt flags;
-	BKTKParserNode const * node;
-	BKTKTrack * globalTrack;
-	uint32_t cmd;
-
-	cmd = BKInstrMaskArg1Make (BKIntrWaveform, BK_SQUARE);
-	globalTrack = BKTKCompilerTrackAtOffset (compiler, 0, 1);
+	BKInstrMask mask;
+	BKUSize size, numWords;
+	BKInt bodySize, growth;
+	BKInt numInlined = 0;
+	BKTKGroup * group;
+	uint32_t const * code;
+	BKByteBuffer inlined = BK_BYTE_BUFFER_INIT;
 
-	if (BKByteBufferAppendInt32 (&globalTrack -> byteCode, cmd) != 0) {
-		printError (compiler, tree, "Error: allocation failed");
-		res = BK_ALLOCATION_ERROR;
-		goto cleanup;
+	if (!byteCode -> first) {
+		return 0;
 	}
 
-	cmd = BKInstrMaskArg1Make (BKIntrRepeatStart, 0);
+	code = (void *) byteCode -> first -> data;
+	numWords = BKByteBufferSize (byteCode) / sizeof (uint32_t);
 
-	if (BKByteBufferAppendInt32 (&globalTrack -> byteCode, cmd) != 0) {
-		printError (compiler, tree, "Error: allocation failed");
-		return -1;
-	}
+	for (BKUSize i = 0; i < numWords; i += size) {
+		mask.value = code [i];
+		size = BKMin (BKInstrMaskSize (mask), numWords - i);
 
-	for (node = tree; node; node = node -> nextNode) {
-		if (node -> type == BKTKTypeComment) {
-			continue;
-		}
+		if (mask.arg1.cmd == BKIntrCall && (group = BKTKCompilerCallTarget (compiler, mask, track))) {
+			bodySize = groupInlineSize (group, group -> numCalls == 1 ? BK_INT_MAX : INLINE_MAX_SIZE);
+			growth = group -> numCalls == 1 ? 0 : bodySize - (BKInt) size;
 
-		if (!keyvalLookup (cmdNames, NUM_CMD_NAMES, &node -> name, &value, &flags)) {
+			if (bodySize >= 0 && growth <= *budget) {
+				if (BKByteBufferAppendBytes (&inlined, group -> byteCode.first -> data, bodySize * sizeof (uint32_t)) != 0) {
+					goto allocationError;
+				}
+
+				group -> object.object.flags |= BKTKFlagInlined;
+				*budget -= BKMax (growth, 0);
+				numInlined ++;
+				continue;
+			}
+		}
+
+		if (BKByteBufferAppendBytes (&inlined, &code [i], size * sizeof (uint32_t)) != 0) {
+			goto allocationError;
+		}
+	}
+
+	if (!numInlined) {
+		BKByteBufferDispose (&inlined);
+		return 0;
+	}
+
+	if (BKByteBufferMakeContinuous (&inlined) != 0) {
+		goto allocationError;
+	}
+
+	BKByteBufferDispose (byteCode);
+	*byteCode = inlined;
+
+	return numInlined;
+
+	allocationError: {
+		BKByteBufferDispose (&inlined);
+		return -1;
+	}
+}
+
+/**
+ * Inline small and single-use groups
+ *
+ * Calls and returns don't advance time and line numbers are copied with the
+ * group body, so inlining doesn't change line numbers and timing data.
+ * Nothing is inlined if calls are nested deeper than the interpreter stack.
+ * Groups are inlined bottom-up, as a group becomes inlinable after all its
+ * calls were inlined. Code of inlined groups which aren't called anymore is
+ * removed.
+ */
+static BKInt BKTKCompilerInline (BKTKCompiler * compiler)
+{
+	BKInt res;
+	BKInt numInlined;
+	BKSize budget = 0;
+	BKTKTrack * track;
+	BKTKGroup * group;
+
+	for (BKUSize i = 0; i < compiler -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&compiler -> tracks, i);
+
+		if (!track) {
+			continue;
+		}
+
+		if (BKByteBufferMakeContinuous (&track -> byteCode) != 0) {
+			return -1;
+		}
+
+		budget += BKByteBufferSize (&track -> byteCode) / sizeof (uint32_t);
+
+		for (BKUSize j = 0; j < track -> groups.len; j ++) {
+			group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, j);
+
+			if (!group) {
+				continue;
+			}
+
+			if (BKByteBufferMakeContinuous (&group -> byteCode) != 0) {
+				return -1;
+			}
+
+			budget += BKByteBufferSize (&group -> byteCode) / sizeof (uint32_t);
+		}
+	}
+
+	// inlining would execute calls ignored by the interpreter
+	if (BKTKCompilerStackOverflows (compiler)) {
+		return 0;
+	}
+
+	// code may grow by the given factor
+	budget = budget * INLINE_MAX_GROWTH / 100;
+
+	do {
+		numInlined = 0;
+		BKTKCompilerCountCalls (compiler);
+
+		for (BKUSize i = 0; i < compiler -> tracks.len; i ++) {
+			track = *(BKTKTrack **) BKArrayItemAt (&compiler -> tracks, i);
+
+			if (!track) {
+				continue;
+			}
+
+			if ((res = BKTKCompilerInlineByteCode (compiler, &track -> byteCode, track, &budget)) < 0) {
+				return -1;
+			}
+
+			numInlined += res;
+
+			for (BKUSize j = 0; j < track -> groups.len; j ++) {
+				group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, j);
+
+				if (!group) {
+					continue;
+				}
+
+				if ((res = BKTKCompilerInlineByteCode (compiler, &group -> byteCode, track, &budget)) < 0) {
+					return -1;
+				}
+
+				numInlined += res;
+			}
+		}
+
+		compiler -> numInlinedCalls += numInlined;
+	}
+	while (numInlined);
+
+	BKTKCompilerCountCalls (compiler);
+
+	// remove code of inlined groups
+	for (BKUSize i = 0; i < compiler -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&compiler -> tracks, i);
+
+		for (BKUSize j = 0; track && j < track -> groups.len; j ++) {
+			group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, j);
+
+			if (group && (group -> object.object.flags & BKTKFlagInlined) && !group -> numCalls) {
+				BKByteBufferDispose (&group -> byteCode);
+				group -> byteCode = BK_BYTE_BUFFER_INIT;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Check if instruction only sets a value without scheduling events
+ */
+static BKInt instrIsSetter (BKInstrMask mask)
+{
+	switch (mask.arg1.cmd) {
+		case BKIntrArpeggioSpeed:
+		case BKIntrDutyCycle:
+		case BKIntrInstrument:
+		case BKIntrLineNo:
+		case BKIntrMasterVolume:
+		case BKIntrPanning:
+		case BKIntrPhaseWrap:
+		case BKIntrPitch:
+		case BKIntrStepTicks:
+		case BKIntrStepTicksTrack:
+		case BKIntrVolume:
+		case BKIntrWaveform: {
+			return 1;
+		}
+		default: {
+			return 0;
+		}
+	}
+}
+
+/**
+ * Check if global step ticks may change after the song has started
+ *
+ * The step length of all tracks is changed by `BKIntrStepTicks`. Merged steps
+ * would use the old step length for the second step.
+ */
+static BKInt BKTKCompilerHasLateStepTicks (BKByteBuffer const * byteCode, BKInt isGroup)
+{
+	BKInstrMask mask;
+	BKUSize size, numWords;
+	BKInt started = isGroup;
+	uint32_t const * code;
+
+	if (!byteCode -> first) {
+		return 0;
+	}
+
+	code = (void *) byteCode -> first -> data;
+	numWords = BKByteBufferSize (byteCode) / sizeof (uint32_t);
+
+	for (BKUSize i = 0; i < numWords; i += size) {
+		mask.value = code [i];
+		size = BKInstrMaskSize (mask);
+
+		switch (mask.arg1.cmd) {
+			case BKIntrStepTicks: {
+				if (started) {
+					return 1;
+				}
+				break;
+			}
+			case BKIntrCall:
+			case BKIntrRepeatStart:
+			case BKIntrStep:
+			case BKIntrTicks: {
+				started = 1;
+				break;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Optimize bytecode in place
+ *
+ * Only instructions which are executed without advancing time are combined:
+ *
+ * - a value setter directly followed by the same setter is overwritten
+ * - a waveform or instrument directly followed by the same one is removed
+ * - a line number followed by another one before the next step is overwritten
+ * - consecutive steps are merged if no events are pending
+ *
+ * A step ends pending attack, release and mute events. Steps are only merged
+ * if the first one follows a step with only setters in between.
+ *
+ * Returns the number of removed instructions
+ */
+static BKInt BKTKCompilerOptimizeByteCode (BKByteBuffer * byteCode, BKInt mergeSteps)
+{
+	BKInstrMask mask, prevMask;
+	BKUSize size, numWords;
+	BKUSize out = 0;
+	BKInt prevIdx = -1;     // last instruction which is not a line number
+	BKInt lineIdx = -1;     // last line number since last step
+	BKInt lineAfterPrev = 0;
+	BKInt hasEvents = 1;    // events may be pending
+	BKInt prevStepMergeable = 0;
+	BKInt numRemoved = 0;
+	uint32_t * code;
+
+	if (!byteCode -> first) {
+		return 0;
+	}
+
+	code = (void *) byteCode -> first -> data;
+	numWords = BKByteBufferSize (byteCode) / sizeof (uint32_t);
+
+	for (BKUSize i = 0; i < numWords; i += size) {
+		mask.value = code [i];
+		size = BKMin (BKInstrMaskSize (mask), numWords - i);
+
+		if (mask.arg1.cmd == BKIntrLineNo) {
+			if (lineIdx >= 0) {
+				code [lineIdx] = mask.value;
+				numRemoved ++;
+			}
+			else {
+				lineIdx = (BKInt) out;
+				code [out ++] = mask.value;
+			}
+
+			lineAfterPrev = 1;
+			continue;
+		}
+
+		if (prevIdx >= 0) {
+			prevMask.value = code [prevIdx];
+
+			if (prevMask.arg1.cmd == mask.arg1.cmd) {
+				switch (mask.arg1.cmd) {
+					case BKIntrStep: {
+						BKInt steps = prevMask.arg1.arg1 + mask.arg1.arg1;
+
+						if (prevStepMergeable && !lineAfterPrev && steps <= MAX_MERGED_STEPS) {
+							code [prevIdx] = BKInstrMaskArg1Make (BKIntrStep, steps);
+							numRemoved ++;
+							continue;
+						}
+						break;
+					}
+					case BKIntrArpeggioSpeed:
+					case BKIntrDutyCycle:
+					case BKIntrMasterVolume:
+					case BKIntrPanning:
+					case BKIntrPhaseWrap:
+					case BKIntrPitch:
+					case BKIntrStepTicks:
+					case BKIntrStepTicksTrack:
+					case BKIntrVolume: {
+						code [prevIdx] = mask.value;
+						numRemoved ++;
+						continue;
+					}
+					case BKIntrInstrument:
+					case BKIntrWaveform: {
+						if (prevMask.value == mask.value) {
+							numRemoved ++;
+							continue;
+						}
+						break;
+					}
+				}
+			}
+		}
+
+		prevStepMergeable = 0;
+
+		switch (mask.arg1.cmd) {
+			case BKIntrStep:
+			case BKIntrTicks: {
+				prevStepMergeable = mergeSteps && !hasEvents && mask.arg1.cmd == BKIntrStep;
+				hasEvents = 0;
+				lineIdx = -1;
+				break;
+			}
+			// execution continues elsewhere or is entered from elsewhere
+			case BKIntrCall:
+			case BKIntrEnd:
+			case BKIntrJump:
+			case BKIntrRepeatStart:
+			case BKIntrReturn: {
+				hasEvents = 1;
+				lineIdx = -1;
+				break;
+			}
+			default: {
+				if (!instrIsSetter (mask)) {
+					hasEvents = 1;
+				}
+				break;
+			}
+		}
+
+		prevIdx = (BKInt) out;
+		lineAfterPrev = 0;
+		memmove (&code [out], &code [i], size * sizeof (uint32_t));
+		out += size;
+	}
+
+	// buffer is continuous
+	byteCode -> ptr = (void *) &code [out];
+
+	return numRemoved;
+}
+
+/**
+ * Optimize bytecode of all tracks and groups
+ */
+static BKInt BKTKCompilerOptimize (BKTKCompiler * compiler)
+{
+	BKInt mergeSteps = 1;
+	BKTKTrack * track;
+	BKTKGroup * group;
+
+	for (BKUSize i = 0; i < compiler -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&compiler -> tracks, i);
+
+		if (!track) {
+			continue;
+		}
+
+		if (BKByteBufferMakeContinuous (&track -> byteCode) != 0) {
+			return -1;
+		}
+
+		if (BKTKCompilerHasLateStepTicks (&track -> byteCode, 0)) {
+			mergeSteps = 0;
+		}
+
+		for (BKUSize j = 0; j < track -> groups.len; j ++) {
+			group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, j);
+
+			if (!group) {
+				continue;
+			}
+
+			if (BKByteBufferMakeContinuous (&group -> byteCode) != 0) {
+				return -1;
+			}
+
+			if (BKTKCompilerHasLateStepTicks (&group -> byteCode, 1)) {
+				mergeSteps = 0;
+			}
+		}
+	}
+
+	for (BKUSize i = 0; i < compiler -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&compiler -> tracks, i);
+
+		if (!track) {
+			continue;
+		}
+
+		compiler -> numRemovedInstrs += BKTKCompilerOptimizeByteCode (&track -> byteCode, mergeSteps);
+
+		for (BKUSize j = 0; j < track -> groups.len; j ++) {
+			group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, j);
+
+			if (!group) {
+				continue;
+			}
+
+			compiler -> numRemovedInstrs += BKTKCompilerOptimizeByteCode (&group -> byteCode, mergeSteps);
+		}
+	}
+
+	return 0;
+}
+
+#if BK_TK_COMPACT_CODE
+
+/**
+ * Write zigzag encoded varint to `out` and return its size
+ *
+ * Only the size is returned if `out` is NULL. The varint is padded to `width`
+ * bytes if it is shorter.
+ */
+static BKUSize writeVarint (uint8_t * out, BKInt value, BKUSize width)
+{
+	uint32_t bits = ((uint32_t) value << 1) ^ (uint32_t) -(value < 0);
+	BKUSize size = 0;
+
+	do {
+		if (out) {
+			out [size] = (bits & 0x7F) | (bits > 0x7F || size + 1 < width ? 0x80 : 0);
+		}
+
+		bits >>= 7;
+		size ++;
+	}
+	while (bits || size < width);
+
+	return size;
+}
+
+/**
+ * Encode instruction at `words` and return its encoded size
+ *
+ * Only the size is returned if `out` is NULL. Call offsets have a fixed size,
+ * so the layout of the program image does not depend on them. Line and column
+ * number of calls are only needed for linking and are dropped.
+ */
+static BKUSize BKTKCompilerEncodeInstr (uint32_t const * words, BKUSize numWords, uint8_t * out)
+{
+	BKInstrMask mask, arg;
+	BKUSize size = 1;
+
+	mask.value = words [0];
+
+	if (out) {
+		out [0] = mask.arg1.cmd;
+	}
+
+	#define WRITE_VARINT(value, width) (size += writeVarint (out ? out + size : NULL, (value), (width)))
+
+	switch (mask.arg1.cmd) {
+		case BKIntrCall: {
+			WRITE_VARINT (mask.arg1.arg1, BK_INTR_CALL_OFFSET_SIZE);
+			break;
+		}
+		case BKIntrArpeggio: {
+			WRITE_VARINT (mask.arg1.arg1, 0);
+
+			for (BKUSize i = 1; i < numWords; i ++) {
+				arg.value = words [i];
+				WRITE_VARINT (arg.arg1.arg1, 0);
+			}
+			break;
+		}
+		case BKIntrEffect: {
+			WRITE_VARINT (mask.arg1.arg1, 0);
+
+			if (numWords == 4) {
+				arg.value = words [1];
+				WRITE_VARINT (arg.arg2.arg1, 0);
+				WRITE_VARINT (arg.arg2.arg2, 0);
+				arg.value = words [2];
+				WRITE_VARINT (arg.arg1.arg1, 0);
+				arg.value = words [3];
+				WRITE_VARINT (arg.arg2.arg1, 0);
+				WRITE_VARINT (arg.arg2.arg2, 0);
+			}
+			break;
+		}
+		case BKIntrSampleRange:
+		case BKIntrSampleSustainRange: {
+			for (BKUSize i = 1; i < numWords; i ++) {
+				arg.value = words [i];
+				WRITE_VARINT (arg.arg1.arg1, 0);
+			}
+			break;
+		}
+		default: {
+			switch (BKInstrNumOperands (mask.arg1.cmd)) {
+				case 1: {
+					WRITE_VARINT (mask.arg1.arg1, 0);
+					break;
+				}
+				case 2: {
+					WRITE_VARINT (mask.arg2.arg1, 0);
+					WRITE_VARINT (mask.arg2.arg2, 0);
+					break;
+				}
+			}
+			break;
+		}
+	}
+
+	#undef WRITE_VARINT
+
+	return size;
+}
+
+#endif /* BK_TK_COMPACT_CODE */
+
+/**
+ * Get size of byte code in program image
+ */
+static BKSize BKTKCompilerCodeSize (BKByteBuffer * byteCode)
+{
+#if BK_TK_COMPACT_CODE
+	BKInstrMask mask;
+	BKSize size = 0;
+	BKUSize numWords, instrSize;
+	uint32_t const * words;
+
+	if (!byteCode -> first) {
+		return 0;
+	}
+
+	words = (void *) byteCode -> first -> data;
+	numWords = BKByteBufferSize (byteCode) / sizeof (uint32_t);
+
+	for (BKUSize i = 0; i < numWords; i += instrSize) {
+		mask.value = words [i];
+		instrSize = BKMin (BKInstrMaskSize (mask), numWords - i);
+		size += BKTKCompilerEncodeInstr (&words [i], instrSize, NULL);
+	}
+
+	return size;
+#else
+	return BKByteBufferSize (byteCode);
+#endif
+}
+
+/**
+ * Resolve calls to offsets relative to the call instruction
+ *
+ * `codeOffset` is the offset of `byteCode` in the program image.
+ */
+static BKInt BKTKCompilerLinkByteCode (BKTKCompiler * compiler, BKByteBuffer * byteCode, BKSize codeOffset, BKTKTrack * track)
+{
+	uint32_t * words;
+	BKUSize numWords, size;
+	BKSize codePos = 0;
+	BKInstrMask mask;
+	BKTKOffset offset;
+	BKInt index, index2;
+	BKSize target;
+	BKTKGroup * group = NULL;
+	BKTKTrack * groupTrack;
+
+	if (!byteCode -> first) {
+		return 0;
+	}
+
+	words = (void *) byteCode -> first -> data;
+	numWords = BKByteBufferSize (byteCode) / sizeof (uint32_t);
+
+	for (BKUSize i = 0; i < numWords; i += size) {
+		mask.value = words [i];
+		size = BKMin (BKInstrMaskSize (mask), numWords - i);
+
+		if (mask.arg1.cmd == BKIntrCall && size == 3) {
+			offset.lineno = ((BKInstrMask *) &words [i + 1]) -> arg1.arg1;
+			offset.colno = ((BKInstrMask *) &words [i + 2]) -> arg1.arg1;
+			index = mask.grp.idx1;
+			index2 = mask.grp.idx2;
+
+			switch (mask.grp.type) {
+				case BKGroupIndexTypeLocal: {
+					group = BKTKCompilerTrackGroupAtOffset (track, index, 0);
+
+					if (!group || !(group -> object.object.flags & BKTKFlagUsed) || !group -> codeSize) {
+						BKStringAppendFormat (&compiler -> error, "Local group '%d' not defined on line %d:%d\n", index, offset.lineno, offset.colno);
+						return -1;
+					}
+					break;
+				}
+				case BKGroupIndexTypeGlobal: {
+					groupTrack = BKTKCompilerTrackAtOffset (compiler, 0, 0);
+					group = BKTKCompilerTrackGroupAtOffset (groupTrack, index, 0);
+
+					if (!group || !(group -> object.object.flags & BKTKFlagUsed) || !group -> codeSize) {
+						BKStringAppendFormat (&compiler -> error, "Global group '%d' not defined on line %d:%d\n", index, offset.lineno, offset.colno);
+						return -1;
+					}
+					break;
+				}
+				case BKGroupIndexTypeTrack: {
+					groupTrack = BKTKCompilerTrackAtOffset (compiler, index2, 0);
+
+					if (!groupTrack|| !(groupTrack -> object.object.flags & BKTKFlagUsed)) {
+						BKStringAppendFormat (&compiler -> error, "Track '%d' not defined on line %d:%d\n", index2 - 1, offset.lineno, offset.colno);
+						return -1;
+					}
+
+					group = BKTKCompilerTrackGroupAtOffset (groupTrack, index, 0);
+
+					if (!group|| !(group -> object.object.flags & BKTKFlagUsed) || !group -> codeSize) {
+						BKStringAppendFormat (&compiler -> error, "Group '%d' of track '%d' not defined on line %d:%d\n", index, index2 - 1, offset.lineno, offset.colno);
+						return -1;
+					}
+					break;
+				}
+			}
+
+			target = (group -> codeOffset - (codeOffset + codePos)) / (BKSize) BK_INTR_CODE_UNIT;
+
+			if (target < -MAX_CALL_OFFSET || target >= MAX_CALL_OFFSET) {
+				BKStringAppendFormat (&compiler -> error, "Group call too far away on line %d:%d\n", offset.lineno, offset.colno);
+				return -1;
+			}
+
+			words [i] = BKInstrMaskArg1Make (BKIntrCall, (BKInt) target);
+		}
+
+#if BK_TK_COMPACT_CODE
+		codePos += BKTKCompilerEncodeInstr (&words [i], size, NULL);
+#else
+		codePos += size * sizeof (uint32_t);
+#endif
+	}
+
+	return 0;
+}
+
+/**
+ * Assign offsets in program image to tracks and groups
+ */
+static BKInt BKTKCompilerLayout (BKTKCompiler * compiler, BKSize * outSize)
+{
+	BKSize size = 0;
+	BKTKTrack * track;
+	BKTKGroup * group;
+
+	for (BKUSize i = 0; i < compiler -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&compiler -> tracks, i);
+
+		if (!track) {
+			continue;
+		}
+
+		// make continous byte array for linking
+		if (BKByteBufferMakeContinuous (&track -> byteCode) != 0) {
+			return -1;
+		}
+
+		track -> codeOffset = size;
+		track -> codeSize = BKTKCompilerCodeSize (&track -> byteCode);
+		size += track -> codeSize;
+
+		for (BKUSize j = 0; j < track -> groups.len; j ++) {
+			group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, j);
+
+			if (!group) {
+				continue;
+			}
+
+			if (BKByteBufferMakeContinuous (&group -> byteCode) != 0) {
+				return -1;
+			}
+
+			group -> codeOffset = size;
+			group -> codeSize = BKTKCompilerCodeSize (&group -> byteCode);
+			size += group -> codeSize;
+		}
+	}
+
+	*outSize = size;
+
+	return 0;
+}
+
+/**
+ * Move byte code of tracks and groups into program image
+ *
+ * The byte code is encoded if compact code is enabled.
+ */
+static BKInt BKTKCompilerMoveToProgram (BKByteBuffer * program, BKByteBuffer * byteCode)
+{
+	BKInt res = 0;
+
+#if BK_TK_COMPACT_CODE
+	if (byteCode -> first) {
+		BKInstrMask mask;
+		BKUSize size;
+		uint8_t encoded [MAX_ENCODED_SIZE];
+		uint32_t const * words = (void *) byteCode -> first -> data;
+		BKUSize numWords = BKByteBufferSize (byteCode) / sizeof (uint32_t);
+
+		for (BKUSize i = 0; i < numWords && res == 0; i += size) {
+			mask.value = words [i];
+			size = BKMin (BKInstrMaskSize (mask), numWords - i);
+			res = BKByteBufferAppendBytes (program, encoded, BKTKCompilerEncodeInstr (&words [i], size, encoded));
+		}
+	}
+#else
+	if (byteCode -> first) {
+		res = BKByteBufferAppendBytes (program, byteCode -> first -> data, BKByteBufferSize (byteCode));
+	}
+#endif
+
+	BKByteBufferDispose (byteCode);
+	*byteCode = BK_BYTE_BUFFER_INIT;
+
+	return res;
+}
+
+static BKInt BKTKCompilerTrackLink (BKTKCompiler * compiler, BKTKTrack * track)
+{
+	BKTKGroup * group;
+
+	if (BKTKCompilerLinkByteCode (compiler, &track -> byteCode, track -> codeOffset, track) != 0) {
+		return -1;
+	}
+
+	for (BKUSize i = 0; i < track -> groups.len; i ++) {
+		group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, i);
+
+		if (group) {
+			if (BKTKCompilerLinkByteCode (compiler, &group -> byteCode, group -> codeOffset, track) != 0) {
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Link tracks and groups into a single program image
+ *
+ * Calls are replaced by offsets to the called groups, so the interpreter
+ * doesn't have to look them up.
+ */
+static BKInt BKTKCompilerLink (BKTKCompiler * compiler)
+{
+	BKSize size;
+	BKTKTrack * track;
+	BKTKGroup * group;
+
+	if (BKTKCompilerLayout (compiler, &size) != 0) {
+		BKStringAppendFormat (&compiler -> error, "Error: allocation failed\n");
+		return -1;
+	}
+
+	for (BKUSize i = 0; i < compiler -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&compiler -> tracks, i);
+
+		if (track) {
+			if (BKTKCompilerTrackLink (compiler, track) != 0) {
+				return -1;
+			}
+		}
+	}
+
+	BKByteBufferDispose (&compiler -> program);
+	compiler -> program = BK_BYTE_BUFFER_INIT;
+
+	if (BKByteBufferReserve (&compiler -> program, size) != 0) {
+		BKStringAppendFormat (&compiler -> error, "Error: allocation failed\n");
+		return -1;
+	}
+
+	for (BKUSize i = 0; i < compiler -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&compiler -> tracks, i);
+
+		if (!track) {
+			continue;
+		}
+
+		if (BKTKCompilerMoveToProgram (&compiler -> program, &track -> byteCode) != 0) {
+			BKStringAppendFormat (&compiler -> error, "Error: allocation failed\n");
+			return -1;
+		}
+
+		for (BKUSize j = 0; j < track -> groups.len; j ++) {
+			group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, j);
+
+			if (!group) {
+				continue;
+			}
+
+			if (BKTKCompilerMoveToProgram (&compiler -> program, &group -> byteCode) != 0) {
+				BKStringAppendFormat (&compiler -> error, "Error: allocation failed\n");
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+BKInt BKTKCompilerCompileTree (BKTKCompiler * compiler, BKTKTree const * tree)
+{
+	BKInt res = 0;
+	BKInt value;
+	BKUInt flags;
+	BKTKTreeNode const * node;
+	BKTKTrack * globalTrack;
+	uint32_t cmd;
+
+	node = BKTKTreeNodeSub (BKTKTreeGetRoot (tree));
+
+	if (symbolsResolve (&compiler -> symbols, tree) != 0) {
+		printError (compiler, node, "Error: allocation failed");
+		res = BK_ALLOCATION_ERROR;
+		goto cleanup;
+	}
+
+	cmd = BKInstrMaskArg1Make (BKIntrWaveform, BK_SQUARE);
+	globalTrack = BKTKCompilerTrackAtOffset (compiler, 0, 1);
+
+	if (BKByteBufferAppendInt32 (&globalTrack -> byteCode, cmd) != 0) {
+		printError (compiler, node, "Error: allocation failed");
+		res = BK_ALLOCATION_ERROR;
+		goto cleanup;
+	}
+
+	cmd = BKInstrMaskArg1Make (BKIntrRepeatStart, 0);
+
+	if (BKByteBufferAppendInt32 (&globalTrack -> byteCode, cmd) != 0) {
+		printError (compiler, node, "Error: allocation failed");
+		return -1;
+	}
+
+	for (; node; node = BKTKTreeNodeNext (node)) {
+		if (node -> type == BKTKTypeComment) {
+			continue;
+		}
+
+		if (!nodeLookup (compiler, node, BKTKSymbolTableCmd, &value, &flags)) {
 			printErrorUnexpectedCommand (compiler, node);
 			continue;
 		}
@@ -1897,6 +2759,22 @@ BKInt BKTKCompilerCompile (BKTKCompiler * compiler, BKTKParserNode const * tree)
 		goto cleanup;
 	}
 
+	if (compiler -> object.flags & BKTKCompilerFlagInline) {
+		if (BKTKCompilerInline (compiler) != 0) {
+			printError (compiler, NULL, "Error: allocation failed\n");
+			res = BK_ALLOCATION_ERROR;
+			goto cleanup;
+		}
+	}
+
+	if (compiler -> object.flags & BKTKCompilerFlagOptimize) {
+		if (BKTKCompilerOptimize (compiler) != 0) {
+			printError (compiler, NULL, "Error: allocation failed\n");
+			res = BK_ALLOCATION_ERROR;
+			goto cleanup;
+		}
+	}
+
 	if (BKTKCompilerLink (compiler) != 0) {
 		res = -1;
 		goto cleanup;
@@ -1907,6 +2785,22 @@ BKInt BKTKCompilerCompile (BKTKCompiler * compiler, BKTKParserNode const * tree)
 	}
 }
 
+BKInt BKTKCompilerCompile (BKTKCompiler * compiler, BKTKParserNode const * node)
+{
+	BKInt res;
+	BKTKTree tree;
+
+	if ((res = BKTKTreeInit (&tree, node)) != 0) {
+		printError (compiler, NULL, "Error: allocation failed\n");
+		return res;
+	}
+
+	res = BKTKCompilerCompileTree (compiler, &tree);
+	BKDispose (&tree);
+
+	return res;
+}
+
 BKInt BKTKCompilerReset (BKTKCompiler * compiler)
 {
 	char const * key;
@@ -1946,11 +2840,17 @@ BKInt BKTKCompilerReset (BKTKCompiler * compiler)
 	BKStringEmpty (&compiler -> auxString);
 	BKStringEmpty (&compiler -> error);
 	BKArrayEmpty (&compiler -> notesTable);
+	BKArrayEmpty (&compiler -> symbols);
+	BKByteBufferDispose (&compiler -> program);
+	compiler -> program = BK_BYTE_BUFFER_INIT;
 
 	if (initDefaultNotesTable (&compiler -> notesTable, &compiler -> octaveSize, noteNames, NUM_NOTE_NAMES) != 0) {
 		return -1;
 	}
 
+	compiler -> notesDefined = 0;
+	compiler -> numRemovedInstrs = 0;
+	compiler -> numInlinedCalls = 0;
 	compiler -> lineno = 0;
 	compiler -> info = (BKTKFileInfo) {0};
 
@@ -1977,6 +2877,7 @@ static void BKTKCompilerDispose (BKTKCompiler * compiler)
 	BKStringDispose (&compiler -> auxString);
 	BKStringDispose (&compiler -> error);
 	BKArrayDispose (&compiler -> notesTable);
+	BKArrayDispose (&compiler -> symbols);
 }
 
 BKClass const BKTKCompilerClass =
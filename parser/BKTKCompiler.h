@@ -28,6 +28,7 @@
 #include "BKInstrument.h"
 #include "BKTKInterpreter.h"
 #include "BKTKParser.h"
+#include "BKTKTree.h"
 
 /**
  * Globally used flags
@@ -36,6 +37,16 @@ enum BKTKFlag
 {
 	BKTKFlagUsed      = 1 << 0,
 	BKTKFlagAutoIndex = 1 << 1,
+	BKTKFlagInlined   = 1 << 2,
+};
+
+/**
+ * Compiler options set in `object.flags`
+ */
+enum BKTKCompilerFlag
+{
+	BKTKCompilerFlagOptimize = 1 << 0, // run peephole optimizer before linking
+	BKTKCompilerFlagInline   = 1 << 1, // inline small and single-use groups
 };
 
 struct BKTKCompiler
@@ -51,6 +62,11 @@ struct BKTKCompiler
 	BKTKFileInfo info;
 	BKArray      notesTable;
 	BKUInt       octaveSize;
+	BKInt        notesDefined; // notes table was redefined with "octave"
+	BKArray      symbols;    // lookup table entries of tree symbols
+	BKUSize      numRemovedInstrs; // instructions removed by optimizer
+	BKUSize      numInlinedCalls;  // group calls replaced by group body
+	BKByteBuffer program;    // linked byte code of all tracks and groups
 };
 
 /**
@@ -60,9 +76,18 @@ extern BKInt BKTKCompilerInit (BKTKCompiler * compiler);
 
 /**
  * Parse tree from BKParser
+ *
+ * Copies the nodes into a `BKTKTree` and compiles it. Use
+ * `BKTKParserSetTree` and `BKTKCompilerCompileTree` to compile parsed nodes
+ * without copying them.
  */
 extern BKInt BKTKCompilerCompile (BKTKCompiler * compiler, BKTKParserNode const * tree);
 
+/**
+ * Parse flat tree
+ */
+extern BKInt BKTKCompilerCompileTree (BKTKCompiler * compiler, BKTKTree const * tree);
+
 /**
  * Reset compiler to compile another node
  */
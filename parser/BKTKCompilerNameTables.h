@@ -0,0 +1,242 @@
+/**
+ * Generated by gen-name-tables from BKTKCompilerNames.h; do not edit
+ *
+ * Regenerate with `make -C parser name-tables`
+ */
+
+static struct keyval const noteNames [] =
+{
+	{"a#", 10, 0},
+	{"c", 0, 0},
+	{"d", 2, 0},
+	{"f#", 6, 0},
+	{"a", 9, 0},
+	{"h", 11, 0},
+	{"e", 4, 0},
+	{"c#", 1, 0},
+	{"b", 11, 0},
+	{"f", 5, 0},
+	{"g#", 8, 0},
+	{"d#", 3, 0},
+	{"g", 7, 0},
+};
+
+static uint8_t const noteNamesDisp [] =
+{
+	1, 2, 1, 2, 0, 4, 12,
+};
+
+static struct keyhash const noteNamesHash =
+{
+	.items      = noteNames,
+	.disp       = noteNamesDisp,
+	.seed       = 2,
+	.size       = 13,
+	.numBuckets = 7,
+};
+
+static struct keyval const cmdNames [] =
+{
+	{"m", BKIntrMute, 0},
+	{"s", BKIntrStep, 0},
+	{"vm", BKIntrMasterVolume, 0},
+	{"as", BKIntrArpeggioSpeed, 0},
+	{"stt", BKIntrStepTicksTrack, 0},
+	{"xb", BKIntrRepeatStart, 0},
+	{"octave", BKIntrOctaveDef, 0},
+	{"w", BKIntrWaveform, 0},
+	{"sample", BKIntrSampleDef, BKTKParserFlagIsGroup},
+	{"r", BKIntrRelease, 0},
+	{"pw", BKIntrPhaseWrap, 0},
+	{"g", BKIntrGroupJump, 0},
+	{"pt", BKIntrPitch, 0},
+	{"t", BKIntrTicks, 0},
+	{"stepticks", BKIntrStepTicks, 0},
+	{"pulsekernel", BKIntrPulseKernel, 0},
+	{"p", BKIntrPanning, 0},
+	{"track", BKIntrTrackDef, BKTKParserFlagIsGroup},
+	{"tstepticks", BKIntrStepTicksTrack, 0},
+	{"x", BKIntrRepeat, 0},
+	{"rt", BKIntrReleaseTicks, 0},
+	{"pk", BKIntrPulseKernel, 0},
+	{"tr", BKIntrTickRate, 0},
+	{"instr", BKIntrInstrumentDef, BKTKParserFlagIsGroup},
+	{"st", BKIntrStepTicks, 0},
+	{"d", BKIntrSample, 0},
+	{"a", BKIntrAttack, 0},
+	{"e", BKIntrEffect, 0},
+	{"dr", BKIntrSampleRepeat, 0},
+	{"samp", BKIntrSampleDef, BKTKParserFlagIsGroup},
+	{"i", BKIntrInstrument, 0},
+	{"z", BKIntrEnd, 0},
+	{"dn", BKIntrSampleRange, 0},
+	{"ds", BKIntrSampleSustainRange, 0},
+	{"v", BKIntrVolume, 0},
+	{"tickrate", BKIntrTickRate, 0},
+	{"mt", BKIntrMuteTicks, 0},
+	{"wave", BKIntrWaveformDef, BKTKParserFlagIsGroup},
+	{"dc", BKIntrDutyCycle, 0},
+	{"at", BKIntrAttackTicks, 0},
+	{"grp", BKIntrGroupDef, BKTKParserFlagIsGroup},
+};
+
+static uint8_t const cmdNamesDisp [] =
+{
+	4, 4, 9, 2, 4, 0, 1, 0, 5, 8, 0, 6, 16, 0, 0, 17, 0, 1, 0, 31, 40,
+};
+
+static struct keyhash const cmdNamesHash =
+{
+	.items      = cmdNames,
+	.disp       = cmdNamesDisp,
+	.seed       = 3,
+	.size       = 41,
+	.numBuckets = 21,
+};
+
+static struct keyval const effectNames [] =
+{
+	{"vb", BK_EFFECT_VIBRATO, 0},
+	{"pr", BK_EFFECT_PORTAMENTO, 0},
+	{"vs", BK_EFFECT_VOLUME_SLIDE, 0},
+	{"ps", BK_EFFECT_PANNING_SLIDE, 0},
+	{"tr", BK_EFFECT_TREMOLO, 0},
+};
+
+static uint8_t const effectNamesDisp [] =
+{
+	0, 0, 1,
+};
+
+static struct keyhash const effectNamesHash =
+{
+	.items      = effectNames,
+	.disp       = effectNamesDisp,
+	.seed       = 11,
+	.size       = 5,
+	.numBuckets = 3,
+};
+
+static struct keyval const waveformNames [] =
+{
+	{"saw", BK_SAWTOOTH, 0},
+	{"sin", BK_SINE, 0},
+	{"square", BK_SQUARE, 0},
+	{"sine", BK_SINE, 0},
+	{"sawtooth", BK_SAWTOOTH, 0},
+	{"tri", BK_TRIANGLE, 0},
+	{"smp", BK_SAMPLE, 0},
+	{"sqr", BK_SQUARE, 0},
+	{"noise", BK_NOISE, 0},
+	{"noi", BK_NOISE, 0},
+	{"triangle", BK_TRIANGLE, 0},
+	{"sample", BK_SAMPLE, 0},
+};
+
+static uint8_t const waveformNamesDisp [] =
+{
+	0, 3, 2, 0, 0, 5, 8,
+};
+
+static struct keyhash const waveformNamesHash =
+{
+	.items      = waveformNames,
+	.disp       = waveformNamesDisp,
+	.seed       = 0,
+	.size       = 12,
+	.numBuckets = 7,
+};
+
+static struct keyval const envelopeNames [] =
+{
+	{"vnv", BKTKEnvelopeTypeVolumeEnv, 0},
+	{"dc", BKTKEnvelopeTypeDutyCycleSeq, 0},
+	{"p", BKTKEnvelopeTypePanningSeq, 0},
+	{"anv", BKTKEnvelopeTypePitchEnv, 0},
+	{"adsr", BKTKEnvelopeTypeADSR, 0},
+	{"a", BKTKEnvelopeTypePitchSeq, 0},
+	{"v", BKTKEnvelopeTypeVolumeSeq, 0},
+	{"pnv", BKTKEnvelopeTypePanningEnv, 0},
+	{"dcnv", BKTKEnvelopeTypeDutyCycleEnv, 0},
+};
+
+static uint8_t const envelopeNamesDisp [] =
+{
+	3, 0, 0, 2, 2,
+};
+
+static struct keyhash const envelopeNamesHash =
+{
+	.items      = envelopeNames,
+	.disp       = envelopeNamesDisp,
+	.seed       = 5,
+	.size       = 9,
+	.numBuckets = 5,
+};
+
+static struct keyval const miscNames [] =
+{
+	{"ds", BKTKMiscSampleSustainRange, 0},
+	{"s", BKTKMiscSequence, 0},
+	{"data", BKTKMiscData, 0},
+	{"dn", BKTKMiscSampleRange, 0},
+	{"pt", BKTKMiscPitch, 0},
+	{"dr", BKTKMiscSampleRepeat, 0},
+	{"load", BKTKMiscLoad, 0},
+};
+
+static uint8_t const miscNamesDisp [] =
+{
+	0, 2, 4, 0,
+};
+
+static struct keyhash const miscNamesHash =
+{
+	.items      = miscNames,
+	.disp       = miscNamesDisp,
+	.seed       = 1,
+	.size       = 7,
+	.numBuckets = 4,
+};
+
+static struct keyval const repeatNames [] =
+{
+	{"rep", BK_REPEAT, 0},
+	{"pal", BK_PALINDROME, 0},
+	{"no", BK_NO_REPEAT, 0},
+};
+
+static uint8_t const repeatNamesDisp [] =
+{
+	0, 0,
+};
+
+static struct keyhash const repeatNamesHash =
+{
+	.items      = repeatNames,
+	.disp       = repeatNamesDisp,
+	.seed       = 0,
+	.size       = 3,
+	.numBuckets = 2,
+};
+
+static struct keyval const pulseNames [] =
+{
+	{"sinc", BK_PULSE_KERNEL_SINC, 0},
+	{"harm", BK_PULSE_KERNEL_HARM, 0},
+};
+
+static uint8_t const pulseNamesDisp [] =
+{
+	0, 0,
+};
+
+static struct keyhash const pulseNamesHash =
+{
+	.items      = pulseNames,
+	.disp       = pulseNamesDisp,
+	.seed       = 0,
+	.size       = 2,
+	.numBuckets = 2,
+};
+
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2012-2016 Simon Schoenenberger
+ * http://blipkit.audio
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef _BK_TK_COMPILER_NAMES_H_
+#define _BK_TK_COMPILER_NAMES_H_
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Names of lookup tables used by the compiler
+ *
+ * Each list calls `X (name, value, flags)` for every entry. The lists are
+ * expanded by `gen-name-tables` which generates the hash tables in
+ * BKTKCompilerNameTables.h. Values and flags are only resolved by the
+ * compiler. The tables are regenerated by the build when not cross compiling.
+ */
+
+enum BKCompilerEnvelopeType
+{
+	BKTKEnvelopeTypeVolumeSeq,
+	BKTKEnvelopeTypePitchSeq,
+	BKTKEnvelopeTypePanningSeq,
+	BKTKEnvelopeTypeDutyCycleSeq,
+	BKTKEnvelopeTypeADSR,
+	BKTKEnvelopeTypeVolumeEnv,
+	BKTKEnvelopeTypePitchEnv,
+	BKTKEnvelopeTypePanningEnv,
+	BKTKEnvelopeTypeDutyCycleEnv,
+};
+
+enum BKCompilerMiscCmds
+{
+	BKTKMiscLoad,
+	BKTKMiscData,
+	BKTKMiscPitch,
+	BKTKMiscSampleRange,
+	BKTKMiscSampleRepeat,
+	BKTKMiscSampleSustainRange,
+	BKTKMiscSequence,
+};
+
+/**
+ * Used for lookup tables to assign a string to a value
+ */
+struct keyval
+{
+	char const * name;
+	int32_t value;
+	int32_t flags;
+};
+
+/**
+ * Minimal perfect hash table generated by `gen-name-tables`
+ */
+struct keyhash
+{
+	struct keyval const * items;  // ordered by slot
+	uint8_t const * disp;         // slot displacement of each bucket
+	uint32_t seed;
+	uint32_t size;
+	uint32_t numBuckets;
+};
+
+/**
+ * Note names
+ */
+#define BK_NOTE_NAMES(X) \
+	X ("a",  9,  0) \
+	X ("a#", 10, 0) \
+	X ("b",  11, 0) \
+	X ("c",  0,  0) \
+	X ("c#", 1,  0) \
+	X ("d",  2,  0) \
+	X ("d#", 3,  0) \
+	X ("e",  4,  0) \
+	X ("f",  5,  0) \
+	X ("f#", 6,  0) \
+	X ("g",  7,  0) \
+	X ("g#", 8,  0) \
+	X ("h",  11, 0)
+
+/**
+ * Command names
+ */
+#define BK_CMD_NAMES(X) \
+	X ("a",           BKIntrAttack,             0) \
+	X ("as",          BKIntrArpeggioSpeed,      0) \
+	X ("at",          BKIntrAttackTicks,        0) \
+	X ("d",           BKIntrSample,             0) \
+	X ("dc",          BKIntrDutyCycle,          0) \
+	X ("dn",          BKIntrSampleRange,        0) \
+	X ("dr",          BKIntrSampleRepeat,       0) \
+	X ("ds",          BKIntrSampleSustainRange, 0) \
+	X ("e",           BKIntrEffect,             0) \
+	X ("g",           BKIntrGroupJump,          0) \
+	X ("grp",         BKIntrGroupDef,           BKTKParserFlagIsGroup) \
+	X ("i",           BKIntrInstrument,         0) \
+	X ("instr",       BKIntrInstrumentDef,      BKTKParserFlagIsGroup) \
+	X ("m",           BKIntrMute,               0) \
+	X ("mt",          BKIntrMuteTicks,          0) \
+	X ("octave",      BKIntrOctaveDef,          0) \
+	X ("p",           BKIntrPanning,            0) \
+	X ("pk",          BKIntrPulseKernel,        0) \
+	X ("pt",          BKIntrPitch,              0) \
+	X ("pulsekernel", BKIntrPulseKernel,        0) \
+	X ("pw",          BKIntrPhaseWrap,          0) \
+	X ("r",           BKIntrRelease,            0) \
+	X ("rt",          BKIntrReleaseTicks,       0) \
+	X ("s",           BKIntrStep,               0) \
+	X ("samp",        BKIntrSampleDef,          BKTKParserFlagIsGroup) \
+	X ("sample",      BKIntrSampleDef,          BKTKParserFlagIsGroup) \
+	X ("st",          BKIntrStepTicks,          0) \
+	X ("stepticks",   BKIntrStepTicks,          0) \
+	X ("stt",         BKIntrStepTicksTrack,     0) \
+	X ("t",           BKIntrTicks,              0) \
+	X ("tickrate",    BKIntrTickRate,           0) \
+	X ("tr",          BKIntrTickRate,           0) \
+	X ("track",       BKIntrTrackDef,           BKTKParserFlagIsGroup) \
+	X ("tstepticks",  BKIntrStepTicksTrack,     0) \
+	X ("v",           BKIntrVolume,             0) \
+	X ("vm",          BKIntrMasterVolume,       0) \
+	X ("w",           BKIntrWaveform,           0) \
+	X ("wave",        BKIntrWaveformDef,        BKTKParserFlagIsGroup) \
+	X ("x",           BKIntrRepeat,             0) \
+	X ("xb",          BKIntrRepeatStart,        0) \
+	X ("z",           BKIntrEnd,                0)
+
+/**
+ * Effect names
+ */
+#define BK_EFFECT_NAMES(X) \
+	X ("pr", BK_EFFECT_PORTAMENTO,    0) \
+	X ("ps", BK_EFFECT_PANNING_SLIDE, 0) \
+	X ("tr", BK_EFFECT_TREMOLO,       0) \
+	X ("vb", BK_EFFECT_VIBRATO,       0) \
+	X ("vs", BK_EFFECT_VOLUME_SLIDE,  0)
+
+/**
+ * Waveform names
+ */
+#define BK_WAVEFORM_NAMES(X) \
+	X ("noi",      BK_NOISE,    0) \
+	X ("noise",    BK_NOISE,    0) \
+	X ("sample",   BK_SAMPLE,   0) \
+	X ("saw",      BK_SAWTOOTH, 0) \
+	X ("sawtooth", BK_SAWTOOTH, 0) \
+	X ("sin",      BK_SINE,     0) \
+	X ("sine",     BK_SINE,     0) \
+	X ("smp",      BK_SAMPLE,   0) \
+	X ("sqr",      BK_SQUARE,   0) \
+	X ("square",   BK_SQUARE,   0) \
+	X ("tri",      BK_TRIANGLE, 0) \
+	X ("triangle", BK_TRIANGLE, 0)
+
+/**
+ * Envelope names
+ */
+#define BK_ENVELOPE_NAMES(X) \
+	X ("a",    BKTKEnvelopeTypePitchSeq,     0) \
+	X ("adsr", BKTKEnvelopeTypeADSR,         0) \
+	X ("anv",  BKTKEnvelopeTypePitchEnv,     0) \
+	X ("dc",   BKTKEnvelopeTypeDutyCycleSeq, 0) \
+	X ("dcnv", BKTKEnvelopeTypeDutyCycleEnv, 0) \
+	X ("p",    BKTKEnvelopeTypePanningSeq,   0) \
+	X ("pnv",  BKTKEnvelopeTypePanningEnv,   0) \
+	X ("v",    BKTKEnvelopeTypeVolumeSeq,    0) \
+	X ("vnv",  BKTKEnvelopeTypeVolumeEnv,    0)
+
+/**
+ * Miscellaneous names
+ */
+#define BK_MISC_NAMES(X) \
+	X ("data", BKTKMiscData,               0) \
+	X ("dn",   BKTKMiscSampleRange,        0) \
+	X ("dr",   BKTKMiscSampleRepeat,       0) \
+	X ("ds",   BKTKMiscSampleSustainRange, 0) \
+	X ("load", BKTKMiscLoad,               0) \
+	X ("pt",   BKTKMiscPitch,              0) \
+	X ("s",    BKTKMiscSequence,           0)
+
+/**
+ * Repeat mode names
+ */
+#define BK_REPEAT_NAMES(X) \
+	X ("no",  BK_NO_REPEAT,  0) \
+	X ("pal", BK_PALINDROME, 0) \
+	X ("rep", BK_REPEAT,     0)
+
+/**
+ * Pulse kernel names
+ */
+#define BK_PULSE_NAMES(X) \
+	X ("harm", BK_PULSE_KERNEL_HARM, 0) \
+	X ("sinc", BK_PULSE_KERNEL_SINC, 0)
+
+/**
+ * Hash name with seed
+ *
+ * Used by the generator and the compiler to calculate table slots
+ */
+static inline uint32_t BKTKNameHash (char const * name, uint32_t seed)
+{
+	uint32_t hash = 2166136261u ^ seed;
+
+	for (; *name; name ++) {
+		hash ^= (uint8_t) *name;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/**
+ * Find item with `name` in hash table
+ *
+ * Returns NULL if name is not contained in table
+ */
+static inline struct keyval const * BKTKNameFind (struct keyhash const * table, char const * name)
+{
+	uint32_t hash = BKTKNameHash (name, table -> seed);
+	struct keyval const * item = &table -> items [((hash >> 16) + table -> disp [hash % table -> numBuckets]) % table -> size];
+
+	if (strcmp (name, item -> name) != 0) {
+		return NULL;
+	}
+
+	return item;
+}
+
+#endif /* ! _BK_TK_COMPILER_NAMES_H_ */
@@ -21,6 +21,7 @@
  * IN THE SOFTWARE.
  */
 
+#include <stddef.h>
 #include "BKWaveFileReader.h"
 #include "BKTKContext.h"
 #include "BKTKInterpreter.h"
@@ -31,6 +32,7 @@ extern BKClass const BKTKTrackClass;
 extern BKClass const BKTKInstrumentClass;
 extern BKClass const BKTKWaveformClass;
 extern BKClass const BKTKSampleClass;
+extern BKClass const BKTKKeyframesClass;
 
 static void printError (BKTKContext * ctx, char const * format, ...)
 {
@@ -83,6 +85,7 @@ BKInt BKTKInstrumentAlloc (BKTKInstrument ** instrument)
 	}
 
 	(*instrument) -> name = BK_STRING_INIT;
+	(*instrument) -> sequences = BK_BYTE_BUFFER_INIT;
 
 	return res;
 }
@@ -121,6 +124,88 @@ BKInt BKTKSampleAlloc (BKTKSample ** sample)
 	return res;
 }
 
+enum BKTKSequenceRecord
+{
+	BKTKSequenceRecordValues,
+	BKTKSequenceRecordPhases,
+	BKTKSequenceRecordADSR,
+};
+
+/**
+ * Record header: kind, slot, length, sustain offset, sustain length
+ * Followed by `length` values, `length` step/value pairs or 4 ADSR values
+ */
+static BKInt BKTKInstrumentRecordSequence (BKTKInstrument * instrument, BKInt kind, BKInt slot, BKUInt length, BKInt sustainOffset, BKInt sustainLength)
+{
+	uint32_t header [5] = {kind, slot, length, sustainOffset, sustainLength};
+
+	return BKByteBufferAppendBytes (&instrument -> sequences, header, sizeof (header));
+}
+
+BKInt BKTKInstrumentSetSequence (BKTKInstrument * instrument, BKEnum slot, BKInt const * values, BKUInt length, BKInt sustainOffset, BKInt sustainLength)
+{
+	BKInt res;
+
+	if ((res = BKInstrumentSetSequence (&instrument -> instr, slot, values, length, sustainOffset, sustainLength)) < 0) {
+		return res;
+	}
+
+	if (BKTKInstrumentRecordSequence (instrument, BKTKSequenceRecordValues, slot, length, sustainOffset, sustainLength) != 0) {
+		return BK_ALLOCATION_ERROR;
+	}
+
+	if (BKByteBufferAppendBytes (&instrument -> sequences, values, length * sizeof (BKInt)) != 0) {
+		return BK_ALLOCATION_ERROR;
+	}
+
+	return res;
+}
+
+BKInt BKTKInstrumentSetEnvelope (BKTKInstrument * instrument, BKEnum slot, BKSequencePhase const * phases, BKUInt length, BKInt sustainOffset, BKInt sustainLength)
+{
+	BKInt res;
+
+	if ((res = BKInstrumentSetEnvelope (&instrument -> instr, slot, phases, length, sustainOffset, sustainLength)) < 0) {
+		return res;
+	}
+
+	if (BKTKInstrumentRecordSequence (instrument, BKTKSequenceRecordPhases, slot, length, sustainOffset, sustainLength) != 0) {
+		return BK_ALLOCATION_ERROR;
+	}
+
+	for (BKUInt i = 0; i < length; i ++) {
+		if (BKByteBufferAppendInt32 (&instrument -> sequences, phases [i].steps) != 0) {
+			return BK_ALLOCATION_ERROR;
+		}
+
+		if (BKByteBufferAppendInt32 (&instrument -> sequences, phases [i].value) != 0) {
+			return BK_ALLOCATION_ERROR;
+		}
+	}
+
+	return res;
+}
+
+BKInt BKTKInstrumentSetEnvelopeADSR (BKTKInstrument * instrument, BKUInt attack, BKUInt decay, BKInt sustain, BKUInt release)
+{
+	BKInt res;
+	uint32_t adsr [4] = {attack, decay, sustain, release};
+
+	if ((res = BKInstrumentSetEnvelopeADSR (&instrument -> instr, attack, decay, sustain, release)) < 0) {
+		return res;
+	}
+
+	if (BKTKInstrumentRecordSequence (instrument, BKTKSequenceRecordADSR, 0, 4, 0, 0) != 0) {
+		return BK_ALLOCATION_ERROR;
+	}
+
+	if (BKByteBufferAppendBytes (&instrument -> sequences, adsr, sizeof (adsr)) != 0) {
+		return BK_ALLOCATION_ERROR;
+	}
+
+	return res;
+}
+
 static void BKTKGroupDispose (BKTKGroup * group)
 {
 	BKByteBufferDispose (&group -> byteCode);
@@ -132,7 +217,10 @@ static void BKTKTrackDispose (BKTKTrack * track)
 
 	for (BKUSize i = 0; i < track -> groups.len; i ++) {
 		group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, i);
-		BKTKGroupDispose (group);
+
+		if (group) {
+			BKTKGroupDispose (group);
+		}
 	}
 
 	BKByteBufferDispose (&track -> byteCode);
@@ -145,6 +233,7 @@ static void BKTKInstrumentDispose (BKTKInstrument * instrument)
 {
 	BKDispose (&instrument -> instr);
 	BKStringDispose (&instrument -> name);
+	BKByteBufferDispose (&instrument -> sequences);
 }
 
 static void BKTKWaveformDispose (BKTKWaveform * waveform)
@@ -173,12 +262,26 @@ BKInt BKTKContextInit (BKTKContext * ctx, BKUInt flags)
 	ctx -> waveforms = BK_ARRAY_INIT (sizeof (BKTKWaveform *));
 	ctx -> samples = BK_ARRAY_INIT (sizeof (BKTKSample *));
 	ctx -> tracks = BK_ARRAY_INIT (sizeof (BKTKTrack *));
+	ctx -> program = BK_BYTE_BUFFER_INIT;
 	ctx -> error = BK_STRING_INIT;
 	ctx -> loadPath = BK_STRING_INIT;
 
 	return 0;
 }
 
+static void BKTKSampleApplyAttributes (BKTKSample * sample)
+{
+	if (sample -> range [0] || sample -> range [1]) {
+		BKSetPtr (&sample -> data, BK_SAMPLE_RANGE, &sample -> range, sizeof (sample -> range));
+	}
+
+	if (sample -> sustainRange [0] || sample -> sustainRange [1]) {
+		BKSetPtr (&sample -> data, BK_SAMPLE_SUSTAIN_RANGE, &sample -> sustainRange, sizeof (sample -> sustainRange));
+	}
+
+	BKSetAttr (&sample -> data, BK_SAMPLE_PITCH, (BKInt) (((uint64_t) sample -> pitch * BK_FINT20_UNIT) / 100));
+}
+
 static BKInt BKTKContextLoadSamples (BKTKContext * ctx, BKTKCompiler * compiler)
 {
 	BKInt res = 0;
@@ -299,15 +402,7 @@ static BKInt BKTKContextLoadSamples (BKTKContext * ctx, BKTKCompiler * compiler)
 			//}
 		}
 
-		if (sample -> range [0] || sample -> range [1]) {
-			BKSetPtr (&sample -> data, BK_SAMPLE_RANGE, &sample -> range, sizeof (sample -> range));
-		}
-
-		if (sample -> sustainRange [0] || sample -> sustainRange [1]) {
-			BKSetPtr (&sample -> data, BK_SAMPLE_SUSTAIN_RANGE, &sample -> sustainRange, sizeof (sample -> sustainRange));
-		}
-
-		BKSetAttr (&sample -> data, BK_SAMPLE_PITCH, (BKInt) (((uint64_t) sample -> pitch * BK_FINT20_UNIT) / 100));
+		BKTKSampleApplyAttributes (sample);
 	}
 
 	cleanup: {
@@ -330,6 +425,29 @@ static BKInt BKTKContextLoadSamples (BKTKContext * ctx, BKTKCompiler * compiler)
 	}
 }
 
+static BKInt BKTKContextPrepareTrack (BKTKContext * ctx, BKTKTrack * track, BKUInt octaveSize)
+{
+	BKInt res;
+
+	if ((res = BKTKInterpreterInit (&track -> interpreter)) != 0) {
+		return res;
+	}
+
+	if ((res = BKTrackInit (&track -> renderTrack, BK_SQUARE)) != 0) {
+		return res;
+	}
+
+	BKSetAttr (&track -> renderTrack, BK_VOLUME, BK_MAX_VOLUME);
+
+	track -> object.object.flags |= ctx -> object.flags;
+	track -> interpreter.opcode = (void *) track -> code;
+	track -> interpreter.opcodePtr = track -> interpreter.opcode;
+	track -> interpreter.octaveSize = octaveSize;
+	track -> ctx = ctx;
+
+	return 0;
+}
+
 static BKInt BKTKContextCreateTracks (BKTKContext * ctx, BKTKCompiler * compiler)
 {
 	BKInt res = 0;
@@ -351,6 +469,12 @@ static BKInt BKTKContextCreateTracks (BKTKContext * ctx, BKTKCompiler * compiler
 
 	BKArrayEmpty (&compiler -> tracks);
 
+	// move program image
+	ctx -> program = compiler -> program;
+	compiler -> program = BK_BYTE_BUFFER_INIT;
+	ctx -> code = ctx -> program.first ? ctx -> program.first -> data : NULL;
+	ctx -> codeSize = BKByteBufferSize (&ctx -> program);
+
 	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
 		BKTKTrack ** trackRef = BKArrayItemAt (&ctx -> tracks, i);
 		BKTKTrack * track = *trackRef;
@@ -359,21 +483,19 @@ static BKInt BKTKContextCreateTracks (BKTKContext * ctx, BKTKCompiler * compiler
 			continue;
 		}
 
-		if ((res = BKTKInterpreterInit (&track -> interpreter)) != 0) {
-			goto cleanup;
+		track -> code = ctx -> code + track -> codeOffset;
+
+		for (BKUSize j = 0; j < track -> groups.len; j ++) {
+			BKTKGroup * group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, j);
+
+			if (group && group -> codeSize) {
+				group -> code = ctx -> code + group -> codeOffset;
+			}
 		}
 
-		if ((res = BKTrackInit (&track -> renderTrack, BK_SQUARE)) != 0) {
+		if ((res = BKTKContextPrepareTrack (ctx, track, compiler -> octaveSize)) != 0) {
 			goto cleanup;
 		}
-
-		BKSetAttr (&track -> renderTrack, BK_VOLUME, BK_MAX_VOLUME);
-
-		track -> object.object.flags |= ctx -> object.flags;
-		track -> interpreter.opcode = track -> byteCode.first -> data;
-		track -> interpreter.opcodePtr = track -> interpreter.opcode;
-		track -> interpreter.octaveSize = compiler -> octaveSize;
-		track -> ctx = ctx;
 	}
 
 	cleanup: {
@@ -455,201 +577,1819 @@ BKInt BKTKContextCreate (BKTKContext * ctx, BKTKCompiler * compiler)
 	}
 }
 
-static void writeTimingData (BKTKTrack * track, char const * data, ...)
+/**
+ * Program layout; all fields are 32 bit words
+ *
+ * header:     magic, version, file info (4), number of instruments, waveforms,
+ *             samples and tracks
+ * instrument: present, name length, name, sequences size, sequences
+ * waveform:   present, name length, name, frames, channels, frame data
+ * sample:     present, name length, name, pitch, repeat, range (2),
+ *             sustain range (2), frames, channels, frame data
+ * track:      present, flags, waveform, code size, code, number of groups
+ *             followed by groups: present, code size, code
+ */
+struct BKTKProgramReader
 {
-	va_list args;
-	char buffer [1024];
-	BKInt size;
+	uint8_t const * ptr;
+	uint8_t const * end;
+};
 
-	buffer [0] = '\0';
+static BKInt writeProgramData (BKTKWriterWriteFunc write, void * userInfo, void const * data, BKUSize size)
+{
+	BKInt res;
+	static uint8_t const padding [4] = {0};
 
-	va_start (args, data);
-	size = vsnprintf (buffer, sizeof (buffer), data, args);
-	va_end (args);
+	if (size && (res = write (userInfo, data, size)) != 0) {
+		return res;
+	}
 
-	if (size >= 0) {
-		BKByteBufferAppendBytes (&track -> timingData, buffer, size);
+	if (size % 4) {
+		if ((res = write (userInfo, padding, 4 - size % 4)) != 0) {
+			return res;
+		}
 	}
+
+	return 0;
 }
 
-static void writeTimingLine (BKTKTrack * track)
+static BKInt writeProgramWord (BKTKWriterWriteFunc write, void * userInfo, uint32_t value)
 {
-	BKTKInterpreter * interpreter = & track -> interpreter;
-	BKEnum type = track -> object.object.flags & BKTKContextOptionTimingDataMask;
-	float tickTime = 0;
+	return write (userInfo, (uint8_t const *) &value, sizeof (value));
+}
 
-	if (type == BKTKContextOptionTimingDataSecs) {
-		BKContext * ctx = track -> ctx -> renderContext;
-		BKTime masterTick;
-		BKInt sampleRate;
+static BKInt writeProgramFrames (BKTKWriterWriteFunc write, void * userInfo, BKData const * data)
+{
+	BKInt res;
 
-		BKGetPtr (ctx, BK_CLOCK_PERIOD, & masterTick, sizeof (masterTick));
-		BKGetAttr (ctx, BK_SAMPLE_RATE, & sampleRate);
-		tickTime = (float) BKTimeGetTime (masterTick);
-		tickTime += (float) BKTimeGetFrac (masterTick) / BK_FINT20_UNIT;
-		tickTime = tickTime / sampleRate * interpreter -> lineTime;
-	}
-	else if (type == BKTKContextOptionTimingDataTicks) {
-		tickTime = interpreter -> lineTime;
+	if ((res = writeProgramWord (write, userInfo, data -> numFrames)) != 0) {
+		return res;
 	}
 
-	if (interpreter -> lineno != track -> lineno + 1) {
-		writeTimingData (track, "l:%.5g:%u\n", tickTime, interpreter -> lineno);
-	}
-	else {
-		writeTimingData (track, "l:%.5g\n", tickTime);
+	if ((res = writeProgramWord (write, userInfo, data -> numChannels)) != 0) {
+		return res;
 	}
+
+	return writeProgramData (write, userInfo, data -> frames, (BKUSize) data -> numFrames * data -> numChannels * sizeof (BKFrame));
 }
 
-static BKEnum dividerCallback (BKCallbackInfo * info, BKTKTrack * track)
+static BKInt readProgramWord (struct BKTKProgramReader * reader, uint32_t * outValue)
 {
-	BKInt ticks;
-	BKTKInterpreter * interpreter = &track -> interpreter;
-
-	BKTKInterpreterAdvance (&track -> interpreter, track, &ticks);
-	info -> divider = ticks;
-
-	if (track -> object.object.flags & BKTKContextOptionTimingDataMask) {
-		if ((interpreter -> object.flags & BKTKInterpreterFlagHasRepeated) == 0) {
-			if (interpreter -> lineno != track -> lineno) {
-				writeTimingLine (track);
-			}
-		}
+	if ((BKUSize) (reader -> end - reader -> ptr) < sizeof (*outValue)) {
+		return -1;
 	}
 
-	track -> lineno = interpreter -> lineno;
+	*outValue = *(uint32_t const *) reader -> ptr;
+	reader -> ptr += sizeof (*outValue);
 
 	return 0;
 }
 
-BKInt BKTKContextAttach (BKTKContext * ctx, BKContext * renderContext)
+static BKInt readProgramData (struct BKTKProgramReader * reader, BKUSize size, void const ** outData)
 {
-	BKInt res;
-	BKTKTrack * track;
-	BKCallback callback;
+	BKUSize padded = (size + 3) & ~(BKUSize) 3;
 
-	if (ctx -> renderContext) {
-		return BK_INVALID_STATE;
+	if (padded < size || (BKUSize) (reader -> end - reader -> ptr) < padded) {
+		return -1;
 	}
 
-	ctx -> renderContext = renderContext;
-	callback.func = (BKCallbackFunc) dividerCallback;
-
-	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
-		track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i);
+	*outData = reader -> ptr;
+	reader -> ptr += padded;
 
-		if (track) {
-			if ((res = BKTrackAttach (&track -> renderTrack, ctx -> renderContext)) != 0) {
-				return res;
-			}
+	return 0;
+}
 
-			callback.userInfo = track;
+static BKInt readProgramName (struct BKTKProgramReader * reader, BKString * name)
+{
+	uint32_t length;
+	void const * data;
 
-			if ((res = BKDividerInit (&track -> divider, 0, &callback)) != 0) {
-				return res;
-			}
+	if (readProgramWord (reader, &length) != 0 || readProgramData (reader, length, &data) != 0) {
+		return BK_INVALID_VALUE;
+	}
 
-			if ((res = BKContextAttachDivider (ctx -> renderContext, &track -> divider, BK_CLOCK_TYPE_BEAT)) != 0) {
-				return res;
-			}
-		}
+	if (BKStringAppendLen (name, data, length) != 0) {
+		return BK_ALLOCATION_ERROR;
 	}
 
 	return 0;
 }
 
-void BKTKContextDetach (BKTKContext * ctx)
+static BKInt readProgramFrames (struct BKTKProgramReader * reader, BKData * data)
 {
-	BKTKTrack * track;
+	uint32_t numFrames, numChannels;
+	void const * frames;
 
-	if (!ctx -> renderContext) {
-		return;
+	if (readProgramWord (reader, &numFrames) != 0 || readProgramWord (reader, &numChannels) != 0) {
+		return BK_INVALID_VALUE;
 	}
 
-	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
-		track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i);
+	if (numChannels > BK_MAX_CHANNELS) {
+		return BK_INVALID_VALUE;
+	}
 
-		if (track) {
-			BKDividerDetach (&track -> divider);
-			BKTrackDetach (&track -> renderTrack);
-		}
+	if (readProgramData (reader, (BKUSize) numFrames * numChannels * sizeof (BKFrame), &frames) != 0) {
+		return BK_INVALID_VALUE;
 	}
 
-	ctx -> renderContext = NULL;
+	if (!numFrames || !numChannels) {
+		return 0;
+	}
+
+	return BKDataSetFrames (data, frames, numFrames, numChannels, 1);
 }
 
-static void BKTKTrackReset (BKTKTrack * track)
+static BKInt BKTKInstrumentLoadSequences (BKTKInstrument * instrument, uint32_t const * words, BKUSize numWords)
 {
-	BKDividerReset (&track -> divider);
-	BKTKInterpreterReset (&track -> interpreter);
-	BKTrackReset (&track -> renderTrack);
-	track -> lineno = 0;
+	BKInt res = 0;
+	BKUInt length;
+	BKInt kind, slot, sustainOffset, sustainLength;
+	BKSequencePhase * phases = NULL;
 
-	BKByteBufferDispose (&track -> timingData);
-	track -> timingData = BK_BYTE_BUFFER_INIT;
-}
+	while (numWords) {
+		if (numWords < 5) {
+			return BK_INVALID_VALUE;
+		}
 
-void BKTKContextReset (BKTKContext * ctx)
-{
-	BKTKTrack * track;
+		kind = words [0];
+		slot = words [1];
+		length = words [2];
+		sustainOffset = words [3];
+		sustainLength = words [4];
+		words += 5;
+		numWords -= 5;
+
+		switch (kind) {
+			case BKTKSequenceRecordValues: {
+				if (numWords < length) {
+					return BK_INVALID_VALUE;
+				}
 
-	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
-		track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i);
-		BKTKTrackReset (track);
+				res = BKTKInstrumentSetSequence (instrument, slot, (BKInt const *) words, length, sustainOffset, sustainLength);
+				break;
+			}
+			case BKTKSequenceRecordPhases: {
+				if (numWords / 2 < length) {
+					return BK_INVALID_VALUE;
+				}
+
+				phases = malloc (BKMax (length, 1) * sizeof (*phases));
+
+				if (!phases) {
+					return BK_ALLOCATION_ERROR;
+				}
+
+				for (BKUInt i = 0; i < length; i ++) {
+					phases [i].steps = words [i * 2];
+					phases [i].value = words [i * 2 + 1];
+				}
+
+				res = BKTKInstrumentSetEnvelope (instrument, slot, phases, length, sustainOffset, sustainLength);
+				free (phases);
+				length *= 2;
+				break;
+			}
+			case BKTKSequenceRecordADSR: {
+				if (length != 4 || numWords < length) {
+					return BK_INVALID_VALUE;
+				}
+
+				res = BKTKInstrumentSetEnvelopeADSR (instrument, words [0], words [1], words [2], words [3]);
+				break;
+			}
+			default: {
+				return BK_INVALID_VALUE;
+			}
+		}
+
+		if (res < 0) {
+			return res;
+		}
+
+		words += length;
+		numWords -= length;
 	}
 
-	BKStringEmpty (&ctx -> error);
+	return 0;
 }
 
-static void BKTKContextDispose (BKTKContext * ctx)
+/**
+ * Read offset and size of track or group code in program image
+ */
+static BKInt readProgramCode (BKTKContext const * ctx, struct BKTKProgramReader * reader, uint8_t const ** outCode, BKSize * outSize)
 {
-	BKTKContextDetach (ctx);
-
-	for (BKUSize i = 0; i < ctx -> instruments.len; i ++) {
-		BKDispose (*(BKTKInstrument **) BKArrayItemAt (&ctx -> instruments, i));
-	}
+	uint32_t offset, size;
 
-	for (BKUSize i = 0; i < ctx -> waveforms.len; i ++) {
-		BKDispose (*(BKTKWaveform **)BKArrayItemAt (&ctx -> waveforms, i));
+	if (readProgramWord (reader, &offset) != 0 || readProgramWord (reader, &size) != 0) {
+		return -1;
 	}
 
-	for (BKUSize i = 0; i < ctx -> samples.len; i ++) {
-		BKDispose (*(BKTKSample **)BKArrayItemAt (&ctx -> samples, i));
+	if (!size || offset % BK_INTR_CODE_UNIT || size % BK_INTR_CODE_UNIT || offset > ctx -> codeSize || size > ctx -> codeSize - offset) {
+		return -1;
 	}
 
-	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
-		BKDispose (*(BKTKTrack **)BKArrayItemAt (&ctx -> tracks, i));
-	}
+	*outCode = ctx -> code + offset;
+	*outSize = size;
 
-	BKArrayDispose (&ctx -> instruments);
-	BKArrayDispose (&ctx -> waveforms);
-	BKArrayDispose (&ctx -> samples);
-	BKArrayDispose (&ctx -> tracks);
+	return 0;
 }
 
-BKClass const BKTKContextClass =
+/**
+ * Sorted offsets of group code used to check call targets
+ */
+struct BKTKProgramGroups
 {
-	.instanceSize = sizeof (BKTKContext),
-	.dispose      = (void *) BKTKContextDispose,
+	BKSize * offsets;
+	BKUSize  count;
 };
 
-BKClass const BKTKGroupClass =
+static int compareOffsets (void const * a, void const * b)
 {
-	.instanceSize = sizeof (BKTKGroup),
-	.dispose      = (void *) BKTKGroupDispose,
-};
+	BKSize x = *(BKSize const *) a, y = *(BKSize const *) b;
 
-BKClass const BKTKTrackClass =
-{
-	.instanceSize = sizeof (BKTKTrack),
-	.dispose      = (void *) BKTKTrackDispose,
-};
+	return x < y ? -1 : x > y;
+}
 
-BKClass const BKTKInstrumentClass =
+/**
+ * Check if call target is the beginning of group code
+ */
+static BKInt checkProgramCallTarget (struct BKTKProgramGroups const * groups, BKSize target)
 {
-	.instanceSize = sizeof (BKTKInstrument),
-	.dispose      = (void *) BKTKInstrumentDispose,
-};
+	return bsearch (&target, groups -> offsets, groups -> count, sizeof (BKSize), compareOffsets) ? 0 : -1;
+}
+
+/**
+ * Check operands of decoded instruction
+ *
+ * Instrument, waveform and sample indices have to refer to objects present
+ * in the program. The interpreter does not check them.
+ */
+static BKInt checkProgramInstr (BKTKContext const * ctx, BKInstrMask mask)
+{
+	BKInt value = mask.arg1.arg1;
+	void * const * item;
+
+	switch (mask.arg1.cmd) {
+		case BKIntrArpeggio: {
+			if (value < 0 || value > BK_MAX_ARPEGGIO) {
+				return -1;
+			}
+			break;
+		}
+		case BKIntrInstrument: {
+			// -1 disables instrument
+			if (value != -1) {
+				item = BKArrayItemAt (&ctx -> instruments, value);
+
+				if (value < 0 || !item || !*item) {
+					return -1;
+				}
+			}
+			break;
+		}
+		case BKIntrWaveform: {
+			if (value & BK_INTR_CUSTOM_WAVEFORM_FLAG) {
+				value &= ~BK_INTR_CUSTOM_WAVEFORM_FLAG;
+				item = BKArrayItemAt (&ctx -> waveforms, value);
+
+				if (value < 0 || !item || !*item) {
+					return -1;
+				}
+			}
+			break;
+		}
+		case BKIntrSample: {
+			item = BKArrayItemAt (&ctx -> samples, value);
+
+			if (value < 0 || !item || !*item) {
+				return -1;
+			}
+			break;
+		}
+		case BKIntrPulseKernel: {
+			if (value < BK_PULSE_KERNEL_HARM || value > BK_PULSE_KERNEL_SINC) {
+				return -1;
+			}
+			break;
+		}
+	}
+
+	return 0;
+}
+
+#if BK_TK_COMPACT_CODE
+
+/**
+ * Read varint operand of compact code which must not exceed `end`
+ */
+static BKInt readProgramOperand (uint8_t const ** ptr, uint8_t const * end, BKInt * outValue)
+{
+	uint8_t const * p = *ptr;
+
+	for (BKUSize i = 0; i < BK_INTR_MAX_VARINT_SIZE; i ++) {
+		if (p + i >= end) {
+			return -1;
+		}
+
+		if (!(p [i] & 0x80)) {
+			*outValue = BKInstrReadVarint (ptr);
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * Check if instructions of code are complete and valid, calls jump to group
+ * code and the code ends with `BKIntrEnd` or `BKIntrReturn`
+ */
+static BKInt checkProgramCode (BKTKContext const * ctx, struct BKTKProgramGroups const * groups, uint8_t const * code, BKSize codeSize)
+{
+	BKUInt cmd = BKIntrNoop;
+	BKInt operands [2];
+	BKInt value;
+	BKUInt numOperands, numArgs;
+	BKInstrMask mask;
+	uint8_t const * instr;
+	uint8_t const * ptr = code;
+	uint8_t const * end = code + codeSize;
+
+	while (ptr < end) {
+		instr = ptr;
+		cmd = *ptr ++;
+		numOperands = BKInstrNumOperands (cmd);
+		numArgs = 0;
+
+		for (BKUInt i = 0; i < numOperands; i ++) {
+			if (readProgramOperand (&ptr, end, &operands [i]) != 0) {
+				return -1;
+			}
+		}
+
+		// fields are truncated as when decoding
+		mask.value = 0;
+		mask.arg1.cmd = cmd;
+
+		if (numOperands == 1) {
+			mask.arg1.arg1 = operands [0];
+		}
+		else if (numOperands == 2) {
+			mask.arg2.arg1 = operands [0];
+			mask.arg2.arg2 = operands [1];
+		}
+
+		if (checkProgramInstr (ctx, mask) != 0) {
+			return -1;
+		}
+
+		switch (cmd) {
+			case BKIntrArpeggio: {
+				numArgs = mask.arg1.arg1;
+				break;
+			}
+			case BKIntrEffect: {
+				numArgs = 5;
+				break;
+			}
+			case BKIntrSampleRange:
+			case BKIntrSampleSustainRange: {
+				numArgs = 2;
+				break;
+			}
+			case BKIntrCall: {
+				if (checkProgramCallTarget (groups, (instr - ctx -> code) + (BKSize) mask.arg1.arg1) != 0) {
+					return -1;
+				}
+				break;
+			}
+		}
+
+		for (BKUInt i = 0; i < numArgs; i ++) {
+			if (readProgramOperand (&ptr, end, &value) != 0) {
+				return -1;
+			}
+		}
+	}
+
+	return cmd == BKIntrEnd || cmd == BKIntrReturn ? 0 : -1;
+}
+
+#else
+
+/**
+ * Check if instructions of code are complete and valid, calls jump to group
+ * code and the code ends with `BKIntrEnd` or `BKIntrReturn`
+ */
+static BKInt checkProgramCode (BKTKContext const * ctx, struct BKTKProgramGroups const * groups, uint8_t const * code, BKSize codeSize)
+{
+	BKInstrMask mask;
+	BKSize size;
+	BKUInt cmd = BKIntrNoop;
+	BKSize numWords = codeSize / sizeof (uint32_t);
+	BKSize codeIndex = (code - ctx -> code) / sizeof (uint32_t);
+
+	for (BKSize i = 0; i < numWords; i += size) {
+		mask.value = ((uint32_t const *) code) [i];
+		cmd = mask.arg1.cmd;
+
+		if (checkProgramInstr (ctx, mask) != 0) {
+			return -1;
+		}
+
+		// arguments must not exceed code
+		size = BKInstrMaskSize (mask);
+
+		if (size > numWords - i) {
+			return -1;
+		}
+
+		if (cmd == BKIntrCall) {
+			if (checkProgramCallTarget (groups, (codeIndex + i + mask.arg1.arg1) * sizeof (uint32_t)) != 0) {
+				return -1;
+			}
+		}
+	}
+
+	return cmd == BKIntrEnd || cmd == BKIntrReturn ? 0 : -1;
+}
+
+#endif /* BK_TK_COMPACT_CODE */
+
+/**
+ * Check code of all tracks and groups after loading
+ */
+static BKInt checkProgram (BKTKContext const * ctx)
+{
+	BKInt res = 0;
+	BKTKTrack const * track;
+	BKTKGroup const * group;
+	struct BKTKProgramGroups groups = {NULL, 0};
+	BKUSize numGroups = 0;
+
+	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+		if ((track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i))) {
+			numGroups += track -> groups.len;
+		}
+	}
+
+	if ((groups.offsets = malloc (BKMax (numGroups, 1) * sizeof (BKSize))) == NULL) {
+		return BK_ALLOCATION_ERROR;
+	}
+
+	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+		if (!(track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i))) {
+			continue;
+		}
+
+		for (BKUSize j = 0; j < track -> groups.len; j ++) {
+			if ((group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, j))) {
+				groups.offsets [groups.count ++] = group -> code - ctx -> code;
+			}
+		}
+	}
+
+	qsort (groups.offsets, groups.count, sizeof (BKSize), compareOffsets);
+
+	for (BKUSize i = 0; i < ctx -> tracks.len && res == 0; i ++) {
+		if (!(track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i))) {
+			continue;
+		}
+
+		if (checkProgramCode (ctx, &groups, track -> code, track -> codeSize) != 0) {
+			res = BK_INVALID_VALUE;
+			break;
+		}
+
+		for (BKUSize j = 0; j < track -> groups.len; j ++) {
+			if ((group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, j))) {
+				if (checkProgramCode (ctx, &groups, group -> code, group -> codeSize) != 0) {
+					res = BK_INVALID_VALUE;
+					break;
+				}
+			}
+		}
+	}
+
+	free (groups.offsets);
+
+	return res;
+}
+
+static BKInt BKTKContextLoadTrack (BKTKContext * ctx, struct BKTKProgramReader * reader, BKTKTrack * track)
+{
+	uint32_t value, numGroups;
+	BKTKGroup * group;
+
+	if (readProgramWord (reader, &value) != 0) {
+		return BK_INVALID_VALUE;
+	}
+
+	track -> object.object.flags |= value & (BKTKFlagUsed | BKTKFlagAutoIndex);
+
+	if (readProgramWord (reader, &value) != 0) {
+		return BK_INVALID_VALUE;
+	}
+
+	track -> waveform = value;
+
+	if (readProgramCode (ctx, reader, &track -> code, &track -> codeSize) != 0) {
+		return BK_INVALID_VALUE;
+	}
+
+	if (readProgramWord (reader, &numGroups) != 0 || numGroups > (BKUSize) (reader -> end - reader -> ptr)) {
+		return BK_INVALID_VALUE;
+	}
+
+	if (BKArrayResize (&track -> groups, numGroups) != 0) {
+		return BK_ALLOCATION_ERROR;
+	}
+
+	for (BKUSize i = 0; i < numGroups; i ++) {
+		if (readProgramWord (reader, &value) != 0) {
+			return BK_INVALID_VALUE;
+		}
+
+		if (!value) {
+			continue;
+		}
+
+		group = calloc (1, sizeof (BKTKGroup));
+
+		if (!group) {
+			return BK_ALLOCATION_ERROR;
+		}
+
+		*(BKTKGroup **) BKArrayItemAt (&track -> groups, i) = group;
+		group -> byteCode = BK_BYTE_BUFFER_INIT;
+		group -> object.index = (BKInt) i;
+		group -> object.object.flags |= BKTKFlagUsed;
+
+		if (readProgramCode (ctx, reader, &group -> code, &group -> codeSize) != 0) {
+			return BK_INVALID_VALUE;
+		}
+	}
+
+	return 0;
+}
+
+BKInt BKTKContextLoadProgram (BKTKContext * ctx, void const * data, BKUSize size)
+{
+	BKInt res = 0;
+	uint32_t header [11];
+	uint32_t value;
+	void const * bytes;
+	struct BKTKProgramReader reader = {data, (uint8_t const *) data + size};
+
+	if ((uintptr_t) data % 4) {
+		printError (ctx, "Error: program data is not aligned");
+		return BK_INVALID_VALUE;
+	}
+
+	for (BKUSize i = 0; i < 11; i ++) {
+		if (readProgramWord (&reader, &header [i]) != 0) {
+			goto invalidError;
+		}
+	}
+
+	if (memcmp (&header [0], BK_TK_PROGRAM_MAGIC, 4) != 0) {
+		printError (ctx, "Error: not a compiled program");
+		return BK_INVALID_VALUE;
+	}
+
+	if (header [10] == BK_TK_PROGRAM_BYTE_ORDER_SWAPPED) {
+		printError (ctx, "Error: program was written with a different byte order");
+		return BK_INVALID_VALUE;
+	}
+
+	if ((header [1] ^ BK_TK_PROGRAM_VERSION) == BK_TK_PROGRAM_COMPACT_CODE) {
+		printError (ctx, "Error: program code has a different encoding");
+		return BK_INVALID_VALUE;
+	}
+
+	if (header [1] != BK_TK_PROGRAM_VERSION) {
+		printError (ctx, "Error: unsupported program version %u", header [1]);
+		return BK_INVALID_VALUE;
+	}
+
+	if (header [10] != BK_TK_PROGRAM_BYTE_ORDER) {
+		goto invalidError;
+	}
+
+	ctx -> info.stepTicks = header [2];
+	ctx -> info.tickRate.factor = header [3];
+	ctx -> info.tickRate.divisor = header [4];
+	ctx -> info.octaveSize = header [5];
+
+	// every item has at least one word
+	for (BKUSize i = 6; i < 10; i ++) {
+		if (header [i] > size / 4) {
+			goto invalidError;
+		}
+	}
+
+	if (BKArrayResize (&ctx -> instruments, header [6]) != 0 ||
+		BKArrayResize (&ctx -> waveforms, header [7]) != 0 ||
+		BKArrayResize (&ctx -> samples, header [8]) != 0 ||
+		BKArrayResize (&ctx -> tracks, header [9]) != 0) {
+		goto allocationError;
+	}
+
+	for (BKUSize i = 0; i < ctx -> instruments.len; i ++) {
+		BKTKInstrument * instrument;
+
+		if (readProgramWord (&reader, &value) != 0) {
+			goto invalidError;
+		}
+
+		if (!value) {
+			continue;
+		}
+
+		if ((res = BKTKInstrumentAlloc (&instrument)) != 0) {
+			goto allocationError;
+		}
+
+		*(BKTKInstrument **) BKArrayItemAt (&ctx -> instruments, i) = instrument;
+		instrument -> object.index = (BKInt) i;
+
+		if ((res = readProgramName (&reader, &instrument -> name)) != 0) {
+			goto cleanup;
+		}
+
+		if (readProgramWord (&reader, &value) != 0 || value % 4 || readProgramData (&reader, value, &bytes) != 0) {
+			goto invalidError;
+		}
+
+		if ((res = BKTKInstrumentLoadSequences (instrument, bytes, value / 4)) != 0) {
+			printError (ctx, "Error: invalid sequence in instrument '%s'", instrument -> name.str);
+			goto cleanup;
+		}
+	}
+
+	for (BKUSize i = 0; i < ctx -> waveforms.len; i ++) {
+		BKTKWaveform * waveform;
+
+		if (readProgramWord (&reader, &value) != 0) {
+			goto invalidError;
+		}
+
+		if (!value) {
+			continue;
+		}
+
+		if ((res = BKTKWaveformAlloc (&waveform)) != 0) {
+			goto allocationError;
+		}
+
+		*(BKTKWaveform **) BKArrayItemAt (&ctx -> waveforms, i) = waveform;
+		waveform -> object.index = (BKInt) i;
+
+		if ((res = readProgramName (&reader, &waveform -> name)) != 0) {
+			goto cleanup;
+		}
+
+		if ((res = readProgramFrames (&reader, &waveform -> data)) != 0) {
+			goto cleanup;
+		}
+	}
+
+	for (BKUSize i = 0; i < ctx -> samples.len; i ++) {
+		BKTKSample * sample;
+		uint32_t attrs [6];
+
+		if (readProgramWord (&reader, &value) != 0) {
+			goto invalidError;
+		}
+
+		if (!value) {
+			continue;
+		}
+
+		if ((res = BKTKSampleAlloc (&sample)) != 0) {
+			goto allocationError;
+		}
+
+		*(BKTKSample **) BKArrayItemAt (&ctx -> samples, i) = sample;
+		sample -> object.index = (BKInt) i;
+
+		if ((res = readProgramName (&reader, &sample -> name)) != 0) {
+			goto cleanup;
+		}
+
+		for (BKUSize j = 0; j < 6; j ++) {
+			if (readProgramWord (&reader, &attrs [j]) != 0) {
+				goto invalidError;
+			}
+		}
+
+		sample -> pitch = attrs [0];
+		sample -> repeat = attrs [1];
+		sample -> range [0] = attrs [2];
+		sample -> range [1] = attrs [3];
+		sample -> sustainRange [0] = attrs [4];
+		sample -> sustainRange [1] = attrs [5];
+
+		if ((res = readProgramFrames (&reader, &sample -> data)) != 0) {
+			goto cleanup;
+		}
+
+		BKTKSampleApplyAttributes (sample);
+	}
+
+	if (readProgramWord (&reader, &value) != 0 || !value || value % BK_INTR_CODE_UNIT || readProgramData (&reader, value, &bytes) != 0) {
+		goto invalidError;
+	}
+
+	ctx -> code = bytes;
+	ctx -> codeSize = value;
+
+	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+		BKTKTrack * track;
+
+		if (readProgramWord (&reader, &value) != 0) {
+			goto invalidError;
+		}
+
+		if (!value) {
+			continue;
+		}
+
+		track = calloc (1, sizeof (BKTKTrack));
+
+		if (!track) {
+			goto allocationError;
+		}
+
+		*(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i) = track;
+		track -> byteCode = BK_BYTE_BUFFER_INIT;
+		track -> groups = BK_ARRAY_INIT (sizeof (BKTKGroup *));
+		track -> object.index = (BKInt) i;
+
+		if ((res = BKTKContextLoadTrack (ctx, &reader, track)) != 0) {
+			goto cleanup;
+		}
+
+		if ((res = BKTKContextPrepareTrack (ctx, track, ctx -> info.octaveSize)) != 0) {
+			goto cleanup;
+		}
+	}
+
+	// code is checked after all group offsets are known
+	res = checkProgram (ctx);
+
+	cleanup: {
+		if (res == BK_INVALID_VALUE && !ctx -> error.len) {
+			printError (ctx, "Error: program data is malformed");
+		}
+		else if (res == BK_ALLOCATION_ERROR) {
+			printError (ctx, "Error: allocation error");
+		}
+
+		return res;
+	}
+
+	invalidError: {
+		res = BK_INVALID_VALUE;
+		goto cleanup;
+	}
+
+	allocationError: {
+		res = BK_ALLOCATION_ERROR;
+		goto cleanup;
+	}
+}
+
+BKInt BKTKContextWriteProgram (BKTKContext const * ctx, BKTKWriterWriteFunc write, void * userInfo)
+{
+	BKInt res;
+	uint32_t header [11] = {
+		0,
+		BK_TK_PROGRAM_VERSION,
+		ctx -> info.stepTicks,
+		ctx -> info.tickRate.factor,
+		ctx -> info.tickRate.divisor,
+		ctx -> info.octaveSize,
+		(uint32_t) ctx -> instruments.len,
+		(uint32_t) ctx -> waveforms.len,
+		(uint32_t) ctx -> samples.len,
+		(uint32_t) ctx -> tracks.len,
+		BK_TK_PROGRAM_BYTE_ORDER,
+	};
+
+	memcpy (&header [0], BK_TK_PROGRAM_MAGIC, 4);
+
+	if ((res = writeProgramData (write, userInfo, header, sizeof (header))) != 0) {
+		return res;
+	}
+
+	for (BKUSize i = 0; i < ctx -> instruments.len; i ++) {
+		BKTKInstrument const * instrument = *(BKTKInstrument **) BKArrayItemAt (&ctx -> instruments, i);
+		BKUSize size;
+		void * sequences;
+
+		if ((res = writeProgramWord (write, userInfo, instrument != NULL)) != 0) {
+			return res;
+		}
+
+		if (!instrument) {
+			continue;
+		}
+
+		if ((res = writeProgramWord (write, userInfo, (uint32_t) instrument -> name.len)) != 0) {
+			return res;
+		}
+
+		if ((res = writeProgramData (write, userInfo, instrument -> name.str, instrument -> name.len)) != 0) {
+			return res;
+		}
+
+		size = BKByteBufferSize (&instrument -> sequences);
+
+		if ((res = writeProgramWord (write, userInfo, (uint32_t) size)) != 0) {
+			return res;
+		}
+
+		sequences = malloc (BKMax (size, 1));
+
+		if (!sequences) {
+			return BK_ALLOCATION_ERROR;
+		}
+
+		BKByteBufferCopy (&instrument -> sequences, sequences);
+		res = writeProgramData (write, userInfo, sequences, size);
+		free (sequences);
+
+		if (res != 0) {
+			return res;
+		}
+	}
+
+	for (BKUSize i = 0; i < ctx -> waveforms.len; i ++) {
+		BKTKWaveform const * waveform = *(BKTKWaveform **) BKArrayItemAt (&ctx -> waveforms, i);
+
+		if ((res = writeProgramWord (write, userInfo, waveform != NULL)) != 0) {
+			return res;
+		}
+
+		if (!waveform) {
+			continue;
+		}
+
+		if ((res = writeProgramWord (write, userInfo, (uint32_t) waveform -> name.len)) != 0) {
+			return res;
+		}
+
+		if ((res = writeProgramData (write, userInfo, waveform -> name.str, waveform -> name.len)) != 0) {
+			return res;
+		}
+
+		if ((res = writeProgramFrames (write, userInfo, &waveform -> data)) != 0) {
+			return res;
+		}
+	}
+
+	for (BKUSize i = 0; i < ctx -> samples.len; i ++) {
+		BKTKSample const * sample = *(BKTKSample **) BKArrayItemAt (&ctx -> samples, i);
+		uint32_t attrs [6];
+
+		if ((res = writeProgramWord (write, userInfo, sample != NULL)) != 0) {
+			return res;
+		}
+
+		if (!sample) {
+			continue;
+		}
+
+		if ((res = writeProgramWord (write, userInfo, (uint32_t) sample -> name.len)) != 0) {
+			return res;
+		}
+
+		if ((res = writeProgramData (write, userInfo, sample -> name.str, sample -> name.len)) != 0) {
+			return res;
+		}
+
+		attrs [0] = sample -> pitch;
+		attrs [1] = sample -> repeat;
+		attrs [2] = sample -> range [0];
+		attrs [3] = sample -> range [1];
+		attrs [4] = sample -> sustainRange [0];
+		attrs [5] = sample -> sustainRange [1];
+
+		if ((res = writeProgramData (write, userInfo, attrs, sizeof (attrs))) != 0) {
+			return res;
+		}
+
+		if ((res = writeProgramFrames (write, userInfo, &sample -> data)) != 0) {
+			return res;
+		}
+	}
+
+	if ((res = writeProgramWord (write, userInfo, (uint32_t) ctx -> codeSize)) != 0) {
+		return res;
+	}
+
+	if ((res = writeProgramData (write, userInfo, ctx -> code, ctx -> codeSize)) != 0) {
+		return res;
+	}
+
+	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+		BKTKTrack const * track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i);
+
+		if ((res = writeProgramWord (write, userInfo, track != NULL)) != 0) {
+			return res;
+		}
+
+		if (!track) {
+			continue;
+		}
+
+		if ((res = writeProgramWord (write, userInfo, track -> object.object.flags & (BKTKFlagUsed | BKTKFlagAutoIndex))) != 0) {
+			return res;
+		}
+
+		if ((res = writeProgramWord (write, userInfo, track -> waveform)) != 0) {
+			return res;
+		}
+
+		if ((res = writeProgramWord (write, userInfo, (uint32_t) (track -> code - ctx -> code))) != 0) {
+			return res;
+		}
+
+		if ((res = writeProgramWord (write, userInfo, (uint32_t) track -> codeSize)) != 0) {
+			return res;
+		}
+
+		if ((res = writeProgramWord (write, userInfo, (uint32_t) track -> groups.len)) != 0) {
+			return res;
+		}
+
+		for (BKUSize j = 0; j < track -> groups.len; j ++) {
+			BKTKGroup const * group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, j);
+
+			if (group && !group -> code) {
+				group = NULL;
+			}
+
+			if ((res = writeProgramWord (write, userInfo, group != NULL)) != 0) {
+				return res;
+			}
+
+			if (!group) {
+				continue;
+			}
+
+			if ((res = writeProgramWord (write, userInfo, (uint32_t) (group -> code - ctx -> code))) != 0) {
+				return res;
+			}
+
+			if ((res = writeProgramWord (write, userInfo, (uint32_t) group -> codeSize)) != 0) {
+				return res;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void writeTimingData (BKTKTrack * track, char const * data, ...)
+{
+	va_list args;
+	char buffer [1024];
+	BKInt size;
+
+	buffer [0] = '\0';
+
+	va_start (args, data);
+	size = vsnprintf (buffer, sizeof (buffer), data, args);
+	va_end (args);
+
+	if (size >= 0) {
+		BKByteBufferAppendBytes (&track -> timingData, buffer, size);
+	}
+}
+
+static void writeTimingLine (BKTKTrack * track)
+{
+	BKTKInterpreter * interpreter = & track -> interpreter;
+	BKEnum type = track -> object.object.flags & BKTKContextOptionTimingDataMask;
+	float tickTime = 0;
+
+	if (type == BKTKContextOptionTimingDataSecs) {
+		BKContext * ctx = track -> ctx -> renderContext;
+		BKTime masterTick;
+		BKInt sampleRate;
+
+		BKGetPtr (ctx, BK_CLOCK_PERIOD, & masterTick, sizeof (masterTick));
+		BKGetAttr (ctx, BK_SAMPLE_RATE, & sampleRate);
+		tickTime = (float) BKTimeGetTime (masterTick);
+		tickTime += (float) BKTimeGetFrac (masterTick) / BK_FINT20_UNIT;
+		tickTime = tickTime / sampleRate * interpreter -> lineTime;
+	}
+	else if (type == BKTKContextOptionTimingDataTicks) {
+		tickTime = interpreter -> lineTime;
+	}
+
+	if (interpreter -> lineno != track -> lineno + 1) {
+		writeTimingData (track, "l:%.5g:%u\n", tickTime, interpreter -> lineno);
+	}
+	else {
+		writeTimingData (track, "l:%.5g\n", tickTime);
+	}
+}
+
+/**
+ * Run interpreter and return number of ticks to next call
+ */
+static BKInt BKTKTrackAdvance (BKTKTrack * track)
+{
+	BKInt ticks;
+	BKTKInterpreter * interpreter = &track -> interpreter;
+
+	BKTKInterpreterAdvance (&track -> interpreter, track, &ticks);
+
+	// no timing data while seeking
+	if ((track -> object.object.flags & BKTKContextOptionTimingDataMask) && !(track -> object.object.flags & (BKTKTrackFlagNoTiming | BKTKTrackFlagRecordState))) {
+		if ((interpreter -> object.flags & BKTKInterpreterFlagHasRepeated) == 0) {
+			if (interpreter -> lineno != track -> lineno) {
+				writeTimingLine (track);
+			}
+		}
+	}
+
+	track -> lineno = interpreter -> lineno;
+
+	return ticks;
+}
+
+static BKEnum dividerCallback (BKCallbackInfo * info, BKTKTrack * track)
+{
+	// wait for remaining ticks after seeking
+	if (track -> seekTicks > 0) {
+		info -> divider = track -> seekTicks;
+		track -> seekTicks = 0;
+
+		return 0;
+	}
+
+	info -> divider = BKTKTrackAdvance (track);
+
+	return 0;
+}
+
+/**
+ * Check if instruction changes the timing or rendering of all tracks
+ */
+static BKInt isContextInstr (BKUInt cmd)
+{
+	switch (cmd) {
+		case BKIntrPulseKernel:
+		case BKIntrStepTicks:
+		case BKIntrTickRate: {
+			return 1;
+		}
+		default: {
+			return 0;
+		}
+	}
+}
+
+#if BK_TK_COMPACT_CODE
+
+/**
+ * Scan code for instructions changing all tracks and for group calls
+ */
+static void scanContextInstrs (uint8_t const * code, BKSize codeSize, BKInt * outContext, BKInt * outCalls)
+{
+	BKUInt cmd;
+	BKInt value = 0;
+	BKUInt numOperands, numArgs;
+	uint8_t const * ptr = code;
+	uint8_t const * end = code + codeSize;
+
+	while (ptr < end) {
+		cmd = *ptr ++;
+		numOperands = BKInstrNumOperands (cmd);
+		numArgs = 0;
+
+		for (BKUInt i = 0; i < numOperands; i ++) {
+			value = BKInstrReadVarint (&ptr);
+		}
+
+		switch (cmd) {
+			case BKIntrArpeggio: {
+				numArgs = value;
+				break;
+			}
+			case BKIntrEffect: {
+				numArgs = 5;
+				break;
+			}
+			case BKIntrSampleRange:
+			case BKIntrSampleSustainRange: {
+				numArgs = 2;
+				break;
+			}
+			case BKIntrCall: {
+				*outCalls = 1;
+				break;
+			}
+			default: {
+				*outContext |= isContextInstr (cmd);
+				break;
+			}
+		}
+
+		for (BKUInt i = 0; i < numArgs; i ++) {
+			BKInstrReadVarint (&ptr);
+		}
+	}
+}
+
+#else
+
+/**
+ * Scan code for instructions changing all tracks and for group calls
+ */
+static void scanContextInstrs (uint8_t const * code, BKSize codeSize, BKInt * outContext, BKInt * outCalls)
+{
+	BKInstrMask mask;
+	BKSize numWords = codeSize / sizeof (uint32_t);
+
+	for (BKSize i = 0; i < numWords; i += BKInstrMaskSize (mask)) {
+		mask.value = ((uint32_t const *) code) [i];
+
+		if (mask.arg1.cmd == BKIntrCall) {
+			*outCalls = 1;
+		}
+		else {
+			*outContext |= isContextInstr (mask.arg1.cmd);
+		}
+	}
+}
+
+#endif /* BK_TK_COMPACT_CODE */
+
+/**
+ * Check if any group changes the timing or rendering of all tracks
+ */
+static BKInt groupsChangeContext (BKTKContext const * ctx)
+{
+	BKInt context = 0, calls = 0;
+	BKTKTrack const * track;
+	BKTKGroup const * group;
+
+	for (BKUSize i = 0; i < ctx -> tracks.len && !context; i ++) {
+		if (!(track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i))) {
+			continue;
+		}
+
+		for (BKUSize j = 0; j < track -> groups.len; j ++) {
+			if ((group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, j)) && group -> code) {
+				scanContextInstrs (group -> code, group -> codeSize, &context, &calls);
+			}
+		}
+	}
+
+	return context;
+}
+
+/**
+ * Check if track may change the timing or rendering of all tracks
+ *
+ * Calls are not followed; the track is assumed to change the context if it
+ * calls any group and `groupsChange` is set.
+ */
+static BKInt trackChangesContext (BKTKTrack const * track, BKInt groupsChange)
+{
+	BKInt context = 0, calls = 0;
+
+	if (track -> code) {
+		scanContextInstrs (track -> code, track -> codeSize, &context, &calls);
+	}
+
+	return context || (calls && groupsChange);
+}
+
+BKInt BKTKContextAttachShard (BKTKContext * ctx, BKContext * renderContext, BKInt shardIndex, BKInt numShards)
+{
+	BKInt res;
+	BKTKTrack * track;
+	BKCallback callback;
+	BKInt trackCount = 0;
+	BKInt runAll = shardIndex == 0;
+	BKInt groupsChange = 0;
+
+	if (ctx -> renderContext) {
+		return BK_INVALID_STATE;
+	}
+
+	if (numShards < 1 || shardIndex < 0 || shardIndex >= numShards) {
+		return BK_INVALID_VALUE;
+	}
+
+	ctx -> renderContext = renderContext;
+	callback.func = (BKCallbackFunc) dividerCallback;
+
+	if (!runAll) {
+		groupsChange = groupsChangeContext (ctx);
+	}
+
+	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i);
+
+		if (track) {
+			BKInt run = runAll;
+
+			if ((trackCount ++ % numShards) == shardIndex) {
+				track -> object.object.flags &= ~BKTKTrackFlagSilent;
+
+				if ((res = BKTrackAttach (&track -> renderTrack, ctx -> renderContext)) != 0) {
+					return res;
+				}
+
+				run = 1;
+			}
+			else {
+				track -> object.object.flags |= BKTKTrackFlagSilent;
+
+				if (!run) {
+					run = trackChangesContext (track, groupsChange);
+				}
+			}
+
+			callback.userInfo = track;
+
+			if ((res = BKDividerInit (&track -> divider, 0, &callback)) != 0) {
+				return res;
+			}
+
+			// interpreters of other tracks only have to run if they change
+			// the timing or rendering of the rendered tracks
+			if (run) {
+				if ((res = BKContextAttachDivider (ctx -> renderContext, &track -> divider, BK_CLOCK_TYPE_BEAT)) != 0) {
+					return res;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+BKInt BKTKContextAttach (BKTKContext * ctx, BKContext * renderContext)
+{
+	return BKTKContextAttachShard (ctx, renderContext, 0, 1);
+}
+
+/**
+ * Make rendered tracks silent and record track state while running interpreters
+ */
+static void BKTKContextBeginSilent (BKTKContext * ctx)
+{
+	BKTKTrack * track;
+
+	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i);
+
+		if (track) {
+			if (!(track -> object.object.flags & BKTKTrackFlagSilent)) {
+				track -> object.object.flags |= BKTKTrackFlagSilent | BKTKTrackFlagSeeking;
+			}
+
+			track -> object.object.flags |= BKTKTrackFlagRecordState;
+		}
+	}
+}
+
+/**
+ * Apply recorded state to tracks made silent by `BKTKContextBeginSilent`
+ */
+static void BKTKContextEndSilent (BKTKContext * ctx)
+{
+	BKTKTrack * track;
+
+	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i);
+
+		if (track) {
+			track -> object.object.flags &= ~BKTKTrackFlagRecordState;
+		}
+
+		if (track && (track -> object.object.flags & BKTKTrackFlagSeeking)) {
+			track -> object.object.flags &= ~(BKTKTrackFlagSilent | BKTKTrackFlagSeeking);
+
+			BKTrackReset (&track -> renderTrack);
+			BKSetAttr (&track -> renderTrack, BK_VOLUME, BK_MAX_VOLUME);
+			BKTKTrackStateApply (&track -> state, &track -> renderTrack);
+		}
+	}
+}
+
+static BKInt BKTKContextHasEnded (BKTKContext const * ctx)
+{
+	BKTKTrack * track;
+
+	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i);
+
+		if (track && !(track -> interpreter.object.flags & (BKTKInterpreterFlagHasStopped | BKTKInterpreterFlagHasRepeated))) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * Run interpreters without rendering
+ *
+ * Runs ticks beginning at `tickTime` until `time` or `maxTicks` is reached.
+ * `time` may be NULL to only stop at `maxTicks`. If `untilEnd` is set, also
+ * stops at the tick where all tracks have stopped or repeated. `tickTime` is
+ * set to the time of the next tick to run. Returns the number of ticks run.
+ */
+static BKInt BKTKContextRunSilent (BKTKContext * ctx, BKTime * tickTime, BKTime const * time, BKInt maxTicks, BKInt untilEnd)
+{
+	BKInt ticks, numTicks;
+	BKInt ticksRun = 0;
+	BKTime period;
+	BKTKTrack * track;
+
+	while (ticksRun < maxTicks && (!time || BKTimeIsLess (*tickTime, *time))) {
+		numTicks = maxTicks - ticksRun;
+
+		// run tracks in attach order as the dividers would
+		for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+			track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i);
+
+			if (track) {
+				if (track -> seekTicks <= 0) {
+					track -> seekTicks = BKMax (BKTKTrackAdvance (track), 1);
+				}
+
+				numTicks = BKMin (numTicks, track -> seekTicks);
+			}
+		}
+
+		if (untilEnd && BKTKContextHasEnded (ctx)) {
+			break;
+		}
+
+		// tick rate may have been changed by interpreter
+		BKGetPtr (ctx -> renderContext, BK_CLOCK_PERIOD, &period, sizeof (period));
+
+		for (ticks = 0; ticks < numTicks && (!time || BKTimeIsLess (*tickTime, *time)); ticks ++) {
+			*tickTime = BKTimeAdd (*tickTime, period);
+		}
+
+		for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+			track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i);
+
+			if (track) {
+				track -> seekTicks -= ticks;
+			}
+		}
+
+		ticksRun += ticks;
+	}
+
+	return ticksRun;
+}
+
+BKInt BKTKContextSeek (BKTKContext * ctx, BKTime time, BKTime * outTime)
+{
+	BKTKTrack * track;
+	BKTime tickTime = (BKTime) {0};
+
+	if (!ctx -> renderContext) {
+		return BK_INVALID_STATE;
+	}
+
+	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i);
+
+		if (track) {
+			track -> seekTicks = 0;
+		}
+	}
+
+	BKTKContextBeginSilent (ctx);
+	BKTKContextRunSilent (ctx, &tickTime, &time, BK_INT_MAX, 0);
+	BKTKContextEndSilent (ctx);
+
+	ctx -> seekTime = tickTime;
+
+	if (outTime) {
+		*outTime = tickTime;
+	}
+
+	return 0;
+}
+
+BKInt BKTKSnapshotInit (BKTKSnapshot * snapshot)
+{
+	memset (snapshot, 0, sizeof (*snapshot));
+	snapshot -> tracks = BK_ARRAY_INIT (sizeof (BKTKTrackSnapshot));
+
+	return 0;
+}
+
+void BKTKSnapshotDispose (BKTKSnapshot * snapshot)
+{
+	BKArrayDispose (&snapshot -> tracks);
+}
+
+/**
+ * Get index of the object containing `ptr` or -1 if `ptr` is NULL
+ */
+#define BKTKObjectIndexOf(ptr, type, field) \
+	((ptr) ? ((type *) ((uint8_t *) (ptr) - offsetof (type, field))) -> object.index : -1)
+
+/**
+ * Get field at `offset` of object at `index` or NULL if it does not exist
+ */
+static void * BKTKObjectFieldAt (BKArray const * objects, BKInt index, BKSize offset)
+{
+	void ** ref = index >= 0 ? BKArrayItemAt (objects, index) : NULL;
+
+	return ref && *ref ? (uint8_t *) *ref + offset : NULL;
+}
+
+/**
+ * Save snapshot at `time`
+ */
+static BKInt BKTKContextSaveSnapshotAt (BKTKContext * ctx, BKTKSnapshot * snapshot, BKTime time)
+{
+	BKTKTrack * track;
+	BKTKTrackSnapshot * item;
+
+	if (BKArrayResize (&snapshot -> tracks, ctx -> tracks.len) != 0) {
+		return BK_ALLOCATION_ERROR;
+	}
+
+	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i);
+		item = BKArrayItemAt (&snapshot -> tracks, i);
+
+		if (track) {
+			item -> interpreter = track -> interpreter;
+			item -> stackSize = (BKInt) (track -> interpreter.stackPtr - track -> interpreter.stack);
+			item -> state = track -> state;
+			item -> lineno = track -> lineno;
+			item -> seekTicks = track -> seekTicks;
+
+			// objects are resolved by index when restoring
+			item -> instrument = BKTKObjectIndexOf (track -> state.instrument, BKTKInstrument, instr);
+			item -> waveform = BKTKObjectIndexOf (track -> state.waveformData, BKTKWaveform, data);
+			item -> sample = BKTKObjectIndexOf (track -> state.sample, BKTKSample, data);
+		}
+	}
+
+	snapshot -> code = ctx -> code;
+	snapshot -> codeSize = ctx -> codeSize;
+
+	BKGetPtr (ctx -> renderContext, BK_CLOCK_PERIOD, &snapshot -> clockPeriod, sizeof (snapshot -> clockPeriod));
+	snapshot -> time = time;
+
+	return 0;
+}
+
+BKInt BKTKContextSaveSnapshot (BKTKContext * ctx, BKTKSnapshot * snapshot)
+{
+	if (!ctx -> renderContext) {
+		return BK_INVALID_STATE;
+	}
+
+	return BKTKContextSaveSnapshotAt (ctx, snapshot, ctx -> seekTime);
+}
+
+/**
+ * Move code pointers of interpreter by `delta`
+ */
+static void BKTKInterpreterRebase (BKTKInterpreter * interpreter, uintptr_t delta)
+{
+	interpreter -> opcode = (void *) ((uintptr_t) interpreter -> opcode + delta);
+	interpreter -> opcodePtr = (void *) ((uintptr_t) interpreter -> opcodePtr + delta);
+
+	if (interpreter -> repeatStartAddr) {
+		interpreter -> repeatStartAddr += delta;
+	}
+
+	for (BKTKStackItem * item = interpreter -> stack; item < interpreter -> stackPtr; item ++) {
+		item -> ptr += delta;
+	}
+}
+
+/**
+ * Restore interpreters and track state without applying it to the render tracks
+ *
+ * The snapshot may have been saved by another context with the same program.
+ */
+static BKInt BKTKContextRestoreInterpreters (BKTKContext * ctx, BKTKSnapshot const * snapshot)
+{
+	BKTKTrack * track;
+	BKTKTrackSnapshot const * item;
+	BKTKInterpreter * interpreter;
+	uintptr_t delta = (uintptr_t) ctx -> code - (uintptr_t) snapshot -> code;
+
+	if (snapshot -> tracks.len != ctx -> tracks.len || snapshot -> codeSize != ctx -> codeSize) {
+		return BK_INVALID_VALUE;
+	}
+
+	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i);
+		item = BKArrayItemAt (&snapshot -> tracks, i);
+
+		if (track) {
+			interpreter = &track -> interpreter;
+			*interpreter = item -> interpreter;
+
+			// stack pointers point into copied stack
+			interpreter -> stackPtr = interpreter -> stack + item -> stackSize;
+			interpreter -> stackEnd = interpreter -> stack + BK_INTR_STACK_SIZE;
+
+			if (delta) {
+				BKTKInterpreterRebase (interpreter, delta);
+			}
+
+			track -> state = item -> state;
+			track -> state.instrument = BKTKObjectFieldAt (&ctx -> instruments, item -> instrument, offsetof (BKTKInstrument, instr));
+			track -> state.waveformData = BKTKObjectFieldAt (&ctx -> waveforms, item -> waveform, offsetof (BKTKWaveform, data));
+			track -> state.sample = BKTKObjectFieldAt (&ctx -> samples, item -> sample, offsetof (BKTKSample, data));
+			track -> lineno = item -> lineno;
+			track -> seekTicks = item -> seekTicks;
+
+			// call interpreter on next tick
+			BKDividerReset (&track -> divider);
+		}
+	}
+
+	BKSetPtr (ctx -> renderContext, BK_CLOCK_PERIOD, (void *) &snapshot -> clockPeriod, sizeof (snapshot -> clockPeriod));
+	ctx -> seekTime = snapshot -> time;
+
+	return 0;
+}
+
+BKInt BKTKContextRestoreSnapshot (BKTKContext * ctx, BKTKSnapshot const * snapshot)
+{
+	BKInt res;
+
+	if (!ctx -> renderContext) {
+		return BK_INVALID_STATE;
+	}
+
+	BKTKContextBeginSilent (ctx);
+	res = BKTKContextRestoreInterpreters (ctx, snapshot);
+	BKTKContextEndSilent (ctx);
+
+	return res;
+}
+
+BKInt BKTKKeyframesInit (BKTKKeyframes * keyframes)
+{
+	BKInt res;
+
+	if ((res = BKObjectInit (keyframes, &BKTKKeyframesClass, sizeof (*keyframes))) != 0) {
+		return res;
+	}
+
+	keyframes -> snapshots = BK_ARRAY_INIT (sizeof (BKTKSnapshot));
+
+	return 0;
+}
+
+BKInt BKTKContextBuildKeyframes (BKTKContext * ctx, BKTKKeyframes * keyframes, BKInt interval, BKTime const * maxTime)
+{
+	BKInt res = 0;
+	BKTKTrack * track;
+	BKTKSnapshot * snapshot;
+	BKTime tickTime = (BKTime) {0};
+
+	if (!ctx -> renderContext) {
+		return BK_INVALID_STATE;
+	}
+
+	if (interval < 1) {
+		return BK_INVALID_VALUE;
+	}
+
+	for (BKUSize i = 0; i < keyframes -> snapshots.len; i ++) {
+		BKTKSnapshotDispose (BKArrayItemAt (&keyframes -> snapshots, i));
+	}
+
+	BKArrayEmpty (&keyframes -> snapshots);
+	keyframes -> interval = interval;
+	keyframes -> hasEnded = 0;
+
+	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i);
+
+		if (track) {
+			// don't write timing data twice
+			track -> object.object.flags |= BKTKTrackFlagNoTiming;
+			track -> seekTicks = 0;
+		}
+	}
+
+	BKTKContextBeginSilent (ctx);
+
+	do {
+		if ((snapshot = BKArrayPush (&keyframes -> snapshots)) == NULL) {
+			res = BK_ALLOCATION_ERROR;
+			break;
+		}
+
+		BKTKSnapshotInit (snapshot);
+
+		if ((res = BKTKContextSaveSnapshotAt (ctx, snapshot, tickTime)) != 0) {
+			break;
+		}
+
+		BKTKContextRunSilent (ctx, &tickTime, maxTime, interval, 1);
+		keyframes -> hasEnded = BKTKContextHasEnded (ctx);
+	}
+	while (!keyframes -> hasEnded && (!maxTime || BKTimeIsLess (tickTime, *maxTime)));
+
+	keyframes -> endTime = tickTime;
+
+	// rewind
+	if (res == 0) {
+		res = BKTKContextRestoreInterpreters (ctx, BKArrayItemAt (&keyframes -> snapshots, 0));
+	}
+
+	BKTKContextEndSilent (ctx);
+
+	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i);
+
+		if (track) {
+			track -> object.object.flags &= ~BKTKTrackFlagNoTiming;
+		}
+	}
+
+	return res;
+}
+
+BKInt BKTKContextSeekKeyframe (BKTKContext * ctx, BKTKKeyframes const * keyframes, BKTime time, BKTime * outTime)
+{
+	BKInt res;
+	BKUSize lo = 0, hi;
+	BKTKSnapshot const * snapshot;
+	BKTime tickTime;
+
+	if (!ctx -> renderContext) {
+		return BK_INVALID_STATE;
+	}
+
+	if (keyframes -> snapshots.len == 0) {
+		return BK_INVALID_VALUE;
+	}
+
+	// find last keyframe before time
+	hi = keyframes -> snapshots.len;
+
+	while (hi - lo > 1) {
+		BKUSize mid = (lo + hi) / 2;
+		snapshot = BKArrayItemAt (&keyframes -> snapshots, mid);
+
+		if (BKTimeIsLessEqual (snapshot -> time, time)) {
+			lo = mid;
+		}
+		else {
+			hi = mid;
+		}
+	}
+
+	snapshot = BKArrayItemAt (&keyframes -> snapshots, lo);
+
+	BKTKContextBeginSilent (ctx);
+
+	if ((res = BKTKContextRestoreInterpreters (ctx, snapshot)) == 0) {
+		tickTime = snapshot -> time;
+		BKTKContextRunSilent (ctx, &tickTime, &time, BK_INT_MAX, 0);
+		ctx -> seekTime = tickTime;
+	}
+
+	BKTKContextEndSilent (ctx);
+
+	if (res == 0 && outTime) {
+		*outTime = ctx -> seekTime;
+	}
+
+	return res;
+}
+
+static void BKTKKeyframesDispose (BKTKKeyframes * keyframes)
+{
+	for (BKUSize i = 0; i < keyframes -> snapshots.len; i ++) {
+		BKTKSnapshotDispose (BKArrayItemAt (&keyframes -> snapshots, i));
+	}
+
+	BKArrayDispose (&keyframes -> snapshots);
+}
+
+void BKTKContextDetach (BKTKContext * ctx)
+{
+	BKTKTrack * track;
+
+	if (!ctx -> renderContext) {
+		return;
+	}
+
+	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i);
+
+		if (track) {
+			BKDividerDetach (&track -> divider);
+
+			if (!(track -> object.object.flags & BKTKTrackFlagSilent)) {
+				BKTrackDetach (&track -> renderTrack);
+			}
+
+			track -> object.object.flags &= ~BKTKTrackFlagSilent;
+		}
+	}
+
+	ctx -> renderContext = NULL;
+}
+
+static void BKTKTrackReset (BKTKTrack * track)
+{
+	BKDividerReset (&track -> divider);
+	BKTKInterpreterReset (&track -> interpreter);
+	BKTrackReset (&track -> renderTrack);
+	track -> lineno = 0;
+	track -> seekTicks = 0;
+	memset (&track -> state, 0, sizeof (track -> state));
+
+	BKByteBufferDispose (&track -> timingData);
+	track -> timingData = BK_BYTE_BUFFER_INIT;
+}
+
+void BKTKContextReset (BKTKContext * ctx)
+{
+	BKTKTrack * track;
+
+	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i);
+		BKTKTrackReset (track);
+	}
+
+	BKStringEmpty (&ctx -> error);
+	ctx -> seekTime = (BKTime) {0};
+}
+
+static void BKTKContextDispose (BKTKContext * ctx)
+{
+	BKTKContextDetach (ctx);
+
+	for (BKUSize i = 0; i < ctx -> instruments.len; i ++) {
+		BKDispose (*(BKTKInstrument **) BKArrayItemAt (&ctx -> instruments, i));
+	}
+
+	for (BKUSize i = 0; i < ctx -> waveforms.len; i ++) {
+		BKDispose (*(BKTKWaveform **)BKArrayItemAt (&ctx -> waveforms, i));
+	}
+
+	for (BKUSize i = 0; i < ctx -> samples.len; i ++) {
+		BKDispose (*(BKTKSample **)BKArrayItemAt (&ctx -> samples, i));
+	}
+
+	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+		BKDispose (*(BKTKTrack **)BKArrayItemAt (&ctx -> tracks, i));
+	}
+
+	BKArrayDispose (&ctx -> instruments);
+	BKArrayDispose (&ctx -> waveforms);
+	BKArrayDispose (&ctx -> samples);
+	BKArrayDispose (&ctx -> tracks);
+	BKByteBufferDispose (&ctx -> program);
+}
+
+BKClass const BKTKContextClass =
+{
+	.instanceSize = sizeof (BKTKContext),
+	.dispose      = (void *) BKTKContextDispose,
+};
+
+BKClass const BKTKGroupClass =
+{
+	.instanceSize = sizeof (BKTKGroup),
+	.dispose      = (void *) BKTKGroupDispose,
+};
+
+BKClass const BKTKTrackClass =
+{
+	.instanceSize = sizeof (BKTKTrack),
+	.dispose      = (void *) BKTKTrackDispose,
+};
+
+BKClass const BKTKInstrumentClass =
+{
+	.instanceSize = sizeof (BKTKInstrument),
+	.dispose      = (void *) BKTKInstrumentDispose,
+};
 
 BKClass const BKTKWaveformClass =
 {
@@ -662,3 +2402,9 @@ BKClass const BKTKSampleClass =
 	.instanceSize = sizeof (BKTKSample),
 	.dispose      = (void *) BKTKSampleDispose,
 };
+
+BKClass const BKTKKeyframesClass =
+{
+	.instanceSize = sizeof (BKTKKeyframes),
+	.dispose      = (void *) BKTKKeyframesDispose,
+};
@@ -27,6 +27,20 @@
 #include "BKTKBase.h"
 #include "BKTKInterpreter.h"
 #include "BKTKCompiler.h"
+#include "BKTKWriter.h"
+
+/**
+ * Compiled program file identifier and format version
+ *
+ * The version has `BK_TK_PROGRAM_COMPACT_CODE` set if the program code uses
+ * the compact encoding. The byte order marker is written as native integer
+ * to reject programs written on a machine with a different byte order.
+ */
+#define BK_TK_PROGRAM_MAGIC              "BLPC"
+#define BK_TK_PROGRAM_COMPACT_CODE       (1 << 16)
+#define BK_TK_PROGRAM_VERSION            (3 | (BK_TK_COMPACT_CODE ? BK_TK_PROGRAM_COMPACT_CODE : 0))
+#define BK_TK_PROGRAM_BYTE_ORDER         0x01020304
+#define BK_TK_PROGRAM_BYTE_ORDER_SWAPPED 0x04030201
 
 typedef struct BKTKGroup BKTKGroup;
 typedef struct BKTKInstrument BKTKInstrument;
@@ -35,6 +49,9 @@ typedef struct BKTKSample BKTKSample;
 typedef struct BKTKTrack BKTKTrack;
 typedef struct BKTKContext BKTKContext;
 typedef struct BKTKObject BKTKObject;
+typedef struct BKTKTrackSnapshot BKTKTrackSnapshot;
+typedef struct BKTKSnapshot BKTKSnapshot;
+typedef struct BKTKKeyframes BKTKKeyframes;
 
 struct BKTKObject
 {
@@ -45,9 +62,13 @@ struct BKTKObject
 
 struct BKTKGroup
 {
-	BKTKObject   object;
-	BKByteBuffer byteCode;
-	BKSize       codeSize;
+	BKTKObject      object;
+	BKByteBuffer    byteCode;
+	uint8_t const * code;     // points into program image
+	BKSize          codeSize;
+	BKSize          codeOffset; // offset in program image
+	BKInt           numCalls;   // number of calls while compiling
+	BKInt           callDepth;  // maximum nested calls in group while compiling
 };
 
 struct BKTKInstrument
@@ -55,6 +76,7 @@ struct BKTKInstrument
 	BKTKObject   object;
 	BKInstrument instr;
 	BKString     name;
+	BKByteBuffer sequences; // recorded sequences for writing programs
 };
 
 struct BKTKWaveform
@@ -81,13 +103,18 @@ struct BKTKTrack
 	BKTKObject      object;
 	BKArray         groups; // BKTKGroup
 	BKByteBuffer    byteCode;
+	uint8_t const * code;   // points into program image
+	BKSize          codeSize;
+	BKSize          codeOffset; // offset in program image
 	BKDivider       divider;
 	BKTKContext   * ctx;
 	BKTrack         renderTrack;
 	BKInt           waveform;
 	BKTKInterpreter interpreter;
+	BKTKTrackState  state;
 	BKByteBuffer    timingData;
 	BKInt           lineno;
+	BKInt           seekTicks;
 };
 
 struct BKTKContext
@@ -98,9 +125,51 @@ struct BKTKContext
 	BKArray      waveforms;    // BKTKWaveform
 	BKArray      samples;      // BKTKSample; may contain shared BKData!
 	BKArray      tracks;       // BKTKTrack
+	BKByteBuffer program;      // linked byte code of all tracks and groups
+	uint8_t const * code;      // points into `program` or a loaded program
+	BKSize       codeSize;
 	BKString     loadPath;
 	BKString     error;
 	BKTKFileInfo info;
+	BKTime       seekTime;     // time of last seek or restored snapshot
+};
+
+struct BKTKTrackSnapshot
+{
+	BKTKInterpreter interpreter;
+	BKInt           stackSize;
+	BKTKTrackState  state;
+	BKInt           lineno;
+	BKInt           seekTicks;
+	BKInt           instrument; // object indices of state pointers
+	BKInt           waveform;
+	BKInt           sample;
+};
+
+struct BKTKSnapshot
+{
+	BKTime          time;
+	BKTime          clockPeriod;
+	uint8_t const * code;     // program code of saving context
+	BKSize          codeSize;
+	BKArray         tracks;   // BKTKTrackSnapshot
+};
+
+struct BKTKKeyframes
+{
+	BKObject object;
+	BKInt    interval;  // ticks between snapshots
+	BKTime   endTime;   // time when all tracks have stopped or repeated
+	BKInt    hasEnded;  // tracks have ended before reaching the maximum time
+	BKArray  snapshots; // BKTKSnapshot
+};
+
+enum BKTKTrackFlag
+{
+	BKTKTrackFlagSilent      = 1 << 8,  // interpreter runs but track is not rendered
+	BKTKTrackFlagSeeking     = 1 << 9,  // track is silent while seeking
+	BKTKTrackFlagNoTiming    = 1 << 10, // don't write timing data
+	BKTKTrackFlagRecordState = 1 << 11, // record track state while running silently
 };
 
 enum BKTKContextOption
@@ -121,11 +190,121 @@ extern BKInt BKTKContextInit (BKTKContext * ctx, BKUInt flags);
  */
 extern BKInt BKTKContextCreate (BKTKContext * ctx, BKTKCompiler * compiler);
 
+/**
+ * Create context from compiled program
+ *
+ * Loads a program written with `BKTKContextWriteProgram`. The byte code is
+ * not copied but used directly from `data`, which has to be aligned to 4 bytes
+ * and remain valid until the context is disposed, e.g., a mapped file.
+ * Programs written with a different byte order or code encoding are rejected.
+ * The code is validated before use: instructions must not cross the end of a
+ * code block, calls must target a group, blocks must end with `End` or
+ * `Return` and referenced instruments, waveforms and samples must exist.
+ */
+extern BKInt BKTKContextLoadProgram (BKTKContext * ctx, void const * data, BKUSize size);
+
+/**
+ * Write compiled program
+ *
+ * Writes the file info, instruments, waveforms, samples and the linked byte
+ * code of all tracks and groups. Sample files are embedded. Integers are
+ * written in native byte order, which is recorded in the header, and all
+ * sections are padded to 4 bytes.
+ */
+extern BKInt BKTKContextWriteProgram (BKTKContext const * ctx, BKTKWriterWriteFunc write, void * userInfo);
+
 /**
  * Attach to render context
  */
 extern BKInt BKTKContextAttach (BKTKContext * ctx, BKContext * renderContext);
 
+/**
+ * Attach to render context but only render a subset of tracks
+ *
+ * Only every `numShards`th track beginning at `shardIndex` is rendered. The
+ * remaining tracks are marked with `BKTKTrackFlagSilent`. Shard 0 runs the
+ * interpreters of all tracks, so it can detect when all tracks have stopped
+ * and write timing data. The other shards only run the interpreters of silent
+ * tracks which change the step ticks, tick rate or pulse kernel, which keeps
+ * the timing of every shard identical. The stopped state of the tracks not
+ * run is not updated in these shards.
+ */
+extern BKInt BKTKContextAttachShard (BKTKContext * ctx, BKContext * renderContext, BKInt shardIndex, BKInt numShards);
+
+/**
+ * Advance interpreters to `time` without rendering
+ *
+ * Runs the interpreters of all tracks up to the last tick before `time` and
+ * applies the recorded track state to the render tracks. The render context
+ * is not advanced and continues from the reached tick. `outTime` is set to
+ * the time of that tick.
+ *
+ * The track state is only recorded while running silently, so no timing
+ * data is written for the skipped ticks.
+ *
+ * Must be called after attaching and before rendering.
+ */
+extern BKInt BKTKContextSeek (BKTKContext * ctx, BKTime time, BKTime * outTime);
+
+/**
+ * Initialize snapshot
+ */
+extern BKInt BKTKSnapshotInit (BKTKSnapshot * snapshot);
+
+/**
+ * Dispose snapshot
+ */
+extern void BKTKSnapshotDispose (BKTKSnapshot * snapshot);
+
+/**
+ * Save interpreters and track state
+ *
+ * The state can only be saved at the position reached by the last
+ * `BKTKContextSeek`, `BKTKContextSeekKeyframe` or
+ * `BKTKContextRestoreSnapshot` before rendering continues.
+ * Render track internals like envelope phases are not saved.
+ */
+extern BKInt BKTKContextSaveSnapshot (BKTKContext * ctx, BKTKSnapshot * snapshot);
+
+/**
+ * Restore interpreters and track state from snapshot
+ *
+ * Playing notes are attacked again. Timing data is not restored. The
+ * snapshot may also be restored in another context with the same program,
+ * e.g., loaded from the same compiled program.
+ */
+extern BKInt BKTKContextRestoreSnapshot (BKTKContext * ctx, BKTKSnapshot const * snapshot);
+
+/**
+ * Initialize keyframe index
+ */
+extern BKInt BKTKKeyframesInit (BKTKKeyframes * keyframes);
+
+/**
+ * Build keyframe index with snapshot every `interval` ticks
+ *
+ * Runs the interpreters without rendering until all tracks have stopped or
+ * repeated or `maxTime` is reached, then rewinds the context to the
+ * beginning. `maxTime` may be NULL to only stop when the tracks have ended.
+ * The time at which building stopped is stored in `endTime` and `hasEnded` is
+ * set if the tracks have ended.
+ *
+ * The snapshots only contain the interpreter and track state. Envelope and
+ * effect phases and the buffered output of the render tracks are not saved,
+ * so seeking should render some frames before the target time to let them
+ * settle.
+ */
+extern BKInt BKTKContextBuildKeyframes (BKTKContext * ctx, BKTKKeyframes * keyframes, BKInt interval, BKTime const * maxTime);
+
+/**
+ * Seek to `time` from the nearest keyframe
+ *
+ * Like `BKTKContextSeek` but can be used at any time and only runs the
+ * interpreters from the last keyframe before `time`. The keyframes are only
+ * read, so contexts with the same program can share them between threads.
+ */
+extern BKInt BKTKContextSeekKeyframe (BKTKContext * ctx, BKTKKeyframes const * keyframes, BKTime time, BKTime * outTime);
+
 /**
  * Detach from render context
  */
@@ -145,4 +324,11 @@ extern BKInt BKTKInstrumentAlloc (BKTKInstrument ** instrument);
 extern BKInt BKTKWaveformAlloc (BKTKWaveform ** waveform);
 extern BKInt BKTKSampleAlloc (BKTKSample ** sample);
 
+/**
+ * Set instrument sequences and record them for `BKTKContextWriteProgram`
+ */
+extern BKInt BKTKInstrumentSetSequence (BKTKInstrument * instrument, BKEnum slot, BKInt const * values, BKUInt length, BKInt sustainOffset, BKInt sustainLength);
+extern BKInt BKTKInstrumentSetEnvelope (BKTKInstrument * instrument, BKEnum slot, BKSequencePhase const * phases, BKUInt length, BKInt sustainOffset, BKInt sustainLength);
+extern BKInt BKTKInstrumentSetEnvelopeADSR (BKTKInstrument * instrument, BKUInt attack, BKUInt decay, BKInt sustain, BKUInt release);
+
 #endif /* ! _BK_TK_CONTEXT_H_ */
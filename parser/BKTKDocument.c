@@ -0,0 +1,728 @@
+/*
+ * Copyright (c) 2012-2016 Simon Schoenenberger
+ * http://blipkit.audio
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "BKTKDocument.h"
+
+#define TEXT_INIT_SIZE 4096
+#define TOKEN_BATCH_SIZE 64
+#define BLOCK_POOL_SEGMENT_CAPACITY 256
+
+extern BKClass const BKTKDocumentClass;
+
+BKInt BKTKDocumentInit (BKTKDocument * doc)
+{
+	BKInt res;
+
+	if ((res = BKObjectInit (doc, &BKTKDocumentClass, sizeof (*doc))) != 0) {
+		return res;
+	}
+
+	if ((res = BKTKTokenizerInit (&doc -> tokenizer)) != 0) {
+		goto error;
+	}
+
+	if ((res = BKTKParserInit (&doc -> parser)) != 0) {
+		goto error;
+	}
+
+	doc -> textCap = TEXT_INIT_SIZE;
+	doc -> text = malloc (doc -> textCap);
+
+	if (!doc -> text) {
+		goto error;
+	}
+
+	if ((res = BKBlockPoolInit (&doc -> blockPool, sizeof (BKTKDocumentBlock), BLOCK_POOL_SEGMENT_CAPACITY)) != 0) {
+		goto error;
+	}
+
+	// empty text has a single empty block
+	doc -> firstBlock = BKBlockPoolAlloc (&doc -> blockPool);
+
+	if (!doc -> firstBlock) {
+		goto error;
+	}
+
+	doc -> firstBlock -> lineno = 1;
+	doc -> rootBlock = doc -> firstBlock;
+	doc -> seed = 0x9E3779B9;
+
+	return 0;
+
+	error: {
+		BKDispose (doc);
+
+		return BK_ALLOCATION_ERROR;
+	}
+}
+
+/**
+ * Free nodes of block
+ */
+static void BKTKDocumentBlockFreeNodes (BKTKDocument * doc, BKTKDocumentBlock * block)
+{
+	if (block -> lastNode) {
+		// unlink nodes of following block
+		block -> lastNode -> nextNode = NULL;
+		BKTKParserFreeNodeTree (&doc -> parser, block -> firstNode);
+	}
+
+	block -> firstNode = NULL;
+	block -> lastNode = NULL;
+}
+
+static void BKTKDocumentDispose (BKTKDocument * doc)
+{
+	BKTKDocumentBlock * block;
+
+	// nodes are allocated by parser
+	if (doc -> parser.object.flags & BKObjectFlagInitialized) {
+		for (block = doc -> firstBlock; block; block = block -> nextBlock) {
+			BKTKDocumentBlockFreeNodes (doc, block);
+		}
+	}
+
+	BKDispose (&doc -> tokenizer);
+	BKDispose (&doc -> parser);
+	BKBlockPoolDispose (&doc -> blockPool);
+	BKStringDispose (&doc -> error);
+
+	free (doc -> text);
+}
+
+/**
+ * Get contiguous chars at `offset`
+ *
+ * Stores the number of chars before the gap or the end in `size`
+ */
+static uint8_t const * BKTKDocumentGetChars (BKTKDocument const * doc, BKUSize offset, BKUSize * size)
+{
+	if (offset < doc -> gapOffset) {
+		*size = doc -> gapOffset - offset;
+
+		return &doc -> text [offset];
+	}
+
+	*size = doc -> textLen - offset;
+
+	return &doc -> text [offset + doc -> textCap - doc -> textLen];
+}
+
+/**
+ * Move gap to `offset`
+ */
+static void BKTKDocumentMoveGap (BKTKDocument * doc, BKUSize offset)
+{
+	BKUSize gapSize = doc -> textCap - doc -> textLen;
+
+	if (offset < doc -> gapOffset) {
+		memmove (&doc -> text [offset + gapSize], &doc -> text [offset], doc -> gapOffset - offset);
+	}
+	else {
+		memmove (&doc -> text [doc -> gapOffset], &doc -> text [doc -> gapOffset + gapSize], offset - doc -> gapOffset);
+	}
+
+	doc -> gapOffset = offset;
+}
+
+/**
+ * Ensure that the gap has space for `size` chars
+ */
+static BKInt BKTKDocumentEnsureGapSpace (BKTKDocument * doc, BKUSize size)
+{
+	uint8_t * newText;
+	BKUSize newCapacity;
+	BKUSize tailSize = doc -> textLen - doc -> gapOffset;
+
+	if (doc -> textLen + size <= doc -> textCap) {
+		return 0;
+	}
+
+	newCapacity = BKNextPow2 (doc -> textLen + size);
+	newText = realloc (doc -> text, newCapacity);
+
+	if (!newText) {
+		return -1;
+	}
+
+	// move chars after gap to end
+	memmove (&newText [newCapacity - tailSize], &newText [doc -> textCap - tailSize], tailSize);
+
+	doc -> text = newText;
+	doc -> textCap = newCapacity;
+
+	return 0;
+}
+
+/**
+ * Count line breaks as the tokenizer does
+ */
+static BKInt BKTKDocumentCountLines (BKTKDocument const * doc, BKUSize offset, BKUSize size)
+{
+	BKInt numLines = 0;
+
+	while (size) {
+		BKUSize length;
+		uint8_t const * chars = BKTKDocumentGetChars (doc, offset, &length);
+
+		length = BKMin (length, size);
+
+		for (BKUSize i = 0; i < length; i ++) {
+			numLines += chars [i] == '\n' || chars [i] == '\r';
+		}
+
+		offset += length;
+		size -= length;
+	}
+
+	return numLines;
+}
+
+/**
+ * Update sums of subtree of `block`
+ */
+static void BKTKDocumentBlockUpdate (BKTKDocumentBlock * block)
+{
+	block -> treeSize = block -> size;
+	block -> treeLines = block -> numLines;
+
+	if (block -> left) {
+		block -> treeSize += block -> left -> treeSize;
+		block -> treeLines += block -> left -> treeLines;
+	}
+
+	if (block -> right) {
+		block -> treeSize += block -> right -> treeSize;
+		block -> treeLines += block -> right -> treeLines;
+	}
+}
+
+/**
+ * Rotate `block` above its parent
+ */
+static void BKTKDocumentRotateUp (BKTKDocument * doc, BKTKDocumentBlock * block)
+{
+	BKTKDocumentBlock * parent = block -> parent;
+	BKTKDocumentBlock * grandParent = parent -> parent;
+
+	if (parent -> left == block) {
+		parent -> left = block -> right;
+
+		if (block -> right) {
+			block -> right -> parent = parent;
+		}
+
+		block -> right = parent;
+	}
+	else {
+		parent -> right = block -> left;
+
+		if (block -> left) {
+			block -> left -> parent = parent;
+		}
+
+		block -> left = parent;
+	}
+
+	parent -> parent = block;
+	block -> parent = grandParent;
+
+	if (!grandParent) {
+		doc -> rootBlock = block;
+	}
+	else if (grandParent -> left == parent) {
+		grandParent -> left = block;
+	}
+	else {
+		grandParent -> right = block;
+	}
+
+	// sums of `grandParent` are unchanged
+	BKTKDocumentBlockUpdate (parent);
+	BKTKDocumentBlockUpdate (block);
+}
+
+/**
+ * Insert `block` into tree following `prevBlock`
+ *
+ * `prevBlock` is NULL to insert the first block.
+ */
+static void BKTKDocumentTreeInsert (BKTKDocument * doc, BKTKDocumentBlock * block, BKTKDocumentBlock * prevBlock)
+{
+	BKTKDocumentBlock * parent;
+
+	// xorshift
+	doc -> seed ^= doc -> seed << 13;
+	doc -> seed ^= doc -> seed >> 17;
+	doc -> seed ^= doc -> seed << 5;
+
+	block -> priority = doc -> seed;
+	block -> left = NULL;
+	block -> right = NULL;
+	BKTKDocumentBlockUpdate (block);
+
+	if (!doc -> rootBlock) {
+		block -> parent = NULL;
+		doc -> rootBlock = block;
+		return;
+	}
+
+	if (!prevBlock) {
+		for (parent = doc -> rootBlock; parent -> left; parent = parent -> left) {
+			;
+		}
+
+		parent -> left = block;
+	}
+	else if (!prevBlock -> right) {
+		parent = prevBlock;
+		parent -> right = block;
+	}
+	else {
+		for (parent = prevBlock -> right; parent -> left; parent = parent -> left) {
+			;
+		}
+
+		parent -> left = block;
+	}
+
+	block -> parent = parent;
+
+	for (; parent; parent = parent -> parent) {
+		BKTKDocumentBlockUpdate (parent);
+	}
+
+	while (block -> parent && block -> parent -> priority < block -> priority) {
+		BKTKDocumentRotateUp (doc, block);
+	}
+}
+
+/**
+ * Remove `block` from tree
+ */
+static void BKTKDocumentTreeRemove (BKTKDocument * doc, BKTKDocumentBlock * block)
+{
+	BKTKDocumentBlock * child;
+	BKTKDocumentBlock * parent;
+
+	while (block -> left && block -> right) {
+		child = block -> left -> priority > block -> right -> priority ? block -> left : block -> right;
+		BKTKDocumentRotateUp (doc, child);
+	}
+
+	child = block -> left ? block -> left : block -> right;
+	parent = block -> parent;
+
+	if (child) {
+		child -> parent = parent;
+	}
+
+	if (!parent) {
+		doc -> rootBlock = child;
+	}
+	else if (parent -> left == block) {
+		parent -> left = child;
+	}
+	else {
+		parent -> right = child;
+	}
+
+	for (; parent; parent = parent -> parent) {
+		BKTKDocumentBlockUpdate (parent);
+	}
+}
+
+/**
+ * Find block containing `offset`
+ *
+ * Stores the offset and the line number of the block's first line in
+ * `outOffset` and `outLineno`. Returns the last block if `offset` is at the
+ * end of the text.
+ */
+static BKTKDocumentBlock * BKTKDocumentFindBlock (BKTKDocument const * doc, BKUSize offset, BKUSize * outOffset, BKInt * outLineno)
+{
+	BKUSize blockOffset = 0;
+	BKInt lineno = 1;
+	BKTKDocumentBlock * block = doc -> rootBlock;
+
+	for (;;) {
+		BKTKDocumentBlock * left = block -> left;
+
+		if (left) {
+			if (offset < blockOffset + left -> treeSize) {
+				block = left;
+				continue;
+			}
+
+			blockOffset += left -> treeSize;
+			lineno += left -> treeLines;
+		}
+
+		if (offset < blockOffset + block -> size || !block -> right) {
+			break;
+		}
+
+		blockOffset += block -> size;
+		lineno += block -> numLines;
+		block = block -> right;
+	}
+
+	*outOffset = blockOffset;
+	*outLineno = lineno;
+
+	return block;
+}
+
+/**
+ * Append new block with nodes detached from the parser
+ */
+static BKTKDocumentBlock * BKTKDocumentAppendBlock (BKTKDocument * doc, BKTKDocumentBlock * lastBlock, BKUSize size, BKInt lineno, BKInt numLines)
+{
+	BKTKParserNode * node;
+	BKTKDocumentBlock * block = BKBlockPoolAlloc (&doc -> blockPool);
+
+	if (!block) {
+		return NULL;
+	}
+
+	block -> size = size;
+	block -> lineno = lineno;
+	block -> numLines = numLines;
+	block -> prevBlock = lastBlock;
+	block -> firstNode = BKTKParserDetachNodeTree (&doc -> parser);
+
+	for (node = block -> firstNode; node; node = node -> nextNode) {
+		block -> lastNode = node;
+	}
+
+	if (lastBlock) {
+		lastBlock -> nextBlock = block;
+	}
+
+	return block;
+}
+
+static void BKTKDocumentSetError (BKTKDocument * doc)
+{
+	char const * msg = "Allocation error";
+
+	if (BKTKParserHasError (&doc -> parser)) {
+		msg = (char const *) doc -> parser.buffer;
+	}
+	else if (BKTKTokenizerHasError (&doc -> tokenizer)) {
+		msg = (char const *) doc -> tokenizer.buffer;
+	}
+
+	BKStringEmpty (&doc -> error);
+	BKStringAppend (&doc -> error, msg);
+}
+
+static BKInt BKTKDocumentPutTokens (BKTKToken const * tokens, BKUSize count, BKTKParser * parser)
+{
+	return BKTKParserPutTokens (parser, tokens, count);
+}
+
+/**
+ * Link nodes of blocks from `firstBlock` to `lastBlock` with the nodes of the
+ * surrounding blocks
+ */
+static void BKTKDocumentLinkNodes (BKTKDocument * doc, BKTKDocumentBlock * firstBlock, BKTKDocumentBlock * lastBlock)
+{
+	BKInt following = 0;
+	BKTKParserNode * lastNode = NULL;
+	BKTKDocumentBlock * block;
+
+	for (block = firstBlock -> prevBlock; block && !block -> lastNode; block = block -> prevBlock) {
+		;
+	}
+
+	if (block) {
+		lastNode = block -> lastNode;
+	}
+
+	for (block = firstBlock; block; block = block -> nextBlock) {
+		if (block -> firstNode) {
+			if (lastNode) {
+				lastNode -> nextNode = block -> firstNode;
+			}
+			else {
+				doc -> nodeTree = block -> firstNode;
+			}
+
+			// first nodes following `lastBlock`
+			if (following) {
+				return;
+			}
+
+			lastNode = block -> lastNode;
+		}
+
+		following |= block == lastBlock;
+	}
+
+	if (lastNode) {
+		lastNode -> nextNode = NULL;
+	}
+	else {
+		doc -> nodeTree = NULL;
+	}
+}
+
+/**
+ * Parse text beginning at `block` at `offset` until the parser reaches a
+ * boundary of an old block following the edit
+ *
+ * Replaces the old blocks with the parsed blocks. If an error occurs, they are
+ * replaced by a single error block.
+ */
+static void BKTKDocumentParse (BKTKDocument * doc, BKTKDocumentBlock * block, BKUSize offset, BKInt lineno, BKUSize editEnd, BKUSize oldEditEnd)
+{
+	BKInt res = 0;
+	BKInt resync = 0;
+	BKTKTokenizer * tok = &doc -> tokenizer;
+	BKTKParser * parser = &doc -> parser;
+	BKTKDocumentBlock * nextBlock;
+	BKTKDocumentBlock * prevBlock = block -> prevBlock;
+	BKTKDocumentBlock * oldBlock = block;
+	BKTKDocumentBlock * firstBlock = NULL;
+	BKTKDocumentBlock * lastBlock = NULL;
+	BKUSize start = offset;
+	BKUSize oldOffset = offset;
+	BKUSize blockOffset = offset;
+	BKInt blockLineno = lineno;
+	BKTKToken tokens [TOKEN_BATCH_SIZE];
+
+	BKTKTokenizerReset (tok);
+	BKTKParserReset (parser);
+	tok -> offset.lineno = lineno;
+	tok -> object.flags |= BKTKTokenizerFlagResident;
+
+	while (offset < doc -> textLen) {
+		BKUSize size;
+		uint8_t const * chars = BKTKDocumentGetChars (doc, offset, &size);
+		uint8_t const * lineEnd = memchr (chars, '\n', size);
+
+		// put single lines
+		if (lineEnd) {
+			size = lineEnd - chars + 1;
+		}
+
+		res = BKTKTokenizerPutCharsBatch (tok, chars, size, tokens, TOKEN_BATCH_SIZE, (BKTKPutTokensFunc) BKTKDocumentPutTokens, parser);
+		offset += size;
+
+		if (res != 0) {
+			break;
+		}
+
+		if (!lineEnd || tok -> state != BKTKStateRoot || !BKTKParserIsAtRoot (parser)) {
+			continue;
+		}
+
+		lastBlock = BKTKDocumentAppendBlock (doc, lastBlock, offset - blockOffset, blockLineno, tok -> offset.lineno - blockLineno);
+
+		if (!lastBlock) {
+			res = BK_ALLOCATION_ERROR;
+			break;
+		}
+
+		if (!firstBlock) {
+			firstBlock = lastBlock;
+		}
+
+		blockOffset = offset;
+		blockLineno = tok -> offset.lineno;
+
+		// stop at old block boundary following the edit
+		if (offset >= editEnd) {
+			BKUSize position = offset - editEnd + oldEditEnd;
+
+			while (oldBlock && oldOffset < position) {
+				oldOffset += oldBlock -> size;
+				oldBlock = oldBlock -> nextBlock;
+			}
+
+			if (oldBlock && oldOffset == position) {
+				resync = 1;
+				break;
+			}
+		}
+	}
+
+	if (!resync && res == 0) {
+		// terminate tokenizer
+		res = BKTKTokenizerPutCharsBatch (tok, NULL, 0, tokens, TOKEN_BATCH_SIZE, (BKTKPutTokensFunc) BKTKDocumentPutTokens, parser);
+
+		if (res == 0) {
+			lastBlock = BKTKDocumentAppendBlock (doc, lastBlock, offset - blockOffset, blockLineno, tok -> offset.lineno - blockLineno);
+
+			if (!lastBlock) {
+				res = BK_ALLOCATION_ERROR;
+			}
+			else if (!firstBlock) {
+				firstBlock = lastBlock;
+			}
+		}
+
+		oldBlock = NULL;
+	}
+
+	tok -> object.flags &= ~BKTKTokenizerFlagResident;
+
+	if (res != 0) {
+		BKTKDocumentSetError (doc);
+		BKTKParserFreeNodeTree (parser, BKTKParserDetachNodeTree (parser));
+
+		// discard parsed blocks
+		for (block = firstBlock; block; block = firstBlock) {
+			firstBlock = block -> nextBlock;
+			BKTKDocumentBlockFreeNodes (doc, block);
+			BKBlockPoolFree (&doc -> blockPool, block);
+		}
+
+		offset = BKMax (offset, editEnd);
+
+		if (offset < doc -> textLen) {
+			BKUSize position = offset - editEnd + oldEditEnd;
+
+			while (oldBlock && oldOffset < position) {
+				oldOffset += oldBlock -> size;
+				oldBlock = oldBlock -> nextBlock;
+			}
+		}
+		else {
+			oldBlock = NULL;
+		}
+
+		// error block ends at next old block
+		offset = oldBlock ? oldOffset - oldEditEnd + editEnd : doc -> textLen;
+
+		// allocation ensured by `BKTKDocumentEdit`
+		block = BKBlockPoolAlloc (&doc -> blockPool);
+		block -> flags = BKTKDocumentBlockFlagError;
+		block -> size = offset - start;
+		block -> lineno = lineno;
+		block -> numLines = BKTKDocumentCountLines (doc, start, block -> size);
+		firstBlock = lastBlock = block;
+		doc -> numErrors ++;
+	}
+
+	// free replaced blocks
+	for (block = prevBlock ? prevBlock -> nextBlock : doc -> firstBlock; block != oldBlock; block = nextBlock) {
+		nextBlock = block -> nextBlock;
+
+		if (block -> flags & BKTKDocumentBlockFlagError) {
+			doc -> numErrors --;
+		}
+
+		BKTKDocumentTreeRemove (doc, block);
+		BKTKDocumentBlockFreeNodes (doc, block);
+		BKBlockPoolFree (&doc -> blockPool, block);
+	}
+
+	// link new blocks
+	firstBlock -> prevBlock = prevBlock;
+	lastBlock -> nextBlock = oldBlock;
+
+	if (prevBlock) {
+		prevBlock -> nextBlock = firstBlock;
+	}
+	else {
+		doc -> firstBlock = firstBlock;
+	}
+
+	if (oldBlock) {
+		oldBlock -> prevBlock = lastBlock;
+	}
+
+	for (block = firstBlock; block != oldBlock; block = block -> nextBlock) {
+		BKTKDocumentTreeInsert (doc, block, block -> prevBlock);
+	}
+
+	BKTKDocumentLinkNodes (doc, firstBlock, lastBlock);
+}
+
+BKInt BKTKDocumentEdit (BKTKDocument * doc, BKUSize offset, BKUSize length, uint8_t const * chars, BKUSize size)
+{
+	BKUSize blockOffset;
+	BKInt blockLineno;
+	BKTKDocumentBlock * block;
+
+	if (offset > doc -> textLen || length > doc -> textLen - offset) {
+		return BK_INVALID_VALUE;
+	}
+
+	if (BKTKDocumentEnsureGapSpace (doc, size) != 0) {
+		return BK_ALLOCATION_ERROR;
+	}
+
+	// reserve block in case of an error
+	if (BKBlockPoolEnsureBlock (&doc -> blockPool) != 0) {
+		return BK_ALLOCATION_ERROR;
+	}
+
+	block = BKTKDocumentFindBlock (doc, offset, &blockOffset, &blockLineno);
+
+	BKTKDocumentMoveGap (doc, offset + length);
+	doc -> gapOffset -= length;
+	doc -> textLen -= length;
+
+	memcpy (&doc -> text [doc -> gapOffset], chars, size);
+	doc -> gapOffset += size;
+	doc -> textLen += size;
+
+	BKTKDocumentParse (doc, block, blockOffset, blockLineno, offset + size, offset + length);
+
+	return 0;
+}
+
+BKTKParserNode * BKTKDocumentGetNodeTree (BKTKDocument * doc)
+{
+	return doc -> nodeTree;
+}
+
+BKInt BKTKDocumentGetLineno (BKTKDocument const * doc, BKTKDocumentBlock const * block, BKInt lineno)
+{
+	BKInt blockLineno = 1;
+	BKTKDocumentBlock const * node;
+
+	// sum lines of preceding blocks
+	if (block -> left) {
+		blockLineno += block -> left -> treeLines;
+	}
+
+	for (node = block; node -> parent; node = node -> parent) {
+		BKTKDocumentBlock const * parent = node -> parent;
+
+		if (parent -> right == node) {
+			blockLineno += parent -> numLines + (parent -> left ? parent -> left -> treeLines : 0);
+		}
+	}
+
+	return lineno - block -> lineno + blockLineno;
+}
+
+BKClass const BKTKDocumentClass =
+{
+	.instanceSize = sizeof (BKTKDocument),
+	.dispose      = (void *) BKTKDocumentDispose,
+};
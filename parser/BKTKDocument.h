@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2012-2016 Simon Schoenenberger
+ * http://blipkit.audio
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef _BK_TK_DOCUMENT_H_
+#define _BK_TK_DOCUMENT_H_
+
+#include "BKTKParser.h"
+
+typedef struct BKTKDocument BKTKDocument;
+typedef struct BKTKDocumentBlock BKTKDocumentBlock;
+
+/**
+ * Block flags
+ */
+enum BKTKDocumentBlockFlag
+{
+	BKTKDocumentBlockFlagError = 1 << 0, // block could not be parsed
+};
+
+/**
+ * Defines a range of lines which is parsed independently
+ *
+ * Blocks begin where the tokenizer and the parser are between commands
+ * outside of groups. Nodes of consecutive blocks are linked.
+ *
+ * Besides the list, blocks form a tree ordered by offset which keeps the
+ * number of chars and lines of each subtree. It is used to find blocks and
+ * their line numbers in logarithmic time.
+ */
+struct BKTKDocumentBlock
+{
+	BKTKDocumentBlock * prevBlock;
+	BKTKDocumentBlock * nextBlock;
+	BKTKDocumentBlock * parent;
+	BKTKDocumentBlock * left;
+	BKTKDocumentBlock * right;
+	BKUInt              priority;  // tree is a heap of priorities
+	BKUInt              flags;
+	BKUSize             size;      // number of chars
+	BKInt               numLines;  // number of line breaks
+	BKUSize             treeSize;  // number of chars of subtree
+	BKInt               treeLines; // number of line breaks of subtree
+	BKInt               lineno;    // line number the nodes were parsed with
+	BKTKParserNode    * firstNode;
+	BKTKParserNode    * lastNode;
+};
+
+/**
+ * Keeps the node tree of a text which is edited incrementally
+ */
+struct BKTKDocument
+{
+	BKObject            object;
+	BKTKTokenizer       tokenizer;
+	BKTKParser          parser;
+	uint8_t           * text;           // text with gap at `gapOffset`
+	BKUSize             textLen, textCap;
+	BKUSize             gapOffset;
+	BKTKDocumentBlock * firstBlock;
+	BKTKDocumentBlock * rootBlock;      // root of block tree
+	BKUInt              seed;           // for block priorities
+	BKTKParserNode    * nodeTree;
+	BKUSize             numErrors;      // number of blocks with errors
+	BKBlockPool         blockPool;
+	BKString            error;
+};
+
+/**
+ * Initialize empty document
+ */
+extern BKInt BKTKDocumentInit (BKTKDocument * doc);
+
+/**
+ * Replace `length` chars at `offset` with `size` chars
+ *
+ * Only the lines from the beginning of the block containing `offset` are
+ * tokenized and parsed again until the parser reaches a block boundary
+ * following the replaced range. The new nodes are linked into the existing
+ * node tree.
+ *
+ * Returns a value < 0 if the range is invalid or the text could not be
+ * allocated. Errors while parsing are reported by `BKTKDocumentHasError`.
+ */
+extern BKInt BKTKDocumentEdit (BKTKDocument * doc, BKUSize offset, BKUSize length, uint8_t const * chars, BKUSize size);
+
+/**
+ * Get node tree
+ *
+ * Nodes keep the line numbers they were parsed with, so nodes following an
+ * edit are not changed when lines are inserted or removed. The nodes of each
+ * block range from `firstNode` to `lastNode`. Use `BKTKDocumentGetLineno` to
+ * get their current line numbers.
+ *
+ * Returns the first node
+ */
+extern BKTKParserNode * BKTKDocumentGetNodeTree (BKTKDocument * doc);
+
+/**
+ * Get current line number of `lineno` of a node in `block`
+ */
+extern BKInt BKTKDocumentGetLineno (BKTKDocument const * doc, BKTKDocumentBlock const * block, BKInt lineno);
+
+/**
+ * Check if any block has an error
+ *
+ * The text of the last error is contained in `doc -> error`. Its line number
+ * is not updated when editing preceding lines.
+ */
+BK_INLINE BKInt BKTKDocumentHasError (BKTKDocument const * doc);
+
+
+// --- Inline implementations
+
+BK_INLINE BKInt BKTKDocumentHasError (BKTKDocument const * doc)
+{
+	return doc -> numErrors > 0;
+}
+
+#endif /* ! _BK_TK_DOCUMENT_H_ */
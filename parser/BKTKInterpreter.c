@@ -160,6 +160,49 @@ BKInt BKTKInterpreterInit (BKTKInterpreter * interpreter)
 	return 0;
 }
 
+#if BK_TK_COMPACT_CODE
+
+/**
+ * Decode opcode byte and operands into instruction mask
+ */
+BK_INLINE BKInstrMask BKReadIntrMask (void ** opcode)
+{
+	uint8_t const * ptr = *opcode;
+	BKInstrMask mask;
+
+	mask.value = 0;
+	mask.arg1.cmd = *ptr ++;
+
+	switch (BKInstrNumOperands (mask.arg1.cmd)) {
+		case 1: {
+			mask.arg1.arg1 = BKInstrReadVarint (&ptr);
+			break;
+		}
+		case 2: {
+			mask.arg2.arg1 = BKInstrReadVarint (&ptr);
+			mask.arg2.arg2 = BKInstrReadVarint (&ptr);
+			break;
+		}
+	}
+
+	(* opcode) = (void *) ptr;
+
+	return mask;
+}
+
+BK_INLINE BKInt BKReadIntrArg (void ** opcode)
+{
+	return BKInstrReadVarint ((uint8_t const **) opcode);
+}
+
+BK_INLINE void BKReadIntrArgs2 (void ** opcode, BKInt * outArg1, BKInt * outArg2)
+{
+	(* outArg1) = BKInstrReadVarint ((uint8_t const **) opcode);
+	(* outArg2) = BKInstrReadVarint ((uint8_t const **) opcode);
+}
+
+#else
+
 BK_INLINE BKInstrMask BKReadIntrMask (void ** opcode)
 {
 	BKInstrMask mask = *(BKInstrMask *) *opcode;
@@ -168,21 +211,208 @@ BK_INLINE BKInstrMask BKReadIntrMask (void ** opcode)
 	return mask;
 }
 
+BK_INLINE BKInt BKReadIntrArg (void ** opcode)
+{
+	return BKReadIntrMask (opcode).arg1.arg1;
+}
+
+BK_INLINE void BKReadIntrArgs2 (void ** opcode, BKInt * outArg1, BKInt * outArg2)
+{
+	BKInstrMask mask = BKReadIntrMask (opcode);
+
+	(* outArg1) = mask.arg2.arg1;
+	(* outArg2) = mask.arg2.arg2;
+}
+
+#endif /* BK_TK_COMPACT_CODE */
+
 BK_INLINE BKInt value2Pitch (BKTKInterpreter const* interpreter, BKInt value)
 {
 	return (BKInt) ((int64_t) value * BK_FINT20_UNIT * 12 / interpreter -> octaveSize / 100);
 }
 
+static void BKTKTrackStateSetAttr (BKTKTrackState * state, BKEnum attr, BKInt value)
+{
+	switch (attr) {
+		case BK_NOTE: {
+			state -> note = value;
+			state -> flags |= BKTKTrackStateNote;
+			break;
+		}
+		case BK_VOLUME: {
+			state -> volume = value;
+			state -> flags |= BKTKTrackStateVolume;
+			break;
+		}
+		case BK_MASTER_VOLUME: {
+			state -> masterVolume = value;
+			state -> flags |= BKTKTrackStateMasterVolume;
+			break;
+		}
+		case BK_PANNING: {
+			state -> panning = value;
+			state -> flags |= BKTKTrackStatePanning;
+			break;
+		}
+		case BK_PITCH: {
+			state -> pitch = value;
+			state -> flags |= BKTKTrackStatePitch;
+			break;
+		}
+		case BK_DUTY_CYCLE: {
+			state -> dutyCycle = value;
+			state -> flags |= BKTKTrackStateDutyCycle;
+			break;
+		}
+		case BK_PHASE_WRAP: {
+			state -> phaseWrap = value;
+			state -> flags |= BKTKTrackStatePhaseWrap;
+			break;
+		}
+		case BK_ARPEGGIO_DIVIDER: {
+			state -> arpeggioDivider = value;
+			state -> flags |= BKTKTrackStateArpeggioDivider;
+			break;
+		}
+		case BK_WAVEFORM: {
+			state -> waveform = value;
+			state -> flags &= ~(BKTKTrackStateWaveformData | BKTKTrackStateSample);
+			state -> flags |= BKTKTrackStateWaveform;
+			break;
+		}
+		case BK_SAMPLE_REPEAT: {
+			state -> sampleRepeat = value;
+			state -> flags |= BKTKTrackStateSampleRepeat;
+			break;
+		}
+	}
+}
+
+static void BKTKTrackStateSetPtr (BKTKTrackState * state, BKEnum attr, void * ptr, BKSize size)
+{
+	switch (attr) {
+		case BK_ARPEGGIO: {
+			state -> arpeggio [0] = 0;
+
+			if (ptr) {
+				memcpy (state -> arpeggio, ptr, BKMin (size, sizeof (state -> arpeggio)));
+			}
+
+			state -> flags |= BKTKTrackStateArpeggio;
+			break;
+		}
+		case BK_WAVEFORM: {
+			state -> waveformData = ptr;
+			state -> flags &= ~(BKTKTrackStateWaveform | BKTKTrackStateSample);
+			state -> flags |= BKTKTrackStateWaveformData;
+			break;
+		}
+		case BK_INSTRUMENT: {
+			state -> instrument = ptr;
+			state -> flags |= BKTKTrackStateInstrument;
+			break;
+		}
+		case BK_SAMPLE: {
+			state -> sample = ptr;
+			state -> flags &= ~(BKTKTrackStateWaveform | BKTKTrackStateWaveformData);
+			state -> flags |= BKTKTrackStateSample;
+			break;
+		}
+		case BK_SAMPLE_RANGE: {
+			memcpy (state -> sampleRange, ptr, sizeof (state -> sampleRange));
+			state -> flags |= BKTKTrackStateSampleRange;
+			break;
+		}
+		case BK_SAMPLE_SUSTAIN_RANGE: {
+			memcpy (state -> sampleSustainRange, ptr, sizeof (state -> sampleSustainRange));
+			state -> flags |= BKTKTrackStateSampleSustainRange;
+			break;
+		}
+	}
+}
+
+static void BKTKTrackStateSetEffect (BKTKTrackState * state, BKEnum effect, BKInt const args [3])
+{
+	BKInt i;
+
+	for (i = 0; i < state -> numEffects; i ++) {
+		if (state -> effects [i][0] == effect) {
+			break;
+		}
+	}
+
+	if (i >= BK_INTR_MAX_EFFECTS) {
+		return;
+	}
+
+	if (i == state -> numEffects) {
+		state -> numEffects ++;
+	}
+
+	state -> effects [i][0] = effect;
+	memcpy (&state -> effects [i][1], args, sizeof (BKInt [3]));
+}
+
+/**
+ * Set attribute of render track
+ *
+ * The value is recorded in the track state only while running silently, i.e.,
+ * when seeking or building keyframes.
+ */
+BK_INLINE void BKTKTrackSetAttr (BKTKTrack * track, BKEnum attr, BKInt value)
+{
+	if (track -> object.object.flags & BKTKTrackFlagRecordState) {
+		BKTKTrackStateSetAttr (&track -> state, attr, value);
+	}
+
+	if (!(track -> object.object.flags & BKTKTrackFlagSilent)) {
+		BKSetAttr (&track -> renderTrack, attr, value);
+	}
+}
+
+/**
+ * Set pointer attribute of render track
+ *
+ * Recorded like `BKTKTrackSetAttr`.
+ */
+BK_INLINE void BKTKTrackSetPtr (BKTKTrack * track, BKEnum attr, void * ptr, BKSize size)
+{
+	if (track -> object.object.flags & BKTKTrackFlagRecordState) {
+		BKTKTrackStateSetPtr (&track -> state, attr, ptr, size);
+	}
+
+	if (!(track -> object.object.flags & BKTKTrackFlagSilent)) {
+		BKSetPtr (&track -> renderTrack, attr, ptr, size);
+	}
+}
+
+/**
+ * Set effect of render track
+ *
+ * Recorded like `BKTKTrackSetAttr`.
+ */
+BK_INLINE void BKTKTrackSetEffect (BKTKTrack * track, BKEnum effect, BKInt const args [3])
+{
+	if (track -> object.object.flags & BKTKTrackFlagRecordState) {
+		BKTKTrackStateSetEffect (&track -> state, effect, args);
+	}
+
+	if (!(track -> object.object.flags & BKTKTrackFlagSilent)) {
+		BKTrackSetEffect (&track -> renderTrack, effect, args, sizeof (BKInt [3]));
+	}
+}
+
 BKInt BKTKInterpreterAdvance (BKTKInterpreter * interpreter, BKTKTrack * ctx, BKInt * outTicks)
 {
 	BKInt           value0, value1;
 	BKInt           numSteps = 1;
 	BKInt           run = 1;
 	void          * opcode;
+	void          * instr;
 	BKInt           result = 1;
 	BKTKTickEvent * tickEvent;
-	BKInstrMask     cmdMask, argMask;
-	BKTrack       * track = &ctx -> renderTrack;
+	BKInstrMask     cmdMask;
+	BKContext     * renderContext = ctx -> ctx -> renderContext;
 
 	opcode   = interpreter -> opcodePtr;
 	numSteps = interpreter -> numSteps;
@@ -203,25 +433,25 @@ BKInt BKTKInterpreterAdvance (BKTKInterpreter * interpreter, BKTKTrack * ctx, BK
 							break;
 						}
 						case BKIntrEventAttack: {
-							BKSetPtr (track, BK_ARPEGGIO, NULL, 0);
+							BKTKTrackSetPtr (ctx, BK_ARPEGGIO, NULL, 0);
 
 							for (BKInt i = 0; i < interpreter -> nextNoteIndex; i ++) {
-								BKSetAttr (track, BK_NOTE, interpreter -> nextNotes [i]);
+								BKTKTrackSetAttr (ctx, BK_NOTE, interpreter -> nextNotes [i]);
 							}
 
 							if (interpreter -> object.flags & BKTKInterpreterFlagHasArpeggio) {
-								BKSetPtr (track, BK_ARPEGGIO, interpreter -> nextArpeggio, sizeof (interpreter -> nextArpeggio));
+								BKTKTrackSetPtr (ctx, BK_ARPEGGIO, interpreter -> nextArpeggio, sizeof (interpreter -> nextArpeggio));
 							}
 
 							break;
 						}
 						case BKIntrEventRelease: {
-							BKSetAttr (track, BK_NOTE, BK_NOTE_RELEASE);
+							BKTKTrackSetAttr (ctx, BK_NOTE, BK_NOTE_RELEASE);
 							break;
 						}
 						case BKIntrEventMute: {
-							BKSetAttr (track, BK_NOTE, BK_NOTE_MUTE);
-							BKSetPtr (track, BK_ARPEGGIO, NULL, 0);
+							BKTKTrackSetAttr (ctx, BK_NOTE, BK_NOTE_MUTE);
+							BKTKTrackSetPtr (ctx, BK_ARPEGGIO, NULL, 0);
 							break;
 						}
 					}
@@ -252,6 +482,7 @@ BKInt BKTKInterpreterAdvance (BKTKInterpreter * interpreter, BKTKTrack * ctx, BK
 	}
 
 	do {
+		instr = opcode;
 		cmdMask = BKReadIntrMask (&opcode);
 
 		switch (cmdMask.arg1.cmd) {
@@ -265,8 +496,8 @@ BKInt BKTKInterpreterAdvance (BKTKInterpreter * interpreter, BKTKTrack * ctx, BK
 					interpreter -> nextNoteIndex ++;
 				}
 				else {
-					BKSetPtr (track, BK_ARPEGGIO, NULL, 0);
-					BKSetAttr (track, BK_NOTE, value0);
+					BKTKTrackSetPtr (ctx, BK_ARPEGGIO, NULL, 0);
+					BKTKTrackSetAttr (ctx, BK_NOTE, value0);
 				}
 
 				interpreter -> object.flags &= ~BKTKInterpreterFlagHasArpeggio;
@@ -284,15 +515,14 @@ BKInt BKTKInterpreterAdvance (BKTKInterpreter * interpreter, BKTKTrack * ctx, BK
 				arpeggio [1] = 0;
 
 				for (BKInt i = 0; i < value0; i ++) {
-					argMask = BKReadIntrMask (&opcode);
-					arpeggio [i + 2] = value2Pitch (interpreter, argMask.arg1.arg1);
+					arpeggio [i + 2] = value2Pitch (interpreter, BKReadIntrArg (&opcode));
 				}
 
 				if (interpreter -> object.flags & BKTKInterpreterFlagHasAttackEvent) {
 					memcpy (interpreter -> nextArpeggio, arpeggio, (value0 + 2) * sizeof (BKInt));
 				}
 				else {
-					BKSetPtr (track, BK_ARPEGGIO, arpeggio, sizeof (arpeggio));
+					BKTKTrackSetPtr (ctx, BK_ARPEGGIO, arpeggio, sizeof (arpeggio));
 				}
 
 				break;
@@ -304,44 +534,44 @@ BKInt BKTKInterpreterAdvance (BKTKInterpreter * interpreter, BKTKTrack * ctx, BK
 					value0 = BK_DEFAULT_ARPEGGIO_DIVIDER;
 				}
 
-				BKSetAttr (track, BK_ARPEGGIO_DIVIDER, value0);
+				BKTKTrackSetAttr (ctx, BK_ARPEGGIO_DIVIDER, value0);
 				break;
 			}
 			case BKIntrRelease: {
 				BKTKInterpreterEventSet (interpreter, BKIntrEventRelease | BKIntrEventMute, 0);
-				BKSetAttr (track, BK_NOTE, BK_NOTE_RELEASE);
+				BKTKTrackSetAttr (ctx, BK_NOTE, BK_NOTE_RELEASE);
 				interpreter -> nextNoteIndex = 0;
 				break;
 			}
 			case BKIntrMute: {
 				BKTKInterpreterEventSet (interpreter, BKIntrEventRelease | BKIntrEventMute, 0);
-				BKSetAttr (track, BK_NOTE, BK_NOTE_MUTE);
+				BKTKTrackSetAttr (ctx, BK_NOTE, BK_NOTE_MUTE);
 				interpreter -> nextNoteIndex = 0;
 				break;
 			}
 			case BKIntrVolume: {
 				value0 = cmdMask.arg1.arg1;
-				BKSetAttr (track, BK_VOLUME, value0);
+				BKTKTrackSetAttr (ctx, BK_VOLUME, value0);
 				break;
 			}
 			case BKIntrMasterVolume: {
 				value0 = cmdMask.arg1.arg1;
-				BKSetAttr (track, BK_MASTER_VOLUME, value0);
+				BKTKTrackSetAttr (ctx, BK_MASTER_VOLUME, value0);
 				break;
 			}
 			case BKIntrPanning: {
 				value0 = cmdMask.arg1.arg1;
-				BKSetAttr (track, BK_PANNING, value0);
+				BKTKTrackSetAttr (ctx, BK_PANNING, value0);
 				break;
 			}
 			case BKIntrPitch: {
 				value0 = value2Pitch (interpreter, cmdMask.arg1.arg1);
-				BKSetAttr (track, BK_PITCH, value0);
+				BKTKTrackSetAttr (ctx, BK_PITCH, value0);
 				break;
 			}
 			case BKIntrPulseKernel: {
 				value0 = cmdMask.arg1.arg1;
-				BKSetPtr (track -> unit.ctx, BK_PULSE_KERNEL, (void *) BKBufferPulseKernels [value0], sizeof (void *));
+				BKSetPtr (renderContext, BK_PULSE_KERNEL, (void *) BKBufferPulseKernels [value0], sizeof (void *));
 				break;
 			}
 			case BKIntrAttackTicks: {
@@ -418,29 +648,22 @@ BKInt BKTKInterpreterAdvance (BKTKInterpreter * interpreter, BKTKTrack * ctx, BK
 			}
 			case BKIntrTickRate: {
 				BKTime time;
-				BKContext * ctx = track -> unit.ctx;
 
 				value0 = cmdMask.arg2.arg1;
 				value1 = cmdMask.arg2.arg2;
 
 				if (value1) {
-					time = BKTimeFromSeconds (ctx, (float) value0 / (float) value1);
-					BKSetPtr (ctx, BK_CLOCK_PERIOD, &time, sizeof (time));
+					time = BKTimeFromSeconds (renderContext, (float) value0 / (float) value1);
+					BKSetPtr (renderContext, BK_CLOCK_PERIOD, &time, sizeof (time));
 				}
 				break;
 			}
 			case BKIntrEffect: {
 				BKInt args [8];
 
-				argMask = BKReadIntrMask (&opcode);
-				args [0] = argMask.arg2.arg1;
-				args [3] = argMask.arg2.arg2;
-
-				args [1] = BKReadIntrMask (&opcode).arg1.arg1;
-
-				argMask = BKReadIntrMask (&opcode);
-				args [2] = argMask.arg2.arg1;
-				args [4] = argMask.arg2.arg2;
+				BKReadIntrArgs2 (&opcode, &args [0], &args [3]);
+				args [1] = BKReadIntrArg (&opcode);
+				BKReadIntrArgs2 (&opcode, &args [2], &args [4]);
 
 				if (args [3]) {
 					args [0] = interpreter -> stepTickCount * args [0] / args [3];
@@ -450,17 +673,17 @@ BKInt BKTKInterpreterAdvance (BKTKInterpreter * interpreter, BKTKTrack * ctx, BK
 					args [2] = interpreter -> stepTickCount * args [2] / args [4];
 				}
 
-				BKTrackSetEffect (track, cmdMask.arg1.arg1, args, sizeof (BKInt [3]));
+				BKTKTrackSetEffect (ctx, cmdMask.arg1.arg1, args);
 				break;
 			}
 			case BKIntrDutyCycle: {
 				value0 = cmdMask.arg1.arg1;
-				BKSetAttr (track, BK_DUTY_CYCLE, value0);
+				BKTKTrackSetAttr (ctx, BK_DUTY_CYCLE, value0);
 				break;
 			}
 			case BKIntrPhaseWrap: {
 				value0 = cmdMask.arg1.arg1;
-				BKSetAttr (track, BK_PHASE_WRAP, value0);
+				BKTKTrackSetAttr (ctx, BK_PHASE_WRAP, value0);
 				break;
 			}
 			case BKIntrInstrument: {
@@ -470,11 +693,11 @@ BKInt BKTKInterpreterAdvance (BKTKInterpreter * interpreter, BKTKTrack * ctx, BK
 				value0 = cmdMask.arg1.arg1;
 				instrRef = BKArrayItemAt (&ctx -> ctx -> instruments, value0);
 
-				if (instrRef) {
+				if (instrRef && *instrRef) {
 					instr = &(*instrRef) -> instr;
 				}
 
-				BKSetPtr (track, BK_INSTRUMENT, instr, sizeof (void *));
+				BKTKTrackSetPtr (ctx, BK_INSTRUMENT, instr, sizeof (void *));
 				break;
 			}
 			case BKIntrWaveform: {
@@ -516,13 +739,13 @@ BKInt BKTKInterpreterAdvance (BKTKInterpreter * interpreter, BKTKTrack * ctx, BK
 				}
 
 				if (value0 == BK_CUSTOM) {
-					BKSetPtr (track, BK_WAVEFORM, &waveform -> data, sizeof (void *));
+					BKTKTrackSetPtr (ctx, BK_WAVEFORM, &waveform -> data, sizeof (void *));
 				}
 				else {
-					BKSetAttr (track, BK_WAVEFORM, value0);
+					BKTKTrackSetAttr (ctx, BK_WAVEFORM, value0);
 				}
 
-				BKSetAttr (track, BK_MASTER_VOLUME, masterVolume);
+				BKTKTrackSetAttr (ctx, BK_MASTER_VOLUME, masterVolume);
 
 				break;
 			}
@@ -533,15 +756,15 @@ BKInt BKTKInterpreterAdvance (BKTKInterpreter * interpreter, BKTKTrack * ctx, BK
 				sample = *(BKTKSample **) BKArrayItemAt (&ctx -> ctx -> samples, value0);
 
 				if (sample) {
-					BKSetPtr (track, BK_SAMPLE, sample ? &sample -> data : NULL, sizeof (void *));
-					BKSetAttr (track, BK_SAMPLE_REPEAT, sample -> repeat);
+					BKTKTrackSetPtr (ctx, BK_SAMPLE, sample ? &sample -> data : NULL, sizeof (void *));
+					BKTKTrackSetAttr (ctx, BK_SAMPLE_REPEAT, sample -> repeat);
 
 					if (sample -> range [0] != sample -> range [1]) {
-						BKSetPtr (track, BK_SAMPLE_RANGE, sample -> range, sizeof (sample -> range));
+						BKTKTrackSetPtr (ctx, BK_SAMPLE_RANGE, sample -> range, sizeof (sample -> range));
 					}
 
 					if (sample -> sustainRange [0] != sample -> sustainRange [1]) {
-						BKSetPtr (track, BK_SAMPLE_SUSTAIN_RANGE, sample -> sustainRange, sizeof (sample -> sustainRange));
+						BKTKTrackSetPtr (ctx, BK_SAMPLE_SUSTAIN_RANGE, sample -> sustainRange, sizeof (sample -> sustainRange));
 					}
 				}
 
@@ -549,25 +772,25 @@ BKInt BKTKInterpreterAdvance (BKTKInterpreter * interpreter, BKTKTrack * ctx, BK
 			}
 			case BKIntrSampleRepeat: {
 				value0 = cmdMask.arg1.arg1;
-				BKSetAttr (track, BK_SAMPLE_REPEAT, value0);
+				BKTKTrackSetAttr (ctx, BK_SAMPLE_REPEAT, value0);
 				break;
 			}
 			case BKIntrSampleRange: {
 				BKInt range [2];
 
-				range [0] = BKReadIntrMask (&opcode).arg1.arg1;
-				range [1] = BKReadIntrMask (&opcode).arg1.arg1;
+				range [0] = BKReadIntrArg (&opcode);
+				range [1] = BKReadIntrArg (&opcode);
 
-				BKSetPtr (track, BK_SAMPLE_RANGE, range, sizeof (range));
+				BKTKTrackSetPtr (ctx, BK_SAMPLE_RANGE, range, sizeof (range));
 				break;
 			}
 			case BKIntrSampleSustainRange: {
 				BKInt range [2];
 
-				range [0] = BKReadIntrMask (&opcode).arg1.arg1;
-				range [1] = BKReadIntrMask (&opcode).arg1.arg1;
+				range [0] = BKReadIntrArg (&opcode);
+				range [1] = BKReadIntrArg (&opcode);
 
-				BKSetPtr (track, BK_SAMPLE_SUSTAIN_RANGE, range, sizeof (range));
+				BKTKTrackSetPtr (ctx, BK_SAMPLE_SUSTAIN_RANGE, range, sizeof (range));
 				break;
 			}
 			case BKIntrReturn: {
@@ -577,51 +800,15 @@ BKInt BKTKInterpreterAdvance (BKTKInterpreter * interpreter, BKTKTrack * ctx, BK
 				break;
 			}
 			case BKIntrCall: {
-				BKTKGroup * group = NULL;
-				BKTKTrack * track = NULL;
-				BKTKStackItem * prevItem = NULL;
-				BKTKStackItem * item;
-
-				value0 = cmdMask.grp.idx1;
-				value1 = cmdMask.grp.idx2;
-
 				if (interpreter -> stackPtr >= interpreter -> stackEnd) {
 					break;
 				}
 
-				if (interpreter -> stackPtr > interpreter -> stack) {
-					prevItem = interpreter -> stackPtr - 1;
-				}
-
-				item = interpreter -> stackPtr ++;
-				item -> ptr = (uintptr_t) opcode;
-
-				switch (cmdMask.grp.type) {
-					case BKGroupIndexTypeLocal: {
-						if (prevItem) {
-							track = *(BKTKTrack **) BKArrayItemAt (&ctx -> ctx -> tracks, prevItem -> trackIdx);
-						}
-						else {
-							track = ctx;
-						}
-						break;
-					}
-					case BKGroupIndexTypeGlobal: {
-						track = *(BKTKTrack **) BKArrayItemAt (&ctx -> ctx -> tracks, 0);
-						break;
-					}
-					case BKGroupIndexTypeTrack: {
-						track = *(BKTKTrack **) BKArrayItemAt (&ctx -> ctx -> tracks, value1);
-						break;
-					}
-				}
-
-				if (track) {
-					group = *(BKTKGroup **) BKArrayItemAt (&track -> groups, value0);
-					opcode = group -> byteCode.first -> data;
-					item -> trackIdx = track -> object.index;
-				}
+				// return after call arguments
+				(interpreter -> stackPtr ++) -> ptr = (uintptr_t) opcode + BK_INTR_CALL_ARGS_SIZE;
 
+				// offset to group was resolved when linking
+				opcode = (uint8_t *) instr + cmdMask.arg1.arg1 * (BKInt) BK_INTR_CODE_UNIT;
 				break;
 			}
 			case BKIntrRepeatStart: {
@@ -646,7 +833,7 @@ BKInt BKTKInterpreterAdvance (BKTKInterpreter * interpreter, BKTKTrack * ctx, BK
 			case BKIntrEnd: {
 				BKTKInterpreterEventSet (interpreter, BKIntrEventStep, BK_INT_MAX);
 				interpreter -> object.flags |= BKTKInterpreterFlagHasStopped;
-				opcode = ((uint32_t *) opcode) - 1; // repeat command forever
+				opcode = instr; // repeat command forever
 				run = 0;
 				result = 0;
 				break;
@@ -694,6 +881,78 @@ void BKTKInterpreterReset (BKTKInterpreter * interpreter)
 	interpreter -> octaveSize      = DEFAULT_OCTAVE_SIZE;
 }
 
+void BKTKTrackStateApply (BKTKTrackState const * state, BKTrack * track)
+{
+	BKUInt flags = state -> flags;
+
+	if (flags & BKTKTrackStateWaveform) {
+		BKSetAttr (track, BK_WAVEFORM, state -> waveform);
+	}
+	else if (flags & BKTKTrackStateWaveformData) {
+		BKSetPtr (track, BK_WAVEFORM, state -> waveformData, sizeof (void *));
+	}
+	else if (flags & BKTKTrackStateSample) {
+		BKSetPtr (track, BK_SAMPLE, state -> sample, sizeof (void *));
+	}
+
+	if (flags & BKTKTrackStateSampleRepeat) {
+		BKSetAttr (track, BK_SAMPLE_REPEAT, state -> sampleRepeat);
+	}
+
+	if (flags & BKTKTrackStateSampleRange) {
+		BKSetPtr (track, BK_SAMPLE_RANGE, (void *) state -> sampleRange, sizeof (state -> sampleRange));
+	}
+
+	if (flags & BKTKTrackStateSampleSustainRange) {
+		BKSetPtr (track, BK_SAMPLE_SUSTAIN_RANGE, (void *) state -> sampleSustainRange, sizeof (state -> sampleSustainRange));
+	}
+
+	if (flags & BKTKTrackStateMasterVolume) {
+		BKSetAttr (track, BK_MASTER_VOLUME, state -> masterVolume);
+	}
+
+	if (flags & BKTKTrackStateVolume) {
+		BKSetAttr (track, BK_VOLUME, state -> volume);
+	}
+
+	if (flags & BKTKTrackStatePanning) {
+		BKSetAttr (track, BK_PANNING, state -> panning);
+	}
+
+	if (flags & BKTKTrackStatePitch) {
+		BKSetAttr (track, BK_PITCH, state -> pitch);
+	}
+
+	if (flags & BKTKTrackStateDutyCycle) {
+		BKSetAttr (track, BK_DUTY_CYCLE, state -> dutyCycle);
+	}
+
+	if (flags & BKTKTrackStatePhaseWrap) {
+		BKSetAttr (track, BK_PHASE_WRAP, state -> phaseWrap);
+	}
+
+	if (flags & BKTKTrackStateArpeggioDivider) {
+		BKSetAttr (track, BK_ARPEGGIO_DIVIDER, state -> arpeggioDivider);
+	}
+
+	if (flags & BKTKTrackStateInstrument) {
+		BKSetPtr (track, BK_INSTRUMENT, state -> instrument, sizeof (void *));
+	}
+
+	for (BKInt i = 0; i < state -> numEffects; i ++) {
+		BKTrackSetEffect (track, state -> effects [i][0], &state -> effects [i][1], sizeof (BKInt [3]));
+	}
+
+	if ((flags & BKTKTrackStateNote) && state -> note >= 0) {
+		BKSetPtr (track, BK_ARPEGGIO, NULL, 0);
+		BKSetAttr (track, BK_NOTE, state -> note);
+
+		if ((flags & BKTKTrackStateArpeggio) && state -> arpeggio [0]) {
+			BKSetPtr (track, BK_ARPEGGIO, (void *) state -> arpeggio, sizeof (state -> arpeggio));
+		}
+	}
+}
+
 BKClass const BKTKInterpreterClass =
 {
 	.instanceSize = sizeof (BKTKInterpreter),
@@ -33,10 +33,33 @@
 #define BK_INTR_STACK_SIZE 16
 #define BK_INTR_MAX_EVENTS 8
 #define BK_INTR_STEP_TICKS 24
+#define BK_INTR_MAX_EFFECTS 8
+
+/**
+ * Encode linked byte code with an opcode byte followed by variable-length
+ * operands instead of 32-bit words
+ *
+ * Set with the configure option `--enable-compact-code`.
+ */
+#ifndef BK_TK_COMPACT_CODE
+#define BK_TK_COMPACT_CODE 0
+#endif
+
+#if BK_TK_COMPACT_CODE
+#define BK_INTR_CODE_UNIT 1
+#define BK_INTR_CALL_ARGS_SIZE 0
+#else
+#define BK_INTR_CODE_UNIT sizeof (uint32_t)
+#define BK_INTR_CALL_ARGS_SIZE (2 * sizeof (uint32_t)) // line and column number
+#endif
+
+#define BK_INTR_MAX_VARINT_SIZE 5
+#define BK_INTR_CALL_OFFSET_SIZE 4 // call offsets have a fixed size
 
 typedef struct BKTKInterpreter BKTKInterpreter;
 typedef struct BKTKTickEvent BKTKTickEvent;
 typedef struct BKTKStackItem BKTKStackItem;
+typedef struct BKTKTrackState BKTKTrackState;
 
 enum BKInstruction
 {
@@ -92,6 +115,26 @@ enum BKTKInterpreterFlag
 	BKTKInterpreterFlagHasRepeated    = 1 << 3,
 };
 
+enum BKTKTrackStateFlag
+{
+	BKTKTrackStateNote               = 1 << 0,
+	BKTKTrackStateVolume             = 1 << 1,
+	BKTKTrackStateMasterVolume       = 1 << 2,
+	BKTKTrackStatePanning            = 1 << 3,
+	BKTKTrackStatePitch              = 1 << 4,
+	BKTKTrackStateDutyCycle          = 1 << 5,
+	BKTKTrackStatePhaseWrap          = 1 << 6,
+	BKTKTrackStateArpeggioDivider    = 1 << 7,
+	BKTKTrackStateArpeggio           = 1 << 8,
+	BKTKTrackStateWaveform           = 1 << 9,
+	BKTKTrackStateWaveformData       = 1 << 10,
+	BKTKTrackStateInstrument         = 1 << 11,
+	BKTKTrackStateSample             = 1 << 12,
+	BKTKTrackStateSampleRepeat       = 1 << 13,
+	BKTKTrackStateSampleRange        = 1 << 14,
+	BKTKTrackStateSampleSustainRange = 1 << 15,
+};
+
 enum BKTKGroupIndexType
 {
 	BKGroupIndexTypeLocal  = 0,
@@ -119,6 +162,87 @@ typedef union
 	uint32_t value;
 } BKInstrMask;
 
+/**
+ * Get number of words of instruction including its arguments
+ */
+BK_INLINE BKUSize BKInstrMaskSize (BKInstrMask mask)
+{
+	switch (mask.arg1.cmd) {
+		case BKIntrArpeggio: {
+			return 1 + mask.arg1.arg1;
+		}
+		case BKIntrEffect: {
+			return 4;
+		}
+		case BKIntrCall:
+		case BKIntrSampleRange:
+		case BKIntrSampleSustainRange: {
+			return 3;
+		}
+		default: {
+			return 1;
+		}
+	}
+}
+
+/**
+ * Get number of operands of instruction in compact encoding
+ *
+ * Additional argument words of `BKIntrArpeggio`, `BKIntrEffect`,
+ * `BKIntrSampleRange` and `BKIntrSampleSustainRange` are not counted.
+ */
+BK_INLINE BKUInt BKInstrNumOperands (BKUInt cmd)
+{
+	switch (cmd) {
+		case BKIntrEnd:
+		case BKIntrMute:
+		case BKIntrRelease:
+		case BKIntrRepeatStart:
+		case BKIntrReturn:
+		case BKIntrSampleRange:
+		case BKIntrSampleSustainRange: {
+			return 0;
+		}
+		case BKIntrAttackTicks:
+		case BKIntrMuteTicks:
+		case BKIntrReleaseTicks:
+		case BKIntrTickRate:
+		case BKIntrTicks: {
+			return 2;
+		}
+		default: {
+			return 1;
+		}
+	}
+}
+
+/**
+ * Read zigzag encoded varint operand and advance `ptr`
+ */
+BK_INLINE BKInt BKInstrReadVarint (uint8_t const ** ptr)
+{
+	uint8_t const * p = *ptr;
+	uint32_t value = *p ++;
+	unsigned shift = 7;
+	uint8_t byte;
+
+	// most operands fit into a single byte
+	if (value & 0x80) {
+		value &= 0x7F;
+
+		do {
+			byte = *p ++;
+			value |= (uint32_t) (byte & 0x7F) << shift;
+			shift += 7;
+		}
+		while (byte & 0x80);
+	}
+
+	*ptr = p;
+
+	return (BKInt) (value >> 1) ^ -(BKInt) (value & 1);
+}
+
 struct BKTKTickEvent
 {
 	BKInt event;
@@ -128,7 +252,35 @@ struct BKTKTickEvent
 struct BKTKStackItem
 {
 	uintptr_t ptr;
-	uint8_t   trackIdx;
+};
+
+/**
+ * Last values set on a render track by the interpreter
+ *
+ * Used to restore a render track which did not receive the commands, e.g.,
+ * after a silent seek.
+ */
+struct BKTKTrackState
+{
+	BKUInt  flags;
+	BKInt   note;
+	BKInt   volume;
+	BKInt   masterVolume;
+	BKInt   panning;
+	BKInt   pitch;
+	BKInt   dutyCycle;
+	BKInt   phaseWrap;
+	BKInt   arpeggioDivider;
+	BKInt   arpeggio [1 + BK_MAX_ARPEGGIO];
+	BKInt   waveform;
+	void  * waveformData;
+	void  * instrument;
+	void  * sample;
+	BKInt   sampleRepeat;
+	BKInt   sampleRange [2];
+	BKInt   sampleSustainRange [2];
+	BKInt   numEffects;
+	BKInt   effects [BK_INTR_MAX_EFFECTS][4]; // effect type and 3 arguments
 };
 
 struct BKTKInterpreter {
@@ -170,4 +322,11 @@ extern BKInt BKTKInterpreterAdvance (BKTKInterpreter * interpreter, BKTKTrack *
  */
 extern void BKTKInterpreterReset (BKTKInterpreter * interpreter);
 
+/**
+ * Apply recorded track state to render track
+ *
+ * A playing note is attacked again, releasing notes are not restored.
+ */
+extern void BKTKTrackStateApply (BKTKTrackState const * state, BKTrack * track);
+
 #endif /* ! _BK_TK_INTERPRETER_H_ */
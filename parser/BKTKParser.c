@@ -22,6 +22,7 @@
  */
 
 #include "BKTKParser.h"
+#include "BKTKTree.h"
 
 #define STACK_INIT_SIZE 32
 #define BUFFER_INIT_SIZE 4096
@@ -62,6 +63,12 @@ BKInt BKTKParserInit (BKTKParser * parser)
 		goto error;
 	}
 
+	parser -> argData = malloc (parser -> argCapacity * sizeof (*parser -> argData));
+
+	if (!parser -> argData) {
+		goto error;
+	}
+
 	if ((res = BKBlockPoolInit (&parser -> blockPool, sizeof (BKTKParserNode), BLOCK_POOL_SEGMENT_CAPACITY)) != 0) {
 		goto error;
 	}
@@ -180,12 +187,20 @@ static BKInt BKTKParserArgsEnsureSpace (BKTKParser * parser)
 	if (parser -> argCount + minAddCap >= parser -> argCapacity) {
 		BKUSize newCapacity = BKNextPow2 (parser -> argCount + minAddCap);
 		BKTKParserArg * args = realloc (parser -> args, newCapacity * sizeof (*args));
+		uint8_t const ** argData;
 
 		if (!args) {
 			return BK_ALLOCATION_ERROR;
 		}
 
 		parser -> args = args;
+		argData = realloc (parser -> argData, newCapacity * sizeof (*argData));
+
+		if (!argData) {
+			return BK_ALLOCATION_ERROR;
+		}
+
+		parser -> argData = argData;
 		parser -> argCapacity = newCapacity;
 	}
 
@@ -200,6 +215,15 @@ static BKTKParserItem * BKTKParserStackPush (BKTKParser * parser)
 	BKTKParserNode * node;
 	BKTKParserItem * item;
 
+	if (parser -> tree) {
+		item = &parser -> stack [parser -> stackSize ++];
+		memset (item, 0, sizeof (*item));
+		item -> index = (uint32_t) parser -> tree -> numNodes;
+		BKTKTreeAppendNode (parser -> tree);
+
+		return item;
+	}
+
 	node = BKTKParserNodeAlloc (parser);
 
 	if (!node) {
@@ -257,6 +281,21 @@ static void BKTKParserStackLink (BKTKParser * parser)
 {
 	BKTKParserNode * a, * b;
 
+	if (parser -> tree) {
+		uint32_t a = parser -> stack [parser -> stackSize - 1].index;
+		uint32_t b = parser -> stack [parser -> stackSize - 2].index;
+
+		// name item has the index of its group
+		if (parser -> itemCount && !parser -> stack [parser -> stackSize - 2].isName) {
+			parser -> tree -> nodes [b].nextNode = a - b;
+		}
+		else {
+			parser -> tree -> nodes [b].subNode = a - b;
+		}
+
+		return;
+	}
+
 	a = parser -> stack [parser -> stackSize - 1].node;
 	b = parser -> stack [parser -> stackSize - 2].node;
 
@@ -322,9 +361,11 @@ void BKTKParserReset (BKTKParser * parser)
 
 	parser -> state     = BKTKParserStateRoot;
 	parser -> stackSize = 0;
+	parser -> tree      = NULL;
 	parser -> bufferLen = 0;
-	parser -> itemCount = 0;
-	parser -> argCount  = 0;
+	parser -> itemCount   = 0;
+	parser -> argCount    = 0;
+	parser -> argDataSize = 0;
 
 	BKStringDispose (&parser -> escapedName);
 	parser -> escapedName = BK_STRING_INIT;
@@ -349,6 +390,7 @@ static void BKTKParserDispose (BKTKParser * parser)
 	free (parser -> stack);
 	free (parser -> buffer);
 	free (parser -> args);
+	free (parser -> argData);
 
 	BKBlockPoolDispose (&parser -> blockPool);
 	BKBlockPoolDispose (&parser -> argsPool);
@@ -393,10 +435,15 @@ static void BKTKParserEndBuffer (BKTKParser * parser)
 }
 
 /**
- * Push argument and append data to buffer
+ * Push argument
+ *
+ * Resident token data is referenced until the command ends; other data is
+ * appended to the buffer. Persistent token data is referenced by the node
+ * except for the command name.
  */
 static void BKTKParserPushArg (BKTKParser * parser, BKTKToken const * token)
 {
+	uint8_t const ** data = &parser -> argData [parser -> argCount];
 	BKTKParserArg * arg = &parser -> args [parser -> argCount ++];
 
 	arg -> cursor = parser -> bufferLen;
@@ -404,16 +451,66 @@ static void BKTKParserPushArg (BKTKParser * parser, BKTKToken const * token)
 	arg -> type = token -> type;
 	arg -> offset = token -> offset;
 
+	if ((token -> flags & BKTKTokenFlagPersistent) && parser -> argCount > 1) {
+		arg -> cursor = BK_TK_PARSER_EXTERNAL_CURSOR;
+		*data = token -> data;
+		return;
+	}
+
+	parser -> argDataSize += token -> dataLen + 1;
+
+	if (token -> flags & (BKTKTokenFlagResident | BKTKTokenFlagPersistent)) {
+		*data = token -> data;
+		return;
+	}
+
+	*data = NULL;
+
 	memcpy (&parser -> buffer [parser -> bufferLen], token -> data, token -> dataLen);
 	parser -> bufferLen += token -> dataLen;
 
 	BKTKParserEndBuffer (parser);
 }
 
+/**
+ * Set empty name of group node in `tree`
+ */
+static BKInt BKTKParserSetEmptyName (BKTKParser * parser, uint32_t index)
+{
+	BKString * strings = BKTKTreeAllocStrings (parser -> tree, 1);
+	uint8_t * chars = BKTKTreeAllocChars (parser -> tree, 1);
+
+	if (!strings || !chars) {
+		return BK_ALLOCATION_ERROR;
+	}
+
+	chars [0] = '\0';
+	strings [0] = (BKString) {
+		.str = chars,
+	};
+
+	return BKTKTreeSetNodeStrings (parser -> tree, &parser -> tree -> nodes [index], strings, 0);
+}
+
 static void BKTKParserBeginCmd (BKTKParser * parser, BKTKToken const * token)
 {
 	BKTKParserItem * item;
 
+	// first command of group in `tree` is written to the group node
+	if (parser -> tree && !parser -> itemCount && parser -> stackSize > 1) {
+		uint32_t index = BKTKParserStackLast (parser) -> index;
+
+		item = &parser -> stack [parser -> stackSize ++];
+		memset (item, 0, sizeof (*item));
+		item -> index = index;
+		item -> isName = 1;
+
+		parser -> itemCount ++;
+		BKTKParserPushArg (parser, token);
+
+		return;
+	}
+
 	// item ensured by `BKTKParserStackEnsureSpace` and `BKTKParserNodeEnsureAlloc`
 	item = BKTKParserStackPush (parser);
 
@@ -425,11 +522,73 @@ static void BKTKParserBeginCmd (BKTKParser * parser, BKTKToken const * token)
 	}
 
 	parser -> itemCount ++;
-	item -> node -> offset = token -> offset;
+
+	// offset is set by `BKTKParserEndTreeCommand`
+	if (!parser -> tree) {
+		item -> node -> offset = token -> offset;
+	}
 
 	BKTKParserPushArg (parser, token);
 }
 
+/**
+ * Copy buffered arguments to current node of `tree`
+ */
+static BKInt BKTKParserEndTreeCommand (BKTKParser * parser)
+{
+	BKTKTree * tree = parser -> tree;
+	BKTKTreeNode * node = &tree -> nodes [BKTKParserStackLast (parser) -> index];
+	BKString * strings = BKTKTreeAllocStrings (tree, parser -> argCount);
+	uint8_t * buffer = BKTKTreeAllocChars (tree, parser -> argDataSize);
+	BKInt res;
+
+	if (!strings || !buffer) {
+		return BK_ALLOCATION_ERROR;
+	}
+
+	for (BKUSize i = 0; i < parser -> argCount; i ++) {
+		BKTKParserArg * arg = &parser -> args [i];
+		uint8_t const * data = parser -> argData [i];
+
+		if (arg -> cursor == BK_TK_PARSER_EXTERNAL_CURSOR) {
+			strings [i] = (BKString) {
+				.str = (uint8_t *) data,
+				.len = arg -> length,
+			};
+			continue;
+		}
+
+		if (!data) {
+			data = &parser -> buffer [arg -> cursor];
+		}
+
+		memcpy (buffer, data, arg -> length);
+		buffer [arg -> length] = '\0';
+
+		strings [i] = (BKString) {
+			.str = buffer,
+			.len = arg -> length,
+		};
+
+		buffer += arg -> length + 1;
+	}
+
+	node -> type = parser -> args [0].type;
+	node -> offset = parser -> args [0].offset;
+
+	if ((res = BKTKTreeSetNodeStrings (tree, node, strings, parser -> argCount - 1)) != 0) {
+		return res;
+	}
+
+	// reset argument buffer
+	parser -> argCount = 0;
+	parser -> argDataSize = 0;
+	parser -> bufferLen = 0;
+	parser -> buffer [0] = '\0';
+
+	return 0;
+}
+
 /**
  * Pack buffered arguments of current node
  *
@@ -441,13 +600,17 @@ static BKInt BKTKParserEndCommand (BKTKParser * parser)
 		return 0;
 	}
 
+	if (parser -> tree) {
+		return BKTKParserEndTreeCommand (parser);
+	}
+
 	BKTKParserNode * node = BKTKParserStackLast (parser) -> node;
 
 	if (parser -> argCount) {
 		uint8_t * buffer;
 
 		BKUSize size = (parser -> argCount - 1) * (sizeof (BKTKParserArg) + sizeof (BKString))
-			+ parser -> bufferLen;
+			+ parser -> argDataSize;
 
 		// most commands require less than ARGS_POOL_SEGMENT_SIZE bytes
 		if (size <= ARGS_POOL_SEGMENT_SIZE) {
@@ -466,13 +629,35 @@ static BKInt BKTKParserEndCommand (BKTKParser * parser)
 		BKString * argStrings = (void *) &args [parser -> argCount - 1];
 		buffer = (void *) &argStrings [parser -> argCount - 1];
 
-		memcpy (buffer, parser -> buffer, parser -> bufferLen);
+		BKUSize cursor = 0;
+
+		// pack strings in order and terminate them
+		for (BKUSize i = 0; i < parser -> argCount; i ++) {
+			BKTKParserArg * arg = &parser -> args [i];
+			uint8_t const * data = parser -> argData [i];
+
+			if (arg -> cursor == BK_TK_PARSER_EXTERNAL_CURSOR) {
+				continue;
+			}
+
+			if (!data) {
+				data = &parser -> buffer [arg -> cursor];
+			}
+
+			memcpy (&buffer [cursor], data, arg -> length);
+			buffer [cursor + arg -> length] = '\0';
+			arg -> cursor = (BKUInt) cursor;
+			cursor += arg -> length + 1;
+		}
+
 		memcpy (args, &parser -> args [1], (parser -> argCount - 1) * sizeof (BKTKParserArg));
 
 		for (BKUSize i = 1; i < parser -> argCount; i ++) {
+			BKTKParserArg * arg = &parser -> args [i];
+
 			argStrings [i - 1] = (BKString) {
-				.str = &buffer [parser -> args [i].cursor],
-				.len = parser -> args [i].length,
+				.str = arg -> cursor == BK_TK_PARSER_EXTERNAL_CURSOR ? (uint8_t *) parser -> argData [i] : &buffer [arg -> cursor],
+				.len = arg -> length,
 			};
 		}
 
@@ -496,16 +681,25 @@ static BKInt BKTKParserEndCommand (BKTKParser * parser)
 
 	// reset argument buffer
 	parser -> argCount = 0;
+	parser -> argDataSize = 0;
 	parser -> bufferLen = 0;
 	parser -> buffer [0] = '\0';
 
 	return 0;
 }
 
-static void BKTKParserOpenGroup (BKTKParser * parser, BKTKToken const * token)
+static BKInt BKTKParserOpenGroup (BKTKParser * parser, BKTKToken const * token)
 {
+	BKInt res;
 	BKTKParserItem * item;
 
+	// group in `tree` opened as first item of group has no name
+	if (parser -> tree && !parser -> itemCount && parser -> stackSize > 1) {
+		if ((res = BKTKParserSetEmptyName (parser, BKTKParserStackLast (parser) -> index)) != 0) {
+			return res;
+		}
+	}
+
 	// item ensured by `BKTKParserStackEnsureSpace` and `BKTKParserNodeEnsureAlloc`
 	item = BKTKParserStackPush (parser);
 
@@ -521,16 +715,28 @@ static void BKTKParserOpenGroup (BKTKParser * parser, BKTKToken const * token)
 	item = BKTKParserStackLast (parser);
 	item -> itemCount = parser -> itemCount;
 
-	item -> node -> flags  |= BKTKParserFlagIsGroup;
-	item -> node -> type    = BKTKTypeGrpOpen;
-	item -> node -> offset  = token -> offset;
+	if (parser -> tree) {
+		BKTKTreeNode * node = &parser -> tree -> nodes [item -> index];
+
+		node -> flags  |= BKTKParserFlagIsGroup;
+		node -> type    = BKTKTypeGrpOpen;
+		node -> offset  = token -> offset;
+	}
+	else {
+		item -> node -> flags  |= BKTKParserFlagIsGroup;
+		item -> node -> type    = BKTKTypeGrpOpen;
+		item -> node -> offset  = token -> offset;
+	}
 
 	parser -> itemCount = 0;
+
+	return 0;
 }
 
 static BKInt BKTKParserCloseGroup (BKTKParser * parser)
 {
 	BKInt res = 0;
+	BKInt isEmpty = !parser -> itemCount;
 	BKTKParserItem * item;
 
 	if ((res = BKTKParserEndCommand (parser)) != 0) {
@@ -543,8 +749,15 @@ static BKInt BKTKParserCloseGroup (BKTKParser * parser)
 
 	item = BKTKParserStackLast (parser);
 
+	// group without commands has an empty name
+	if (parser -> tree && isEmpty) {
+		if ((res = BKTKParserSetEmptyName (parser, item -> index)) != 0) {
+			return res;
+		}
+	}
+
 	// move data from first child node to group node and free first child node
-	if (item -> node -> subNode) {
+	if (!parser -> tree && item -> node -> subNode) {
 		BKTKParserNode * subNode;
 
 		BKTKParserNodeTransferArgs (item -> node, item -> node -> subNode);
@@ -586,7 +799,12 @@ static BKInt BKTKParserPutToken (BKTKParser * parser, BKTKToken const * token)
 		goto allocationError;
 	}
 
-	if ((res = BKTKParserNodeEnsureAlloc (parser)) != 0) {
+	if (parser -> tree) {
+		if ((res = BKTKTreeEnsureNode (parser -> tree)) != 0) {
+			goto allocationError;
+		}
+	}
+	else if ((res = BKTKParserNodeEnsureAlloc (parser)) != 0) {
 		goto allocationError;
 	}
 
@@ -714,7 +932,9 @@ static BKInt BKTKParserPutToken (BKTKParser * parser, BKTKToken const * token)
 				goto allocationError;
 			}
 
-			BKTKParserOpenGroup (parser, token);
+			if ((res = BKTKParserOpenGroup (parser, token)) != 0) {
+				goto allocationError;
+			}
 
 			state = BKTKParserStateRoot;
 			break;
@@ -786,7 +1006,13 @@ static BKInt BKTKParserPutToken (BKTKParser * parser, BKTKToken const * token)
 	}
 
 	unexpectedError: {
-		BKStringEscape (&parser -> escapedName, (char *) token -> data);
+		// token data is not terminated if resident
+		BKString name = BK_STRING_INIT;
+
+		BKStringAppendLen (&name, (char const *) token -> data, token -> dataLen);
+		BKStringEscape (&parser -> escapedName, name.str ? (char *) name.str : "");
+		BKStringDispose (&name);
+
 		BKTKParserSetError (parser, "Unexpected token '%s' on line %u:%u",
 			parser -> escapedName.str,
 			token -> offset.lineno, token -> offset.colno);
@@ -816,11 +1042,54 @@ BKInt BKTKParserPutTokens (BKTKParser * parser, BKTKToken const * tokens, BKUSiz
 	return 0;
 }
 
+void BKTKParserSetTree (BKTKParser * parser, BKTKTree * tree)
+{
+	parser -> tree = tree;
+	parser -> stack [0].index = 0;
+}
+
 BKTKParserNode * BKTKParserGetNodeTree (BKTKParser * parser)
 {
 	return parser -> stack [0].node -> subNode;
 }
 
+BKTKParserNode * BKTKParserDetachNodeTree (BKTKParser * parser)
+{
+	BKTKParserNode * node = &parser -> rootNode;
+	BKTKParserNode * subNode = node -> subNode;
+
+	node -> subNode = NULL;
+	parser -> stackSize = 1;
+	parser -> itemCount = 0;
+
+	return subNode;
+}
+
+void BKTKParserFreeNodeTree (BKTKParser * parser, BKTKParserNode * node)
+{
+	BKTKParserNode * nextNode;
+
+	for (; node; node = nextNode) {
+		nextNode = node -> nextNode;
+
+		if (node -> subNode) {
+			BKTKParserFreeNodeTree (parser, node -> subNode);
+		}
+
+		// arguments are packed into a single block starting at `args` or `name`
+		void * data = node -> args ? (void *) node -> args : node -> name.str;
+
+		if (node -> flags & BKTKParserFlagDataIsBlock) {
+			BKBlockPoolFree (&parser -> argsPool, data);
+		}
+		else {
+			free (data);
+		}
+
+		BKTKParserNodeFree (parser, node);
+	}
+}
+
 BKClass const BKTKParserClass =
 {
 	.instanceSize = sizeof (BKTKParser),
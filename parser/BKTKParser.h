@@ -32,6 +32,12 @@ typedef struct BKTKParser BKTKParser;
 typedef struct BKTKParserNode BKTKParserNode;
 typedef struct BKTKParserItem BKTKParserItem;
 typedef struct BKTKParserArg BKTKParserArg;
+typedef struct BKTKTree BKTKTree;
+
+/**
+ * Cursor of arguments referencing resident token data
+ */
+#define BK_TK_PARSER_EXTERNAL_CURSOR ((BKUInt) -1)
 
 /**
  * Defines the parsers internal state
@@ -96,6 +102,8 @@ struct BKTKParserItem
 {
 	BKTKParserNode * node;
 	BKUSize          itemCount;
+	uint32_t         index;   // node index in `tree`
+	BKInt            isName;  // item is the name of its group node in `tree`
 };
 
 struct BKTKParserArg
@@ -118,9 +126,12 @@ struct BKTKParser
 	uint8_t        * buffer;
 	BKUSize          argCount;
 	BKUSize          argCapacity;
+	BKUSize          argDataSize; // size of all argument strings including NUL
 	BKTKParserArg  * args;
+	uint8_t const ** argData;     // resident token data of arguments or NULL
 	BKTKParserNode   rootNode;
 	BKTKParserNode * freeNodes;
+	BKTKTree       * tree;        // nodes are appended to flat tree if set
 	BKTKParserState  state;
 	BKBlockPool      blockPool;
 	BKBlockPool      argsPool;
@@ -139,9 +150,22 @@ extern BKInt BKTKParserInit (BKTKParser * parser);
  */
 extern void BKTKParserReset (BKTKParser * parser);
 
+/**
+ * Append nodes to flat `tree` instead of linking them
+ *
+ * `tree` has to be initialized without nodes and is set until the parser is
+ * reset. `BKTKParserGetNodeTree` then returns NULL. The tree can be compiled
+ * with `BKTKCompilerCompileTree` without copying the nodes.
+ */
+extern void BKTKParserSetTree (BKTKParser * parser, BKTKTree * tree);
+
 /**
  * Put tokens
  *
+ * Arguments of tokens with `BKTKTokenFlagPersistent` are referenced by the
+ * nodes instead of being copied. The node tree is then only valid until the
+ * tokenizer is reset.
+ *
  * Returns a value != 0 if an error ocurred.
  */
 extern BKInt BKTKParserPutTokens (BKTKParser * parser, BKTKToken const * tokens, BKUSize count);
@@ -153,11 +177,34 @@ extern BKInt BKTKParserPutTokens (BKTKParser * parser, BKTKToken const * tokens,
  */
 extern BKTKParserNode * BKTKParserGetNodeTree (BKTKParser * parser);
 
+/**
+ * Detach node tree
+ *
+ * The parser continues with an empty tree. The returned nodes are owned by the
+ * caller and have to be freed with `BKTKParserFreeNodeTree` before the parser
+ * is disposed.
+ */
+extern BKTKParserNode * BKTKParserDetachNodeTree (BKTKParser * parser);
+
+/**
+ * Free nodes returned by `BKTKParserDetachNodeTree`
+ *
+ * Frees `node` and its subnodes and next nodes
+ */
+extern void BKTKParserFreeNodeTree (BKTKParser * parser, BKTKParserNode * node);
+
 /**
  * Check if parser has encountered an error
  */
 BK_INLINE BKInt BKTKParserHasError (BKTKParser const * parser);
 
+/**
+ * Check if parser is between commands outside of groups
+ *
+ * Following tokens do not depend on previous ones in this state
+ */
+BK_INLINE BKInt BKTKParserIsAtRoot (BKTKParser const * parser);
+
 /**
  * Check if parser is finished
  *
@@ -173,6 +220,12 @@ BK_INLINE BKInt BKTKParserHasError (BKTKParser const * parser)
 	return parser -> state == BKTKParserStateError;
 }
 
+BK_INLINE BKInt BKTKParserIsAtRoot (BKTKParser const * parser)
+{
+	// the last item is an empty group if it has no items
+	return parser -> state == BKTKParserStateRoot && (parser -> stackSize == 1 || (parser -> stackSize == 2 && parser -> itemCount));
+}
+
 BK_INLINE BKInt BKTKParserIsFinished (BKTKParser const * parser)
 {
 	return parser -> state >= BKTKParserStateEnd;
@@ -21,11 +21,29 @@
  * IN THE SOFTWARE.
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include "BKTKTokenizer.h"
 
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+// AVX2 is only used when enabled with compiler flags like `-mavx2`
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #define BUF_INIT_LEN 4096
 #define MIN_BUFFER_FREE_SPACE 256
+#define MAX_CHUNK_SIZE (64 * 1024)
+#define MIN_KEEP_DATA_SIZE 1024
 #define CHAR_END 256
+#define SPLIT_BATCH_SIZE 256
 
 static BKTKType const tokenChars [257] =
 {
@@ -132,13 +150,26 @@ BKInt BKTKTokenizerInit (BKTKTokenizer * tok)
 	return 0;
 }
 
+static void BKTKTokenizerFreeDataBlocks (BKTKTokenizer * tok)
+{
+	for (BKUSize i = 0; i < tok -> dataBlocksLen; i ++) {
+		free (tok -> dataBlocks [i]);
+	}
+
+	tok -> dataBlocksLen = 0;
+}
+
 static void BKTKTokenizerDispose (BKTKTokenizer * tok)
 {
+	BKTKTokenizerFreeDataBlocks (tok);
+	free (tok -> dataBlocks);
 	free (tok -> buffer);
 }
 
 void BKTKTokenizerReset (BKTKTokenizer * tok)
 {
+	BKTKTokenizerFreeDataBlocks (tok);
+
 	tok -> state         = BKTKStateRoot;
 	tok -> offset.lineno = 1;
 	tok -> offset.colno  = 0;
@@ -146,15 +177,30 @@ void BKTKTokenizerReset (BKTKTokenizer * tok)
 	tok -> base64Len     = 0;
 	tok -> charCount     = 0;
 	tok -> charValue     = 0;
+	tok -> residentEnd   = NULL;
+	tok -> tokensLen     = 0;
 }
 
 /**
- * Relocate data of tokend to new allocated buffer
+ * Relocate data of current and collected tokens to new allocated buffer
  */
 static void BKTKTokenizerRelocateTokenData (BKTKTokenizer * tok, uint8_t * newBuffer)
 {
 	BKTKToken * token;
 
+	for (BKUSize i = 0; i < tok -> tokensLen; i ++) {
+		token = &tok -> tokens [i];
+
+		if (!(token -> flags & (BKTKTokenFlagResident | BKTKTokenFlagPersistent))) {
+			token -> data = newBuffer + (token -> data - tok -> buffer);
+		}
+	}
+
+	// data references the input
+	if (tok -> residentEnd) {
+		return;
+	}
+
 	token = &tok -> token;
 	token -> data = newBuffer + (token -> data - tok -> buffer);
 }
@@ -181,11 +227,153 @@ static BKInt BKTKTokenizerEnsureBufferSpace (BKTKTokenizer * tok, BKUSize additi
 	return 0;
 }
 
+/**
+ * Keep buffer containing the data of the current token and allocate a new one
+ *
+ * The kept buffer is shrunk to its length. Reserves `additionalSize` bytes
+ * in the new buffer for the remaining input.
+ */
+static BKInt BKTKTokenizerKeepBuffer (BKTKTokenizer * tok, BKUSize additionalSize)
+{
+	uint8_t * newBuffer;
+	BKUSize newCapacity;
+
+	if (tok -> dataBlocksLen >= tok -> dataBlocksCap) {
+		uint8_t ** dataBlocks;
+
+		newCapacity = tok -> dataBlocksCap ? tok -> dataBlocksCap * 2 : 4;
+		dataBlocks = realloc (tok -> dataBlocks, newCapacity * sizeof (*dataBlocks));
+
+		if (!dataBlocks) {
+			return -1;
+		}
+
+		tok -> dataBlocks = dataBlocks;
+		tok -> dataBlocksCap = newCapacity;
+	}
+
+	newCapacity = BKMax (BKNextPow2 (additionalSize + MIN_BUFFER_FREE_SPACE), BUF_INIT_LEN);
+	newBuffer = malloc (newCapacity);
+
+	if (!newBuffer) {
+		return -1;
+	}
+
+	// shrinking should not fail
+	if (tok -> bufferLen < tok -> bufferCap) {
+		uint8_t * keptBuffer = realloc (tok -> buffer, tok -> bufferLen);
+
+		if (keptBuffer) {
+			BKTKTokenizerRelocateTokenData (tok, keptBuffer);
+			tok -> buffer = keptBuffer;
+		}
+	}
+
+	// collected tokens are also kept
+	for (BKUSize i = 0; i < tok -> tokensLen; i ++) {
+		if (!(tok -> tokens [i].flags & BKTKTokenFlagResident)) {
+			tok -> tokens [i].flags |= BKTKTokenFlagPersistent;
+		}
+	}
+
+	tok -> dataBlocks [tok -> dataBlocksLen ++] = tok -> buffer;
+	tok -> buffer = newBuffer;
+	tok -> bufferCap = newCapacity;
+	tok -> bufferLen = 0;
+
+	return 0;
+}
+
 static void BKTKTokenizerBufferPutChar (BKTKTokenizer * tok, BKInt c)
 {
 	tok -> buffer [tok -> bufferLen ++] = c;
 }
 
+/**
+ * Copy token data referencing the input to the buffer
+ *
+ * Reserves `additionalSize` bytes for the remaining input.
+ */
+static BKInt BKTKTokenizerBufferResidentData (BKTKTokenizer * tok, BKUSize additionalSize)
+{
+	BKUSize length;
+	uint8_t const * data;
+	BKTKToken * token = &tok -> token;
+
+	if (!tok -> residentEnd) {
+		return 0;
+	}
+
+	data = token -> data;
+	length = tok -> residentEnd - data;
+
+	if (BKTKTokenizerEnsureBufferSpace (tok, length + additionalSize) < 0) {
+		return -1;
+	}
+
+	tok -> residentEnd = NULL;
+	token -> data = &tok -> buffer [tok -> bufferLen];
+	memcpy (&tok -> buffer [tok -> bufferLen], data, length);
+	tok -> bufferLen += length;
+
+	return 0;
+}
+
+/**
+ * Append `length` chars of input at `chars` to the current token
+ *
+ * If the input is resident, the token references the input as long as the
+ * appended chars are contiguous.
+ */
+static BKInt BKTKTokenizerPutTokenChars (BKTKTokenizer * tok, uint8_t const * chars, BKUSize length, BKUSize additionalSize)
+{
+	BKTKToken * token = &tok -> token;
+
+	if (!length) {
+		return 0;
+	}
+
+	if (tok -> residentEnd == chars) {
+		tok -> residentEnd += length;
+		return 0;
+	}
+
+	if ((tok -> object.flags & BKTKTokenizerFlagResident) && !tok -> residentEnd && token -> data == &tok -> buffer [tok -> bufferLen]) {
+		token -> data = chars;
+		tok -> residentEnd = chars + length;
+		return 0;
+	}
+
+	if (BKTKTokenizerBufferResidentData (tok, additionalSize) < 0) {
+		return -1;
+	}
+
+	memcpy (&tok -> buffer [tok -> bufferLen], chars, length);
+	tok -> bufferLen += length;
+
+	return 0;
+}
+
+/**
+ * Append char `c` read from input at `chars` to the current token
+ *
+ * `c` differs from the input if it was unescaped.
+ */
+static BKInt BKTKTokenizerPutTokenChar (BKTKTokenizer * tok, BKInt c, uint8_t const * chars, BKUSize additionalSize)
+{
+	if (*chars == c) {
+		return BKTKTokenizerPutTokenChars (tok, chars, 1, additionalSize);
+	}
+
+	if (BKTKTokenizerBufferResidentData (tok, additionalSize) < 0) {
+		return -1;
+	}
+
+	BKTKTokenizerBufferPutChar (tok, c);
+
+	return 0;
+}
+
 static void BKTKTokenizerBufferPutBase64Char (BKTKTokenizer * tok, BKInt c)
 {
 	BKUInt value;
@@ -237,15 +425,44 @@ static void BKTKTokenizerBufferEndBase64 (BKTKTokenizer * tok)
 static void BKTKTokenizerEndBuffer (BKTKTokenizer * tok)
 {
 	// terminate current buffer segment
+	// buffer is reset when collected tokens are delivered
 	tok -> buffer [tok -> bufferLen ++] = '\0';
-	// reset buffer
-	tok -> bufferLen = 0;
+}
+
+static void BKTKTokenizerSetError (BKTKTokenizer * tok, char const * msg, ...);
+
+/**
+ * Deliver collected tokens
+ */
+static BKInt BKTKTokenizerFlushTokens (BKTKTokenizer * tok)
+{
+	BKInt res;
+	BKUSize count = tok -> tokensLen;
+
+	if (!count) {
+		return 0;
+	}
+
+	tok -> tokensLen = 0;
+
+	if ((res = tok -> putTokens (tok -> tokens, count, tok -> putTokensArg)) != 0) {
+		BKTKTokenizerSetError (tok, "User error: %d", res);
+		return res;
+	}
+
+	return 0;
 }
 
 static void BKTKTokenizerSetError (BKTKTokenizer * tok, char const * msg, ...)
 {
 	va_list args;
 
+	// deliver tokens preceding the error first
+	// their data would be overwritten by the message
+	if (BKTKTokenizerFlushTokens (tok) != 0) {
+		return;
+	}
+
 	va_start (args, msg);
 	vsnprintf ((void *) tok -> buffer, tok -> bufferCap, msg, args);
 	va_end (args);
@@ -253,7 +470,307 @@ static void BKTKTokenizerSetError (BKTKTokenizer * tok, char const * msg, ...)
 	tok -> bufferLen = BKStrnlen ((char *) tok -> buffer, tok -> bufferCap);
 }
 
-static BKInt BKTKTokenizerPutCharsChunk (BKTKTokenizer * tok, uint8_t const * chars, BKUSize size, BKTKPutTokenFunc putToken, void * arg)
+#if defined(__AVX2__)
+/**
+ * Get mask of bytes in `v` which end a run in `state`
+ */
+static uint32_t scanStopMask (BKTKState state, __m256i v)
+{
+	__m256i stop, ctrl, space;
+
+	stop = _mm256_or_si256 (_mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('\n')), _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('\r')));
+
+	if (state == BKTKStateComment) {
+		return _mm256_movemask_epi8 (stop);
+	}
+
+	// '\a' to '\r' including line breaks
+	ctrl = _mm256_sub_epi8 (v, _mm256_set1_epi8 ('\a'));
+	space = _mm256_cmpeq_epi8 (_mm256_min_epu8 (ctrl, _mm256_set1_epi8 ('\r' - '\a')), ctrl);
+	space = _mm256_or_si256 (space, _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 (' ')));
+	space = _mm256_or_si256 (space, _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('\xa0')));
+
+	if (state == BKTKStateSpace) {
+		return ~_mm256_movemask_epi8 (_mm256_andnot_si256 (stop, space));
+	}
+
+	stop = _mm256_or_si256 (space, _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 (':')));
+	stop = _mm256_or_si256 (stop, _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 (';')));
+	stop = _mm256_or_si256 (stop, _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('[')));
+	stop = _mm256_or_si256 (stop, _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 (']')));
+	stop = _mm256_or_si256 (stop, _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('"')));
+	stop = _mm256_or_si256 (stop, _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('!')));
+	stop = _mm256_or_si256 (stop, _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('%')));
+
+	return _mm256_movemask_epi8 (stop);
+}
+
+#define SCAN_VECTOR_SIZE 32
+#define scanLoad(ptr) _mm256_loadu_si256 ((__m256i const *) (ptr))
+
+#elif defined(__SSE2__)
+/**
+ * Get mask of bytes in `v` which end a run in `state`
+ */
+static uint32_t scanStopMask (BKTKState state, __m128i v)
+{
+	__m128i stop, ctrl, space;
+
+	stop = _mm_or_si128 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 ('\n')), _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('\r')));
+
+	if (state == BKTKStateComment) {
+		return _mm_movemask_epi8 (stop);
+	}
+
+	// '\a' to '\r' including line breaks
+	ctrl = _mm_sub_epi8 (v, _mm_set1_epi8 ('\a'));
+	space = _mm_cmpeq_epi8 (_mm_min_epu8 (ctrl, _mm_set1_epi8 ('\r' - '\a')), ctrl);
+	space = _mm_or_si128 (space, _mm_cmpeq_epi8 (v, _mm_set1_epi8 (' ')));
+	space = _mm_or_si128 (space, _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('\xa0')));
+
+	if (state == BKTKStateSpace) {
+		return ~_mm_movemask_epi8 (_mm_andnot_si128 (stop, space)) & 0xFFFF;
+	}
+
+	stop = _mm_or_si128 (space, _mm_cmpeq_epi8 (v, _mm_set1_epi8 (':')));
+	stop = _mm_or_si128 (stop, _mm_cmpeq_epi8 (v, _mm_set1_epi8 (';')));
+	stop = _mm_or_si128 (stop, _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('[')));
+	stop = _mm_or_si128 (stop, _mm_cmpeq_epi8 (v, _mm_set1_epi8 (']')));
+	stop = _mm_or_si128 (stop, _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('"')));
+	stop = _mm_or_si128 (stop, _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('!')));
+	stop = _mm_or_si128 (stop, _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('%')));
+
+	return _mm_movemask_epi8 (stop);
+}
+
+#define SCAN_VECTOR_SIZE 16
+#define scanLoad(ptr) _mm_loadu_si128 ((__m128i const *) (ptr))
+
+#endif
+
+/**
+ * Check if character continues a run in `state`
+ */
+static BKInt scanContinues (BKTKState state, uint8_t c)
+{
+	BKTKType type = tokenChars [c];
+
+	switch (state) {
+		case BKTKStateComment: {
+			return type != BKTKTypeLineBreak;
+		}
+		case BKTKStateArg: {
+			return type == BKTKTypeOther || type == BKTKTypeEscape;
+		}
+		case BKTKStateSpace: {
+			return type == BKTKTypeSpace;
+		}
+		default: {
+			return 0;
+		}
+	}
+}
+
+/**
+ * Get length of run at `chars` which does not change `state`
+ *
+ * Runs are comment bodies, plain arguments and spaces. They do not contain
+ * line breaks, so the column can be advanced by the run length.
+ */
+static BKUSize BKTKTokenizerScanRun (BKTKState state, uint8_t const * chars, uint8_t const * end)
+{
+	uint8_t const * ptr = chars;
+
+#ifdef SCAN_VECTOR_SIZE
+	for (; end - ptr >= SCAN_VECTOR_SIZE; ptr += SCAN_VECTOR_SIZE) {
+		uint32_t mask = scanStopMask (state, scanLoad (ptr));
+
+		if (mask) {
+			return ptr - chars + __builtin_ctz (mask);
+		}
+	}
+#endif
+
+	while (ptr < end && scanContinues (state, *ptr)) {
+		ptr ++;
+	}
+
+	return ptr - chars;
+}
+
+#if defined(__AVX2__)
+/**
+ * Get mask of bytes in `v` which are in range `lo` to `hi`
+ *
+ * Bytes >= 0x80 are negative and never in range.
+ */
+static __m256i base64InRange (__m256i v, char lo, char hi)
+{
+	return _mm256_and_si256 (_mm256_cmpgt_epi8 (v, _mm256_set1_epi8 (lo - 1)), _mm256_cmpgt_epi8 (_mm256_set1_epi8 (hi + 1), v));
+}
+
+/**
+ * Decode 32 base64 chars at `chars` to 24 bytes at `data`
+ *
+ * Writes 32 bytes. Returns 0 if a char is not in the base64 alphabet.
+ */
+static BKInt base64DecodeBlock (uint8_t const * chars, uint8_t * data)
+{
+	__m256i v, upper, lower, digit, plus, slash, values;
+
+	v = _mm256_loadu_si256 ((__m256i const *) chars);
+
+	upper = base64InRange (v, 'A', 'Z');
+	lower = base64InRange (v, 'a', 'z');
+	digit = base64InRange (v, '0', '9');
+	plus  = _mm256_or_si256 (_mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('+')), _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('-')));
+	slash = _mm256_or_si256 (_mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('/')), _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('_')));
+
+	values = _mm256_or_si256 (_mm256_or_si256 (upper, lower), _mm256_or_si256 (_mm256_or_si256 (digit, plus), slash));
+
+	if (_mm256_movemask_epi8 (values) != -1) {
+		return 0;
+	}
+
+	values = _mm256_and_si256 (upper, _mm256_sub_epi8 (v, _mm256_set1_epi8 ('A')));
+	values = _mm256_or_si256 (values, _mm256_and_si256 (lower, _mm256_sub_epi8 (v, _mm256_set1_epi8 ('a' - 26))));
+	values = _mm256_or_si256 (values, _mm256_and_si256 (digit, _mm256_add_epi8 (v, _mm256_set1_epi8 (52 - '0'))));
+	values = _mm256_or_si256 (values, _mm256_and_si256 (plus, _mm256_set1_epi8 (62)));
+	values = _mm256_or_si256 (values, _mm256_and_si256 (slash, _mm256_set1_epi8 (63)));
+
+	// merge 6 bit values to 24 bit values
+	values = _mm256_or_si256 (_mm256_slli_epi16 (_mm256_and_si256 (values, _mm256_set1_epi16 (0xFF)), 6), _mm256_srli_epi16 (values, 8));
+	values = _mm256_or_si256 (_mm256_slli_epi32 (_mm256_and_si256 (values, _mm256_set1_epi32 (0xFFFF)), 12), _mm256_srli_epi32 (values, 16));
+
+	// reverse and pack bytes
+	values = _mm256_shuffle_epi8 (values, _mm256_setr_epi8 (
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+	values = _mm256_permutevar8x32_epi32 (values, _mm256_setr_epi32 (0, 1, 2, 4, 5, 6, 3, 7));
+
+	_mm256_storeu_si256 ((__m256i *) data, values);
+
+	return 1;
+}
+
+#define BASE64_BLOCK_SIZE 32
+
+#elif defined(__SSE2__)
+/**
+ * Get mask of bytes in `v` which are in range `lo` to `hi`
+ *
+ * Bytes >= 0x80 are negative and never in range.
+ */
+static __m128i base64InRange (__m128i v, char lo, char hi)
+{
+	return _mm_and_si128 (_mm_cmpgt_epi8 (v, _mm_set1_epi8 (lo - 1)), _mm_cmpgt_epi8 (_mm_set1_epi8 (hi + 1), v));
+}
+
+/**
+ * Decode 16 base64 chars at `chars` to 12 bytes at `data`
+ *
+ * Writes 14 bytes. Returns 0 if a char is not in the base64 alphabet.
+ */
+static BKInt base64DecodeBlock (uint8_t const * chars, uint8_t * data)
+{
+	__m128i v, upper, lower, digit, plus, slash, values;
+
+	v = _mm_loadu_si128 ((__m128i const *) chars);
+
+	upper = base64InRange (v, 'A', 'Z');
+	lower = base64InRange (v, 'a', 'z');
+	digit = base64InRange (v, '0', '9');
+	plus  = _mm_or_si128 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 ('+')), _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('-')));
+	slash = _mm_or_si128 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 ('/')), _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('_')));
+
+	values = _mm_or_si128 (_mm_or_si128 (upper, lower), _mm_or_si128 (_mm_or_si128 (digit, plus), slash));
+
+	if (_mm_movemask_epi8 (values) != 0xFFFF) {
+		return 0;
+	}
+
+	values = _mm_and_si128 (upper, _mm_sub_epi8 (v, _mm_set1_epi8 ('A')));
+	values = _mm_or_si128 (values, _mm_and_si128 (lower, _mm_sub_epi8 (v, _mm_set1_epi8 ('a' - 26))));
+	values = _mm_or_si128 (values, _mm_and_si128 (digit, _mm_add_epi8 (v, _mm_set1_epi8 (52 - '0'))));
+	values = _mm_or_si128 (values, _mm_and_si128 (plus, _mm_set1_epi8 (62)));
+	values = _mm_or_si128 (values, _mm_and_si128 (slash, _mm_set1_epi8 (63)));
+
+	// merge 6 bit values to 24 bit values
+	values = _mm_or_si128 (_mm_slli_epi16 (_mm_and_si128 (values, _mm_set1_epi16 (0xFF)), 6), _mm_srli_epi16 (values, 8));
+	values = _mm_or_si128 (_mm_slli_epi32 (_mm_and_si128 (values, _mm_set1_epi32 (0xFFFF)), 12), _mm_srli_epi32 (values, 16));
+
+	// reverse bytes
+	values = _mm_or_si128 (_mm_or_si128 (
+		_mm_and_si128 (_mm_srli_epi32 (values, 16), _mm_set1_epi32 (0xFF)),
+		_mm_and_si128 (values, _mm_set1_epi32 (0xFF00))),
+		_mm_slli_epi32 (_mm_and_si128 (values, _mm_set1_epi32 (0xFF)), 16));
+
+	// pack 2 values in each 64 bit half
+	values = _mm_or_si128 (
+		_mm_and_si128 (values, _mm_set_epi32 (0, -1, 0, -1)),
+		_mm_srli_epi64 (_mm_and_si128 (values, _mm_set_epi32 (-1, 0, -1, 0)), 8));
+
+	_mm_storel_epi64 ((__m128i *) &data [0], values);
+	_mm_storel_epi64 ((__m128i *) &data [6], _mm_unpackhi_epi64 (values, values));
+
+	return 1;
+}
+
+#define BASE64_BLOCK_SIZE 16
+
+#else
+/**
+ * Decode 4 base64 chars at `chars` to 3 bytes at `data`
+ *
+ * Returns 0 if a char is not in the base64 alphabet.
+ */
+static BKInt base64DecodeBlock (uint8_t const * chars, uint8_t * data)
+{
+	int32_t value;
+
+	value  = (int32_t) base64Chars [chars [0]] << 18;
+	value |= (int32_t) base64Chars [chars [1]] << 12;
+	value |= (int32_t) base64Chars [chars [2]] << 6;
+	value |= (int32_t) base64Chars [chars [3]] << 0;
+
+	// any invalid char sets the sign
+	if (value < 0) {
+		return 0;
+	}
+
+	data [0] = (value >> 16) & 0xFF;
+	data [1] = (value >>  8) & 0xFF;
+	data [2] = (value >>  0) & 0xFF;
+
+	return 1;
+}
+
+#define BASE64_BLOCK_SIZE 4
+
+#endif
+
+/**
+ * Decode base64 chars at `chars` in blocks to the buffer
+ *
+ * Stops before the first block containing a char not in the base64 alphabet,
+ * which also includes line breaks. Returns the number of chars consumed.
+ */
+static BKUSize BKTKTokenizerDecodeBase64Run (BKTKTokenizer * tok, uint8_t const * chars, uint8_t const * end)
+{
+	uint8_t const * ptr = chars;
+
+	for (; end - ptr >= BASE64_BLOCK_SIZE; ptr += BASE64_BLOCK_SIZE) {
+		if (!base64DecodeBlock (ptr, &tok -> buffer [tok -> bufferLen])) {
+			break;
+		}
+
+		tok -> bufferLen += BASE64_BLOCK_SIZE / 4 * 3;
+	}
+
+	return ptr - chars;
+}
+
+static BKInt BKTKTokenizerPutCharsChunk (BKTKTokenizer * tok, uint8_t const * chars, BKUSize size)
 {
 	BKInt c;
 	BKInt res = -1;
@@ -278,6 +795,27 @@ static BKInt BKTKTokenizerPutCharsChunk (BKTKTokenizer * tok, uint8_t const * ch
 	offset = tok -> offset;
 
 	do {
+		// consume runs which do not change the state at once
+		if (state == BKTKStateComment || state == BKTKStateArg || state == BKTKStateSpace) {
+			BKUSize length = BKTKTokenizerScanRun (state, chars, end);
+
+			if (state != BKTKStateSpace) {
+				if (BKTKTokenizerPutTokenChars (tok, chars, length, (end - chars) * 2) < 0) {
+					goto allocationError;
+				}
+			}
+
+			offset.colno += length;
+			chars += length;
+		}
+		else if (state == BKTKStateData && tok -> base64Len == 0) {
+			// decode complete groups at once
+			BKUSize length = BKTKTokenizerDecodeBase64Run (tok, chars, end);
+
+			offset.colno += length;
+			chars += length;
+		}
+
 		if (chars < end) {
 			c = *chars ++;
 		}
@@ -383,6 +921,7 @@ static BKInt BKTKTokenizerPutCharsChunk (BKTKTokenizer * tok, uint8_t const * ch
 					if (capture) {
 						token = &tok -> token;
 						token -> type   = type;
+						token -> flags  = 0;
 						token -> data   = &tok -> buffer [tok -> bufferLen];
 						token -> offset = offset;
 					}
@@ -573,7 +1112,17 @@ static BKInt BKTKTokenizerPutCharsChunk (BKTKTokenizer * tok, uint8_t const * ch
 							goto error;
 							break;
 						}
+						case BKTKTypeSpace:
+						case BKTKTypeLineBreak: {
+							break;
+						}
 						default: {
+							// padding is ignored
+							if (base64Chars [c] < 0 && c != '=') {
+								BKTKTokenizerSetError (tok, "Invalid data char \\x%02x on line %u:%u",
+									c, offset.lineno, offset.colno);
+								goto error;
+							}
 							break;
 						}
 					}
@@ -607,7 +1156,9 @@ static BKInt BKTKTokenizerPutCharsChunk (BKTKTokenizer * tok, uint8_t const * ch
 				case BKTKStateArg:
 				case BKTKStateString:
 				case BKTKStateComment: {
-					BKTKTokenizerBufferPutChar (tok, c);
+					if (BKTKTokenizerPutTokenChar (tok, c, chars - 1, (end - chars) * 2) < 0) {
+						goto allocationError;
+					}
 					break;
 				}
 				case BKTKStateData: {
@@ -624,7 +1175,9 @@ static BKInt BKTKTokenizerPutCharsChunk (BKTKTokenizer * tok, uint8_t const * ch
 					switch (type) {
 						case BKTKTypeArgSep:
 						case BKTKTypeCmdSep: {
-							BKTKTokenizerBufferPutChar (tok, c);
+							if (BKTKTokenizerPutTokenChar (tok, c, chars - 1, (end - chars) * 2) < 0) {
+								goto allocationError;
+							}
 							break;
 						}
 						default: {
@@ -649,12 +1202,35 @@ static BKInt BKTKTokenizerPutCharsChunk (BKTKTokenizer * tok, uint8_t const * ch
 
 			if (accept) {
 				token = &tok -> token;
-				token -> dataLen = &tok -> buffer [tok -> bufferLen] - token -> data;
-				BKTKTokenizerEndBuffer (tok);
 
-				if ((res = putToken (&tok -> token, arg)) != 0) {
-					BKTKTokenizerSetError (tok, "User error: %d", res);
-					goto error;
+				if (tok -> residentEnd) {
+					token -> flags |= BKTKTokenFlagResident;
+					token -> dataLen = tok -> residentEnd - token -> data;
+					tok -> residentEnd = NULL;
+				}
+				else {
+					token -> dataLen = &tok -> buffer [tok -> bufferLen] - token -> data;
+					BKTKTokenizerEndBuffer (tok);
+
+					// data stays in its buffer until reset
+					if (token -> type == BKTKTypeData && token -> dataLen >= MIN_KEEP_DATA_SIZE && (tok -> object.flags & BKTKTokenizerFlagKeepData)) {
+						if (BKTKTokenizerKeepBuffer (tok, (end - chars) * 2) < 0) {
+							goto allocationError;
+						}
+
+						token -> flags |= BKTKTokenFlagPersistent;
+					}
+				}
+
+				tok -> tokens [tok -> tokensLen ++] = *token;
+
+				if (tok -> tokensLen >= tok -> tokensCap) {
+					if ((res = BKTKTokenizerFlushTokens (tok)) != 0) {
+						goto error;
+					}
+
+					// no token is in progress
+					tok -> bufferLen = 0;
 				}
 			}
 		}
@@ -665,6 +1241,15 @@ static BKInt BKTKTokenizerPutCharsChunk (BKTKTokenizer * tok, uint8_t const * ch
 	tok -> state = state;
 	tok -> offset = offset;
 
+	if ((res = BKTKTokenizerFlushTokens (tok)) != 0) {
+		goto error;
+	}
+
+	// keep data of token in progress
+	if (state == BKTKStateRoot || state == BKTKStateSpace || state >= BKTKStateEnd) {
+		tok -> bufferLen = 0;
+	}
+
 	return 0;
 
 	allocationError: {
@@ -678,19 +1263,54 @@ static BKInt BKTKTokenizerPutCharsChunk (BKTKTokenizer * tok, uint8_t const * ch
 	}
 }
 
+struct BKTKPutTokenInfo
+{
+	BKTKPutTokenFunc putToken;
+	void           * arg;
+};
+
+static BKInt BKTKTokenizerPutSingleTokens (BKTKToken const * tokens, BKUSize count, struct BKTKPutTokenInfo * info)
+{
+	BKInt res;
+
+	for (BKUSize i = 0; i < count; i ++) {
+		if ((res = info -> putToken (&tokens [i], info -> arg)) != 0) {
+			return res;
+		}
+	}
+
+	return 0;
+}
+
+BKInt BKTKTokenizerPutChars (BKTKTokenizer * tok, uint8_t const * chars, BKUSize size, BKTKPutTokenFunc putToken, void * arg)
+{
+	BKTKToken token;
+	struct BKTKPutTokenInfo info = {
+		.putToken = putToken,
+		.arg      = arg,
+	};
+
+	return BKTKTokenizerPutCharsBatch (tok, chars, size, &token, 1, (BKTKPutTokensFunc) BKTKTokenizerPutSingleTokens, &info);
+}
+
 /**
- * Splits input chars into smaller chunks for better buffer usage
+ * Splits input chars into chunks to limit the reserved buffer space
  */
-BKInt BKTKTokenizerPutChars (BKTKTokenizer * tok, uint8_t const * chars, BKUSize size, BKTKPutTokenFunc putToken, void * arg)
+BKInt BKTKTokenizerPutCharsBatch (BKTKTokenizer * tok, uint8_t const * chars, BKUSize size, BKTKToken * tokens, BKUSize capacity, BKTKPutTokensFunc putTokens, void * arg)
 {
-	int res;
-	size_t chunkSize;
-	size_t const maxSize = 1024;
+	BKInt res;
+	BKUSize chunkSize;
+
+	tok -> tokens = tokens;
+	tok -> tokensLen = 0;
+	tok -> tokensCap = capacity;
+	tok -> putTokens = putTokens;
+	tok -> putTokensArg = arg;
 
 	do {
-		chunkSize = size > maxSize ? maxSize : size;
+		chunkSize = size > MAX_CHUNK_SIZE ? MAX_CHUNK_SIZE : size;
 
-		if ((res = BKTKTokenizerPutCharsChunk (tok, chars, chunkSize, putToken, arg)) != 0) {
+		if ((res = BKTKTokenizerPutCharsChunk (tok, chars, chunkSize)) != 0) {
 			break;
 		}
 
@@ -699,9 +1319,368 @@ BKInt BKTKTokenizerPutChars (BKTKTokenizer * tok, uint8_t const * chars, BKUSize
 	}
 	while (size);
 
+	tok -> tokens = NULL;
+	tok -> tokensLen = 0;
+	tok -> tokensCap = 0;
+	tok -> putTokens = NULL;
+	tok -> putTokensArg = NULL;
+
+	return res;
+}
+
+BKInt BKTKTokenizerPutResidentChars (BKTKTokenizer * tok, uint8_t const * chars, BKUSize size, BKTKToken * tokens, BKUSize capacity, BKTKPutTokensFunc putTokens, void * arg)
+{
+	BKInt res;
+
+	tok -> object.flags |= BKTKTokenizerFlagResident;
+
+	if ((res = BKTKTokenizerPutCharsBatch (tok, chars, size, tokens, capacity, putTokens, arg)) == 0) {
+		// terminate tokenizer
+		res = BKTKTokenizerPutCharsBatch (tok, NULL, 0, tokens, capacity, putTokens, arg);
+	}
+
+	tok -> object.flags &= ~BKTKTokenizerFlagResident;
+
+	return res;
+}
+
+#ifdef HAVE_PTHREAD_H
+
+typedef struct BKTKSplitSegment BKTKSplitSegment;
+typedef struct BKTKSplitPool BKTKSplitPool;
+
+enum BKTKSplitState
+{
+	BKTKSplitStatePending,
+	BKTKSplitStateDone,
+	BKTKSplitStateError,
+};
+
+/**
+ * Segment of input tokenized by a worker
+ */
+struct BKTKSplitSegment
+{
+	uint8_t const * chars;
+	BKUSize         size;
+	BKEnum          state;
+	BKUInt          numLines;  // line breaks in segment
+	BKTKToken     * tokens;    // line numbers are relative to segment
+	BKUSize         numTokens, tokensCap;
+	uint8_t       * data;      // data of tokens not referencing the input
+	BKUSize         dataLen, dataCap;
+};
+
+struct BKTKSplitPool
+{
+	pthread_mutex_t    mutex;
+	pthread_cond_t     cond;
+	BKInt              next;     // next segment to tokenize
+	BKInt              parsed;   // number of segments passed to `putTokens`
+	BKInt              maxAhead; // maximum number of segments tokenized ahead
+	BKInt              running;  // number of running workers
+	BKInt              quit;
+	BKInt              numSegments;
+	BKTKSplitSegment * segments;
+};
+
+/**
+ * Collect tokens of segment
+ *
+ * Data not referencing the input is copied in token order, so the data
+ * pointers can be restored when the segment is delivered.
+ */
+static BKInt BKTKSplitSegmentCollect (BKTKToken const * tokens, BKUSize count, BKTKSplitSegment * segment)
+{
+	if (segment -> numTokens + count > segment -> tokensCap) {
+		BKUSize capacity = BKMax (segment -> tokensCap * 2, segment -> numTokens + count);
+		BKTKToken * newTokens = realloc (segment -> tokens, capacity * sizeof (*newTokens));
+
+		if (!newTokens) {
+			return -1;
+		}
+
+		segment -> tokens = newTokens;
+		segment -> tokensCap = capacity;
+	}
+
+	for (BKUSize i = 0; i < count; i ++) {
+		BKTKToken const * token = &tokens [i];
+
+		if (!(token -> flags & BKTKTokenFlagResident)) {
+			if (segment -> dataLen + token -> dataLen + 1 > segment -> dataCap) {
+				BKUSize capacity = BKMax (segment -> dataCap * 2, segment -> dataLen + token -> dataLen + 1);
+				uint8_t * newData = realloc (segment -> data, capacity);
+
+				if (!newData) {
+					return -1;
+				}
+
+				segment -> data = newData;
+				segment -> dataCap = capacity;
+			}
+
+			// including NUL
+			memcpy (&segment -> data [segment -> dataLen], token -> data, token -> dataLen + 1);
+			segment -> dataLen += token -> dataLen + 1;
+		}
+
+		segment -> tokens [segment -> numTokens ++] = *token;
+	}
+
+	return 0;
+}
+
+static void BKTKSplitSegmentFree (BKTKSplitSegment * segment)
+{
+	free (segment -> tokens);
+	free (segment -> data);
+	segment -> tokens = NULL;
+	segment -> data = NULL;
+}
+
+/**
+ * Tokenize segment assuming it begins at the root state
+ *
+ * Fails if the segment is not complete, e.g., ends in a string.
+ */
+static BKInt BKTKSplitSegmentTokenize (BKTKTokenizer * tok, BKTKSplitSegment * segment)
+{
+	BKTKToken tokens [SPLIT_BATCH_SIZE];
+
+	BKTKTokenizerReset (tok);
+	BKTKTokenizerPutResidentChars (tok, segment -> chars, segment -> size, tokens, SPLIT_BATCH_SIZE, (BKTKPutTokensFunc) BKTKSplitSegmentCollect, segment);
+
+	if (BKTKTokenizerHasError (tok)) {
+		return -1;
+	}
+
+	segment -> numLines = tok -> offset.lineno - 1;
+
 	return 0;
 }
 
+static void * BKTKSplitWorkerRun (void * info)
+{
+	BKInt res;
+	BKTKTokenizer tok;
+	BKTKSplitSegment * segment;
+	BKTKSplitPool * pool = info;
+
+	res = BKTKTokenizerInit (&tok);
+
+	while (res == 0) {
+		pthread_mutex_lock (&pool -> mutex);
+
+		// don't tokenize too far ahead of delivered segments
+		while (!pool -> quit && pool -> next < pool -> numSegments && pool -> next >= pool -> parsed + pool -> maxAhead) {
+			pthread_cond_wait (&pool -> cond, &pool -> mutex);
+		}
+
+		if (pool -> quit || pool -> next >= pool -> numSegments) {
+			pthread_mutex_unlock (&pool -> mutex);
+			break;
+		}
+
+		segment = &pool -> segments [pool -> next ++];
+
+		pthread_mutex_unlock (&pool -> mutex);
+
+		// segment is tokenized again in sequence on failure
+		BKInt ok = BKTKSplitSegmentTokenize (&tok, segment) == 0;
+
+		pthread_mutex_lock (&pool -> mutex);
+		segment -> state = ok ? BKTKSplitStateDone : BKTKSplitStateError;
+		pthread_cond_broadcast (&pool -> cond);
+		pthread_mutex_unlock (&pool -> mutex);
+	}
+
+	if (res == 0) {
+		BKDispose (&tok);
+	}
+
+	pthread_mutex_lock (&pool -> mutex);
+	pool -> running --;
+	pthread_cond_broadcast (&pool -> cond);
+	pthread_mutex_unlock (&pool -> mutex);
+
+	return NULL;
+}
+
+/**
+ * Deliver tokens of segment
+ *
+ * Restores line numbers and data pointers. The end token is only delivered for
+ * the last segment.
+ */
+static BKInt BKTKSplitSegmentPut (BKTKSplitSegment * segment, BKUInt lineOffset, BKInt isLast, BKTKPutTokensFunc putTokens, void * arg)
+{
+	uint8_t * data = segment -> data;
+	BKUSize numTokens = segment -> numTokens;
+
+	for (BKUSize i = 0; i < numTokens; i ++) {
+		BKTKToken * token = &segment -> tokens [i];
+
+		token -> offset.lineno += lineOffset;
+
+		if (!(token -> flags & BKTKTokenFlagResident)) {
+			token -> data = data;
+			data += token -> dataLen + 1;
+		}
+	}
+
+	if (!isLast && numTokens && segment -> tokens [numTokens - 1].type == BKTKTypeEnd) {
+		numTokens --;
+	}
+
+	if (!numTokens) {
+		return 0;
+	}
+
+	return putTokens (segment -> tokens, numTokens, arg);
+}
+
+BKInt BKTKTokenizerPutResidentCharsSplit (BKTKTokenizer * tok, uint8_t const * chars, BKUSize size, BKUSize segmentSize, BKInt numJobs, BKTKToken * tokens, BKUSize capacity, BKTKPutTokensFunc putTokens, void * arg)
+{
+	BKInt res = 0;
+	BKInt numThreads = 0;
+	BKInt sequential = 0;
+	BKUInt lineOffset = 0;
+	BKInt numSegments = 0;
+	uint8_t const * end = &chars [size];
+	pthread_t * threads;
+	BKTKSplitPool pool;
+	BKTKSplitSegment * segment;
+
+	segmentSize = BKMax (segmentSize, 1);
+
+	if (numJobs < 2 || size <= segmentSize) {
+		return BKTKTokenizerPutResidentChars (tok, chars, size, tokens, capacity, putTokens, arg);
+	}
+
+	memset (&pool, 0, sizeof (pool));
+	pool.segments = calloc (size / segmentSize + 1, sizeof (*pool.segments));
+	threads = malloc (numJobs * sizeof (*threads));
+
+	if (!pool.segments || !threads) {
+		free (pool.segments);
+		free (threads);
+
+		return BKTKTokenizerPutResidentChars (tok, chars, size, tokens, capacity, putTokens, arg);
+	}
+
+	for (uint8_t const * ptr = chars; ptr < end; numSegments ++) {
+		uint8_t const * next = end;
+
+		if ((BKUSize) (end - ptr) > segmentSize) {
+			next = memchr (&ptr [segmentSize], '\n', end - &ptr [segmentSize]);
+			next = next ? next + 1 : end;
+		}
+
+		segment = &pool.segments [numSegments];
+		segment -> chars = ptr;
+		segment -> size = next - ptr;
+		segment -> state = BKTKSplitStatePending;
+		ptr = next;
+	}
+
+	pool.numSegments = numSegments;
+	pool.maxAhead = 2 * numJobs;
+	pthread_mutex_init (&pool.mutex, NULL);
+	pthread_cond_init (&pool.cond, NULL);
+
+	pthread_mutex_lock (&pool.mutex);
+
+	for (BKInt i = 0; i < BKMin (numJobs, numSegments); i ++) {
+		if (pthread_create (&threads [i], NULL, BKTKSplitWorkerRun, &pool) != 0) {
+			break;
+		}
+
+		numThreads ++;
+		pool.running ++;
+	}
+
+	pthread_mutex_unlock (&pool.mutex);
+
+	tok -> object.flags |= BKTKTokenizerFlagResident;
+
+	for (BKInt i = 0; i < numSegments && res == 0; i ++) {
+		segment = &pool.segments [i];
+
+		pthread_mutex_lock (&pool.mutex);
+
+		while (segment -> state == BKTKSplitStatePending && pool.running) {
+			pthread_cond_wait (&pool.cond, &pool.mutex);
+		}
+
+		pthread_mutex_unlock (&pool.mutex);
+
+		if (!sequential && segment -> state == BKTKSplitStateDone) {
+			res = BKTKSplitSegmentPut (segment, lineOffset, i == numSegments - 1, putTokens, arg);
+			lineOffset += segment -> numLines;
+		}
+		else {
+			// continue with state of previous segment
+			if (!sequential) {
+				tok -> offset.lineno = lineOffset + 1;
+				sequential = 1;
+			}
+
+			res = BKTKTokenizerPutCharsBatch (tok, segment -> chars, segment -> size, tokens, capacity, putTokens, arg);
+			lineOffset = tok -> offset.lineno - 1;
+
+			// next segments begin at the assumed state again
+			if (tok -> state == BKTKStateRoot && i < numSegments - 1) {
+				sequential = 0;
+			}
+		}
+
+		BKTKSplitSegmentFree (segment);
+
+		pthread_mutex_lock (&pool.mutex);
+		pool.parsed ++;
+		pthread_cond_broadcast (&pool.cond);
+		pthread_mutex_unlock (&pool.mutex);
+	}
+
+	if (sequential && res == 0) {
+		// terminate tokenizer
+		res = BKTKTokenizerPutCharsBatch (tok, NULL, 0, tokens, capacity, putTokens, arg);
+	}
+
+	tok -> object.flags &= ~BKTKTokenizerFlagResident;
+
+	pthread_mutex_lock (&pool.mutex);
+	pool.quit = 1;
+	pthread_cond_broadcast (&pool.cond);
+	pthread_mutex_unlock (&pool.mutex);
+
+	for (BKInt i = 0; i < numThreads; i ++) {
+		pthread_join (threads [i], NULL);
+	}
+
+	for (BKInt i = 0; i < numSegments; i ++) {
+		BKTKSplitSegmentFree (&pool.segments [i]);
+	}
+
+	pthread_cond_destroy (&pool.cond);
+	pthread_mutex_destroy (&pool.mutex);
+
+	free (pool.segments);
+	free (threads);
+
+	return res;
+}
+
+#else /* ! HAVE_PTHREAD_H */
+
+BKInt BKTKTokenizerPutResidentCharsSplit (BKTKTokenizer * tok, uint8_t const * chars, BKUSize size, BKUSize segmentSize, BKInt numJobs, BKTKToken * tokens, BKUSize capacity, BKTKPutTokensFunc putTokens, void * arg)
+{
+	return BKTKTokenizerPutResidentChars (tok, chars, size, tokens, capacity, putTokens, arg);
+}
+
+#endif /* HAVE_PTHREAD_H */
+
 BKClass const BKTKTokenizerClass =
 {
 	.instanceSize = sizeof (BKTKTokenizer),
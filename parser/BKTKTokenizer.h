@@ -32,6 +32,7 @@ typedef struct BKTKTokenizer BKTKTokenizer;
 typedef struct BKTKToken BKTKToken;
 
 typedef BKInt (* BKTKPutTokenFunc) (BKTKToken const * token, void * arg);
+typedef BKInt (* BKTKPutTokensFunc) (BKTKToken const * tokens, BKUSize count, void * arg);
 
 /**
  * Defines a token type
@@ -75,12 +76,25 @@ enum BKTKState
 	BKTKStateError, // after end
 };
 
+/**
+ * Token flags
+ */
+enum BKTKTokenFlag
+{
+	BKTKTokenFlagResident   = 1 << 0, // `data` references the input and is not NUL-terminated
+	BKTKTokenFlagPersistent = 1 << 1, // `data` is valid until the tokenizer is reset
+};
+
 /**
  * Defines a token in the given string
+ *
+ * `data` is NUL-terminated and only valid while the token is handled unless
+ * `BKTKTokenFlagResident` or `BKTKTokenFlagPersistent` is set.
  */
 struct BKTKToken
 {
 	BKTKType        type;
+	BKUInt          flags;
 	BKUSize         dataLen;
 	uint8_t const * data;
 	BKTKOffset      offset;
@@ -91,16 +105,36 @@ struct BKTKToken
  */
 struct BKTKTokenizer
 {
-	BKObject   object;
-	BKTKState  state;
-	BKUSize    bufferLen, bufferCap;
-	uint8_t  * buffer;
-	BKUInt     base64Len;
-	BKTKOffset offset;
-	BKTKToken  token;
-	uint32_t   base64Value;
-	BKUInt     charCount;
-	uint32_t   charValue;
+	BKObject        object;
+	BKTKState       state;
+	BKUSize         bufferLen, bufferCap;
+	uint8_t       * buffer;
+	BKUInt          base64Len;
+	BKTKOffset      offset;
+	BKTKToken       token;
+	uint32_t        base64Value;
+	BKUInt          charCount;
+	uint32_t        charValue;
+	uint8_t const * residentEnd; // end of token data referencing the input
+	BKTKToken     * tokens;      // accepted tokens not yet delivered
+	BKUSize         tokensLen, tokensCap;
+	BKTKPutTokensFunc putTokens;
+	void          * putTokensArg;
+	uint8_t      ** dataBlocks;  // buffers kept for persistent tokens
+	BKUSize         dataBlocksLen, dataBlocksCap;
+};
+
+/**
+ * Tokenizer flags
+ *
+ * Set `BKTKTokenizerFlagKeepData` in `tok -> object.flags` to decode large
+ * data literals into blocks which are delivered with `BKTKTokenFlagPersistent`
+ * and are not copied by the parser.
+ */
+enum BKTKTokenizerFlag
+{
+	BKTKTokenizerFlagResident = 1 << 0, // input stays valid until tokens are consumed
+	BKTKTokenizerFlagKeepData = 1 << 1, // keep large data literals until reset
 };
 
 /**
@@ -111,7 +145,7 @@ extern BKInt BKTKTokenizerInit (BKTKTokenizer * tok);
 /**
  * Reset tokenizer for scanning a new string
  *
- * Keeps the allocated buffer
+ * Keeps the allocated buffer but frees data of persistent tokens
  */
 extern void BKTKTokenizerReset (BKTKTokenizer * tok);
 
@@ -128,6 +162,48 @@ extern void BKTKTokenizerReset (BKTKTokenizer * tok);
  */
 extern BKInt BKTKTokenizerPutChars (BKTKTokenizer * tok, uint8_t const * chars, BKUSize size, BKTKPutTokenFunc putToken, void * arg);
 
+/**
+ * Parse full string or multiple partial strings and deliver tokens in batches
+ *
+ * Accepted tokens are collected in `tokens` which has space for `capacity`
+ * tokens (at least 1). `putTokens` is called with the collected tokens when
+ * `tokens` is full and before the function returns. The tokens and their data
+ * are only valid while `putTokens` is called.
+ *
+ * `putTokens` should return 0. A value != 0 indicates an error and aborts the
+ * tokenizer.
+ *
+ * Call the function with `size` = 0 to terminate the tokenizer.
+ */
+extern BKInt BKTKTokenizerPutCharsBatch (BKTKTokenizer * tok, uint8_t const * chars, BKUSize size, BKTKToken * tokens, BKUSize capacity, BKTKPutTokensFunc putTokens, void * arg);
+
+/**
+ * Parse complete string and terminate tokenizer
+ *
+ * Tokens are delivered in batches as with `BKTKTokenizerPutCharsBatch`.
+ * Tokens which need no unescaping or decoding reference `chars` directly and
+ * have `BKTKTokenFlagResident` set. `chars` has to remain valid as long as the
+ * tokens are used.
+ */
+extern BKInt BKTKTokenizerPutResidentChars (BKTKTokenizer * tok, uint8_t const * chars, BKUSize size, BKTKToken * tokens, BKUSize capacity, BKTKPutTokensFunc putTokens, void * arg);
+
+/**
+ * Parse complete string with `numJobs` threads and terminate tokenizer
+ *
+ * `chars` is split after the first line break following every `segmentSize`
+ * chars, speculating that it is not contained in a string or data literal.
+ * Segments are tokenized independently by worker threads and are delivered in
+ * order to `putTokens` on the calling thread. Segments which fail, or which
+ * follow a segment ending in a string or data literal, are tokenized again in
+ * sequence by `tok`.
+ *
+ * The tokens, their line numbers and errors are the same as with
+ * `BKTKTokenizerPutResidentChars`, but tokens of a segment are delivered in a
+ * single call. Only resident tokens stay valid after `putTokens` returns.
+ * Parses the string in sequence if threads are not available.
+ */
+extern BKInt BKTKTokenizerPutResidentCharsSplit (BKTKTokenizer * tok, uint8_t const * chars, BKUSize size, BKUSize segmentSize, BKInt numJobs, BKTKToken * tokens, BKUSize capacity, BKTKPutTokensFunc putTokens, void * arg);
+
 /**
  * Check if tokenizer is finished
  *
@@ -0,0 +1,315 @@
+/*
+ * Copyright (c) 2012-2016 Simon Schoenenberger
+ * http://blipkit.audio
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "BKTKTree.h"
+
+#define NODES_INIT_CAPACITY 256
+#define SYMBOLS_INIT_CAPACITY 64
+#define CHUNK_SIZE (64 * 1024)
+
+extern BKClass const BKTKTreeClass;
+
+struct BKTKTreeChunk
+{
+	BKTKTreeChunk * next;
+	BKUSize         size;
+	BKUSize         used;
+	void          * data [];
+};
+
+/**
+ * Check if argument at `index` references resident token data
+ */
+static BKInt BKTKTreeArgIsExternal (BKTKParserNode const * node, BKUSize index)
+{
+	return node -> args && node -> args [index].cursor == BK_TK_PARSER_EXTERNAL_CURSOR;
+}
+
+/**
+ * Allocate `size` bytes aligned to `align` from chunks
+ */
+static void * BKTKTreeAlloc (BKTKTree * tree, BKUSize size, BKUSize align)
+{
+	BKTKTreeChunk * chunk = tree -> chunks;
+	BKUSize offset = 0;
+
+	if (chunk) {
+		offset = (chunk -> used + align - 1) & ~(align - 1);
+	}
+
+	if (!chunk || offset + size > chunk -> size) {
+		BKUSize chunkSize = BKMax (size, CHUNK_SIZE);
+
+		chunk = malloc (sizeof (*chunk) + chunkSize);
+
+		if (!chunk) {
+			return NULL;
+		}
+
+		chunk -> next = tree -> chunks;
+		chunk -> size = chunkSize;
+		tree -> chunks = chunk;
+		offset = 0;
+	}
+
+	chunk -> used = offset + size;
+
+	return &((uint8_t *) chunk -> data) [offset];
+}
+
+BKInt BKTKTreeEnsureNode (BKTKTree * tree)
+{
+	if (tree -> numNodes >= tree -> nodeCapacity) {
+		BKUSize newCapacity = BKMax (tree -> nodeCapacity * 2, NODES_INIT_CAPACITY);
+		BKTKTreeNode * nodes;
+
+		// links are 32 bit
+		if (newCapacity > UINT32_MAX) {
+			if (tree -> numNodes >= UINT32_MAX) {
+				return BK_INVALID_VALUE;
+			}
+
+			newCapacity = UINT32_MAX;
+		}
+
+		nodes = realloc (tree -> nodes, newCapacity * sizeof (*nodes));
+
+		if (!nodes) {
+			return BK_ALLOCATION_ERROR;
+		}
+
+		tree -> nodes = nodes;
+		tree -> nodeCapacity = newCapacity;
+	}
+
+	return 0;
+}
+
+BKTKTreeNode * BKTKTreeAppendNode (BKTKTree * tree)
+{
+	BKTKTreeNode * node = &tree -> nodes [tree -> numNodes ++];
+
+	memset (node, 0, sizeof (*node));
+
+	return node;
+}
+
+BKString * BKTKTreeAllocStrings (BKTKTree * tree, BKUSize count)
+{
+	return BKTKTreeAlloc (tree, count * sizeof (BKString), sizeof (void *));
+}
+
+uint8_t * BKTKTreeAllocChars (BKTKTree * tree, BKUSize size)
+{
+	return BKTKTreeAlloc (tree, size, 1);
+}
+
+BKInt BKTKTreeSetNodeStrings (BKTKTree * tree, BKTKTreeNode * node, BKString const * strings, BKUSize argCount)
+{
+	void ** ref;
+
+	if (BKHashTableLookupOrInsert (&tree -> symbolTable, (char const *) strings [0].str, &ref) < 0) {
+		return BK_ALLOCATION_ERROR;
+	}
+
+	// indices are stored incremented to distinguish them from new items
+	if (!*ref) {
+		if (tree -> numSymbols >= tree -> symbolCapacity) {
+			BKUSize newCapacity = BKMax (tree -> symbolCapacity * 2, SYMBOLS_INIT_CAPACITY);
+			BKString const ** symbols = realloc (tree -> symbols, newCapacity * sizeof (*symbols));
+
+			if (!symbols) {
+				BKHashTableRemove (&tree -> symbolTable, (char const *) strings [0].str);
+				return BK_ALLOCATION_ERROR;
+			}
+
+			tree -> symbols = symbols;
+			tree -> symbolCapacity = newCapacity;
+		}
+
+		tree -> symbols [tree -> numSymbols] = &strings [0];
+		*ref = (void *) (uintptr_t) ++ tree -> numSymbols;
+	}
+
+	node -> symbol = (uint32_t) ((uintptr_t) *ref - 1);
+	node -> name = strings;
+	node -> argCount = (uint32_t) argCount;
+
+	return 0;
+}
+
+/**
+ * Copy string into chars and terminate it
+ */
+static BKInt BKTKTreeCopyString (BKTKTree * tree, BKString * string, BKString const * source)
+{
+	uint8_t * chars = BKTKTreeAllocChars (tree, source -> len + 1);
+
+	if (!chars) {
+		return BK_ALLOCATION_ERROR;
+	}
+
+	memcpy (chars, source -> str, source -> len);
+	chars [source -> len] = '\0';
+
+	*string = (BKString) {
+		.str = chars,
+		.len = source -> len,
+	};
+
+	return 0;
+}
+
+/**
+ * Append `node` and following nodes
+ */
+static BKInt BKTKTreeFill (BKTKTree * tree, BKTKParserNode const * node)
+{
+	BKInt res;
+	BKUSize prevIndex = 0;
+
+	for (; node; node = node -> nextNode) {
+		BKUSize index = tree -> numNodes;
+		BKTKTreeNode * treeNode;
+		BKString * strings;
+
+		if ((res = BKTKTreeEnsureNode (tree)) != 0) {
+			return res;
+		}
+
+		treeNode = BKTKTreeAppendNode (tree);
+		treeNode -> flags = node -> flags & BKTKParserFlagIsGroup;
+		treeNode -> type = node -> type;
+		treeNode -> offset = node -> offset;
+
+		strings = BKTKTreeAllocStrings (tree, 1 + node -> argCount);
+
+		if (!strings) {
+			return BK_ALLOCATION_ERROR;
+		}
+
+		if ((res = BKTKTreeCopyString (tree, &strings [0], &node -> name)) != 0) {
+			return res;
+		}
+
+		for (BKUSize i = 0; i < node -> argCount; i ++) {
+			if (BKTKTreeArgIsExternal (node, i)) {
+				strings [i + 1] = node -> argStrings [i];
+			}
+			else if ((res = BKTKTreeCopyString (tree, &strings [i + 1], &node -> argStrings [i])) != 0) {
+				return res;
+			}
+		}
+
+		if ((res = BKTKTreeSetNodeStrings (tree, treeNode, strings, node -> argCount)) != 0) {
+			return res;
+		}
+
+		if (prevIndex) {
+			tree -> nodes [prevIndex].nextNode = (uint32_t) (index - prevIndex);
+		}
+
+		if (node -> subNode) {
+			tree -> nodes [index].subNode = 1;
+
+			if ((res = BKTKTreeFill (tree, node -> subNode)) != 0) {
+				return res;
+			}
+		}
+
+		prevIndex = index;
+	}
+
+	return 0;
+}
+
+BKInt BKTKTreeInit (BKTKTree * tree, BKTKParserNode const * node)
+{
+	BKInt res;
+	BKString * strings;
+	BKTKTreeNode * root;
+
+	if ((res = BKObjectInit (tree, &BKTKTreeClass, sizeof (*tree))) != 0) {
+		return res;
+	}
+
+	if ((res = BKTKTreeEnsureNode (tree)) != 0) {
+		goto error;
+	}
+
+	// root node has an empty name
+	strings = BKTKTreeAllocStrings (tree, 1);
+
+	if (!strings) {
+		res = BK_ALLOCATION_ERROR;
+		goto error;
+	}
+
+	if ((res = BKTKTreeCopyString (tree, &strings [0], &BK_STRING_INIT)) != 0) {
+		goto error;
+	}
+
+	root = BKTKTreeAppendNode (tree);
+	root -> flags = BKTKParserFlagIsGroup;
+
+	if ((res = BKTKTreeSetNodeStrings (tree, root, strings, 0)) != 0) {
+		goto error;
+	}
+
+	if (node) {
+		root -> subNode = 1;
+
+		if ((res = BKTKTreeFill (tree, node)) != 0) {
+			goto error;
+		}
+	}
+
+	return 0;
+
+	error: {
+		BKDispose (tree);
+
+		return res;
+	}
+}
+
+static void BKTKTreeDispose (BKTKTree * tree)
+{
+	BKTKTreeChunk * next;
+
+	for (BKTKTreeChunk * chunk = tree -> chunks; chunk; chunk = next) {
+		next = chunk -> next;
+		free (chunk);
+	}
+
+	free (tree -> nodes);
+	free (tree -> symbols);
+	BKHashTableDispose (&tree -> symbolTable);
+}
+
+BKClass const BKTKTreeClass =
+{
+	.instanceSize = sizeof (BKTKTree),
+	.dispose      = (void *) BKTKTreeDispose,
+};
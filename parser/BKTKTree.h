@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2012-2016 Simon Schoenenberger
+ * http://blipkit.audio
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#ifndef _BK_TK_TREE_H_
+#define _BK_TK_TREE_H_
+
+#include "BKTKParser.h"
+#include "BKHashTable.h"
+
+typedef struct BKTKTree BKTKTree;
+typedef struct BKTKTreeNode BKTKTreeNode;
+typedef struct BKTKTreeChunk BKTKTreeChunk;
+
+/**
+ * Defines a node in a flat tree
+ *
+ * Nodes are stored in depth-first order. Links are relative indices to the
+ * next node or to the first subnode, which always directly follows its parent
+ * node. An index of 0 means that no node is linked.
+ */
+struct BKTKTreeNode
+{
+	BKUInt           flags;
+	BKTKType         type;
+	BKTKOffset       offset;
+	uint32_t         nextNode;
+	uint32_t         subNode;
+	uint32_t         argCount;
+	uint32_t         symbol;   // index of interned name in `symbols`
+	BKString const * name;     // followed by `argCount` arguments
+};
+
+/**
+ * Contains a node tree in a single array
+ *
+ * `nodes [0]` is a root node whose subnodes are the top-level nodes.
+ * Equal node names have the same symbol. `symbols` contains the name of each
+ * symbol in order of first occurrence.
+ *
+ * Names and arguments are allocated in chunks which are not moved when
+ * appending nodes.
+ */
+struct BKTKTree
+{
+	BKObject          object;
+	BKTKTreeNode    * nodes;
+	BKUSize           numNodes;
+	BKUSize           nodeCapacity;
+	BKString const ** symbols;
+	BKUSize           numSymbols;
+	BKUSize           symbolCapacity;
+	BKTKTreeChunk   * chunks;
+	BKHashTable       symbolTable;
+};
+
+/**
+ * Initialize tree with a copy of the nodes beginning with `node`
+ *
+ * If `node` is NULL, the tree only contains the root node. Nodes can then be
+ * appended by the parser with `BKTKParserSetTree`.
+ *
+ * Argument strings referencing resident token data are not copied and are
+ * only valid as long as the tokenizer which produced them.
+ */
+extern BKInt BKTKTreeInit (BKTKTree * tree, BKTKParserNode const * node);
+
+/**
+ * Ensure that at least one node can be appended
+ */
+extern BKInt BKTKTreeEnsureNode (BKTKTree * tree);
+
+/**
+ * Append empty node
+ *
+ * Space has to be ensured with `BKTKTreeEnsureNode`. Links have to be set by
+ * the caller. The returned pointer is only valid until the next node is
+ * appended.
+ */
+extern BKTKTreeNode * BKTKTreeAppendNode (BKTKTree * tree);
+
+/**
+ * Allocate `count` strings
+ *
+ * Returns NULL if the allocation failed
+ */
+extern BKString * BKTKTreeAllocStrings (BKTKTree * tree, BKUSize count);
+
+/**
+ * Allocate `size` chars
+ *
+ * Returns NULL if the allocation failed
+ */
+extern uint8_t * BKTKTreeAllocChars (BKTKTree * tree, BKUSize size);
+
+/**
+ * Set name and arguments of `node`
+ *
+ * `strings` contains the name followed by `argCount` arguments. It is
+ * allocated with `BKTKTreeAllocStrings`.
+ */
+extern BKInt BKTKTreeSetNodeStrings (BKTKTree * tree, BKTKTreeNode * node, BKString const * strings, BKUSize argCount);
+
+/**
+ * Get root node
+ */
+BK_INLINE BKTKTreeNode const * BKTKTreeGetRoot (BKTKTree const * tree);
+
+/**
+ * Get following node or NULL
+ */
+BK_INLINE BKTKTreeNode const * BKTKTreeNodeNext (BKTKTreeNode const * node);
+
+/**
+ * Get first subnode or NULL
+ */
+BK_INLINE BKTKTreeNode const * BKTKTreeNodeSub (BKTKTreeNode const * node);
+
+
+// --- Inline implementations
+
+BK_INLINE BKTKTreeNode const * BKTKTreeGetRoot (BKTKTree const * tree)
+{
+	return &tree -> nodes [0];
+}
+
+BK_INLINE BKTKTreeNode const * BKTKTreeNodeNext (BKTKTreeNode const * node)
+{
+	return node -> nextNode ? &node [node -> nextNode] : NULL;
+}
+
+BK_INLINE BKTKTreeNode const * BKTKTreeNodeSub (BKTKTreeNode const * node)
+{
+	return node -> subNode ? &node [node -> subNode] : NULL;
+}
+
+#endif /* ! _BK_TK_TREE_H_ */
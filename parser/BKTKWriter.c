@@ -23,6 +23,12 @@
 
 #include "BKTKWriter.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #define INIT_BUFFER_SIZE 4096
 #define INIT_INDENT_CAPACITY 16
 
@@ -84,6 +90,93 @@ static uint8_t const base64Chars [64] =
 	'4', '5', '6', '7', '8', '9', '+', '/',
 };
 
+#if defined(__AVX2__)
+/**
+ * Convert 6 bit values in `v` to base64 chars
+ */
+static __m256i base64Translate (__m256i v)
+{
+	__m256i chars = _mm256_add_epi8 (v, _mm256_set1_epi8 ('A'));
+
+	chars = _mm256_add_epi8 (chars, _mm256_and_si256 (_mm256_cmpgt_epi8 (v, _mm256_set1_epi8 (25)), _mm256_set1_epi8 ('a' - 26 - 'A')));
+	chars = _mm256_add_epi8 (chars, _mm256_and_si256 (_mm256_cmpgt_epi8 (v, _mm256_set1_epi8 (51)), _mm256_set1_epi8 ('0' - 52 - ('a' - 26))));
+	chars = _mm256_add_epi8 (chars, _mm256_and_si256 (_mm256_cmpeq_epi8 (v, _mm256_set1_epi8 (62)), _mm256_set1_epi8 ('+' - 62 - ('0' - 52))));
+	chars = _mm256_add_epi8 (chars, _mm256_and_si256 (_mm256_cmpeq_epi8 (v, _mm256_set1_epi8 (63)), _mm256_set1_epi8 ('/' - 63 - ('0' - 52))));
+
+	return chars;
+}
+
+/**
+ * Encode 24 bytes at `data` to 32 base64 chars at `chars`
+ *
+ * Reads 28 bytes.
+ */
+static void base64EncodeBlock (uint8_t const * data, uint8_t * chars)
+{
+	__m256i v, hi, lo;
+
+	v = _mm256_inserti128_si256 (_mm256_castsi128_si256 (_mm_loadu_si128 ((__m128i const *) &data [0])),
+		_mm_loadu_si128 ((__m128i const *) &data [12]), 1);
+
+	// spread each 3 bytes to 32 bit values containing bytes 1, 0, 2, 1
+	v = _mm256_shuffle_epi8 (v, _mm256_setr_epi8 (
+		1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+		1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+
+	// move 6 bit values to separate bytes
+	hi = _mm256_mulhi_epu16 (_mm256_and_si256 (v, _mm256_set1_epi32 (0x0FC0FC00)), _mm256_set1_epi32 (0x04000040));
+	lo = _mm256_mullo_epi16 (_mm256_and_si256 (v, _mm256_set1_epi32 (0x003F03F0)), _mm256_set1_epi32 (0x01000010));
+	v = _mm256_or_si256 (hi, lo);
+
+	_mm256_storeu_si256 ((__m256i *) chars, base64Translate (v));
+}
+
+#define BASE64_BLOCK_SIZE 24
+#define BASE64_BLOCK_READ_SIZE 28
+
+#elif defined(__SSE2__)
+/**
+ * Convert 6 bit values in `v` to base64 chars
+ */
+static __m128i base64Translate (__m128i v)
+{
+	__m128i chars = _mm_add_epi8 (v, _mm_set1_epi8 ('A'));
+
+	chars = _mm_add_epi8 (chars, _mm_and_si128 (_mm_cmpgt_epi8 (v, _mm_set1_epi8 (25)), _mm_set1_epi8 ('a' - 26 - 'A')));
+	chars = _mm_add_epi8 (chars, _mm_and_si128 (_mm_cmpgt_epi8 (v, _mm_set1_epi8 (51)), _mm_set1_epi8 ('0' - 52 - ('a' - 26))));
+	chars = _mm_add_epi8 (chars, _mm_and_si128 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 (62)), _mm_set1_epi8 ('+' - 62 - ('0' - 52))));
+	chars = _mm_add_epi8 (chars, _mm_and_si128 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 (63)), _mm_set1_epi8 ('/' - 63 - ('0' - 52))));
+
+	return chars;
+}
+
+/**
+ * Encode 12 bytes at `data` to 16 base64 chars at `chars`
+ */
+static void base64EncodeBlock (uint8_t const * data, uint8_t * chars)
+{
+	__m128i v, values;
+
+	v = _mm_setr_epi32 (
+		(uint32_t) data [0] << 16 | (uint32_t) data  [1] << 8 | data  [2],
+		(uint32_t) data [3] << 16 | (uint32_t) data  [4] << 8 | data  [5],
+		(uint32_t) data [6] << 16 | (uint32_t) data  [7] << 8 | data  [8],
+		(uint32_t) data [9] << 16 | (uint32_t) data [10] << 8 | data [11]);
+
+	// move 6 bit values to separate bytes
+	values = _mm_and_si128 (_mm_srli_epi32 (v, 18), _mm_set1_epi32 (0x0000003F));
+	values = _mm_or_si128 (values, _mm_and_si128 (_mm_srli_epi32 (v, 4), _mm_set1_epi32 (0x00003F00)));
+	values = _mm_or_si128 (values, _mm_and_si128 (_mm_slli_epi32 (v, 10), _mm_set1_epi32 (0x003F0000)));
+	values = _mm_or_si128 (values, _mm_and_si128 (_mm_slli_epi32 (v, 24), _mm_set1_epi32 (0x3F000000)));
+
+	_mm_storeu_si128 ((__m128i *) chars, base64Translate (values));
+}
+
+#define BASE64_BLOCK_SIZE 12
+#define BASE64_BLOCK_READ_SIZE 12
+
+#endif
+
 static void BKTKWriterIndentBufferExtend (uint8_t * indentBuffer, BKUSize indentSize, BKUSize capacity, BKUSize newCapacity)
 {
 	for (BKUSize i = capacity; i < newCapacity; i ++) {
@@ -270,6 +363,15 @@ static BKInt BKTKWriterWriteBase64 (BKTKWriter * writer, const BKString * data)
 		// leave space for base64 encoded string (33% larger)
 		maxLen = BKMin ((writer -> bufferCap - writer -> bufferLen) / 2, size);
 
+#ifdef BASE64_BLOCK_SIZE
+		for (; maxLen >= BASE64_BLOCK_READ_SIZE; maxLen -= BASE64_BLOCK_SIZE) {
+			base64EncodeBlock (str, &writer -> buffer [bufferLen]);
+			bufferLen += BASE64_BLOCK_SIZE / 3 * 4;
+			str += BASE64_BLOCK_SIZE;
+			size -= BASE64_BLOCK_SIZE;
+		}
+#endif
+
 		for (; maxLen >= 3; maxLen -= 3) {
 			value  = (uint32_t) str [0] << 16;
 			value |= (uint32_t) str [1] << 8;
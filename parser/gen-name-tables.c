@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2012-2016 Simon Schoenenberger
+ * http://blipkit.audio
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/**
+ * Generates minimal perfect hash tables of the compiler's lookup tables
+ *
+ * Each name is assigned to a bucket by its hash. Buckets are placed in
+ * descending order of size by searching a displacement which moves all names
+ * of the bucket to free slots. A name is then found with a single hash and
+ * compare:
+ *
+ *   hash = BKTKNameHash (name, seed)
+ *   slot = ((hash >> 16) + disp [hash % numBuckets]) % size
+ *
+ * The tables are written to stdout in the order of their slots.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "BKTKCompilerNames.h"
+
+#define MAX_NAMES 256
+#define MAX_SEEDS 100000
+
+struct entry
+{
+	char const * name;
+	char const * value;
+	char const * flags;
+};
+
+struct table
+{
+	char const         * name;
+	struct entry const * entries;
+	size_t               size;
+};
+
+struct bucket
+{
+	size_t count;
+	size_t items [MAX_NAMES];
+};
+
+#define ENTRY(name, value, flags) {name, #value, #flags},
+
+static struct entry const noteNames [] = {BK_NOTE_NAMES (ENTRY)};
+static struct entry const cmdNames [] = {BK_CMD_NAMES (ENTRY)};
+static struct entry const effectNames [] = {BK_EFFECT_NAMES (ENTRY)};
+static struct entry const waveformNames [] = {BK_WAVEFORM_NAMES (ENTRY)};
+static struct entry const envelopeNames [] = {BK_ENVELOPE_NAMES (ENTRY)};
+static struct entry const miscNames [] = {BK_MISC_NAMES (ENTRY)};
+static struct entry const repeatNames [] = {BK_REPEAT_NAMES (ENTRY)};
+static struct entry const pulseNames [] = {BK_PULSE_NAMES (ENTRY)};
+
+#define TABLE(table) {#table, table, sizeof (table) / sizeof (*table)}
+
+static struct table const tables [] =
+{
+	TABLE (noteNames),
+	TABLE (cmdNames),
+	TABLE (effectNames),
+	TABLE (waveformNames),
+	TABLE (envelopeNames),
+	TABLE (miscNames),
+	TABLE (repeatNames),
+	TABLE (pulseNames),
+};
+
+static struct bucket buckets [MAX_NAMES];
+
+static int compareBuckets (void const * a, void const * b)
+{
+	struct bucket const * bucketA = *(struct bucket const **) a;
+	struct bucket const * bucketB = *(struct bucket const **) b;
+
+	return (int) bucketB -> count - (int) bucketA -> count;
+}
+
+/**
+ * Try to place all names with `seed`
+ *
+ * Returns 0 on success
+ */
+static int placeNames (struct table const * table, uint32_t seed, size_t numBuckets, uint8_t disp [], size_t slots [])
+{
+	uint32_t hashes [MAX_NAMES];
+	struct bucket * order [MAX_NAMES];
+	int used [MAX_NAMES] = {0};
+
+	for (size_t i = 0; i < numBuckets; i ++) {
+		buckets [i].count = 0;
+		order [i] = &buckets [i];
+		disp [i] = 0;
+	}
+
+	for (size_t i = 0; i < table -> size; i ++) {
+		struct bucket * bucket;
+
+		hashes [i] = BKTKNameHash (table -> entries [i].name, seed);
+		bucket = &buckets [hashes [i] % numBuckets];
+		bucket -> items [bucket -> count ++] = i;
+	}
+
+	qsort (order, numBuckets, sizeof (*order), compareBuckets);
+
+	for (size_t i = 0; i < numBuckets && order [i] -> count; i ++) {
+		struct bucket * bucket = order [i];
+		size_t d;
+
+		for (d = 0; d < table -> size; d ++) {
+			size_t j;
+
+			for (j = 0; j < bucket -> count; j ++) {
+				size_t item = bucket -> items [j];
+				size_t slot = ((hashes [item] >> 16) + d) % table -> size;
+
+				if (used [slot]) {
+					break;
+				}
+
+				// reserve slot to detect collisions inside bucket
+				used [slot] = 1;
+				slots [item] = slot;
+			}
+
+			if (j == bucket -> count) {
+				break;
+			}
+
+			while (j --) {
+				used [slots [bucket -> items [j]]] = 0;
+			}
+		}
+
+		if (d == table -> size) {
+			return -1;
+		}
+
+		disp [bucket - buckets] = (uint8_t) d;
+	}
+
+	return 0;
+}
+
+static int writeTable (FILE * file, struct table const * table)
+{
+	uint32_t seed;
+	uint8_t disp [MAX_NAMES];
+	size_t slots [MAX_NAMES];
+	struct entry const * ordered [MAX_NAMES];
+	size_t numBuckets = table -> size / 2 + 1;
+
+	if (table -> size > MAX_NAMES) {
+		fprintf (stderr, "Table '%s' has more than %d names\n", table -> name, MAX_NAMES);
+		return -1;
+	}
+
+	for (seed = 0; seed < MAX_SEEDS; seed ++) {
+		if (placeNames (table, seed, numBuckets, disp, slots) == 0) {
+			break;
+		}
+	}
+
+	if (seed == MAX_SEEDS) {
+		fprintf (stderr, "Could not find hash seed for table '%s'\n", table -> name);
+		return -1;
+	}
+
+	for (size_t i = 0; i < table -> size; i ++) {
+		ordered [slots [i]] = &table -> entries [i];
+	}
+
+	fprintf (file, "static struct keyval const %s [] =\n{\n", table -> name);
+
+	for (size_t i = 0; i < table -> size; i ++) {
+		struct entry const * entry = ordered [i];
+
+		fprintf (file, "\t{\"%s\", %s, %s},\n", entry -> name, entry -> value, entry -> flags);
+	}
+
+	fprintf (file, "};\n\nstatic uint8_t const %sDisp [] =\n{\n\t", table -> name);
+
+	for (size_t i = 0; i < numBuckets; i ++) {
+		fprintf (file, "%u,%s", disp [i], i + 1 < numBuckets ? " " : "\n");
+	}
+
+	fprintf (file, "};\n\nstatic struct keyhash const %sHash =\n{\n", table -> name);
+	fprintf (file, "\t.items      = %s,\n", table -> name);
+	fprintf (file, "\t.disp       = %sDisp,\n", table -> name);
+	fprintf (file, "\t.seed       = %u,\n", seed);
+	fprintf (file, "\t.size       = %zu,\n", table -> size);
+	fprintf (file, "\t.numBuckets = %zu,\n", numBuckets);
+	fprintf (file, "};\n\n");
+
+	return 0;
+}
+
+int main (int argc, char const * argv [])
+{
+	FILE * file = stdout;
+
+	fprintf (file, "/**\n * Generated by gen-name-tables from BKTKCompilerNames.h; do not edit\n *\n * Regenerate with `make -C parser name-tables`\n */\n\n");
+
+	for (size_t i = 0; i < sizeof (tables) / sizeof (*tables); i ++) {
+		if (writeTable (file, &tables [i]) != 0) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
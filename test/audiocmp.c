@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+
+/**
+ * Read little endian 16 bit sample
+ *
+ * Returns 0 at the end of the file.
+ */
+static int read_sample (FILE * file, int * outValue)
+{
+	uint8_t bytes [2];
+
+	if (fread (bytes, sizeof (bytes), 1, file) != 1) {
+		return 0;
+	}
+
+	*outValue = (int16_t) (bytes [0] | (bytes [1] << 8));
+
+	return 1;
+}
+
+/**
+ * Compare raw audio files within a tolerance
+ *
+ * Fails if the files have a different length or any sample differs by more
+ * than `tolerance`. The largest difference is printed.
+ */
+int main (int argc, char const * argv [])
+{
+	int res = RESULT_ERROR;
+	int tolerance, a, b, hasA, hasB;
+	int maxDiff = 0;
+	long numSamples = 0;
+	FILE * fileA = NULL;
+	FILE * fileB = NULL;
+
+	if (argc < 4) {
+		fprintf (stderr, "Usage: %s a.raw b.raw tolerance\n", argv [0]);
+		return RESULT_ERROR;
+	}
+
+	tolerance = atoi (argv [3]);
+
+	if ((fileA = fopen (argv [1], "rb")) == NULL || (fileB = fopen (argv [2], "rb")) == NULL) {
+		fprintf (stderr, "Could not open files\n");
+		goto cleanup;
+	}
+
+	for (;;) {
+		hasA = read_sample (fileA, &a);
+		hasB = read_sample (fileB, &b);
+
+		if (hasA != hasB) {
+			fprintf (stderr, "Length differs after %ld samples\n", numSamples);
+			res = RESULT_FAIL;
+			goto cleanup;
+		}
+
+		if (!hasA) {
+			break;
+		}
+
+		maxDiff = BKMax (maxDiff, abs (a - b));
+		numSamples ++;
+	}
+
+	printf ("%ld samples, maximum difference %d\n", numSamples, maxDiff);
+
+	res = maxDiff <= tolerance ? RESULT_PASS : RESULT_FAIL;
+
+	cleanup: {
+		if (fileA) {
+			fclose (fileA);
+		}
+
+		if (fileB) {
+			fclose (fileB);
+		}
+	}
+
+	return res;
+}
@@ -0,0 +1,242 @@
+#include "test.h"
+#include "BKTKParser.h"
+#include "BKTKWriter.h"
+
+#define MAX_DATA_SIZE 100
+
+static char const base64Alphabet [] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static BKInt put_tokens (BKTKToken const * tokens, BKUSize count, BKString * out)
+{
+	for (BKUSize i = 0; i < count; i ++) {
+		BKTKToken const * token = &tokens [i];
+
+		BKStringAppendFormat (out, "%d %u:%u %u:", token -> type, token -> offset.lineno, token -> offset.colno, (BKUInt) token -> dataLen);
+		BKStringAppendLen (out, (char const *) token -> data, token -> dataLen);
+		BKStringAppend (out, "\n");
+	}
+
+	return 0;
+}
+
+static BKInt put_data (BKTKToken const * tokens, BKUSize count, BKString * out)
+{
+	for (BKUSize i = 0; i < count; i ++) {
+		if (tokens [i].type == BKTKTypeData) {
+			BKStringAppendLen (out, (char const *) tokens [i].data, tokens [i].dataLen);
+		}
+	}
+
+	return 0;
+}
+
+static BKInt put_parser_tokens (BKTKToken const * tokens, BKUSize count, BKTKParser * parser)
+{
+	return BKTKParserPutTokens (parser, tokens, count);
+}
+
+static BKInt write_string (BKString * out, uint8_t const * data, BKUSize size)
+{
+	return BKStringAppendLen (out, (char const *) data, size);
+}
+
+/**
+ * Encode `size` bytes of `data` as base64 chars with padding
+ */
+static void encode (uint8_t const * data, BKUSize size, BKString * out)
+{
+	uint32_t value;
+
+	for (BKUSize i = 0; i < size; i += 3) {
+		value = (uint32_t) data [i] << 16;
+		value |= i + 1 < size ? (uint32_t) data [i + 1] << 8 : 0;
+		value |= i + 2 < size ? (uint32_t) data [i + 2] : 0;
+
+		BKStringAppendLen (out, &base64Alphabet [(value >> 18) & 0x3F], 1);
+		BKStringAppendLen (out, &base64Alphabet [(value >> 12) & 0x3F], 1);
+		BKStringAppendLen (out, i + 1 < size ? &base64Alphabet [(value >> 6) & 0x3F] : "=", 1);
+		BKStringAppendLen (out, i + 2 < size ? &base64Alphabet [value & 0x3F] : "=", 1);
+	}
+}
+
+/**
+ * Tokenize `source` at once or one char at a time
+ *
+ * Base64 chars are only decoded in blocks when enough chars are put at
+ * once. Appends tokens and error to `out`.
+ */
+static void tokenize (BKString const * source, BKInt charwise, BKTKPutTokensFunc putTokens, BKString * out)
+{
+	BKTKTokenizer tok;
+	BKTKToken tokens [16];
+
+	assert (BKTKTokenizerInit (&tok) == 0);
+
+	if (charwise) {
+		for (BKUSize i = 0; i < source -> len; i ++) {
+			BKTKTokenizerPutCharsBatch (&tok, &source -> str [i], 1, tokens, 16, putTokens, out);
+		}
+	}
+	else {
+		BKTKTokenizerPutCharsBatch (&tok, source -> str, source -> len, tokens, 16, putTokens, out);
+	}
+
+	BKTKTokenizerPutCharsBatch (&tok, NULL, 0, tokens, 16, putTokens, out);
+
+	if (BKTKTokenizerHasError (&tok)) {
+		BKStringAppendFormat (out, "error: %s\n", tok.buffer);
+	}
+
+	BKDispose (&tok);
+}
+
+/**
+ * Check that decoding in blocks gives the same data and errors as decoding
+ * char by char
+ *
+ * Each byte value is placed at every position of a literal spanning
+ * multiple blocks.
+ */
+static void check_blocks (void)
+{
+	uint8_t data [72];
+	BKString chars = BK_STRING_INIT;
+	BKString source = BK_STRING_INIT;
+	BKString expected = BK_STRING_INIT;
+	BKString result = BK_STRING_INIT;
+
+	for (BKInt i = 0; i < sizeof (data); i ++) {
+		data [i] = i * 37 + 11;
+	}
+
+	encode (data, sizeof (data), &chars);
+
+	for (BKUSize pos = 0; pos < chars.len; pos ++) {
+		for (BKInt c = 0; c < 256; c ++) {
+			BKStringEmpty (&source);
+			BKStringAppend (&source, "d:!\"");
+			BKStringAppendLen (&source, (char const *) chars.str, pos);
+			BKStringAppendLen (&source, (char const *) &(uint8_t) {c}, 1);
+			BKStringAppendLen (&source, (char const *) &chars.str [pos + 1], chars.len - pos - 1);
+			BKStringAppend (&source, "\"\n");
+
+			BKStringEmpty (&expected);
+			BKStringEmpty (&result);
+			tokenize (&source, 1, (BKTKPutTokensFunc) put_tokens, &expected);
+			tokenize (&source, 0, (BKTKPutTokensFunc) put_tokens, &result);
+
+			// token data may contain null chars
+			assert (result.len == expected.len && BKStringCompareString (&result, &expected) == 0);
+		}
+	}
+
+	BKStringDispose (&result);
+	BKStringDispose (&expected);
+	BKStringDispose (&source);
+	BKStringDispose (&chars);
+}
+
+/**
+ * Check that `source` fails with `error` at once and char by char
+ */
+static void check_error (char const * source, char const * error)
+{
+	BKString string = BK_STRING_INIT;
+	BKString result = BK_STRING_INIT;
+
+	BKStringAppend (&string, source);
+
+	for (BKInt charwise = 0; charwise <= 1; charwise ++) {
+		BKStringEmpty (&result);
+		tokenize (&string, charwise, (BKTKPutTokensFunc) put_data, &result);
+		assert (strstr ((char const *) result.str, error) != NULL);
+	}
+
+	BKStringDispose (&result);
+	BKStringDispose (&string);
+}
+
+/**
+ * Check that invalid data chars are reported at their position
+ */
+static void check_errors (void)
+{
+	// first char of block
+	check_error ("d:!\"$GF0YWRhdGFkYXRhZGF0YWRhdGFkYXRhZGF0YWRh\"\n",
+		"Invalid data char \\x24 on line 1:5");
+	// last char of a 32 char block
+	check_error ("d:!\"ZGF0YWRhdGFkYXRhZGF0YWRhdGFkYXR$ZGF0YWRh\"\n",
+		"Invalid data char \\x24 on line 1:36");
+	// following line break
+	check_error ("d:!\"ZGF0YWRhdGFk\n\tYXRhZGF0YWRhdGFkYXRh*GF0YWRh\"\n",
+		"Invalid data char \\x2a on line 2:22");
+	// non-ASCII char in last block
+	check_error ("a:1\nd:!\"ZGF0YWRhdGFkYXRhZGF0YWRhdGFkYXRhZGF0YW\xc3\xa4\"\n",
+		"Invalid data char \\xc3 on line 2:43");
+}
+
+/**
+ * Check that data is the same after decoding and encoding it again
+ */
+static void check_round_trip (void)
+{
+	uint8_t data [MAX_DATA_SIZE];
+	BKTKTokenizer tok;
+	BKTKParser parser;
+	BKTKToken tokens [16];
+	BKString source = BK_STRING_INIT;
+	BKString decoded = BK_STRING_INIT;
+	BKString written = BK_STRING_INIT;
+	BKString chars = BK_STRING_INIT;
+
+	for (BKUSize size = 0; size <= MAX_DATA_SIZE; size ++) {
+		for (BKUSize i = 0; i < size; i ++) {
+			data [i] = (i * 97 + size * 13) ^ (i >> 2);
+		}
+
+		BKStringEmpty (&chars);
+		encode (data, size, &chars);
+
+		BKStringEmpty (&source);
+		BKStringAppend (&source, "d:!\"");
+		BKStringAppendString (&source, &chars);
+		BKStringAppend (&source, "\"\n");
+
+		// decode
+		for (BKInt charwise = 0; charwise <= 1; charwise ++) {
+			BKStringEmpty (&decoded);
+			tokenize (&source, charwise, (BKTKPutTokensFunc) put_data, &decoded);
+			assert (decoded.len == size && memcmp (decoded.str, data, size) == 0);
+		}
+
+		// encode
+		assert (BKTKTokenizerInit (&tok) == 0);
+		assert (BKTKParserInit (&parser) == 0);
+		BKTKTokenizerPutCharsBatch (&tok, source.str, source.len, tokens, 16, (BKTKPutTokensFunc) put_parser_tokens, &parser);
+		BKTKTokenizerPutCharsBatch (&tok, NULL, 0, tokens, 16, (BKTKPutTokensFunc) put_parser_tokens, &parser);
+		assert (!BKTKTokenizerHasError (&tok));
+		assert (!BKTKParserHasError (&parser));
+
+		BKStringEmpty (&written);
+		assert (BKTKWriterWriteNode (BKTKParserGetNodeTree (&parser), (BKTKWriterWriteFunc) write_string, &written, (uint8_t const *) "\t") == 0);
+		assert (written.len == source.len && BKStringCompareString (&written, &source) == 0);
+
+		BKDispose (&parser);
+		BKDispose (&tok);
+	}
+
+	BKStringDispose (&chars);
+	BKStringDispose (&written);
+	BKStringDispose (&decoded);
+	BKStringDispose (&source);
+}
+
+int main (int argc, char const * argv [])
+{
+	check_blocks ();
+	check_errors ();
+	check_round_trip ();
+
+	return RESULT_PASS;
+}
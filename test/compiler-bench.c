@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <time.h>
+#include "test.h"
+#include "BKTKCompiler.h"
+
+#define MIN_SOURCE_SIZE (1 << 20)
+#define NUM_ROUNDS 20
+
+static char const snippet [] =
+	"% global track\n"
+	"st:18; w:sqr; dc:8; v:200\n"
+	"a:c5; s:1; a:d#5; s:1; r; s:2\n"
+	"e:vs:16; a:g4:c5; p:-32; s:1\n"
+	"at:12; a:f#3+20; rt:6; s:1; m\n"
+	"e:vb:4:1200; v:180; a:h4; s:3\n";
+
+static double get_time (void)
+{
+	struct timespec time;
+
+	clock_gettime (CLOCK_MONOTONIC, &time);
+
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static BKInt put_tokens (BKTKToken const * tokens, BKUSize count, BKTKParser * parser)
+{
+	return BKTKParserPutTokens (parser, tokens, count);
+}
+
+static int load_source (BKString * source, char const * filename)
+{
+	FILE * file;
+	size_t size;
+	char buffer [16 * 1024];
+
+	if (!filename) {
+		while (source -> len < MIN_SOURCE_SIZE) {
+			BKStringAppend (source, snippet);
+		}
+
+		return 0;
+	}
+
+	file = fopen (filename, "rb");
+
+	if (!file) {
+		fprintf (stderr, "Could not open '%s'\n", filename);
+		return -1;
+	}
+
+	while ((size = fread (buffer, 1, sizeof (buffer), file)) > 0) {
+		BKStringAppendLen (source, buffer, size);
+	}
+
+	fclose (file);
+
+	return 0;
+}
+
+/**
+ * Parse `source` into linked nodes and copy them into `tree` as
+ * `BKTKCompilerCompile` does
+ */
+static double parse_copy (BKTKTokenizer * tok, BKTKParser * parser, BKString const * source, BKTKTree * tree)
+{
+	double time;
+	BKTKToken tokens [256];
+
+	BKTKTokenizerReset (tok);
+	BKTKParserReset (parser);
+
+	time = get_time ();
+
+	BKTKTokenizerPutCharsBatch (tok, source -> str, source -> len, tokens, 256, (BKTKPutTokensFunc) put_tokens, parser);
+	BKTKTokenizerPutCharsBatch (tok, NULL, 0, tokens, 256, (BKTKPutTokensFunc) put_tokens, parser);
+	assert (BKTKTreeInit (tree, BKTKParserGetNodeTree (parser)) == 0);
+
+	time = get_time () - time;
+
+	assert (!BKTKTokenizerHasError (tok));
+	assert (!BKTKParserHasError (parser));
+
+	return time;
+}
+
+/**
+ * Parse `source` directly into `tree`
+ */
+static double parse_flat (BKTKTokenizer * tok, BKTKParser * parser, BKString const * source, BKTKTree * tree)
+{
+	double time;
+	BKTKToken tokens [256];
+
+	BKTKTokenizerReset (tok);
+	BKTKParserReset (parser);
+
+	time = get_time ();
+
+	assert (BKTKTreeInit (tree, NULL) == 0);
+	BKTKParserSetTree (parser, tree);
+	BKTKTokenizerPutCharsBatch (tok, source -> str, source -> len, tokens, 256, (BKTKPutTokensFunc) put_tokens, parser);
+	BKTKTokenizerPutCharsBatch (tok, NULL, 0, tokens, 256, (BKTKPutTokensFunc) put_tokens, parser);
+
+	time = get_time () - time;
+
+	assert (!BKTKTokenizerHasError (tok));
+	assert (!BKTKParserHasError (parser));
+	BKTKParserReset (parser);
+
+	return time;
+}
+
+/**
+ * Compile `tree` and reset compiler
+ */
+static double run (BKTKCompiler * compiler, BKTKTree const * tree)
+{
+	double time;
+
+	time = get_time ();
+
+	assert (BKTKCompilerCompileTree (compiler, tree) == 0);
+
+	time = get_time () - time;
+
+	assert (compiler -> error.len == 0);
+	assert (BKTKCompilerReset (compiler) == 0);
+
+	return time;
+}
+
+int main (int argc, char const * argv [])
+{
+	double time, minTime = 1e9, minCopyTime = 1e9, minFlatTime = 1e9;
+	BKString source = BK_STRING_INIT;
+	BKTKTokenizer tok;
+	BKTKParser parser;
+	BKTKCompiler compiler;
+	BKTKTree tree;
+
+	if (load_source (&source, argc > 1 ? argv [1] : NULL) != 0) {
+		return RESULT_ERROR;
+	}
+
+	assert (BKTKTokenizerInit (&tok) == 0);
+	assert (BKTKParserInit (&parser) == 0);
+	assert (BKTKCompilerInit (&compiler) == 0);
+
+	for (int round = 0; round < NUM_ROUNDS; round ++) {
+		time = parse_copy (&tok, &parser, &source, &tree);
+		minCopyTime = time < minCopyTime ? time : minCopyTime;
+		BKDispose (&tree);
+
+		time = parse_flat (&tok, &parser, &source, &tree);
+		minFlatTime = time < minFlatTime ? time : minFlatTime;
+
+		if (round < NUM_ROUNDS - 1) {
+			BKDispose (&tree);
+		}
+	}
+
+	printf ("%zu bytes, %zu nodes, %zu symbols\n", (size_t) source.len, (size_t) tree.numNodes, (size_t) tree.numSymbols);
+
+	for (int round = 0; round < NUM_ROUNDS; round ++) {
+		time = run (&compiler, &tree);
+		minTime = time < minTime ? time : minTime;
+	}
+
+	printf ("parse and copy: %6.2f ns/node, %6.2f MB/s\n", minCopyTime * 1e9 / tree.numNodes, source.len / minCopyTime * 1e-6);
+	printf ("parse flat:     %6.2f ns/node, %6.2f MB/s\n", minFlatTime * 1e9 / tree.numNodes, source.len / minFlatTime * 1e-6);
+	printf ("compile:        %6.2f ns/node, %6.2f MB/s\n", minTime * 1e9 / tree.numNodes, source.len / minTime * 1e-6);
+
+	BKDispose (&tree);
+	BKDispose (&compiler);
+	BKDispose (&parser);
+	BKDispose (&tok);
+	BKStringDispose (&source);
+
+	return RESULT_PASS;
+}
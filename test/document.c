@@ -0,0 +1,171 @@
+#include "test.h"
+#include "BKTKDocument.h"
+
+static BKInt edit (BKTKDocument * doc, BKUSize offset, BKUSize length, char const * chars)
+{
+	return BKTKDocumentEdit (doc, offset, length, (uint8_t const *) chars, strlen (chars));
+}
+
+static BKInt name_is (BKTKParserNode const * node, char const * name)
+{
+	return node && BKStringCompare (&node -> name, name) == 0;
+}
+
+static BKInt lineno_of (BKTKDocument const * doc, BKTKParserNode const * node)
+{
+	for (BKTKDocumentBlock * block = doc -> firstBlock; block; block = block -> nextBlock) {
+		for (BKTKParserNode * blockNode = block -> firstNode; blockNode; blockNode = blockNode -> nextNode) {
+			if (blockNode == node) {
+				return BKTKDocumentGetLineno (doc, block, node -> offset.lineno);
+			}
+
+			if (blockNode == block -> lastNode) {
+				break;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Check that each line has a single node with the current line number
+ */
+static BKInt check_lines (BKTKDocument const * doc, BKInt numLines)
+{
+	BKInt lineno = 1;
+
+	for (BKTKDocumentBlock * block = doc -> firstBlock; block; block = block -> nextBlock) {
+		for (BKTKParserNode * node = block -> firstNode; node; node = node -> nextNode) {
+			if (BKTKDocumentGetLineno (doc, block, node -> offset.lineno) != lineno ++) {
+				return 0;
+			}
+
+			if (node == block -> lastNode) {
+				break;
+			}
+		}
+	}
+
+	return lineno - 1 == numLines;
+}
+
+/**
+ * Edit document with many blocks
+ */
+static void test_large (void)
+{
+	BKTKDocument doc;
+	BKTKParserNode * node, * lastNode;
+	BKInt const numLines = 20000;
+	char * text = malloc (numLines * 4 + 1);
+
+	for (BKInt i = 0; i < numLines; i ++) {
+		memcpy (&text [i * 4], "a:1\n", 4);
+	}
+
+	text [numLines * 4] = '\0';
+
+	assert (BKTKDocumentInit (&doc) == 0);
+	assert (edit (&doc, 0, 0, text) == 0);
+	assert (check_lines (&doc, numLines));
+
+	for (lastNode = BKTKDocumentGetNodeTree (&doc); lastNode -> nextNode; lastNode = lastNode -> nextNode) {
+		;
+	}
+
+	// insert line at top
+	assert (edit (&doc, 0, 0, "x\n") == 0);
+	assert (check_lines (&doc, numLines + 1));
+	assert (lastNode -> offset.lineno == numLines);
+	assert (lineno_of (&doc, lastNode) == numLines + 1);
+
+	// split line in the middle
+	assert (edit (&doc, 2 + 10000 * 4 + 3, 1, ";\nb\n") == 0);
+	assert (check_lines (&doc, numLines + 2));
+	assert (lineno_of (&doc, lastNode) == numLines + 2);
+
+	node = BKTKDocumentGetNodeTree (&doc);
+
+	for (BKInt i = 0; i < 10002; i ++) {
+		node = node -> nextNode;
+	}
+
+	assert (name_is (node, "b"));
+	assert (lineno_of (&doc, node) == 10003);
+
+	// remove 1000 lines
+	assert (edit (&doc, 2 + 5000 * 4, 1000 * 4, "") == 0);
+	assert (check_lines (&doc, numLines + 2 - 1000));
+	assert (lineno_of (&doc, lastNode) == numLines + 2 - 1000);
+	assert (lineno_of (&doc, node) == 9003);
+
+	// edit at end
+	assert (edit (&doc, doc.textLen, 0, "c\n") == 0);
+	assert (check_lines (&doc, numLines + 3 - 1000));
+
+	BKDispose (&doc);
+	free (text);
+}
+
+int main (int argc, char const * argv [])
+{
+	BKTKDocument doc;
+	BKTKParserNode * node, * lastNode;
+
+	assert (BKTKDocumentInit (&doc) == 0);
+	assert (BKTKDocumentGetNodeTree (&doc) == NULL);
+
+	assert (edit (&doc, 0, 0, "a:1\n[b:2\nc]\nd:3\n") == 0);
+	assert (!BKTKDocumentHasError (&doc));
+
+	node = BKTKDocumentGetNodeTree (&doc);
+	assert (name_is (node, "a"));
+	assert (node -> argCount == 1);
+	assert (name_is (node -> nextNode, "b"));
+	assert (name_is (node -> nextNode -> subNode, "c"));
+	lastNode = node -> nextNode -> nextNode;
+	assert (name_is (lastNode, "d"));
+	assert (lastNode -> offset.lineno == 4);
+
+	// following nodes are kept
+	assert (edit (&doc, 0, 0, "x\n") == 0);
+	node = BKTKDocumentGetNodeTree (&doc);
+	assert (name_is (node, "x"));
+	assert (name_is (node -> nextNode, "a"));
+	assert (node -> nextNode -> nextNode -> nextNode == lastNode);
+	assert (lastNode -> offset.lineno == 4);
+	assert (lineno_of (&doc, lastNode) == 5);
+
+	// edit inside group
+	assert (edit (&doc, 11, 1, "e") == 0);
+	node = BKTKDocumentGetNodeTree (&doc) -> nextNode -> nextNode;
+	assert (name_is (node -> subNode, "e"));
+	assert (node -> nextNode == lastNode);
+
+	// unterminated string
+	assert (edit (&doc, 4, 0, "\"") == 0);
+	assert (BKTKDocumentHasError (&doc));
+	assert (edit (&doc, 4, 1, "") == 0);
+	assert (!BKTKDocumentHasError (&doc));
+	node = BKTKDocumentGetNodeTree (&doc);
+	assert (name_is (node -> nextNode, "a"));
+	lastNode = node -> nextNode -> nextNode -> nextNode;
+	assert (name_is (lastNode, "d"));
+
+	// join lines
+	assert (edit (&doc, 5, 1, ";") == 0);
+	node = BKTKDocumentGetNodeTree (&doc) -> nextNode;
+	assert (name_is (node, "a"));
+	assert (name_is (node -> nextNode, "b"));
+	assert (lineno_of (&doc, node -> nextNode) == 2);
+	assert (lineno_of (&doc, lastNode) == 4);
+
+	assert (edit (&doc, 100, 0, "y") == BK_INVALID_VALUE);
+
+	BKDispose (&doc);
+
+	test_large ();
+
+	return RESULT_PASS;
+}
@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include "test.h"
+#include "BKTKContext.h"
+#include "BKTKParser.h"
+
+#define SAMPLE_RATE 44100
+#define NUM_SECONDS 60
+
+static BKInt put_tokens (BKTKToken const * tokens, BKUSize count, BKTKParser * parser)
+{
+	return BKTKParserPutTokens (parser, tokens, count);
+}
+
+static int load_source (BKString * source, char const * filename)
+{
+	FILE * file;
+	size_t size;
+	char buffer [16 * 1024];
+
+	file = fopen (filename, "rb");
+
+	if (!file) {
+		fprintf (stderr, "Could not open '%s'\n", filename);
+		return -1;
+	}
+
+	while ((size = fread (buffer, 1, sizeof (buffer), file)) > 0) {
+		BKStringAppendLen (source, buffer, size);
+	}
+
+	fclose (file);
+
+	return 0;
+}
+
+/**
+ * Render the first seconds of a file to standard output
+ *
+ * The program is built once for each code encoding, so the output of both
+ * encodings can be compared.
+ */
+int main (int argc, char const * argv [])
+{
+	int res = RESULT_ERROR;
+	BKString source = BK_STRING_INIT;
+	BKString path = BK_STRING_INIT;
+	BKTKTokenizer tok;
+	BKTKParser parser;
+	BKTKCompiler compiler;
+	BKTKContext ctx;
+	BKContext renderCtx;
+	BKTKToken tokens [256];
+	static BKFrame frames [SAMPLE_RATE * 2];
+
+	if (argc < 2) {
+		fprintf (stderr, "Usage: %s file.blip\n", argv [0]);
+		return RESULT_ERROR;
+	}
+
+	if (load_source (&source, argv [1]) != 0) {
+		return RESULT_ERROR;
+	}
+
+	assert (BKTKTokenizerInit (&tok) == 0);
+	assert (BKTKParserInit (&parser) == 0);
+	assert (BKTKCompilerInit (&compiler) == 0);
+	assert (BKTKContextInit (&ctx, 0) == 0);
+	assert (BKContextInit (&renderCtx, 2, SAMPLE_RATE) == 0);
+
+	// samples are loaded relative to the file
+	BKStringAppend (&path, argv [1]);
+	assert (BKStringDirname (&path, &ctx.loadPath) == 0);
+
+	BKTKTokenizerPutCharsBatch (&tok, source.str, source.len, tokens, 256, (BKTKPutTokensFunc) put_tokens, &parser);
+	BKTKTokenizerPutCharsBatch (&tok, NULL, 0, tokens, 256, (BKTKPutTokensFunc) put_tokens, &parser);
+
+	if (BKTKTokenizerHasError (&tok) || BKTKParserHasError (&parser)) {
+		fprintf (stderr, "%s: parsing failed\n", argv [1]);
+		goto cleanup;
+	}
+
+	if (BKTKCompilerCompile (&compiler, BKTKParserGetNodeTree (&parser)) != 0) {
+		fprintf (stderr, "%s: %s", argv [1], (char const *) compiler.error.str);
+		goto cleanup;
+	}
+
+	if (BKTKContextCreate (&ctx, &compiler) != 0 || BKTKContextAttach (&ctx, &renderCtx) != 0) {
+		fprintf (stderr, "%s: creating context failed\n", argv [1]);
+		goto cleanup;
+	}
+
+	for (BKInt i = 0; i < NUM_SECONDS; i ++) {
+		BKContextGenerate (&renderCtx, frames, SAMPLE_RATE);
+
+		if (fwrite (frames, sizeof (frames), 1, stdout) != 1) {
+			goto cleanup;
+		}
+	}
+
+	res = RESULT_PASS;
+
+	cleanup: {
+		BKTKContextDetach (&ctx);
+		BKDispose (&ctx);
+		BKDispose (&renderCtx);
+		BKDispose (&compiler);
+		BKDispose (&parser);
+		BKDispose (&tok);
+		BKStringDispose (&path);
+		BKStringDispose (&source);
+	}
+
+	return res;
+}
@@ -0,0 +1,27 @@
+#!/bin/sh
+
+# Programs have to render the same audio with compact code as with word
+# code. Examples which cannot be rendered with word code are skipped.
+
+res=0
+
+for file in $examples_dir/*.blip; do
+	NAME=`basename $file .blip`
+
+	if ! ./encoding-word $file > $NAME-word.raw 2> /dev/null; then
+		rm -f $NAME-word.raw
+		continue
+	fi
+
+	if ! ./encoding-compact $file > $NAME-compact.raw; then
+		echo "$NAME: compact program failed"
+		res=1
+	elif ! cmp $NAME-word.raw $NAME-compact.raw; then
+		echo "$NAME: compact output differs"
+		res=1
+	fi
+
+	rm -f $NAME-word.raw $NAME-compact.raw
+done
+
+exit $res
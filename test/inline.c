@@ -0,0 +1,144 @@
+#include "test.h"
+#include "BKTKContext.h"
+#include "BKTKParser.h"
+
+#define MAX_STEPS 10000
+#define NUM_NESTED (BK_INTR_STACK_SIZE + 2)
+
+static char const source [] =
+	"stepticks:24\n"
+	"[grp\n"
+	"	a:c4;s:1;r;s:1\n"
+	"]\n"
+	"[grp\n"
+	"	v:200;a:e4;s:2\n"
+	"	g:0g\n"
+	"]\n"
+	"[track:square\n"
+	"	[grp\n"
+	"		a:g3:c4;s:2;r;s:1\n"
+	"	]\n"
+	"	[grp\n"
+	"		a:d4\n"
+	"		s:1\n"
+	"		g:0\n"
+	"	]\n"
+	"	[grp\n"
+	"		a:f4;s:3\n"
+	"	]\n"
+	"	v:200\n"
+	"	g:0;g:0;g:1\n"
+	"	xb;g:1g;g:0g\n"
+	"	g:2;x\n"
+	"]\n"
+	"[track:triangle\n"
+	"	g:1g;g:1g\n"
+	"	g:0g;s:2;z\n"
+	"]\n";
+
+static BKInt put_tokens (BKTKToken const * tokens, BKUSize count, BKTKParser * parser)
+{
+	return BKTKParserPutTokens (parser, tokens, count);
+}
+
+/**
+ * Append line number and ticks of every step of all tracks to `out`
+ */
+static void step (BKString const * source, BKInt flags, BKString * out, BKUSize * outNumInlined)
+{
+	BKTKTokenizer tok;
+	BKTKParser parser;
+	BKTKCompiler compiler;
+	BKTKContext ctx;
+	BKTKToken tokens [256];
+	BKTKTrack * track;
+	BKInt ticks, res;
+
+	assert (BKTKTokenizerInit (&tok) == 0);
+	assert (BKTKParserInit (&parser) == 0);
+	assert (BKTKCompilerInit (&compiler) == 0);
+	assert (BKTKContextInit (&ctx, 0) == 0);
+
+	compiler.object.flags |= flags;
+
+	BKTKTokenizerPutCharsBatch (&tok, source -> str, source -> len, tokens, 256, (BKTKPutTokensFunc) put_tokens, &parser);
+	BKTKTokenizerPutCharsBatch (&tok, NULL, 0, tokens, 256, (BKTKPutTokensFunc) put_tokens, &parser);
+
+	assert (!BKTKTokenizerHasError (&tok));
+	assert (!BKTKParserHasError (&parser));
+	assert (BKTKCompilerCompile (&compiler, BKTKParserGetNodeTree (&parser)) == 0);
+
+	*outNumInlined = compiler.numInlinedCalls;
+	assert (BKTKContextCreate (&ctx, &compiler) == 0);
+
+	for (BKUSize i = 0; i < ctx.tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&ctx.tracks, i);
+
+		if (!track) {
+			continue;
+		}
+
+		BKStringAppendFormat (out, "track %u\n", (BKUInt) i);
+
+		for (BKInt j = 0; j < MAX_STEPS; j ++) {
+			ticks = 0;
+			res = BKTKInterpreterAdvance (&track -> interpreter, track, &ticks);
+			BKStringAppendFormat (out, "%d %d %d\n", track -> interpreter.lineno, ticks, res);
+
+			if (!res && (track -> interpreter.object.flags & BKTKInterpreterFlagHasStopped)) {
+				break;
+			}
+		}
+	}
+
+	BKDispose (&ctx);
+	BKDispose (&compiler);
+	BKDispose (&parser);
+	BKDispose (&tok);
+}
+
+/**
+ * Check that inlining doesn't change line numbers and timing
+ *
+ * Returns number of inlined calls
+ */
+static BKUSize check_inline (BKString const * source)
+{
+	BKUSize numInlined;
+	BKString expected = BK_STRING_INIT;
+	BKString result = BK_STRING_INIT;
+
+	step (source, 0, &expected, &numInlined);
+	assert (numInlined == 0);
+
+	step (source, BKTKCompilerFlagInline, &result, &numInlined);
+	assert (BKStringCompare (&result, (char const *) expected.str) == 0);
+
+	BKStringDispose (&result);
+	BKStringDispose (&expected);
+
+	return numInlined;
+}
+
+int main (int argc, char const * argv [])
+{
+	BKString string = BK_STRING_INIT;
+
+	BKStringAppend (&string, source);
+	assert (check_inline (&string) > 0);
+
+	// calls nested deeper than the interpreter stack
+	BKStringEmpty (&string);
+	BKStringAppend (&string, "[grp\n\ta:c4;s:1;r;s:1\n]\n");
+
+	for (BKInt i = 1; i < NUM_NESTED; i ++) {
+		BKStringAppendFormat (&string, "[grp\n\ts:1\n\tg:%dg\n]\n", i - 1);
+	}
+
+	BKStringAppendFormat (&string, "[track:square\n\tg:%dg;s:1;z\n]\n", NUM_NESTED - 1);
+	assert (check_inline (&string) == 0);
+
+	BKStringDispose (&string);
+
+	return RESULT_PASS;
+}
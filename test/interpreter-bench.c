@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <time.h>
+#include "test.h"
+#include "BKTKContext.h"
+#include "BKTKParser.h"
+
+#define MIN_SOURCE_SIZE (1 << 18)
+#define NUM_ROUNDS 20
+#define MAX_TICKS (1 << 24)
+
+static char const snippet [] =
+	"% global track\n"
+	"st:18; w:sqr; dc:8; v:200\n"
+	"a:c5; s:1; a:d#5; s:1; r; s:2\n"
+	"e:vs:16; a:g4:c5; p:-32; s:1\n"
+	"at:12; a:f#3+20; rt:6; s:1; m\n"
+	"e:vb:4:1200; v:180; a:h4; s:3\n";
+
+static double get_time (void)
+{
+	struct timespec time;
+
+	clock_gettime (CLOCK_MONOTONIC, &time);
+
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static BKInt put_tokens (BKTKToken const * tokens, BKUSize count, BKTKParser * parser)
+{
+	return BKTKParserPutTokens (parser, tokens, count);
+}
+
+static int load_source (BKString * source, char const * filename)
+{
+	FILE * file;
+	size_t size;
+	char buffer [16 * 1024];
+
+	if (!filename) {
+		while (source -> len < MIN_SOURCE_SIZE) {
+			BKStringAppend (source, snippet);
+		}
+
+		return 0;
+	}
+
+	file = fopen (filename, "rb");
+
+	if (!file) {
+		fprintf (stderr, "Could not open '%s'\n", filename);
+		return -1;
+	}
+
+	while ((size = fread (buffer, 1, sizeof (buffer), file)) > 0) {
+		BKStringAppendLen (source, buffer, size);
+	}
+
+	fclose (file);
+
+	return 0;
+}
+
+/**
+ * Run interpreters of all tracks until they end or repeat
+ *
+ * The tracks are silent, so only the interpreter is measured.
+ */
+static double run (BKTKContext * ctx, BKTKSnapshot const * snapshot, BKUSize * outSteps)
+{
+	double time;
+	BKInt ticks;
+	BKUSize numSteps = 0;
+	BKTKTrack * track;
+	BKTKInterpreter * interpreter;
+
+	assert (BKTKContextRestoreSnapshot (ctx, snapshot) == 0);
+
+	time = get_time ();
+
+	for (BKUSize i = 0; i < ctx -> tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&ctx -> tracks, i);
+
+		if (!track) {
+			continue;
+		}
+
+		interpreter = &track -> interpreter;
+
+		while (!(interpreter -> object.flags & (BKTKInterpreterFlagHasStopped | BKTKInterpreterFlagHasRepeated)) && interpreter -> time < MAX_TICKS) {
+			BKTKInterpreterAdvance (interpreter, track, &ticks);
+			numSteps ++;
+		}
+	}
+
+	time = get_time () - time;
+
+	*outSteps = numSteps;
+
+	return time;
+}
+
+int main (int argc, char const * argv [])
+{
+	double time, minTime = 1e9;
+	BKUSize numSteps = 0;
+	BKString source = BK_STRING_INIT;
+	BKTKTokenizer tok;
+	BKTKParser parser;
+	BKTKCompiler compiler;
+	BKTKContext ctx;
+	BKContext renderCtx;
+	BKTKSnapshot snapshot;
+	BKTKTree tree;
+	BKTKTrack * track;
+	BKTKToken tokens [256];
+
+	if (load_source (&source, argc > 1 ? argv [1] : NULL) != 0) {
+		return RESULT_ERROR;
+	}
+
+	assert (BKTKTokenizerInit (&tok) == 0);
+	assert (BKTKParserInit (&parser) == 0);
+	assert (BKTKCompilerInit (&compiler) == 0);
+	assert (BKTKContextInit (&ctx, 0) == 0);
+	assert (BKContextInit (&renderCtx, 2, 44100) == 0);
+	assert (BKTKSnapshotInit (&snapshot) == 0);
+
+	BKTKTokenizerPutCharsBatch (&tok, source.str, source.len, tokens, 256, (BKTKPutTokensFunc) put_tokens, &parser);
+	BKTKTokenizerPutCharsBatch (&tok, NULL, 0, tokens, 256, (BKTKPutTokensFunc) put_tokens, &parser);
+
+	assert (!BKTKTokenizerHasError (&tok));
+	assert (!BKTKParserHasError (&parser));
+	assert (BKTKTreeInit (&tree, BKTKParserGetNodeTree (&parser)) == 0);
+	assert (BKTKCompilerCompileTree (&compiler, &tree) == 0);
+	assert (BKTKContextCreate (&ctx, &compiler) == 0);
+	assert (BKTKContextAttach (&ctx, &renderCtx) == 0);
+
+	for (BKUSize i = 0; i < ctx.tracks.len; i ++) {
+		track = *(BKTKTrack **) BKArrayItemAt (&ctx.tracks, i);
+
+		if (track) {
+			track -> object.object.flags |= BKTKTrackFlagSilent;
+		}
+	}
+
+	assert (BKTKContextSaveSnapshot (&ctx, &snapshot) == 0);
+
+	printf ("%s code: %zu bytes, %zu tracks\n", BK_TK_COMPACT_CODE ? "compact" : "word", (size_t) ctx.codeSize, (size_t) ctx.tracks.len);
+
+	for (int round = 0; round < NUM_ROUNDS; round ++) {
+		time = run (&ctx, &snapshot, &numSteps);
+		minTime = time < minTime ? time : minTime;
+	}
+
+	printf ("advance: %6.2f ns/step, %zu steps\n", minTime * 1e9 / BKMax (numSteps, 1), (size_t) numSteps);
+
+	BKTKSnapshotDispose (&snapshot);
+	BKTKContextDetach (&ctx);
+	BKDispose (&ctx);
+	BKDispose (&renderCtx);
+	BKDispose (&tree);
+	BKDispose (&compiler);
+	BKDispose (&parser);
+	BKDispose (&tok);
+	BKStringDispose (&source);
+
+	return RESULT_PASS;
+}
@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include "test.h"
+#include "BKTKCompiler.h"
+#include "BKTKCompilerNames.h"
+#include "BKTKCompilerNameTables.h"
+
+static struct keyhash const * table;
+static BKUSize numNames;
+
+/**
+ * Check that `name` resolves to its value and flags
+ *
+ * The name with an additional char must not be found.
+ */
+static void check_name (char const * name, BKInt value, BKUInt flags)
+{
+	char other [32];
+	struct keyval const * item = BKTKNameFind (table, name);
+
+	assert (item != NULL);
+	assert (item -> value == value);
+	assert (item -> flags == flags);
+
+	snprintf (other, sizeof (other), "%s~", name);
+	assert (BKTKNameFind (table, other) == NULL);
+
+	numNames ++;
+}
+
+#define CHECK_NAME(name, value, flags) check_name (name, value, flags);
+
+/**
+ * Check all names of `list` in `hashTable`
+ *
+ * The table must not contain other names. Otherwise it was not regenerated
+ * after changing the list.
+ */
+#define CHECK_TABLE(list, hashTable) \
+	table = &hashTable; \
+	numNames = 0; \
+	list (CHECK_NAME) \
+	assert (numNames == table -> size);
+
+int main (int argc, char const * argv [])
+{
+	CHECK_TABLE (BK_NOTE_NAMES, noteNamesHash)
+	CHECK_TABLE (BK_CMD_NAMES, cmdNamesHash)
+	CHECK_TABLE (BK_EFFECT_NAMES, effectNamesHash)
+	CHECK_TABLE (BK_WAVEFORM_NAMES, waveformNamesHash)
+	CHECK_TABLE (BK_ENVELOPE_NAMES, envelopeNamesHash)
+	CHECK_TABLE (BK_MISC_NAMES, miscNamesHash)
+	CHECK_TABLE (BK_REPEAT_NAMES, repeatNamesHash)
+	CHECK_TABLE (BK_PULSE_NAMES, pulseNamesHash)
+
+	return RESULT_PASS;
+}
@@ -0,0 +1,28 @@
+#!/bin/sh
+
+# Programs compiled with `-O` have to render the same audio as without
+# optimization. Examples which cannot be rendered without `-O` are skipped.
+
+ARGS="-y -l 60s"
+res=0
+
+for file in $examples_dir/*.blip; do
+	NAME=`basename $file .blip`
+
+	if ! $bliplay $ARGS -o $NAME.wav $file > /dev/null 2>&1; then
+		rm -f $NAME.wav
+		continue
+	fi
+
+	if ! $bliplay $ARGS -O -o $NAME-opt.wav $file > /dev/null 2>&1; then
+		echo "$NAME: optimized program failed"
+		res=1
+	elif ! cmp $NAME.wav $NAME-opt.wav; then
+		echo "$NAME: optimized output differs"
+		res=1
+	fi
+
+	rm -f $NAME.wav $NAME-opt.wav
+done
+
+exit $res
@@ -0,0 +1,212 @@
+#include "test.h"
+#include "BKTKContext.h"
+#include "BKTKParser.h"
+
+#define NUM_FRAMES 44100
+
+static char const source [] =
+	"stepticks:24\n"
+	"[instr\n"
+	"	v:255:192:128:64:0\n"
+	"	a:<:0:700:>:0\n"
+	"]\n"
+	"[wave\n"
+	"	s:255:255:0:255:0:0:-128:-64\n"
+	"]\n"
+	"[grp\n"
+	"	a:c4;s:1;r;s:1\n"
+	"]\n"
+	"[track:square\n"
+	"	[grp\n"
+	"		a:g3:c4;s:2;r;s:1\n"
+	"	]\n"
+	"	i:0;w:0;v:200\n"
+	"	g:0;g:0;i;w:square\n"
+	"	e:vb:4:1200;a:e4;s:3;r;s:1\n"
+	"	g:0;z\n"
+	"]\n";
+
+static BKInt put_tokens (BKTKToken const * tokens, BKUSize count, BKTKParser * parser)
+{
+	return BKTKParserPutTokens (parser, tokens, count);
+}
+
+static BKInt write_bytes (BKByteBuffer * buffer, uint8_t const * data, BKUSize size)
+{
+	return BKByteBufferAppendBytes (buffer, data, size);
+}
+
+static void render (BKTKContext * ctx, BKFrame * frames)
+{
+	BKContext renderCtx;
+
+	assert (BKContextInit (&renderCtx, 2, 44100) == 0);
+	assert (BKTKContextAttach (ctx, &renderCtx) == 0);
+
+	BKContextGenerate (&renderCtx, frames, NUM_FRAMES);
+
+	BKTKContextDetach (ctx);
+	BKDispose (&renderCtx);
+}
+
+static BKInt load (void const * data, BKUSize size)
+{
+	BKInt res;
+	BKTKContext ctx;
+
+	assert (BKTKContextInit (&ctx, 0) == 0);
+	res = BKTKContextLoadProgram (&ctx, data, size);
+	BKDispose (&ctx);
+
+	return res;
+}
+
+int main (int argc, char const * argv [])
+{
+	uint8_t * data;
+	BKUSize size;
+	BKTKTokenizer tok;
+	BKTKParser parser;
+	BKTKCompiler compiler;
+	BKTKContext ctx, loaded;
+	BKByteBuffer buffer = BK_BYTE_BUFFER_INIT;
+	BKTKToken tokens [256];
+	uint32_t * header, save;
+#if !BK_TK_COMPACT_CODE
+	BKTKTrack * track = NULL;
+	uint32_t * code;
+	BKUSize numWords;
+	BKInstrMask mask;
+	BKInt numChecked = 0;
+#else
+	BKTKTrack * track = NULL;
+	uint8_t * code;
+	uint8_t end;
+#endif
+	static BKFrame frames [NUM_FRAMES * 2], loadedFrames [NUM_FRAMES * 2];
+
+	assert (BKTKTokenizerInit (&tok) == 0);
+	assert (BKTKParserInit (&parser) == 0);
+	assert (BKTKCompilerInit (&compiler) == 0);
+	assert (BKTKContextInit (&ctx, 0) == 0);
+	assert (BKTKContextInit (&loaded, 0) == 0);
+
+	BKTKTokenizerPutCharsBatch (&tok, (uint8_t const *) source, sizeof (source) - 1, tokens, 256, (BKTKPutTokensFunc) put_tokens, &parser);
+	BKTKTokenizerPutCharsBatch (&tok, NULL, 0, tokens, 256, (BKTKPutTokensFunc) put_tokens, &parser);
+
+	assert (!BKTKTokenizerHasError (&tok));
+	assert (!BKTKParserHasError (&parser));
+	assert (BKTKCompilerCompile (&compiler, BKTKParserGetNodeTree (&parser)) == 0);
+	assert (BKTKContextCreate (&ctx, &compiler) == 0);
+
+	// compile -> write -> load -> render
+	assert (BKTKContextWriteProgram (&ctx, (BKTKWriterWriteFunc) write_bytes, &buffer) == 0);
+	assert (BKByteBufferMakeContinuous (&buffer) == 0);
+
+	data = buffer.first -> data;
+	size = BKByteBufferSize (&buffer);
+	header = (uint32_t *) data;
+
+	assert (BKTKContextLoadProgram (&loaded, data, size) == 0);
+	assert (loaded.codeSize == ctx.codeSize);
+	assert (memcmp (loaded.code, ctx.code, ctx.codeSize) == 0);
+
+	render (&ctx, frames);
+	render (&loaded, loadedFrames);
+	assert (memcmp (frames, loadedFrames, sizeof (frames)) == 0);
+
+	// truncated program
+	assert (load (data, size - 4) != 0);
+	assert (load (data, size / 2) != 0);
+	assert (load (data, 20) != 0);
+
+	// different byte order
+	save = header [10];
+	header [10] = BK_TK_PROGRAM_BYTE_ORDER_SWAPPED;
+	assert (load (data, size) != 0);
+	header [10] = save;
+
+#if !BK_TK_COMPACT_CODE
+	// word code of last track
+	for (BKUSize i = 0; i < loaded.tracks.len; i ++) {
+		if (*(BKTKTrack **) BKArrayItemAt (&loaded.tracks, i)) {
+			track = *(BKTKTrack **) BKArrayItemAt (&loaded.tracks, i);
+		}
+	}
+
+	code = (uint32_t *) track -> code;
+	numWords = track -> codeSize / sizeof (uint32_t);
+
+	for (BKUSize i = 0; i < numWords; i += BKInstrMaskSize (mask)) {
+		mask.value = save = code [i];
+
+		// missing instrument
+		if (mask.arg1.cmd == BKIntrInstrument && mask.arg1.arg1 >= 0) {
+			mask.arg1.arg1 = 5;
+		}
+		// call target is not a group
+		else if (mask.arg1.cmd == BKIntrCall) {
+			mask.arg1.arg1 = 1;
+		}
+		else {
+			continue;
+		}
+
+		code [i] = mask.value;
+		assert (load (data, size) != 0);
+		code [i] = mask.value = save;
+		numChecked ++;
+	}
+
+	assert (numChecked == 4);
+
+	save = code [numWords - 1];
+
+	// missing end
+	mask.value = 0;
+	mask.arg1.cmd = BKIntrStep;
+	mask.arg1.arg1 = 1;
+	code [numWords - 1] = mask.value;
+	assert (load (data, size) != 0);
+
+	// argument words cross end of code
+	mask.arg1.cmd = BKIntrEffect;
+	code [numWords - 1] = mask.value;
+	assert (load (data, size) != 0);
+
+	code [numWords - 1] = save;
+#else
+	// compact code of last track
+	for (BKUSize i = 0; i < loaded.tracks.len; i ++) {
+		if (*(BKTKTrack **) BKArrayItemAt (&loaded.tracks, i)) {
+			track = *(BKTKTrack **) BKArrayItemAt (&loaded.tracks, i);
+		}
+	}
+
+	code = (uint8_t *) track -> code;
+	end = code [track -> codeSize - 1];
+	assert (end == BKIntrEnd);
+
+	// missing end
+	code [track -> codeSize - 1] = BKIntrMute;
+	assert (load (data, size) != 0);
+
+	// operand crosses end of code
+	code [track -> codeSize - 1] = BKIntrStep;
+	assert (load (data, size) != 0);
+
+	code [track -> codeSize - 1] = end;
+#endif
+
+	// restored program is valid again
+	assert (load (data, size) == 0);
+
+	BKDispose (&loaded);
+	BKDispose (&ctx);
+	BKByteBufferDispose (&buffer);
+	BKDispose (&compiler);
+	BKDispose (&parser);
+	BKDispose (&tok);
+
+	return RESULT_PASS;
+}
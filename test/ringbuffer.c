@@ -0,0 +1,34 @@
+#include "test.h"
+#include "BKRingBuffer.h"
+
+int main (int argc, char const * argv [])
+{
+	char data [8];
+	BKRingBuffer buffer;
+
+	assert (BKRingBufferInit (&buffer, 6) == 0);
+	assert (buffer.capacity == 8);
+	assert (BKRingBufferReadable (&buffer) == 0);
+	assert (BKRingBufferWritable (&buffer) == 8);
+
+	assert (BKRingBufferWrite (&buffer, "abcdef", 6) == 6);
+	assert (BKRingBufferRead (&buffer, data, 4) == 4);
+	assert (memcmp (data, "abcd", 4) == 0);
+
+	// wraps around
+	assert (BKRingBufferWrite (&buffer, "ghijklmn", 8) == 6);
+	assert (BKRingBufferReadable (&buffer) == 8);
+	assert (BKRingBufferWritable (&buffer) == 0);
+	assert (BKRingBufferRead (&buffer, data, 8) == 8);
+	assert (memcmp (data, "efghijkl", 8) == 0);
+
+	assert (BKRingBufferWrite (&buffer, "xyz", 3) == 3);
+	assert (BKRingBufferSkip (&buffer, 2) == 2);
+	assert (BKRingBufferRead (&buffer, data, 8) == 1);
+	assert (data [0] == 'z');
+	assert (BKRingBufferRead (&buffer, data, 8) == 0);
+
+	BKRingBufferDispose (&buffer);
+
+	return RESULT_PASS;
+}
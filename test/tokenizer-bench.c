@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <time.h>
+#include "test.h"
+#include "BKTKParser.h"
+
+#define READ_CHUNK_SIZE (16 * 1024)
+#define TOKEN_BATCH_SIZE 256
+#define MIN_SOURCE_SIZE (1 << 20)
+#define NUM_ROUNDS 20
+
+static char const snippet [] =
+	"% set speed\n"
+	"st:18\n"
+	"w:square; dc:8\n"
+	"[i:lead; v:0:4:8:16:24:32]\n"
+	"a:c5; s:1; a:c6\n"
+	"e:vs:9/1; v:0\n"
+	"s:9; r\n";
+
+struct source
+{
+	uint8_t * data;
+	size_t    size;
+};
+
+static double get_time (void)
+{
+	struct timespec time;
+
+	clock_gettime (CLOCK_MONOTONIC, &time);
+
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static BKInt put_token (BKTKToken const * token, BKTKParser * parser)
+{
+	return BKTKParserPutTokens (parser, token, 1);
+}
+
+static BKInt put_tokens (BKTKToken const * tokens, BKUSize count, BKTKParser * parser)
+{
+	return BKTKParserPutTokens (parser, tokens, count);
+}
+
+static BKInt count_token (BKTKToken const * token, size_t * count)
+{
+	(* count) ++;
+
+	return 0;
+}
+
+static int load_source (struct source * source, char const * filename)
+{
+	FILE * file;
+	size_t size;
+	uint8_t buffer [READ_CHUNK_SIZE];
+
+	if (!filename) {
+		while (source -> size < MIN_SOURCE_SIZE) {
+			source -> data = realloc (source -> data, source -> size + sizeof (snippet) - 1);
+			memcpy (&source -> data [source -> size], snippet, sizeof (snippet) - 1);
+			source -> size += sizeof (snippet) - 1;
+		}
+
+		return 0;
+	}
+
+	file = fopen (filename, "rb");
+
+	if (!file) {
+		fprintf (stderr, "Could not open '%s'\n", filename);
+		return -1;
+	}
+
+	while ((size = fread (buffer, 1, sizeof (buffer), file)) > 0) {
+		source -> data = realloc (source -> data, source -> size + size);
+		memcpy (&source -> data [source -> size], buffer, size);
+		source -> size += size;
+	}
+
+	fclose (file);
+
+	return 0;
+}
+
+/**
+ * Tokenize and parse `source` in chunks like reading from a file
+ *
+ * Delivers single tokens if `batchSize` is 0
+ */
+static double run (struct source const * source, BKUSize batchSize)
+{
+	double time;
+	BKTKTokenizer tok;
+	BKTKParser parser;
+	BKTKToken tokens [TOKEN_BATCH_SIZE];
+
+	assert (BKTKTokenizerInit (&tok) == 0);
+	assert (BKTKParserInit (&parser) == 0);
+
+	time = get_time ();
+
+	for (size_t offset = 0; ; offset += READ_CHUNK_SIZE) {
+		size_t size = 0;
+
+		if (offset < source -> size) {
+			size = source -> size - offset;
+			size = size < READ_CHUNK_SIZE ? size : READ_CHUNK_SIZE;
+		}
+
+		if (batchSize) {
+			BKTKTokenizerPutCharsBatch (&tok, &source -> data [offset], size, tokens, batchSize, (BKTKPutTokensFunc) put_tokens, &parser);
+		}
+		else {
+			BKTKTokenizerPutChars (&tok, &source -> data [offset], size, (BKTKPutTokenFunc) put_token, &parser);
+		}
+
+		if (!size) {
+			break;
+		}
+	}
+
+	time = get_time () - time;
+
+	assert (!BKTKTokenizerHasError (&tok));
+	assert (!BKTKParserHasError (&parser));
+
+	BKDispose (&parser);
+	BKDispose (&tok);
+
+	return time;
+}
+
+int main (int argc, char const * argv [])
+{
+	size_t numTokens = 0;
+	BKTKTokenizer tok;
+	struct source source = {0};
+	BKUSize const batchSizes [] = {0, 16, TOKEN_BATCH_SIZE};
+
+	if (load_source (&source, argc > 1 ? argv [1] : NULL) != 0) {
+		return RESULT_ERROR;
+	}
+
+	assert (BKTKTokenizerInit (&tok) == 0);
+	BKTKTokenizerPutChars (&tok, source.data, source.size, (BKTKPutTokenFunc) count_token, &numTokens);
+	BKTKTokenizerPutChars (&tok, NULL, 0, (BKTKPutTokenFunc) count_token, &numTokens);
+	BKDispose (&tok);
+
+	printf ("%zu bytes, %zu tokens\n", source.size, numTokens);
+
+	for (size_t i = 0; i < sizeof (batchSizes) / sizeof (*batchSizes); i ++) {
+		double time, minTime = 1e9;
+
+		for (int round = 0; round < NUM_ROUNDS; round ++) {
+			time = run (&source, batchSizes [i]);
+			minTime = time < minTime ? time : minTime;
+		}
+
+		if (batchSizes [i]) {
+			printf ("batch of %3u: %6.2f ns/token\n", (unsigned) batchSizes [i], minTime * 1e9 / numTokens);
+		}
+		else {
+			printf ("single token: %6.2f ns/token\n", minTime * 1e9 / numTokens);
+		}
+	}
+
+	free (source.data);
+
+	return RESULT_PASS;
+}
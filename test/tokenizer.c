@@ -0,0 +1,189 @@
+#include "test.h"
+#include "BKTKTokenizer.h"
+
+static char const lines [] =
+	"% comment with \"quote\n"
+	"a:c4;s:1\n"
+	"t:\"string with\n"
+	"line break\":\"esc\\\"aped\n"
+	"\"\n"
+	"[grp\n"
+	"	d:!\"ZGF0\n"
+	"	YQ==\n"
+	"\"\n"
+	"]\n"
+	"u:\"\\h263a;\"\n"
+	"\n";
+
+static BKInt put_tokens (BKTKToken const * tokens, BKUSize count, BKString * out)
+{
+	for (BKUSize i = 0; i < count; i ++) {
+		BKTKToken const * token = &tokens [i];
+
+		BKStringAppendFormat (out, "%d %u:%u %u:", token -> type, token -> offset.lineno, token -> offset.colno, (BKUInt) token -> dataLen);
+		BKStringAppendLen (out, (char const *) token -> data, token -> dataLen);
+		BKStringAppend (out, "\n");
+	}
+
+	return 0;
+}
+
+/**
+ * Append tokens and error of `source` to `out`
+ */
+static void tokenize (BKString const * source, BKUSize segmentSize, BKInt numJobs, BKString * out)
+{
+	BKTKTokenizer tok;
+	BKTKToken tokens [16];
+
+	assert (BKTKTokenizerInit (&tok) == 0);
+
+	if (numJobs) {
+		BKTKTokenizerPutResidentCharsSplit (&tok, source -> str, source -> len, segmentSize, numJobs, tokens, 16, (BKTKPutTokensFunc) put_tokens, out);
+	}
+	else {
+		BKTKTokenizerPutResidentChars (&tok, source -> str, source -> len, tokens, 16, (BKTKPutTokensFunc) put_tokens, out);
+	}
+
+	if (BKTKTokenizerHasError (&tok)) {
+		BKStringAppendFormat (out, "error: %s\n", tok.buffer);
+	}
+
+	BKDispose (&tok);
+}
+
+/**
+ * Append tokens and error of `source` to `out` when putting one char at a
+ * time, which never scans runs with vector instructions
+ */
+static void tokenize_chars (BKString const * source, BKString * out)
+{
+	BKTKTokenizer tok;
+	BKTKToken tokens [16];
+
+	assert (BKTKTokenizerInit (&tok) == 0);
+
+	for (BKUSize i = 0; i < source -> len; i ++) {
+		BKTKTokenizerPutCharsBatch (&tok, &source -> str [i], 1, tokens, 16, (BKTKPutTokensFunc) put_tokens, out);
+	}
+
+	BKTKTokenizerPutCharsBatch (&tok, NULL, 0, tokens, 16, (BKTKPutTokensFunc) put_tokens, out);
+
+	if (BKTKTokenizerHasError (&tok)) {
+		BKStringAppendFormat (out, "error: %s\n", tok.buffer);
+	}
+
+	BKDispose (&tok);
+}
+
+/**
+ * Check that runs of comments, arguments and spaces end at the same chars
+ * when scanned with and without vector instructions
+ *
+ * Each byte value is placed at every position of a vector.
+ */
+static void check_scan (void)
+{
+	BKString source = BK_STRING_INIT;
+	BKString expected = BK_STRING_INIT;
+	BKString result = BK_STRING_INIT;
+	char const * const runs [][3] = {
+		{"%", "x", "\n"},
+		{"a:", "x", "\n"},
+		{"a:1", " ", "b\n"},
+	};
+
+	for (BKInt i = 0; i < sizeof (runs) / sizeof (*runs); i ++) {
+		for (BKInt c = 0; c < 256; c ++) {
+			for (BKInt pos = 0; pos < 40; pos ++) {
+				BKStringEmpty (&source);
+				BKStringAppend (&source, runs [i][0]);
+
+				for (BKInt k = 0; k < 80; k ++) {
+					if (k == pos) {
+						BKStringAppendLen (&source, (char const *) &(uint8_t) {c}, 1);
+					}
+					else {
+						BKStringAppend (&source, runs [i][1]);
+					}
+				}
+
+				BKStringAppend (&source, runs [i][2]);
+
+				BKStringEmpty (&expected);
+				BKStringEmpty (&result);
+				tokenize_chars (&source, &expected);
+				tokenize (&source, 0, 0, &result);
+
+				// token data may contain null chars
+				assert (result.len == expected.len && BKStringCompareString (&result, &expected) == 0);
+			}
+		}
+	}
+
+	BKStringDispose (&result);
+	BKStringDispose (&expected);
+	BKStringDispose (&source);
+}
+
+/**
+ * Check that split tokenizing gives the same tokens, line numbers and
+ * errors as tokenizing in sequence
+ */
+static void check_split (BKString const * source, BKInt hasError)
+{
+	BKString expected = BK_STRING_INIT;
+	BKString result = BK_STRING_INIT;
+	BKUSize const segmentSizes [] = {1, 2, 3, 5, 8, 13, 21, 34, 55, 89, 144};
+
+	tokenize (source, 0, 0, &expected);
+	assert ((strstr ((char const *) expected.str, "error: ") != NULL) == hasError);
+
+	for (BKInt i = 0; i < sizeof (segmentSizes) / sizeof (*segmentSizes); i ++) {
+		for (BKInt numJobs = 2; numJobs <= 4; numJobs += 2) {
+			BKStringEmpty (&result);
+			tokenize (source, segmentSizes [i], numJobs, &result);
+
+			assert (BKStringCompare (&result, (char const *) expected.str) == 0);
+		}
+	}
+
+	BKStringDispose (&result);
+	BKStringDispose (&expected);
+}
+
+int main (int argc, char const * argv [])
+{
+	BKString source = BK_STRING_INIT;
+	BKString error = BK_STRING_INIT;
+
+	check_scan ();
+
+	for (BKInt i = 0; i < 20; i ++) {
+		BKStringAppend (&source, lines);
+	}
+
+	check_split (&source, 0);
+
+	// unterminated string
+	BKStringAppend (&error, (char const *) source.str);
+	BKStringAppend (&error, "v:\"string\n");
+
+	for (BKInt i = 0; i < 20; i ++) {
+		BKStringAppend (&error, "a:c4;s:1\n");
+	}
+
+	check_split (&error, 1);
+
+	// invalid data char following split point
+	BKStringEmpty (&error);
+	BKStringAppend (&error, lines);
+	BKStringAppend (&error, "d:!\"ZGF0\n$\"\n");
+	BKStringAppend (&error, (char const *) source.str);
+	check_split (&error, 1);
+
+	BKStringDispose (&error);
+	BKStringDispose (&source);
+
+	return RESULT_PASS;
+}
@@ -0,0 +1,98 @@
+#include "test.h"
+#include "BKTKTree.h"
+
+static char const source [] =
+	"% comment\n"
+	"stepticks:24; a:c4:e4\n"
+	"[instr\n"
+	"	v:255:192:128\n"
+	"]\n"
+	"[grp:1]\n"
+	"[% group comment\n"
+	"	a:g3\n"
+	"]\n"
+	"[track:square\n"
+	"	[grp\n"
+	"		a:g3:c4;s:2\n"
+	"		[sub\n"
+	"		]\n"
+	"	]\n"
+	"	i:0;g:0\n"
+	"]\n"
+	"x:\"string\":!\"ZGF0YQ==\"\n";
+
+static BKInt put_tokens (BKTKToken const * tokens, BKUSize count, BKTKParser * parser)
+{
+	return BKTKParserPutTokens (parser, tokens, count);
+}
+
+static void parse (BKTKTokenizer * tok, BKTKParser * parser)
+{
+	BKTKToken tokens [256];
+
+	BKTKTokenizerPutCharsBatch (tok, (uint8_t const *) source, sizeof (source) - 1, tokens, 256, (BKTKPutTokensFunc) put_tokens, parser);
+	BKTKTokenizerPutCharsBatch (tok, NULL, 0, tokens, 256, (BKTKPutTokensFunc) put_tokens, parser);
+
+	assert (!BKTKTokenizerHasError (tok));
+	assert (!BKTKParserHasError (parser));
+}
+
+static BKInt strings_equal (BKString const * a, BKString const * b)
+{
+	return a -> len == b -> len && memcmp (a -> str, b -> str, a -> len) == 0 && b -> str [b -> len] == '\0';
+}
+
+int main (int argc, char const * argv [])
+{
+	BKTKTokenizer tok;
+	BKTKParser parser;
+	BKTKTree copied, flat;
+
+	assert (BKTKTokenizerInit (&tok) == 0);
+	assert (BKTKParserInit (&parser) == 0);
+
+	// copy of linked nodes
+	parse (&tok, &parser);
+	assert (BKTKTreeInit (&copied, BKTKParserGetNodeTree (&parser)) == 0);
+
+	// nodes appended by parser
+	BKTKTokenizerReset (&tok);
+	BKTKParserReset (&parser);
+	assert (BKTKTreeInit (&flat, NULL) == 0);
+	BKTKParserSetTree (&parser, &flat);
+	parse (&tok, &parser);
+	assert (BKTKParserGetNodeTree (&parser) == NULL);
+
+	assert (flat.numNodes == copied.numNodes);
+	assert (flat.numSymbols == copied.numSymbols);
+
+	for (BKUSize i = 0; i < flat.numNodes; i ++) {
+		BKTKTreeNode const * a = &copied.nodes [i];
+		BKTKTreeNode const * b = &flat.nodes [i];
+
+		assert (a -> flags == b -> flags);
+		assert (a -> type == b -> type);
+		assert (a -> offset.lineno == b -> offset.lineno);
+		assert (a -> offset.colno == b -> offset.colno);
+		assert (a -> nextNode == b -> nextNode);
+		assert (a -> subNode == b -> subNode);
+		assert (a -> symbol == b -> symbol);
+		assert (a -> argCount == b -> argCount);
+
+		for (BKUSize j = 0; j <= a -> argCount; j ++) {
+			assert (strings_equal (&a -> name [j], &b -> name [j]));
+		}
+	}
+
+	for (BKUSize i = 0; i < flat.numSymbols; i ++) {
+		assert (strings_equal (copied.symbols [i], flat.symbols [i]));
+	}
+
+	BKTKParserReset (&parser);
+	BKDispose (&flat);
+	BKDispose (&copied);
+	BKDispose (&parser);
+	BKDispose (&tok);
+
+	return RESULT_PASS;
+}
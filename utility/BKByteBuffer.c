@@ -98,6 +98,7 @@ BKInt BKByteBufferReserve (BKByteBuffer * buf, BKUSize size)
 
 			if (buf -> ptr >= buf -> ptrEnd) {
 				seg = buf -> cur -> next;
+				buf -> cur = seg;
 				buf -> ptr = seg -> data;
 				buf -> ptrEnd = seg -> data + seg -> size;
 			}
@@ -115,6 +116,7 @@ BKInt BKByteBufferReserve (BKByteBuffer * buf, BKUSize size)
 
 		if (seg -> next) {
 			seg = seg -> next;
+			buf -> cur = seg;
 			buf -> ptr = seg -> data;
 			buf -> ptrEnd = seg -> data + seg -> size;
 		}
@@ -0,0 +1,91 @@
+#include "BKRingBuffer.h"
+
+BKInt BKRingBufferInit (BKRingBuffer * buffer, BKUSize capacity)
+{
+	BKUSize size = 1;
+
+	memset (buffer, 0, sizeof (*buffer));
+
+	while (size < capacity) {
+		size <<= 1;
+	}
+
+	buffer -> data = malloc (size);
+
+	if (!buffer -> data) {
+		return -1;
+	}
+
+	buffer -> capacity = size;
+	atomic_init (&buffer -> readPos, 0);
+	atomic_init (&buffer -> writePos, 0);
+
+	return 0;
+}
+
+void BKRingBufferDispose (BKRingBuffer * buffer)
+{
+	free (buffer -> data);
+	memset (buffer, 0, sizeof (*buffer));
+}
+
+BKUSize BKRingBufferReadable (BKRingBuffer const * buffer)
+{
+	BKUSize writePos = atomic_load_explicit (&buffer -> writePos, memory_order_acquire);
+	BKUSize readPos = atomic_load_explicit (&buffer -> readPos, memory_order_acquire);
+
+	return writePos - readPos;
+}
+
+BKUSize BKRingBufferWritable (BKRingBuffer const * buffer)
+{
+	return buffer -> capacity - BKRingBufferReadable (buffer);
+}
+
+BKUSize BKRingBufferWrite (BKRingBuffer * buffer, void const * data, BKUSize size)
+{
+	BKUSize offset, head;
+	BKUSize readPos = atomic_load_explicit (&buffer -> readPos, memory_order_acquire);
+	BKUSize writePos = atomic_load_explicit (&buffer -> writePos, memory_order_relaxed);
+
+	size = BKMin (size, buffer -> capacity - (writePos - readPos));
+	offset = writePos & (buffer -> capacity - 1);
+	head = BKMin (size, buffer -> capacity - offset);
+
+	// copy in two parts if wrapping around
+	memcpy (&buffer -> data [offset], data, head);
+	memcpy (buffer -> data, (char const *) data + head, size - head);
+
+	atomic_store_explicit (&buffer -> writePos, writePos + size, memory_order_release);
+
+	return size;
+}
+
+BKUSize BKRingBufferRead (BKRingBuffer * buffer, void * data, BKUSize size)
+{
+	BKUSize offset, head;
+	BKUSize writePos = atomic_load_explicit (&buffer -> writePos, memory_order_acquire);
+	BKUSize readPos = atomic_load_explicit (&buffer -> readPos, memory_order_relaxed);
+
+	size = BKMin (size, writePos - readPos);
+	offset = readPos & (buffer -> capacity - 1);
+	head = BKMin (size, buffer -> capacity - offset);
+
+	memcpy (data, &buffer -> data [offset], head);
+	memcpy ((char *) data + head, buffer -> data, size - head);
+
+	atomic_store_explicit (&buffer -> readPos, readPos + size, memory_order_release);
+
+	return size;
+}
+
+BKUSize BKRingBufferSkip (BKRingBuffer * buffer, BKUSize size)
+{
+	BKUSize writePos = atomic_load_explicit (&buffer -> writePos, memory_order_acquire);
+	BKUSize readPos = atomic_load_explicit (&buffer -> readPos, memory_order_relaxed);
+
+	size = BKMin (size, writePos - readPos);
+	atomic_store_explicit (&buffer -> readPos, readPos + size, memory_order_release);
+
+	return size;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2012-2016 Simon Schoenenberger
+ * http://blipkit.audio
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * @file
+ *
+ * A lock-free ring buffer for a single producer and a single consumer.
+ *
+ * The producer only calls the write functions and the consumer only calls the
+ * read functions. Both may run concurrently in different threads without
+ * locking. This allows reading from a real-time thread like an audio callback.
+ */
+
+#ifndef _BK_RING_BUFFER_H_
+#define _BK_RING_BUFFER_H_
+
+#include <stdatomic.h>
+#include "BKBase.h"
+
+typedef struct BKRingBuffer BKRingBuffer;
+
+/**
+ * The ring buffer struct.
+ */
+struct BKRingBuffer
+{
+	char            * data;     ///< The buffer data.
+	BKUSize           capacity; ///< The buffer capacity. Is a power of 2.
+	_Atomic (BKUSize) readPos;  ///< The total number of bytes read.
+	_Atomic (BKUSize) writePos; ///< The total number of bytes written.
+};
+
+/**
+ * Initialize ring buffer.
+ *
+ * @param buffer The ring buffer to be initialized.
+ * @param capacity The minimum capacity in bytes. Is rounded up to a power of 2.
+ * @return 0 on success.
+ */
+extern BKInt BKRingBufferInit (BKRingBuffer * buffer, BKUSize capacity);
+
+/**
+ * Dispose ring buffer.
+ *
+ * @param buffer The ring buffer to be disposed.
+ */
+extern void BKRingBufferDispose (BKRingBuffer * buffer);
+
+/**
+ * Get number of bytes which can be read.
+ *
+ * @param buffer The ring buffer.
+ * @return The number of readable bytes.
+ */
+extern BKUSize BKRingBufferReadable (BKRingBuffer const * buffer);
+
+/**
+ * Get number of bytes which can be written.
+ *
+ * @param buffer The ring buffer.
+ * @return The number of writable bytes.
+ */
+extern BKUSize BKRingBufferWritable (BKRingBuffer const * buffer);
+
+/**
+ * Write bytes to ring buffer. Must only be called by the producer.
+ *
+ * @param buffer The ring buffer to write to.
+ * @param data The bytes to write.
+ * @param size The number of bytes to write.
+ * @return The number of bytes written. Is less than `size` if the buffer is full.
+ */
+extern BKUSize BKRingBufferWrite (BKRingBuffer * buffer, void const * data, BKUSize size);
+
+/**
+ * Read bytes from ring buffer. Must only be called by the consumer.
+ *
+ * @param buffer The ring buffer to read from.
+ * @param data The buffer to read into.
+ * @param size The maximum number of bytes to read.
+ * @return The number of bytes read. Is less than `size` if not enough bytes are available.
+ */
+extern BKUSize BKRingBufferRead (BKRingBuffer * buffer, void * data, BKUSize size);
+
+/**
+ * Discard bytes from ring buffer. Must only be called by the consumer.
+ *
+ * @param buffer The ring buffer to discard bytes from.
+ * @param size The maximum number of bytes to discard.
+ * @return The number of bytes discarded.
+ */
+extern BKUSize BKRingBufferSkip (BKRingBuffer * buffer, BKUSize size);
+
+#endif /* ! _BK_RING_BUFFER_H_ */